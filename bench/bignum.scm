@@ -0,0 +1,15 @@
+(begin
+  ; Bignum arithmetic: balanced products large enough for Karatsuba, then
+  ; division through number->string and modulo.
+  (define (product lo hi)
+    (if (< lo hi)
+        ((lambda (mid) (* (product lo mid) (product (+ mid 1) hi)))
+         (quotient (+ lo hi) 2))
+        lo))
+  (define f (product 1 3000))
+  (display (string-length (number->string f)))
+  (newline)
+  (display (modulo f 1000000007))
+  (newline)
+  (display (= (quotient f (product 1 2999)) 3000))
+  (newline))
@@ -0,0 +1,10 @@
+(begin
+  ; GC stress: short-lived lists much larger than the initial heap.
+  (define (repeat n f)
+    (if (< n 2)
+        (f)
+        (begin (repeat (quotient n 2) f) (repeat (- n (quotient n 2)) f))))
+  (define keep (list-alloc 2000))
+  (repeat 300 (lambda () (list-alloc 3000)))
+  (display "gc ok")
+  (newline))
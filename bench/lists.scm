@@ -0,0 +1,11 @@
+(begin
+  ; List building with list-alloc and a Scheme-level append.
+  ; There are no tail calls, so loops split in half to keep recursion shallow.
+  (define (repeat n f)
+    (if (< n 2)
+        (f)
+        (begin (repeat (quotient n 2) f) (repeat (- n (quotient n 2)) f))))
+  (define (append a b) (if (null? a) b (cons (car a) (append (cdr a) b))))
+  (repeat 2000 (lambda () (append (list-alloc 40) (list-alloc 40))))
+  (display "lists ok")
+  (newline))
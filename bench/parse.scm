@@ -0,0 +1,27 @@
+(begin
+  ; Symbol-heavy parsing: read fs.scm from the disk image and evaluate it
+  ; repeatedly, which re-reads every form and re-interns every symbol.
+  (define (u8 off) (disk-read-byte off))
+  (define (u32 off)
+    (+ (u8 off)
+       (* 256 (u8 (+ off 1)))
+       (* 65536 (u8 (+ off 2)))
+       (* 16777216 (u8 (+ off 3)))))
+  (define fs-offset (u32 4))
+  (define dir-off (+ fs-offset (u32 (+ fs-offset 12))))
+  (define dir-limit (+ dir-off (u32 (+ fs-offset 16))))
+  (define (find-file name off)
+    (if (< off dir-limit)
+        (if (string=? (disk-read-cstring off 64) name)
+            (cons (+ fs-offset (u32 (+ off 64))) (u32 (+ off 68)))
+            (find-file name (+ off 76)))
+        #f))
+  (define info (find-file "fs.scm" dir-off))
+  (define fs-code (disk-read-bytes (car info) (cdr info)))
+  (define (repeat n f)
+    (if (< n 2)
+        (f)
+        (begin (repeat (quotient n 2) f) (repeat (- n (quotient n 2)) f))))
+  (repeat 40 (lambda () (eval-string fs-code)))
+  (display "parse ok")
+  (newline))
@@ -0,0 +1,11 @@
+(begin
+  ; String churn: build char lists, convert with list->string, compare.
+  (define (repeat n f)
+    (if (< n 2)
+        (f)
+        (begin (repeat (quotient n 2) f) (repeat (- n (quotient n 2)) f))))
+  (define (chars n acc)
+    (if (< n 1) acc (chars (- n 1) (cons (int->char (+ 97 (modulo n 26))) acc))))
+  (repeat 2000 (lambda () (string=? (list->string (chars 32 '())) (number->string 123456))))
+  (display "strings ok")
+  (newline))
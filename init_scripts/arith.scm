@@ -0,0 +1,13 @@
+; Native comparisons and the fixed-arity fast paths, with fixnums and bignums.
+(define big (* 65536 65536))
+(define (show-all xs)
+  (if (pair? xs)
+      (begin (display (car xs)) (display " ") (show-all (cdr xs)))
+      (newline)))
+(show-all (cons (> 3 2) (cons (> 2 3) (cons (<= 2 2) (cons (>= 1 2) (cons (> big 1) '()))))))
+(show-all (cons (< 1 2 3) (cons (< 1 3 2) (cons (= 4 4 4) (cons (>= 3 3 1) (cons (<= (- 0 big) 0 big) '()))))))
+(show-all (cons (not #f) (cons (not 0) (cons (zero? 0) (cons (zero? big) (cons (zero? -1) '()))))))
+(show-all (cons (1+ 41) (cons (1+ 2147483647) (cons (- (1+ big) big) '()))))
+(define (safe thunk) (guard (e (#t (error-object-message e))) (thunk)))
+(show-all (cons (safe (lambda () (< 1 "a"))) (cons (safe (lambda () (+ #t 1))) (cons (safe (lambda () (zero? "0"))) '()))))
+(show-all (cons (quotient 17 5) (cons (modulo -7 3) (cons (safe (lambda () (modulo 5 0))) '()))))
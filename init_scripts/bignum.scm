@@ -0,0 +1,28 @@
+; Integers past the fixnum range promote to bignums and demote back.
+(define (fact n) (if (< n 2) 1 (* n (fact (- n 1)))))
+(display (fact 30))
+(newline)
+(display (+ 2147483647 1))
+(newline)
+(display (- -2147483647 2))
+(newline)
+(display (- (* 65536 65536) 4294967296))
+(newline)
+(display 123456789012345678901234567890)
+(newline)
+(display (quotient (fact 30) (fact 28)))
+(newline)
+(display (modulo (- 0 (fact 25)) 1000000007))
+(newline)
+(display (< (fact 20) (fact 21)))
+(newline)
+(display (= (* (fact 20) 21) (fact 21)))
+(newline)
+(display (number->string (* -99999999999 99999999999)))
+(newline)
+(display (guard (e (#t (error-object-message e))) (+ (fact 20) "x")))
+(newline)
+(define ch (make-channel 1))
+(channel-send ch (fact 25))
+(display (channel-recv ch))
+(newline)
@@ -0,0 +1,12 @@
+(define jobs (make-channel 2))
+(define results (make-channel 2))
+(spawn-thread "(begin (define (work n) (if (< n 0) (channel-send 1 'done) (begin (channel-send 1 (cons n (* n n))) (work (channel-recv 0))))) (work (channel-recv 0)))")
+(channel-send jobs 3)
+(channel-send jobs 4)
+(channel-send jobs 5)
+(channel-send jobs -1)
+(define (show r)
+  (if (pair? r)
+      (begin (display (car r)) (display "^2=") (display (cdr r)) (newline) (show (channel-recv results)))
+      (begin (display "channel ") (display r) (newline))))
+(show (channel-recv results))
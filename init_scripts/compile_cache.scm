@@ -0,0 +1,13 @@
+(create-file "greet.scm" "(display 'hello) (newline)")
+(run-file "greet.scm")
+(run-file "greet.scm")
+(run-file "greet.scm")
+(display (compile-cache-hits))
+(newline)
+; Rewriting the file invalidates its cached forms.
+(create-file "greet.scm" "(display 'goodbye) (newline)")
+(run-file "greet.scm")
+(display (compile-cache-hits))
+(newline)
+(if (run-file "absent.scm") (display "absent ran") (display "absent missing"))
+(newline)
@@ -0,0 +1,38 @@
+(define (safe-div a b)
+  (if (= b 0)
+      (error "divide by zero" a)
+      (quotient a b)))
+(display (guard (e ((error-object? e) (error-object-message e))) (safe-div 1 0)))
+(newline)
+(display (guard (e ((error-object? e) (car (error-object-irritants e)))) (safe-div 7 0)))
+(newline)
+(display (guard (e ((eq? e 'oops) "caught symbol")) (raise 'oops)))
+(newline)
+(display (with-exception-handler (lambda (e) (* e 2)) (lambda () (+ 1 (raise 21)))))
+(newline)
+(guard (outer (#t (display "outer ") (display outer) (newline)))
+  (guard (inner ((eq? inner 'other) 0))
+    (raise 'passed)))
+(guard (e (#t (display e) (newline))) (car 1))
+(guard (e (#t (display e) (newline))) (eval-string "(1 2"))
+
+; Each raise unwinds 50 frames; leftover roots would overflow the stacks.
+(define (deep n)
+  (if (= n 0)
+      (raise 'bottom)
+      (+ 1 (deep (- n 1)))))
+(define (repeat n caught)
+  (if (= n 0)
+      caught
+      (repeat (- n 1) (guard (e ((eq? e 'bottom) (+ caught 1))) (deep 50)))))
+(display (repeat 30 0))
+(newline)
+
+(guard (e (#t (display "no threads") (newline)))
+  (spawn-thread "(begin (display 'child) (newline) (car 5))"))
+(yield)
+(yield)
+(display "main continues")
+(newline)
+(missing-procedure 1)
+(display "unreachable")
@@ -0,0 +1,38 @@
+; Under the copying collector (scheme-host --copying-gc) the structures
+; below move between pages while the churn runs.
+(define (churn n) (if (< 0 n) (begin (list-alloc 2000) (churn (- n 1))) 'done))
+(define (len l) (if (null? l) 0 (+ 1 (len (cdr l)))))
+(define (sum l) (if (null? l) 0 (+ (car l) (sum (cdr l)))))
+; eq? tables hash keys by address; they must find moved keys again.
+(define key-a (cons 'a '()))
+(define key-b (cons 1 2))
+(define t (make-hash-table))
+(hash-set! t key-a "first")
+(hash-set! t key-b "second")
+(churn 20)
+(display (hash-ref t key-a 'lost))
+(newline)
+(display (hash-ref t key-b 'lost))
+(newline)
+(display (hash-ref t (cons 'a '()) 'absent))
+(newline)
+(define v (make-vector 3 0))
+(vector-set! v 0 (cons 1 (cons 2 (cons 3 '()))))
+(vector-set! v 2 "kept")
+(define (make-counter n) (lambda () (set! n (+ n 1)) n))
+(define counter (make-counter 0))
+(counter)
+(churn 20)
+(display (vector-ref v 2))
+(newline)
+(display (sum (vector-ref v 0)))
+(newline)
+(display (counter))
+(newline)
+; Cells held only by unfinished calls survive too.
+(define (deep n) (if (= n 0) (begin (churn 5) (cons 'bottom '())) (cons n (deep (- n 1)))))
+(define d (deep 30))
+(display (len d))
+(newline)
+(display "copying gc ok")
+(newline)
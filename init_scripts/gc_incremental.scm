@@ -0,0 +1,37 @@
+; The boot interpreter collects incrementally, so the stores below land in
+; structures the collector may already have marked; each must keep the new
+; data alive until the cycle ends.
+(define (churn n) (if (< 0 n) (begin (list-alloc 500) (churn (- n 1))) 'done))
+(define (count-up n acc) (if (= n 0) acc (count-up (- n 1) (cons n acc))))
+(define (sum l) (if (null? l) 0 (+ (car l) (sum (cdr l)))))
+(define held '())
+(define v (make-vector 4 0))
+(define t (make-hash-table))
+(define (mutate i)
+  (if (< i 40)
+      (begin
+        (set! held (count-up 10 '()))
+        (vector-set! v (modulo i 4) (count-up 20 '()))
+        (hash-set! t (modulo i 3) (count-up 30 '()))
+        (churn 2)
+        (mutate (+ i 1)))
+      'done))
+(mutate 0)
+(churn 20)
+(display (sum held))
+(newline)
+(display (+ (sum (vector-ref v 0)) (sum (vector-ref v 3))))
+(newline)
+(display (+ (sum (hash-ref t 0 '())) (sum (hash-ref t 2 '()))))
+(newline)
+; A global defined mid-cycle and a list read while the collector runs.
+(churn 3)
+(define late (count-up 15 '()))
+(define quoted (car (parse-string "(1 2 3 4 5 6 7 8 9 10 11 12)")))
+(churn 20)
+(display (sum late))
+(newline)
+(display (sum quoted))
+(newline)
+(display "incremental gc ok")
+(newline)
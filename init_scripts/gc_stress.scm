@@ -3,3 +3,13 @@
 (define ys (list-alloc 1600))
 (display "gc stress ok")
 (newline)
+(define (churn n) (if (< 0 n) (begin (list-alloc 4000) (churn (- n 1))) 'done))
+(churn 10)
+(define (stat name l) (if (null? l) -1 (if (eq? (car (car l)) name) (cdr (car l)) (stat name (cdr l)))))
+(define stats (gc-stats))
+(if (< 0 (stat 'collections stats)) (display "collections counted") (display "no collections"))
+(newline)
+(if (< 0 (stat 'cells-freed stats)) (display "cells freed counted") (display "no cells freed"))
+(newline)
+(if (< (stat 'live-cells stats) (stat 'heap-cells stats)) (display "live below heap") (display "live above heap"))
+(newline)
@@ -0,0 +1,34 @@
+(define t (make-hash-table))
+(hash-set! t 'apple 1)
+(hash-set! t 'pear 2)
+(hash-set! t 42 "forty-two")
+(display (hash-ref t 'pear))
+(newline)
+(display (hash-ref t 42))
+(newline)
+(display (hash-ref t 'plum 'none))
+(newline)
+; Grow well past the initial size, then delete every other key.
+; Recursion splits the range in half since there are no tail calls.
+(define (each lo hi f)
+  (if (< lo hi)
+      (if (= (+ lo 1) hi)
+          (f lo)
+          (begin (each lo (quotient (+ lo hi) 2) f) (each (quotient (+ lo hi) 2) hi f)))
+      0))
+(each 1 1001 (lambda (n) (hash-set! t n (* n n))))
+(each 1 1001 (lambda (n) (if (= (modulo n 2) 0) (hash-remove! t n) #f)))
+(display (hash-count t))
+(newline)
+(display (hash-ref t 999))
+(newline)
+(if (hash-ref t 998) (display "removed key found") (display "removed key gone"))
+(newline)
+(define s (make-string-hash-table))
+(hash-set! s "init.scm" 'boot)
+(hash-set! s (string-append "fs" ".scm") 'lib)
+(display (hash-ref s (substring "xfs.scm" 1 7)))
+(newline)
+(hash-remove! s "init.scm")
+(display (hash-count s))
+(newline)
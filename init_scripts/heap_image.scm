@@ -0,0 +1,6 @@
+(define (stat name l) (if (null? l) -1 (if (eq? (car (car l)) name) (cdr (car l)) (stat name (cdr l)))))
+(display "prelude ready")
+(newline)
+(display "allocated ")
+(display (stat 'cells-allocated (gc-stats)))
+(newline)
@@ -0,0 +1,7 @@
+(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+(profile-start)
+(fib 24)
+(fib 24)
+(define samples (profile-dump))
+(if (< 0 samples) (display "profile has samples") (display "profile empty"))
+(newline)
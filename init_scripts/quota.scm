@@ -0,0 +1,16 @@
+; Each child runs under a lowered quota and is stopped when it runs out,
+; even through its own guard, while this thread carries on.
+(define (quota name n) (cons (cons name n) '()))
+(spawn-thread "(begin (define (spin n) (if (= n 0) 0 (begin (spin (- n 1)) (spin (- n 1))))) (guard (e (#t (display 'caught) (newline))) (spin 40)))" (quota 'cpu-ticks 5))
+(spawn-thread "(begin (define (out n) (if (= n 0) 0 (begin (display \"0123456789\") (out (- n 1))))) (out 10))" (quota 'output-bytes 25))
+; Asking for more than the default gets the default.
+(spawn-thread "(begin (display 'child-cpu-limit) (display (cdr (car (cdr (cdr (cdr (cdr (cdr (thread-stats))))))))) (newline))" (quota 'cpu-ticks 1000000))
+(define (wait n) (if (= n 0) 0 (begin (yield) (wait (- n 1)))))
+(wait 20)
+(newline)
+(display "parent alive")
+(newline)
+(define (lookup key xs) (if (eq? (car (car xs)) key) (cdr (car xs)) (lookup key (cdr xs))))
+(display "parent cpu-limit ")
+(display (lookup 'cpu-limit (thread-stats)))
+(newline)
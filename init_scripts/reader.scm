@@ -0,0 +1,19 @@
+; Reader edge cases: delimiters as character literals, named characters,
+; comments right after a token, and tokens that only start like numbers.
+(display (char->int #\())
+(newline)
+(display (char->int #\)))
+(newline)
+(display (char->int #\space))
+(newline)
+(define x;no space before the comment
+  -12)
+(display x)
+(newline)
+(display (string-length "a;b"))
+(newline)
+(define 1+ (lambda (n) (+ n 1)))
+(display (1+ 41))
+(newline)
+(display (- 0 2147483647))
+(newline)
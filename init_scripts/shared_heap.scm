@@ -0,0 +1,6 @@
+; Spawned threads share the frozen prelude heap; what one thread defines or
+; set!s over a prelude name is its own and leaves the others untouched.
+(define t1 (spawn-thread "(begin (define (cadr x) 'mine) (set! append (lambda (a b) 'appended)) (yield) (display (if (eq? (cadr 1) 'mine) 't1-shadowed 't1-broken)) (newline) (display (if (eq? (append 1 2) 'appended) 't1-set 't1-broken)) (newline))"))
+(define t2 (spawn-thread "(begin (yield) (yield) (display (if (= (cadr (append (cons 1 (cons 2 '())) (cons 3 '()))) 2) 't2-shared 't2-broken)) (newline))"))
+(display "spawned")
+(newline)
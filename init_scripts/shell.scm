@@ -2,18 +2,6 @@
 (define space (int->char 32))
 (define newline-ch (int->char 10))
 
-(define (append a b)
-  (if (null? a)
-      b
-      (cons (car a) (append (cdr a) b))))
-
-(define (string->revlist s)
-  (define (loop i acc)
-    (if (< i (string-length s))
-        (loop (+ i 1) (cons (string-ref s i) acc))
-        acc))
-  (loop 0 '()))
-
 (define (string-trim-left s)
   (define (loop i)
     (if (< i (string-length s))
@@ -37,35 +25,13 @@
   (define end (string-trim-right s))
   (if (< end start)
       ""
-      (begin
-        (define (slice i acc)
-          (if (> i end)
-              (list->string (reverse-list acc))
-              (slice (+ i 1) (cons (string-ref s i) acc))))
-        (slice start '()))))
+      (substring s start (+ end 1))))
 
 (define (split-first s)
-  (define (loop i)
-    (if (< i (string-length s))
-        (if (char=? (string-ref s i) space)
-            i
-            (loop (+ i 1)))
-        i))
-  (define sep (loop 0))
-  (if (= sep (string-length s))
-      (cons s (cons "" '()))
-      (begin
-        (define (take i acc)
-          (if (= i sep)
-              (list->string (reverse-list acc))
-              (take (+ i 1) (cons (string-ref s i) acc))))
-        (define (drop i acc)
-          (if (= i (string-length s))
-              (list->string (reverse-list acc))
-              (drop (+ i 1) (cons (string-ref s i) acc))))
-        (define head (take 0 '()))
-        (define tail (string-trim (drop (+ sep 1) '())))
-        (cons head (cons tail '())))))
+  (define sep (string-index s space))
+  (if sep
+      (cons (substring s 0 sep) (cons (string-trim (substring s (+ sep 1))) '()))
+      (cons s (cons "" '()))))
 
 (define (print-lines xs)
   (if (null? xs)
@@ -81,28 +47,28 @@
       (begin (display contents) (newline))
       (begin (display "missing file") (newline))))
 
+; A failing program reports its error and returns to the prompt.
 (define (cmd-exec name)
-  (define contents (read-text-file name))
-  (if contents
-      (eval-string contents)
-      (begin (display "missing file") (newline))))
+  (guard (e ((error-object? e) (display "error: ") (display e) (newline))
+            (else (display "error: uncaught raise") (newline)))
+    (if (run-file name)
+        0
+        (begin (display "missing file") (newline)))))
 
-(define (create-loop name acc)
+(define (create-loop name buf)
   (define line (readline))
-  (if (not line)
+  (if (if line (string=? (string-trim line) "EOF") #t)
       (begin
-        (create-file name (list->string (reverse-list acc)))
+        (create-file name (string-builder->string buf))
         (display "ok")
         (newline))
-      (if (string=? (string-trim line) "EOF")
-          (begin
-            (create-file name (list->string (reverse-list acc)))
-            (display "ok")
-            (newline))
-          (create-loop name (append (cons newline-ch (string->revlist line)) acc)))))
+      (begin
+        (string-builder-append! buf line)
+        (string-builder-append! buf newline-ch)
+        (create-loop name buf))))
 
 (define (cmd-create name)
-  (create-loop name '()))
+  (create-loop name (make-string-builder 256)))
 
 (define (cmd-help)
   (display "commands:") (newline)
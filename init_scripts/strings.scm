@@ -0,0 +1,19 @@
+(display (substring "hello world" 6 11))
+(newline)
+(display (string-append "con" "cat" "enate"))
+(newline)
+(display (string-index "a=b" #\=))
+(newline)
+(if (string-index "abc" #\z) (display "index wrong") (display "index missing ok"))
+(newline)
+(display (string-length (make-string 5 #\x)))
+(newline)
+(define sb (make-string-builder))
+(define (fill n) (if (< 0 n) (begin (string-builder-append! sb "ab") (string-builder-append! sb #\c) (fill (- n 1))) 0))
+(fill 100)
+(string-builder-truncate! sb 299)
+(define built (string-builder->string sb))
+(display (string-length built))
+(newline)
+(display (substring built 294 299))
+(newline)
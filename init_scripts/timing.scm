@@ -0,0 +1,8 @@
+(define t0 (current-time-ns))
+(sleep-ns 2000000)
+(define slept (- (current-time-ns) t0))
+(if (< slept 2000000) (display "sleep too short") (display "sleep long enough"))
+(newline)
+; A 2ms sleep must not be rounded up to the 10ms timer tick.
+(if (< slept 10000000) (display "sleep was sub-tick") (display "sleep waited for a tick"))
+(newline)
@@ -0,0 +1,13 @@
+(define t1 (spawn-thread "(begin (yield) (display 'worker) (newline))"))
+(yield)
+(yield)
+(define (churn n) (if (< 0 n) (begin (list-alloc 4000) (churn (- n 1))) 'done))
+(churn 6)
+(create-file "traced.txt" "trace me")
+(display "trace start")
+(newline)
+(define n (trace-dump))
+(newline)
+(display "trace records ")
+(display n)
+(newline)
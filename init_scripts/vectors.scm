@@ -0,0 +1,29 @@
+(define v (make-vector 3 0))
+(vector-set! v 1 'b)
+(vector-set! v 2 "c")
+(if (eq? (vector-ref v 1) 'b) (display "vector ok") (display "vector wrong"))
+(newline)
+(define bv (make-bytevector 8 0))
+(bytevector-u32-le-set! bv 4 305419896)
+(display (bytevector-u8-ref bv 4))
+(newline)
+(display (bytevector-u32-le-ref bv 4))
+(newline)
+(display (utf8->string (string->utf8 "bytes round trip")))
+(newline)
+; Unreachable storage is returned by the collector.
+(define (churn n) (if (< 0 n) (begin (make-bytevector 4096 1) (churn (- n 1))) 'done))
+(churn 200)
+(display "bytevector churn ok")
+(newline)
+; An empty write succeeds without touching the disk.
+(display (disk-write-bytevector 0 (make-bytevector 0 0)))
+(newline)
+; Rewriting a file replaces its directory entry instead of adding another.
+(create-file "vec.txt" "first")
+(create-file "vec.txt" "second")
+(display (read-text-file "vec.txt"))
+(newline)
+(define (count-named name l) (if (null? l) 0 (+ (if (string=? (car l) name) 1 0) (count-named name (cdr l)))))
+(display (count-named "vec.txt" (list-files)))
+(newline)
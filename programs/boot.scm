@@ -1,12 +1,7 @@
 (begin
   ; boot.scm runs as the first Scheme program.
   ; It loads fs.scm in a privileged environment, then runs init.scm.
-  (define (u8 off) (disk-read-byte off))
-  (define (u32 off)
-    (+ (u8 off)
-       (* 256 (u8 (+ off 1)))
-       (* 65536 (u8 (+ off 2)))
-       (* 16777216 (u8 (+ off 3)))))
+  (define (u32 off) (bytevector-u32-le-ref (disk-read-bytevector off 4) 0))
   (define (cadr x) (car (cdr x)))
   (define (list a b) (cons a (cons b '())))
 
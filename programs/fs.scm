@@ -1,11 +1,6 @@
 (begin
   ; Filesystem helpers and restricted init loader.
-  (define (u8 off) (disk-read-byte off))
-  (define (u32 off)
-    (+ (u8 off)
-       (* 256 (u8 (+ off 1)))
-       (* 65536 (u8 (+ off 2)))
-       (* 16777216 (u8 (+ off 3)))))
+  (define (u32 off) (bytevector-u32-le-ref (disk-read-bytevector off 4) 0))
   (define (cadr x) (car (cdr x)))
   (define (list a b) (cons a (cons b '())))
 
@@ -19,29 +14,47 @@
   (define dir-off (+ fs-offset (u32 (+ sb 12))))
   (define dir-len (u32 (+ sb 16)))
   (define data-off (u32 (+ sb 20)))
-  (define dir-limit (+ dir-off dir-len))
-
-  ; Find a file by name in the flat directory table.
-  (define (find-file-loop name off)
-    (if (< off dir-limit)
-        (if (string=? (disk-read-cstring off 64) name)
-            (list (+ fs-offset (u32 (+ off 64))) (u32 (+ off 68)))
-            (find-file-loop name (+ off 76)))
+
+  ; The directory table is read into a bytevector with one call and scanned
+  ; in memory. Entry positions below are byte offsets into that table.
+  (define (read-dir) (disk-read-bytevector dir-off dir-len))
+
+  ; Name of the entry at pos; names are NUL-padded to 64 bytes.
+  (define (entry-name dir pos)
+    (define (name-end i)
+      (if (< i (+ pos 64))
+          (if (= (bytevector-u8-ref dir i) 0) i (name-end (+ i 1)))
+          i))
+    (utf8->string dir pos (name-end pos)))
+
+  (define (entry-free? dir pos) (= (bytevector-u8-ref dir pos) 0))
+
+  ; Find a file by name; return its entry position or #f.
+  (define (find-entry dir name pos)
+    (if (< pos dir-len)
+        (if (string=? (entry-name dir pos) name)
+            pos
+            (find-entry dir name (+ pos 76)))
         #f))
 
-  (define (find-file name) (find-file-loop name dir-off))
+  (define (find-file name)
+    (define dir (read-dir))
+    (define pos (find-entry dir name 0))
+    (if pos
+        (list (+ fs-offset (bytevector-u32-le-ref dir (+ pos 64)))
+              (bytevector-u32-le-ref dir (+ pos 68)))
+        #f))
 
   ; List all filenames in the directory table.
   (define (list-files)
-    (define (loop off acc)
-      (if (< off dir-limit)
-          (begin
-            (define name (disk-read-cstring off 64))
-            (if (string=? name "")
-                (loop (+ off 76) acc)
-                (loop (+ off 76) (cons name acc))))
+    (define dir (read-dir))
+    (define (loop pos acc)
+      (if (< pos dir-len)
+          (if (entry-free? dir pos)
+              (loop (+ pos 76) acc)
+              (loop (+ pos 76) (cons (entry-name dir pos) acc)))
           acc))
-    (reverse-list (loop dir-off '())))
+    (reverse-list (loop 0 '())))
 
   ; Load an entire file as a string; return #f if missing.
   (define (read-text-file name)
@@ -51,96 +64,103 @@
           (disk-read-bytes (car info) (cadr info))
           #f)))
 
-  (define (string->list s)
-    (define (loop i acc)
-      (if (< i 0)
-          acc
-          (loop (- i 1) (cons (string-ref s i) acc))))
-    (loop (- (string-length s) 1) '()))
-
-  (define (append a b)
-    (if (null? a)
-        b
-        (cons (car a) (append (cdr a) b))))
-
-  (define (make-filled-string n ch)
-    (define (loop i acc)
-      (if (< i 1)
-          (list->string acc)
-          (loop (- i 1) (cons ch acc))))
-    (loop n '()))
-
   (define (write-bytes off s)
     (disk-write-bytes off s))
 
-  (define (write-u32 off v)
-    (define (b n) (int->char (modulo n 256)))
-    (write-bytes off (list->string (list (b v)
-                                         (b (quotient v 256))
-                                         (b (quotient v 65536))
-                                         (b (quotient v 16777216))))))
-
-  (define (write-dir-entry off name data-off len)
-    (define name-list (string->list name))
-    (define pad-len (- 64 (string-length name)))
-    (define padded (append name-list (string->list (make-filled-string pad-len (int->char 0)))))
-    (write-bytes off (list->string padded))
-    (write-u32 (+ off 64) data-off)
-    (write-u32 (+ off 68) len)
-    (write-u32 (+ off 72) 0))
-
-  (define (clear-dir-entry off)
-    (write-bytes off (make-filled-string 76 (int->char 0))))
-
-  (define (find-empty-entry off)
-    (if (< off dir-limit)
-        (if (string=? (disk-read-cstring off 1) "")
-            off
-            (find-empty-entry (+ off 76)))
+  (define (write-dir-entry pos name data-off len)
+    (define entry (make-bytevector 76 0))
+    (bytevector-copy! entry 0 (string->utf8 name))
+    (bytevector-u32-le-set! entry 64 data-off)
+    (bytevector-u32-le-set! entry 68 len)
+    (disk-write-bytevector (+ dir-off pos) entry))
+
+  (define (clear-dir-entry pos)
+    (disk-write-bytevector (+ dir-off pos) (make-bytevector 76 0)))
+
+  (define (find-empty-entry dir pos)
+    (if (< pos dir-len)
+        (if (entry-free? dir pos)
+            pos
+            (find-empty-entry dir (+ pos 76)))
         #f))
 
-  (define (data-end off current)
-    (if (< off dir-limit)
-        (begin
-          (define name (disk-read-cstring off 64))
-          (if (string=? name "")
-              (data-end (+ off 76) current)
-              (begin
-                (define data-off (u32 (+ off 64)))
-                (define len (u32 (+ off 68)))
-                (define end (+ data-off len))
-                (data-end (+ off 76) (if (< current end) end current)))))
+  ; End of the last file's data, relative to fs-offset.
+  (define (data-end dir pos current)
+    (if (< pos dir-len)
+        (if (entry-free? dir pos)
+            (data-end dir (+ pos 76) current)
+            (begin
+              (define end (+ (bytevector-u32-le-ref dir (+ pos 64))
+                             (bytevector-u32-le-ref dir (+ pos 68))))
+              (data-end dir (+ pos 76) (if (< current end) end current))))
         current))
 
   (define (create-file name contents)
     (begin
-      (define existing (find-file name))
-      (if existing
-          (delete-file name)
-          0)
-      (define entry (find-empty-entry dir-off))
-      (if (not entry)
-          (begin (display "no free dir slots") (newline) #f)
-          (begin
-            (define end (data-end dir-off data-off))
-            (define len (string-length contents))
-            (define abs-off (+ fs-offset end))
-            (if (> (+ abs-off len) (disk-size))
-                (begin (display "disk full") (newline) #f)
-                (begin
-                  (write-bytes abs-off contents)
-                  (write-dir-entry entry name end len)
-                  #t))))))
+      (delete-file name)
+      (define dir (read-dir))
+      (define entry (find-empty-entry dir 0))
+      (if (> (string-length name) 64)
+          (begin (display "name too long") (newline) #f)
+          (if (not entry)
+              (begin (display "no free dir slots") (newline) #f)
+              (begin
+                (define end (data-end dir 0 data-off))
+                (define len (string-length contents))
+                (define abs-off (+ fs-offset end))
+                (if (> (+ abs-off len) (disk-size))
+                    (begin (display "disk full") (newline) #f)
+                    (begin
+                      (write-bytes abs-off contents)
+                      (write-dir-entry entry name end len)
+                      #t)))))))
 
   (define (delete-file name)
-    (begin
-      (define info (find-file name))
-      (if info
-          (begin
-            (define off (car info))
-            (clear-dir-entry (- off 64))
-            #t)
-          #f)))
+    (define pos (find-entry (read-dir) name 0))
+    (hash-remove! compile-cache name)
+    (if pos
+        (begin (clear-dir-entry pos) #t)
+        #f))
+
+  ; Parsed forms of loaded files, keyed by name. An entry is
+  ; #(offset length hash forms); create-file and delete-file drop it, and
+  ; a hash mismatch (e.g. after raw disk-write-bytes) forces a re-parse.
+  ; A hit skips copying the file into the string arena and re-reading it.
+  (define compile-cache (make-string-hash-table))
+  (define cache-hits 0)
+  (define (compile-cache-hits) cache-hits)
+
+  (define (cache-valid? entry off len hash)
+    (if entry
+        (if (= (vector-ref entry 0) off)
+            (if (= (vector-ref entry 1) len) (= (vector-ref entry 2) hash) #f)
+            #f)
+        #f))
+
+  ; Parsed forms of a file, or #f if it is missing.
+  (define (file-forms name)
+    (define info (find-file name))
+    (if info
+        (begin
+          (define off (car info))
+          (define len (cadr info))
+          (define hash (disk-hash off len))
+          (define entry (hash-ref compile-cache name))
+          (if (cache-valid? entry off len hash)
+              (begin
+                (set! cache-hits (+ cache-hits 1))
+                (vector-ref entry 3))
+              (begin
+                (define forms (parse-string (disk-read-bytes off len)))
+                (hash-set! compile-cache name (vector off len hash forms))
+                forms)))
+        #f))
+
+  ; Run a file in the global environment, as eval-string would.
+  ; Returns the number of forms run, or #f if the file is missing.
+  (define (run-file name)
+    (define forms (file-forms name))
+    (if forms (eval-forms forms) #f))
 
   ; Reverse a list (used by read-string).
   (define (reverse-list xs)
@@ -151,80 +171,122 @@
     (rev xs '()))
 
   ; Read a line from serial input with echo + backspace support.
+  ; Characters accumulate in a string builder, so each keystroke is O(1).
   (define bs (int->char 8))
   (define del (int->char 127))
   (define skip-lf #f)
   (define (read-string)
+    (define buf (make-string-builder 64))
     (define (erase)
       (display bs)
       (display (int->char 32))
       (display bs))
-    (define (loop acc)
+    (define (finish) (string-builder->string buf))
+    (define (loop)
       (define ch (read-char))
-      (if skip-lf
+      (if (if skip-lf (char=? ch #\newline) #f)
+          (begin (set! skip-lf #f) (loop))
+          (begin (set! skip-lf #f) (handle ch))))
+    (define (handle ch)
+      (if (char=? ch (int->char 4))
+          (if (= (string-builder-length buf) 0) #f (finish))
           (if (char=? ch #\newline)
-              (begin (set! skip-lf #f) (loop acc))
-              (begin (set! skip-lf #f)
-                     (if (char=? ch (int->char 4))
-                         (if (null? acc) #f (list->string (reverse-list acc)))
-                         (if (char=? ch #\newline)
-                             (begin (newline) (list->string (reverse-list acc)))
-                             (if (char=? ch #\return)
-                                 (begin (set! skip-lf #t) (newline) (list->string (reverse-list acc)))
-                                 (if (char=? ch bs)
-                                     (if (null? acc)
-                                         (loop acc)
-                                         (begin (erase) (loop (cdr acc))))
-                                     (if (char=? ch del)
-                                         (if (null? acc)
-                                             (loop acc)
-                                             (begin (erase) (loop (cdr acc))))
-                                         (begin (display ch) (loop (cons ch acc))))))))))
-          (if (char=? ch (int->char 4))
-              (if (null? acc) #f (list->string (reverse-list acc)))
-              (if (char=? ch #\newline)
-                  (begin (newline) (list->string (reverse-list acc)))
-                  (if (char=? ch #\return)
-                      (begin (set! skip-lf #t) (newline) (list->string (reverse-list acc)))
-                      (if (char=? ch bs)
-                          (if (null? acc)
-                              (loop acc)
-                              (begin (erase) (loop (cdr acc))))
-                          (if (char=? ch del)
-                              (if (null? acc)
-                                  (loop acc)
-                                  (begin (erase) (loop (cdr acc))))
-                              (begin (display ch) (loop (cons ch acc))))))))))
-    (loop '()))
+              (begin (newline) (finish))
+              (if (char=? ch #\return)
+                  (begin (set! skip-lf #t) (newline) (finish))
+                  (if (if (char=? ch bs) #t (char=? ch del))
+                      (begin
+                        (if (< 0 (string-builder-length buf))
+                            (begin
+                              (erase)
+                              (string-builder-truncate! buf (- (string-builder-length buf) 1)))
+                            0)
+                        (loop))
+                      (begin (display ch) (string-builder-append! buf ch) (loop)))))))
+    (loop))
 
   (define (bind name value rest) (cons (cons name value) rest))
 
   ; Allowed bindings for init scripts; eval-scoped restricts the environment.
-  (define (not x) (eq? x #f))
-  (define (> a b) (< b a))
+  ; Writes the kernel trace ring to the serial port; decode with scripts/trace_decode.py.
+  (define (trace-dump) (foreign-call 'trace-dump))
+  (define (sleep-ns n) (foreign-call 'sleep-ns n))
 
   (define allowed '())
   (set! allowed (bind 'read-text-file read-text-file allowed))
   (set! allowed (bind 'eval-string eval-string allowed))
+  (set! allowed (bind 'parse-string parse-string allowed))
+  (set! allowed (bind 'run-file run-file allowed))
+  (set! allowed (bind 'compile-cache-hits compile-cache-hits allowed))
   (set! allowed (bind 'list-files list-files allowed))
   (set! allowed (bind 'delete-file delete-file allowed))
   (set! allowed (bind 'create-file create-file allowed))
   (set! allowed (bind 'disk-size disk-size allowed))
   (set! allowed (bind 'disk-write-bytes disk-write-bytes allowed))
+  (set! allowed (bind 'disk-write-bytevector disk-write-bytevector allowed))
   (set! allowed (bind 'yield yield allowed))
   (set! allowed (bind 'spawn-thread spawn-thread allowed))
+  (set! allowed (bind 'make-channel make-channel allowed))
+  (set! allowed (bind 'channel-send channel-send allowed))
+  (set! allowed (bind 'channel-recv channel-recv allowed))
   (set! allowed (bind 'read-string read-string allowed))
   (set! allowed (bind 'read-char read-char allowed))
   (set! allowed (bind 'number->string number->string allowed))
   (set! allowed (bind 'list->string list->string allowed))
   (set! allowed (bind 'list-alloc list-alloc allowed))
+  (set! allowed (bind 'gc-stats gc-stats allowed))
+  (set! allowed (bind 'thread-stats thread-stats allowed))
+  (set! allowed (bind 'profile-start profile-start allowed))
+  (set! allowed (bind 'profile-dump profile-dump allowed))
+  (set! allowed (bind 'trace-dump trace-dump allowed))
+  (set! allowed (bind 'sleep-ns sleep-ns allowed))
+  (set! allowed (bind 'current-time-ns current-time-ns allowed))
   (set! allowed (bind 'int->char int->char allowed))
   (set! allowed (bind 'char->int char->int allowed))
   (set! allowed (bind 'char=? char=? allowed))
   (set! allowed (bind 'string=? string=? allowed))
   (set! allowed (bind 'string-ref string-ref allowed))
   (set! allowed (bind 'string-length string-length allowed))
+  (set! allowed (bind 'substring substring allowed))
+  (set! allowed (bind 'string-append string-append allowed))
+  (set! allowed (bind 'string-index string-index allowed))
+  (set! allowed (bind 'make-string make-string allowed))
+  (set! allowed (bind 'make-string-builder make-string-builder allowed))
+  (set! allowed (bind 'string-builder-append! string-builder-append! allowed))
+  (set! allowed (bind 'string-builder-length string-builder-length allowed))
+  (set! allowed (bind 'string-builder-truncate! string-builder-truncate! allowed))
+  (set! allowed (bind 'string-builder->string string-builder->string allowed))
+  (set! allowed (bind 'string->utf8 string->utf8 allowed))
+  (set! allowed (bind 'utf8->string utf8->string allowed))
+  (set! allowed (bind 'make-hash-table make-hash-table allowed))
+  (set! allowed (bind 'make-string-hash-table make-string-hash-table allowed))
+  (set! allowed (bind 'hash-table? hash-table? allowed))
+  (set! allowed (bind 'hash-ref hash-ref allowed))
+  (set! allowed (bind 'hash-set! hash-set! allowed))
+  (set! allowed (bind 'hash-remove! hash-remove! allowed))
+  (set! allowed (bind 'hash-count hash-count allowed))
+  (set! allowed (bind 'hash-keys hash-keys allowed))
+  (set! allowed (bind 'make-vector make-vector allowed))
+  (set! allowed (bind 'vector vector allowed))
+  (set! allowed (bind 'vector? vector? allowed))
+  (set! allowed (bind 'vector-length vector-length allowed))
+  (set! allowed (bind 'vector-ref vector-ref allowed))
+  (set! allowed (bind 'vector-set! vector-set! allowed))
+  (set! allowed (bind 'make-bytevector make-bytevector allowed))
+  (set! allowed (bind 'bytevector? bytevector? allowed))
+  (set! allowed (bind 'bytevector-length bytevector-length allowed))
+  (set! allowed (bind 'bytevector-u8-ref bytevector-u8-ref allowed))
+  (set! allowed (bind 'bytevector-u8-set! bytevector-u8-set! allowed))
+  (set! allowed (bind 'bytevector-u32-le-ref bytevector-u32-le-ref allowed))
+  (set! allowed (bind 'bytevector-u32-le-set! bytevector-u32-le-set! allowed))
+  (set! allowed (bind 'bytevector-copy! bytevector-copy! allowed))
   (set! allowed (bind 'reverse-list reverse-list allowed))
+  (set! allowed (bind 'with-exception-handler with-exception-handler allowed))
+  (set! allowed (bind 'raise raise allowed))
+  (set! allowed (bind 'error error allowed))
+  (set! allowed (bind 'error-object? error-object? allowed))
+  (set! allowed (bind 'error-object-message error-object-message allowed))
+  (set! allowed (bind 'error-object-irritants error-object-irritants allowed))
   (set! allowed (bind 'not not allowed))
   (set! allowed (bind 'eq? eq? allowed))
   (set! allowed (bind 'pair? pair? allowed))
@@ -234,7 +296,11 @@
   (set! allowed (bind 'cons cons allowed))
   (set! allowed (bind 'modulo modulo allowed))
   (set! allowed (bind 'quotient quotient allowed))
+  (set! allowed (bind 'zero? zero? allowed))
+  (set! allowed (bind '1+ 1+ allowed))
   (set! allowed (bind '= = allowed))
+  (set! allowed (bind '>= >= allowed))
+  (set! allowed (bind '<= <= allowed))
   (set! allowed (bind '> > allowed))
   (set! allowed (bind '< < allowed))
   (set! allowed (bind '* * allowed))
@@ -245,9 +311,8 @@
 
   ; Eval a Scheme file by name with the restricted environment.
   (define (load name)
-    (begin
-      (define info (find-file name))
-      (if info
-          (eval-scoped allowed (disk-read-bytes (car info) (cadr info)))
-          (begin (display "missing file: ") (display name) (newline)))))
+    (define forms (file-forms name))
+    (if forms
+        (eval-scoped-forms allowed forms)
+        (begin (display "missing file: ") (display name) (newline))))
 )
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Run the interpreter benchmark workloads in bench/ under scheme-host.
+
+Each workload is run several times with `scheme-host --stats`; the JSON
+line it prints on stderr supplies the wall time and interpreter counters.
+Results are printed as one JSON document so runs can be diffed or stored.
+"""
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BENCH_DIR = os.path.join(ROOT, "bench")
+PROGRAMS_DIR = os.path.join(ROOT, "programs")
+MKFS = os.path.join(ROOT, "scripts", "mkfs.py")
+
+# Workloads that read files from the disk image rather than only computing.
+DISK_WORKLOADS = {"parse"}
+
+
+def build_image(build_dir):
+    img = os.path.join(build_dir, "bench_fs.img")
+    subprocess.run([sys.executable, MKFS, PROGRAMS_DIR, img], check=True)
+    return img
+
+
+def run_once(host, program, img, host_args):
+    cmd = [host, "--stats", *host_args, program]
+    if img:
+        cmd.append(img)
+    proc = subprocess.run(cmd, capture_output=True, text=True)
+    if proc.returncode != 0:
+        raise RuntimeError(f"{program} exited with {proc.returncode}: {proc.stderr.strip()}")
+    for line in reversed(proc.stderr.splitlines()):
+        line = line.strip()
+        if line.startswith("{"):
+            return json.loads(line)
+    raise RuntimeError(f"{program}: no stats line on stderr")
+
+
+def run_workload(host, name, img, repeat, host_args):
+    program = os.path.join(BENCH_DIR, name + ".scm")
+    runs = [run_once(host, program, img if name in DISK_WORKLOADS else None, host_args) for _ in range(repeat)]
+    walls = [r["wall_ns"] for r in runs]
+    # Counters are deterministic across runs; report them from the first.
+    first = runs[0]
+    return {
+        "name": name,
+        "runs": repeat,
+        "wall_ns_min": min(walls),
+        "wall_ns_median": int(statistics.median(walls)),
+        "cells_allocated": first["cells_allocated"],
+        "cells_freed": first["cells_freed"],
+        "gc_count": first["gc_count"],
+        "heap_cells": first["heap_cells"],
+        "str_arena_peak": first["str_arena_peak"],
+        "sym_arena_peak": first["sym_arena_peak"],
+        "gc_mark_ns_median": int(statistics.median(r["mark_ns"] for r in runs)),
+        "gc_sweep_ns_median": int(statistics.median(r["sweep_ns"] for r in runs)),
+        "gc_max_pause_ns": max(r["max_pause_ns"] for r in runs),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default=os.path.join(ROOT, "build", "scheme-host"))
+    parser.add_argument("--repeat", type=int, default=3, help="runs per workload (default 3)")
+    parser.add_argument("--copying-gc", action="store_true", help="run with the copying collector")
+    parser.add_argument("--gc-pause", type=int, metavar="CELLS",
+                        help="collect incrementally with at most CELLS cells of work per pause")
+    parser.add_argument("--shared-heap", action="store_true",
+                        help="take the primitives from a frozen heap shared like a spawned thread's")
+    parser.add_argument("--output", help="also write the JSON results to this file")
+    parser.add_argument("workloads", nargs="*", help="workload names (default: all in bench/)")
+    args = parser.parse_args()
+
+    if not os.path.isfile(args.host):
+        print(f"error: {args.host} not found (run `make scheme-host`)", file=sys.stderr)
+        return 1
+
+    names = args.workloads or sorted(f[:-4] for f in os.listdir(BENCH_DIR) if f.endswith(".scm"))
+    img = build_image(os.path.dirname(args.host)) if DISK_WORKLOADS & set(names) else None
+
+    host_args = ["--copying-gc"] if args.copying_gc else []
+    if args.gc_pause:
+        host_args += ["--gc-pause", str(args.gc_pause)]
+    if args.shared_heap:
+        host_args.append("--shared-heap")
+    results = []
+    for name in names:
+        try:
+            results.append(run_workload(args.host, name, img, max(1, args.repeat), host_args))
+        except RuntimeError as e:
+            print(f"error: {e}", file=sys.stderr)
+            return 1
+
+    text = json.dumps({"benchmarks": results}, indent=2)
+    print(text)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,7 +1,9 @@
 #!/usr/bin/env python3
 import os
 import struct
+import subprocess
 import sys
+import tempfile
 
 MAGIC = b"SLOPFS1\0"
 VERSION = 1
@@ -11,19 +13,102 @@ DIR_ENTRIES = 64
 MIN_IMAGE_SIZE = 64 * 1024
 SUPERBLOCK_SIZE = 512
 BOOT_HEADER_SIZE = 8
+# The optional heap image starts at the first 16-byte boundary after boot.scm.
+HEAP_IMAGE_ALIGN = 16
+HEAP_IMAGE_MAGIC = b"SLOPIMG1"
+# The heap image captures the state left by this prelude.
+PRELUDE = "fs.scm"
 
 
 def align(value, multiple):
     return (value + multiple - 1) // multiple * multiple
 
 
+def layout(boot_data, file_entries, heap_image):
+    """Return the ramdisk bytes for boot.scm, an optional heap image and the files."""
+    boot_len = len(boot_data)
+    image_offset = align(BOOT_HEADER_SIZE + boot_len, HEAP_IMAGE_ALIGN)
+    fs_offset = align(image_offset + len(heap_image), 512) if heap_image else align(BOOT_HEADER_SIZE + boot_len, 512)
+    dir_offset = fs_offset + SUPERBLOCK_SIZE
+    dir_length = DIR_ENTRIES * ENTRY_SIZE
+    data_offset = align(dir_offset + dir_length, 512)
+
+    placed = []
+    data_cursor = data_offset
+    for name, data in file_entries:
+        placed.append((name, data_cursor, data))
+        data_cursor += len(data)
+
+    total_size = max(align(data_cursor, 512), MIN_IMAGE_SIZE)
+    img = bytearray(total_size)
+
+    struct.pack_into("<II", img, 0, boot_len, fs_offset)
+    img[BOOT_HEADER_SIZE:BOOT_HEADER_SIZE + boot_len] = boot_data
+    img[image_offset:image_offset + len(heap_image)] = heap_image
+    dir_offset_rel = dir_offset - fs_offset
+    data_offset_rel = data_offset - fs_offset
+    struct.pack_into("<8sIIII", img, fs_offset, MAGIC, VERSION, dir_offset_rel, dir_length, data_offset_rel)
+
+    dir_pos = dir_offset
+    for name, data_off, data in placed:
+        name_bytes = name.encode("ascii")
+        name_field = name_bytes + b"\0" * (ENTRY_NAME_LEN - len(name_bytes))
+        img[dir_pos:dir_pos + ENTRY_NAME_LEN] = name_field
+        struct.pack_into("<III", img, dir_pos + ENTRY_NAME_LEN, data_off - fs_offset, len(data), 0)
+        dir_pos += ENTRY_SIZE
+
+    # Remaining directory entries are zeroed (already zero in img).
+
+    for _, data_off, data in placed:
+        img[data_off:data_off + len(data)] = data
+
+    return img
+
+
+def dump_heap_image(host, prelude_path, img):
+    """Evaluate the prelude against img under scheme-host and return the heap image."""
+    with tempfile.TemporaryDirectory() as tmp:
+        disk_path = os.path.join(tmp, "fs.img")
+        heap_path = os.path.join(tmp, "heap.img")
+        with open(disk_path, "wb") as f:
+            f.write(img)
+        subprocess.run([host, "--dump-image", heap_path, prelude_path, disk_path], check=True,
+                       stdout=subprocess.DEVNULL)
+        with open(heap_path, "rb") as f:
+            return f.read()
+
+
+def build_heap_image(host, prelude_path, boot_data, file_entries):
+    """Dump the prelude's heap against the final layout.
+
+    The prelude records disk offsets, which move with the image's size, so
+    the image is dumped against a layout that reserves room for itself until
+    its length stops changing.
+    """
+    heap_image = b""
+    for _ in range(4):
+        reserved = b"\0" * len(heap_image) if heap_image else b""
+        new_image = dump_heap_image(host, prelude_path, layout(boot_data, file_entries, reserved))
+        if not new_image.startswith(HEAP_IMAGE_MAGIC):
+            raise RuntimeError("scheme-host wrote no heap image")
+        if len(new_image) == len(heap_image):
+            return new_image
+        heap_image = new_image
+    raise RuntimeError("heap image size did not settle")
+
+
 def main():
-    if len(sys.argv) != 3:
-        print(f"usage: {sys.argv[0]} <input-dir> <output-img>", file=sys.stderr)
+    args = sys.argv[1:]
+    host = None
+    if len(args) == 4 and args[0] == "--heap-image":
+        host = args[1]
+        args = args[2:]
+    if len(args) != 2:
+        print(f"usage: {sys.argv[0]} [--heap-image SCHEME_HOST] <input-dir> <output-img>", file=sys.stderr)
         return 1
 
-    in_dir = sys.argv[1]
-    out_path = sys.argv[2]
+    in_dir = args[0]
+    out_path = args[1]
 
     if not os.path.isdir(in_dir):
         print(f"error: input dir not found: {in_dir}", file=sys.stderr)
@@ -37,7 +122,6 @@ def main():
 
     with open(boot_path, "rb") as f:
         boot_data = f.read()
-    boot_len = len(boot_data)
 
     for name in sorted(os.listdir(in_dir)):
         path = os.path.join(in_dir, name)
@@ -49,46 +133,29 @@ def main():
                 return 1
             files.append((name, path))
 
-    fs_offset = align(BOOT_HEADER_SIZE + boot_len, 512)
-    dir_offset = fs_offset + SUPERBLOCK_SIZE
     if len(files) > DIR_ENTRIES:
         print(f"error: too many files (max {DIR_ENTRIES})", file=sys.stderr)
         return 1
-    dir_length = DIR_ENTRIES * ENTRY_SIZE
-    data_offset = align(dir_offset + dir_length, 512)
 
     file_entries = []
-    data_cursor = data_offset
     for name, path in files:
         with open(path, "rb") as f:
-            data = f.read()
-        file_entries.append((name, data_cursor, len(data), data))
-        data_cursor += len(data)
-
-    total_size = max(align(data_cursor, 512), MIN_IMAGE_SIZE)
-    img = bytearray(total_size)
-
-    struct.pack_into("<II", img, 0, boot_len, fs_offset)
-    img[BOOT_HEADER_SIZE:BOOT_HEADER_SIZE + boot_len] = boot_data
-    dir_offset_rel = dir_offset - fs_offset
-    data_offset_rel = data_offset - fs_offset
-    struct.pack_into("<8sIIII", img, fs_offset, MAGIC, VERSION, dir_offset_rel, dir_length, data_offset_rel)
-
-    dir_pos = dir_offset
-    for name, data_off, data_len, _ in file_entries:
-        name_bytes = name.encode("ascii")
-        name_field = name_bytes + b"\0" * (ENTRY_NAME_LEN - len(name_bytes))
-        img[dir_pos:dir_pos + ENTRY_NAME_LEN] = name_field
-        struct.pack_into("<III", img, dir_pos + ENTRY_NAME_LEN, data_off - fs_offset, data_len, 0)
-        dir_pos += ENTRY_SIZE
-
-    # Remaining directory entries are zeroed (already zero in img).
-
-    for _, data_off, _, data in file_entries:
-        img[data_off:data_off + len(data)] = data
+            file_entries.append((name, f.read()))
+
+    heap_image = b""
+    if host:
+        prelude_path = os.path.join(in_dir, PRELUDE)
+        if not os.path.isfile(prelude_path):
+            print(f"error: {PRELUDE} not found in input dir", file=sys.stderr)
+            return 1
+        try:
+            heap_image = build_heap_image(host, prelude_path, boot_data, file_entries)
+        except (OSError, RuntimeError, subprocess.CalledProcessError) as e:
+            print(f"error: heap image: {e}", file=sys.stderr)
+            return 1
 
     with open(out_path, "wb") as f:
-        f.write(img)
+        f.write(layout(boot_data, file_entries, heap_image))
 
     return 0
 
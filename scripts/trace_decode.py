@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Decode a SLOPTRC1 kernel trace dump into a readable timeline.
+
+The kernel writes the dump to the serial port when Scheme code runs
+(foreign-call 'trace-dump). Capture the raw serial output to a file (for
+example `make run > serial.log`) and pass it here; the dump is located by
+its magic, so surrounding console text is ignored.
+"""
+import argparse
+import struct
+import sys
+
+MAGIC = b"SLOPTRC1"
+HEADER = struct.Struct("<8sIIII")
+RECORD = struct.Struct("<QBBHI")
+
+# Mirrors src/kernel/trace.h.
+CTX_SWITCH = 1
+THREAD_SPAWN = 2
+THREAD_EXIT = 3
+DISK_WRITE_START = 4
+DISK_WRITE_END = 5
+GC_START = 6
+GC_END = 7
+CONSOLE_RX = 8
+DISK_FAILED = 0x80000000
+
+NAMES = {
+    CTX_SWITCH: "switch",
+    THREAD_SPAWN: "spawn",
+    THREAD_EXIT: "exit",
+    DISK_WRITE_START: "disk-write",
+    DISK_WRITE_END: "disk-write-done",
+    GC_START: "gc",
+    GC_END: "gc-done",
+    CONSOLE_RX: "rx",
+}
+
+# Start/end pairs whose duration is reported on the end event.
+SPANS = {DISK_WRITE_END: DISK_WRITE_START, GC_END: GC_START}
+
+
+def parse(data):
+    """Return (header dict, list of record tuples) for the last dump in data."""
+    pos = data.rfind(MAGIC)
+    if pos < 0:
+        raise ValueError("no SLOPTRC1 dump found")
+    if pos + HEADER.size > len(data):
+        raise ValueError("truncated trace header")
+    _, count, lost, tsc_khz, _ = HEADER.unpack_from(data, pos)
+    header = {"count": count, "lost": lost, "tsc_khz": tsc_khz}
+    start = pos + HEADER.size
+    available = (len(data) - start) // RECORD.size
+    if available < count:
+        print(f"warning: dump truncated, {available} of {count} records", file=sys.stderr)
+        count = available
+    records = [RECORD.unpack_from(data, start + i * RECORD.size) for i in range(count)]
+    records.sort(key=lambda r: r[0])
+    return header, records
+
+
+def describe(kind, arg):
+    if kind == CTX_SWITCH:
+        return f"-> thread {arg}"
+    if kind == THREAD_SPAWN:
+        return f"thread {arg}"
+    if kind in (DISK_WRITE_START, DISK_WRITE_END):
+        text = f"lba {arg & ~DISK_FAILED}"
+        if kind == DISK_WRITE_END and arg & DISK_FAILED:
+            text += " FAILED"
+        return text
+    if kind == GC_START:
+        return f"{arg} cells"
+    if kind == GC_END:
+        return f"{arg} live"
+    if kind == CONSOLE_RX:
+        return repr(chr(arg & 0xFF))
+    return str(arg)
+
+
+def timeline(header, records, out):
+    khz = header["tsc_khz"]
+
+    def fmt(cycles):
+        if khz:
+            return f"{cycles * 1000 / khz:12.1f}us"
+        return f"{cycles:14d}cy"
+
+    print(f"trace: {len(records)} records, {header['lost']} overwritten", file=out)
+    if not records:
+        return
+    base = records[0][0]
+    open_spans = {}
+    totals = {}
+    for tsc, kind, cpu, thread, arg in records:
+        line = f"{fmt(tsc - base)}  cpu{cpu} t{thread:<2} {NAMES.get(kind, f'event{kind}'):<16} {describe(kind, arg)}"
+        key = (cpu, thread)
+        if kind in SPANS.values():
+            open_spans[(kind, key)] = tsc
+        elif kind in SPANS and (SPANS[kind], key) in open_spans:
+            took = tsc - open_spans.pop((SPANS[kind], key))
+            line += f"  ({fmt(took).strip()})"
+            total, worst, n = totals.get(kind, (0, 0, 0))
+            totals[kind] = (total + took, max(worst, took), n + 1)
+        print(line, file=out)
+    for kind, (total, worst, n) in sorted(totals.items()):
+        name = NAMES[SPANS[kind]]
+        print(f"{name}: {n} spans, total {fmt(total).strip()}, max {fmt(worst).strip()}", file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="raw serial capture containing a trace dump")
+    args = parser.parse_args()
+    with open(args.capture, "rb") as f:
+        data = f.read()
+    try:
+        header, records = parse(data)
+    except ValueError as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+    timeline(header, records, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,10 @@
+BITS 32
+GLOBAL ap_trampoline_start
+GLOBAL ap_trampoline_end
+
+; The trampoline is assembled separately at its fixed low-memory origin
+; and carried in the kernel image as data.
+SECTION .rodata
+ap_trampoline_start:
+    incbin "trampoline.bin"
+ap_trampoline_end:
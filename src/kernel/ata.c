@@ -1,5 +1,6 @@
 #include "ata.h"
 #include "ports.h"
+#include "trace.h"
 
 #define ATA_DATA 0x1F0
 #define ATA_SECTOR_COUNT 0x1F2
@@ -60,7 +61,7 @@ static int ata_wait_drq(void) {
     return -1;
 }
 
-int ata_write_sector_lba(unsigned int lba, const unsigned char *data) {
+static int ata_write_sector(unsigned int lba, const unsigned char *data) {
     if (ata_wait_ready_clear() < 0) {
         return -1;
     }
@@ -90,3 +91,10 @@ int ata_write_sector_lba(unsigned int lba, const unsigned char *data) {
 
     return 0;
 }
+
+int ata_write_sector_lba(unsigned int lba, const unsigned char *data) {
+    trace_event(TRACE_DISK_WRITE_START, lba);
+    int rc = ata_write_sector(lba, data);
+    trace_event(TRACE_DISK_WRITE_END, rc < 0 ? (lba | TRACE_DISK_FAILED) : lba);
+    return rc;
+}
@@ -0,0 +1,121 @@
+#include "channel.h"
+#include "mem.h"
+#include "spinlock.h"
+#include "thread.h"
+
+// A bounded FIFO of byte messages. Senders copy their message into a
+// kmalloc'd block, so the payload outlives the sending interpreter's heap;
+// the receiver copies it out and frees the block.
+typedef struct Message {
+    char *data;
+    int len;
+} Message;
+
+typedef struct Channel {
+    Spinlock lock;
+    int used;
+    int capacity;
+    int head;
+    int count;
+    Message slots[CHANNEL_MAX_CAPACITY];
+    WaitQueue senders;
+    WaitQueue receivers;
+} Channel;
+
+static Channel channels[MAX_CHANNELS];
+static Spinlock channels_lock = SPINLOCK_INIT;
+
+static Channel *channel_get(int id) {
+    if (id < 0 || id >= MAX_CHANNELS || !channels[id].used) {
+        return 0;
+    }
+    return &channels[id];
+}
+
+// channel_make: allocate a channel slot.
+// Args: capacity (messages buffered before senders block, clamped to 1..32).
+// Returns: channel id, or -1 if every slot is taken.
+int channel_make(int capacity) {
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    if (capacity > CHANNEL_MAX_CAPACITY) {
+        capacity = CHANNEL_MAX_CAPACITY;
+    }
+    unsigned int flags = spin_lock_irqsave(&channels_lock);
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (!channels[i].used) {
+            Channel *ch = &channels[i];
+            ch->lock.locked = 0;
+            ch->capacity = capacity;
+            ch->head = 0;
+            ch->count = 0;
+            wait_queue_init(&ch->senders);
+            wait_queue_init(&ch->receivers);
+            ch->used = 1;
+            spin_unlock_irqrestore(&channels_lock, flags);
+            return i;
+        }
+    }
+    spin_unlock_irqrestore(&channels_lock, flags);
+    return -1;
+}
+
+// channel_send: enqueue a copy of a message, blocking while the channel is full.
+// Args: id (channel), data/len (message bytes).
+// Returns: len on success, -1 for a bad channel or allocation failure.
+int channel_send(int id, const char *data, int len) {
+    Channel *ch = channel_get(id);
+    if (!ch || len < 0) {
+        return -1;
+    }
+    char *copy = (char *)kmalloc(len > 0 ? (unsigned int)len : 1);
+    if (!copy) {
+        return -1;
+    }
+    for (int i = 0; i < len; i++) {
+        copy[i] = data[i];
+    }
+    unsigned int flags = spin_lock_irqsave(&ch->lock);
+    while (ch->count == ch->capacity) {
+        thread_block(&ch->senders, &ch->lock);
+    }
+    Message *m = &ch->slots[(ch->head + ch->count) % ch->capacity];
+    m->data = copy;
+    m->len = len;
+    ch->count++;
+    thread_wake_one(&ch->receivers);
+    spin_unlock_irqrestore(&ch->lock, flags);
+    return len;
+}
+
+// channel_recv: dequeue the oldest message, blocking while the channel is empty.
+// Args: id (channel), buf/cap (destination buffer).
+// Returns: message length, or -1 for a bad channel or a message over cap.
+int channel_recv(int id, char *buf, int cap) {
+    Channel *ch = channel_get(id);
+    if (!ch) {
+        return -1;
+    }
+    unsigned int flags = spin_lock_irqsave(&ch->lock);
+    while (ch->count == 0) {
+        thread_block(&ch->receivers, &ch->lock);
+    }
+    Message m = ch->slots[ch->head];
+    ch->slots[ch->head].data = 0;
+    ch->head = (ch->head + 1) % ch->capacity;
+    ch->count--;
+    thread_wake_one(&ch->senders);
+    spin_unlock_irqrestore(&ch->lock, flags);
+
+    int len = m.len;
+    if (len > cap) {
+        len = -1;
+    } else {
+        for (int i = 0; i < len; i++) {
+            buf[i] = m.data[i];
+        }
+    }
+    kfree(m.data);
+    return len;
+}
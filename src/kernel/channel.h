@@ -0,0 +1,11 @@
+#ifndef SLOPOS_CHANNEL_H
+#define SLOPOS_CHANNEL_H
+
+#define MAX_CHANNELS 16
+#define CHANNEL_MAX_CAPACITY 32
+
+int channel_make(int capacity);
+int channel_send(int id, const char *data, int len);
+int channel_recv(int id, char *buf, int cap);
+
+#endif
@@ -1,4 +1,6 @@
 #include "console.h"
+#include "spinlock.h"
+#include "trace.h"
 
 typedef unsigned char u8;
 typedef unsigned short u16;
@@ -13,6 +15,9 @@ static inline u8 inb(u16 port) {
     return ret;
 }
 
+// Serializes the UART between CPUs; held per character or per string.
+static Spinlock console_lock = SPINLOCK_INIT;
+
 static void serial_write(u8 c) {
     while ((inb(0x3F8 + 5) & 0x20) == 0) {
     }
@@ -24,9 +29,16 @@ int console_has_input(void) {
 }
 
 char console_getc(void) {
-    while (!console_has_input()) {
+    for (;;) {
+        unsigned int flags = spin_lock_irqsave(&console_lock);
+        if (console_has_input()) {
+            char c = (char)inb(0x3F8);
+            spin_unlock_irqrestore(&console_lock, flags);
+            trace_event(TRACE_CONSOLE_RX, (unsigned char)c);
+            return c;
+        }
+        spin_unlock_irqrestore(&console_lock, flags);
     }
-    return (char)inb(0x3F8);
 }
 
 void console_init(void) {
@@ -39,17 +51,37 @@ void console_init(void) {
     outb(0x3F8 + 4, 0x0B);
 }
 
-void console_putc(char c) {
+static void console_putc_locked(char c) {
     if (c == '\n') {
         serial_write('\r');
     }
     serial_write((u8)c);
 }
 
+void console_putc(char c) {
+    unsigned int flags = spin_lock_irqsave(&console_lock);
+    console_putc_locked(c);
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
 void console_write(const char *s) {
+    unsigned int flags = spin_lock_irqsave(&console_lock);
     for (; *s; s++) {
-        console_putc(*s);
+        console_putc_locked(*s);
+    }
+    spin_unlock_irqrestore(&console_lock, flags);
+}
+
+// console_write_raw: send bytes to the serial port without newline translation.
+// Args: data (bytes), len (count).
+// Returns: none.
+void console_write_raw(const void *data, unsigned int len) {
+    const u8 *p = (const u8 *)data;
+    unsigned int flags = spin_lock_irqsave(&console_lock);
+    for (unsigned int i = 0; i < len; i++) {
+        serial_write(p[i]);
     }
+    spin_unlock_irqrestore(&console_lock, flags);
 }
 
 void console_write_dec(unsigned int value) {
@@ -17,8 +17,11 @@ struct idt_ptr {
 } __attribute__((packed));
 
 extern void isr_timer_stub(void);
+extern void isr_lapic_timer_stub(void);
+extern void isr_spurious_stub(void);
 
 static struct idt_entry idt[IDT_SIZE];
+static struct idt_ptr idtp;
 
 static void idt_set_gate(int num, unsigned int base, unsigned short sel, unsigned char flags) {
     idt[num].offset_low = (unsigned short)(base & 0xFFFF);
@@ -29,17 +32,24 @@ static void idt_set_gate(int num, unsigned int base, unsigned short sel, unsigne
 }
 
 void idt_init(void) {
-    struct idt_ptr idtp;
-
     for (int i = 0; i < IDT_SIZE; i++) {
         idt_set_gate(i, 0, 0, 0);
     }
 
-    idt_set_gate(32, (unsigned int)isr_timer_stub, 0x08, 0x8E);
+    idt_set_gate(IRQ_TIMER_VECTOR, (unsigned int)isr_timer_stub, 0x08, 0x8E);
+    idt_set_gate(LAPIC_TIMER_VECTOR, (unsigned int)isr_lapic_timer_stub, 0x08, 0x8E);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (unsigned int)isr_spurious_stub, 0x08, 0x8E);
 
     idtp.limit = (unsigned short)(sizeof(idt) - 1);
     idtp.base = (unsigned int)&idt;
 
+    idt_load();
+}
+
+// idt_load: point this CPU at the shared IDT.
+// Args: none.
+// Returns: none. Application processors call this once idt_init has run.
+void idt_load(void) {
     __asm__ volatile ("lidt %0" : : "m"(idtp));
 }
 
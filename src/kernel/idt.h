@@ -1,7 +1,12 @@
 #ifndef SLOPOS_IDT_H
 #define SLOPOS_IDT_H
 
+#define IRQ_TIMER_VECTOR 32
+#define LAPIC_TIMER_VECTOR 64
+#define LAPIC_SPURIOUS_VECTOR 255
+
 void idt_init(void);
+void idt_load(void);
 void pic_remap(void);
 void pit_init(unsigned int hz);
 
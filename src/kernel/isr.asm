@@ -7,3 +7,18 @@ isr_timer_stub:
     call timer_tick
     popa
     iretd
+
+GLOBAL isr_lapic_timer_stub
+EXTERN lapic_timer_tick
+
+isr_lapic_timer_stub:
+    pusha
+    call lapic_timer_tick
+    popa
+    iretd
+
+GLOBAL isr_spurious_stub
+
+; Spurious LAPIC interrupts must not be acknowledged with an EOI.
+isr_spurious_stub:
+    iretd
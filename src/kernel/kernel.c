@@ -1,12 +1,18 @@
 #include "boot.h"
+#include "channel.h"
 #include "console.h"
 #include "floppy.h"
 #include "ata.h"
 #include "idt.h"
 #include "mem.h"
 #include "ports.h"
+#include "profile.h"
 #include "scheme/scheme.h"
+#include "smp.h"
+#include "spinlock.h"
 #include "thread.h"
+#include "time.h"
+#include "trace.h"
 
 static void acpi_shutdown(void) {
     outb(0xF4, 0x00);
@@ -17,7 +23,7 @@ static void acpi_shutdown(void) {
     }
 }
 
-static int scheme_spawn_program(void *user, const char *code);
+static int scheme_spawn_program(void *user, const char *code, const SchemeQuota *quota);
 
 static unsigned char *ramdisk_base;
 static unsigned int ramdisk_size;
@@ -36,6 +42,14 @@ static void scheme_panic(const char *msg) {
     }
 }
 
+static int name_eq(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
 static int scheme_foreign_call(const char *name, int argc, const int *argv) {
     if (name[0] == 'p' && name[1] == 'u' && name[2] == 't' && name[3] == 'c' && name[4] == '\0') {
         if (argc >= 1) {
@@ -60,9 +74,25 @@ static int scheme_foreign_call(const char *name, int argc, const int *argv) {
         }
         return -1;
     }
+    if (name_eq(name, "sleep-ns")) {
+        if (argc >= 1 && argv[0] >= 0) {
+            thread_sleep_ns((unsigned int)argv[0]);
+            return 0;
+        }
+        return -1;
+    }
     if (name[0] == 's' && name[1] == 'p' && name[2] == 'a' && name[3] == 'w' && name[4] == 'n' && name[5] == '\0') {
         return -1;
     }
+    if (name_eq(name, "stack-high-water")) {
+        return (int)thread_stack_high_water(argc >= 1 ? argv[0] : thread_current());
+    }
+    if (name_eq(name, "stack-size")) {
+        return (int)thread_stack_size(argc >= 1 ? argv[0] : thread_current());
+    }
+    if (name_eq(name, "trace-dump")) {
+        return trace_dump();
+    }
     return -1;
 }
 
@@ -87,6 +117,9 @@ static int scheme_read_char(void *user) {
     return (unsigned char)console_getc();
 }
 
+// Serializes ramdisk updates and the ATA write-back that follows them.
+static Spinlock disk_lock = SPINLOCK_INIT;
+
 static int scheme_write_bytes(void *user, int offset, const char *data, int len) {
     (void)user;
     if (offset < 0 || len < 0) {
@@ -96,6 +129,11 @@ static int scheme_write_bytes(void *user, int offset, const char *data, int len)
     if (end > ramdisk_size) {
         return -1;
     }
+    // Nothing to write back; end_sector below would wrap for len 0.
+    if (len == 0) {
+        return 0;
+    }
+    unsigned int flags = spin_lock_irqsave(&disk_lock);
     for (int i = 0; i < len; i++) {
         ramdisk_base[offset + i] = (unsigned char)data[i];
     }
@@ -108,12 +146,29 @@ static int scheme_write_bytes(void *user, int offset, const char *data, int len)
             sector_buf[i] = ramdisk_base[base + i];
         }
         if (ata_write_sector_lba(s, sector_buf) < 0) {
+            spin_unlock_irqrestore(&disk_lock, flags);
             return -1;
         }
     }
+    spin_unlock_irqrestore(&disk_lock, flags);
     return len;
 }
 
+static int scheme_channel_make(void *user, int capacity) {
+    (void)user;
+    return channel_make(capacity);
+}
+
+static int scheme_channel_send(void *user, int channel, const char *data, int len) {
+    (void)user;
+    return channel_send(channel, data, len);
+}
+
+static int scheme_channel_recv(void *user, int channel, char *buf, int cap) {
+    (void)user;
+    return channel_recv(channel, buf, cap);
+}
+
 static unsigned int read_u32_le(const unsigned char *p) {
     return (unsigned int)p[0] |
            ((unsigned int)p[1] << 8) |
@@ -124,19 +179,66 @@ static unsigned int read_u32_le(const unsigned char *p) {
 enum { SCHEME_HEAP_CELLS = 16384 };
 enum { SCHEME_SYM_BUF = 16384 };
 enum { SCHEME_STR_BUF = 65536 };
+enum { SCHEME_HEAP_GROW_CELLS = 8192 };
+enum { SCHEME_HEAP_MAX_CELLS = 262144 };
+enum { SCHEME_ARENA_GROW = 32768 };
+// Interpreters that serve the shell or run timer-driven tasks collect
+// incrementally, doing at most this many cells of GC work per pause.
+enum { SCHEME_GC_PAUSE_CELLS = 1024 };
+// Spawned threads start small and grow on demand; the primitives and
+// prelude live in the shared template heap, not in these.
+enum { SCHEME_THREAD_CELLS = 2048 };
+enum { SCHEME_THREAD_SYM_BUF = 1024 };
+enum { SCHEME_THREAD_STR_BUF = 16384 };
+enum { SCHEME_THREAD_MAX_CELLS = 65536 };
+// Default quotas for spawned threads; spawn-thread may only lower them.
+// A thread past one is stopped at its next procedure call, so a runaway
+// program gives up the CPU within a tick of reaching its CPU quota.
+enum { SCHEME_THREAD_ARENA_QUOTA = 1048576 };
+enum { SCHEME_THREAD_CPU_QUOTA = 30 * TIMER_HZ };
+enum { SCHEME_THREAD_DISK_QUOTA = 262144 };
+enum { SCHEME_THREAD_OUTPUT_QUOTA = 65536 };
 typedef struct SchemeThreadCtx {
     Scheme sc;
     Cell *heap;
     char *sym_buf;
     char *str_buf;
     const char *program;
+    SchemeQuota quota;
     int active;
 } SchemeThreadCtx;
 
 enum { MAX_SCHEME_THREADS = 4 };
+// Kernel stack sizes for interpreter threads. eval() and mark_cell recurse
+// on the C stack, so these bound how deep Scheme code can nest.
+enum { SCHEME_THREAD_STACK = 65536 };
+enum { SCHEME_BOOT_STACK = 262144 };
 
 static SchemeThreadCtx scheme_threads[MAX_SCHEME_THREADS];
 
+// Every spawned thread shares this template interpreter, which holds the
+// primitives plus the helpers below already evaluated and is then frozen:
+// one read-only copy serves all threads, whose collectors never scan it,
+// and a spawn interns and defines nothing.
+enum { SCHEME_TEMPLATE_CELLS = 2048 };
+enum { SCHEME_TEMPLATE_SYM_BUF = 4096 };
+enum { SCHEME_TEMPLATE_STR_BUF = 1024 };
+
+static const char scheme_thread_prelude[] =
+    "(define (cadr x) (car (cdr x)))\n"
+    "(define (append a b) (if (null? a) b (cons (car a) (append (cdr a) b))))\n"
+    "(define (reverse-list xs)\n"
+    "  (define (rev xs acc) (if (null? xs) acc (rev (cdr xs) (cons (car xs) acc))))\n"
+    "  (rev xs '()))\n"
+    "(define (string->list s)\n"
+    "  (define (loop i acc) (if (< i 0) acc (loop (- i 1) (cons (string-ref s i) acc))))\n"
+    "  (loop (- (string-length s) 1) '()))\n";
+
+static Scheme scheme_template;
+static int scheme_template_ready;
+// Guards the active flags of scheme_threads.
+static Spinlock scheme_threads_lock = SPINLOCK_INIT;
+
 static unsigned int str_len(const char *s) {
     unsigned int n = 0;
     while (s[n]) {
@@ -145,98 +247,216 @@ static unsigned int str_len(const char *s) {
     return n;
 }
 
+// scheme_thread_release: return a thread's interpreter memory to the kernel.
+// Args: ctx (thread context).
+// Returns: none.
+static void scheme_thread_release(SchemeThreadCtx *ctx) {
+    kfree(ctx->heap);
+    kfree(ctx->sym_buf);
+    kfree(ctx->str_buf);
+    kfree((void *)ctx->program);
+    ctx->heap = NULL;
+    ctx->sym_buf = NULL;
+    ctx->str_buf = NULL;
+    ctx->program = NULL;
+}
+
 static int scheme_thread_alloc(SchemeThreadCtx *ctx) {
-    if (!ctx->heap) {
-        ctx->heap = (Cell *)kmalloc(sizeof(Cell) * SCHEME_HEAP_CELLS);
-        ctx->sym_buf = (char *)kmalloc(SCHEME_SYM_BUF);
-        ctx->str_buf = (char *)kmalloc(SCHEME_STR_BUF);
-    }
+    ctx->heap = (Cell *)kmalloc(sizeof(Cell) * SCHEME_THREAD_CELLS);
+    ctx->sym_buf = (char *)kmalloc(SCHEME_THREAD_SYM_BUF);
+    ctx->str_buf = (char *)kmalloc(SCHEME_THREAD_STR_BUF);
     if (!ctx->heap || !ctx->sym_buf || !ctx->str_buf) {
         console_write("scheme_thread_alloc: out of memory\n");
+        scheme_thread_release(ctx);
         return -1;
     }
     return 0;
 }
 
+static void *scheme_alloc(void *user, size_t size) {
+    (void)user;
+    return kmalloc((unsigned int)size);
+}
+
+static void scheme_free(void *user, void *ptr) {
+    (void)user;
+    kfree(ptr);
+}
+
+static unsigned long long scheme_now_ns(void *user) {
+    (void)user;
+    return time_now_ns();
+}
+
+static void scheme_trace(void *user, int event, int arg) {
+    (void)user;
+    trace_event(event == SCHEME_TRACE_GC_START ? TRACE_GC_START : TRACE_GC_END, (unsigned int)arg);
+}
+
+static void scheme_quota_none(SchemeQuota *quota) {
+    quota->arena_bytes = 0;
+    quota->cpu_ticks = 0;
+    quota->disk_bytes = 0;
+    quota->output_bytes = 0;
+}
+
+static void scheme_platform_init(SchemePlatform *platform) {
+    platform->user = NULL;
+    platform->putc = scheme_putc;
+    platform->panic = scheme_panic;
+    platform->foreign_call = scheme_foreign_call;
+    platform->read_byte = scheme_read_byte;
+    platform->disk_size = scheme_disk_size;
+    platform->read_char = scheme_read_char;
+    platform->write_bytes = scheme_write_bytes;
+    platform->spawn_thread = scheme_spawn_program;
+    platform->alloc = scheme_alloc;
+    platform->free = scheme_free;
+    platform->channel_make = scheme_channel_make;
+    platform->channel_send = scheme_channel_send;
+    platform->channel_recv = scheme_channel_recv;
+    platform->now_ns = scheme_now_ns;
+    platform->trace = scheme_trace;
+}
+
+// scheme_template_init: build and freeze the template that spawned threads share.
+// Args: none.
+// Returns: none; spawned threads fall back to scheme_init if this fails.
+static void scheme_template_init(void) {
+    SchemeConfig cfg;
+    cfg.heap = (Cell *)kmalloc(sizeof(Cell) * SCHEME_TEMPLATE_CELLS);
+    cfg.heap_cells = SCHEME_TEMPLATE_CELLS;
+    cfg.sym_buf = (char *)kmalloc(SCHEME_TEMPLATE_SYM_BUF);
+    cfg.sym_buf_size = SCHEME_TEMPLATE_SYM_BUF;
+    cfg.str_buf = (char *)kmalloc(SCHEME_TEMPLATE_STR_BUF);
+    cfg.str_buf_size = SCHEME_TEMPLATE_STR_BUF;
+    cfg.heap_grow_cells = 0;
+    cfg.heap_max_cells = 0;
+    cfg.arena_grow_bytes = 0;
+    cfg.gc_mode = SCHEME_GC_MARK_SWEEP;
+    cfg.gc_pause_cells = 0;
+    scheme_quota_none(&cfg.quota);
+    if (!cfg.heap || !cfg.sym_buf || !cfg.str_buf) {
+        console_write("kernel: scheme template alloc failed\n");
+        return;
+    }
+    scheme_platform_init(&cfg.platform);
+    scheme_init(&scheme_template, &cfg);
+    scheme_eval_string(&scheme_template, scheme_thread_prelude);
+    if (scheme_freeze(&scheme_template) < 0) {
+        console_write("kernel: scheme template freeze failed\n");
+        return;
+    }
+    scheme_template_ready = 1;
+}
+
 static void scheme_thread(void *arg) {
     SchemeThreadCtx *ctx = (SchemeThreadCtx *)arg;
     SchemeConfig cfg;
     cfg.heap = ctx->heap;
-    cfg.heap_cells = SCHEME_HEAP_CELLS;
+    cfg.heap_cells = SCHEME_THREAD_CELLS;
     cfg.sym_buf = ctx->sym_buf;
-    cfg.sym_buf_size = SCHEME_SYM_BUF;
+    cfg.sym_buf_size = SCHEME_THREAD_SYM_BUF;
     cfg.str_buf = ctx->str_buf;
-    cfg.str_buf_size = SCHEME_STR_BUF;
-    cfg.platform.user = NULL;
-    cfg.platform.putc = scheme_putc;
-    cfg.platform.panic = scheme_panic;
-    cfg.platform.foreign_call = scheme_foreign_call;
-    cfg.platform.read_byte = scheme_read_byte;
-    cfg.platform.disk_size = scheme_disk_size;
-    cfg.platform.read_char = scheme_read_char;
-    cfg.platform.write_bytes = scheme_write_bytes;
-    cfg.platform.spawn_thread = scheme_spawn_program;
-
-    scheme_init(&ctx->sc, &cfg);
+    cfg.str_buf_size = SCHEME_THREAD_STR_BUF;
+    cfg.heap_grow_cells = SCHEME_THREAD_CELLS;
+    cfg.heap_max_cells = SCHEME_THREAD_MAX_CELLS;
+    cfg.arena_grow_bytes = SCHEME_THREAD_STR_BUF;
+    cfg.gc_mode = SCHEME_GC_MARK_SWEEP;
+    cfg.gc_pause_cells = SCHEME_GC_PAUSE_CELLS;
+    cfg.quota = ctx->quota;
+    scheme_platform_init(&cfg.platform);
+
+    // The frozen template is never written, so threads on any CPU may
+    // share it without a lock.
+    int shared = scheme_template_ready ? scheme_init_shared(&ctx->sc, &scheme_template, &cfg) : -1;
+    if (shared < 0) {
+        scheme_init(&ctx->sc, &cfg);
+    }
+    profile_attach(thread_current(), &ctx->sc);
     scheme_eval_string(&ctx->sc, ctx->program);
+    profile_detach(thread_current());
+    scheme_destroy(&ctx->sc);
+    scheme_thread_release(ctx);
     ctx->active = 0;
     thread_exit();
 }
 
-static int scheme_spawn_program(void *user, const char *code) {
+// quota_limit: a spawner's requested limit, capped at the default.
+// Args: requested (0 for none), limit (default quota).
+// Returns: the limit to enforce.
+static size_t quota_limit(size_t requested, size_t limit) {
+    return requested && requested < limit ? requested : limit;
+}
+
+static int scheme_spawn_program(void *user, const char *code, const SchemeQuota *quota) {
     (void)user;
     if (!code) {
         return -1;
     }
-    for (int i = 0; i < MAX_SCHEME_THREADS; i++) {
-        if (!scheme_threads[i].active) {
-            scheme_threads[i].active = 1;
-            if (scheme_thread_alloc(&scheme_threads[i]) < 0) {
-                scheme_threads[i].active = 0;
-                return -1;
-            }
-            unsigned int len = str_len(code);
-            char *copy = (char *)kmalloc(len + 1);
-            if (!copy) {
-                scheme_threads[i].active = 0;
-                return -1;
-            }
-            for (unsigned int j = 0; j <= len; j++) {
-                copy[j] = code[j];
-            }
-            scheme_threads[i].program = copy;
-            if (thread_spawn(scheme_thread, &scheme_threads[i]) < 0) {
-                scheme_threads[i].active = 0;
-                return -1;
-            }
-            return i;
+    int i = -1;
+    unsigned int flags = spin_lock_irqsave(&scheme_threads_lock);
+    for (int j = 0; j < MAX_SCHEME_THREADS; j++) {
+        if (!scheme_threads[j].active) {
+            scheme_threads[j].active = 1;
+            i = j;
+            break;
         }
     }
-    return -1;
+    spin_unlock_irqrestore(&scheme_threads_lock, flags);
+    if (i < 0) {
+        return -1;
+    }
+    if (scheme_thread_alloc(&scheme_threads[i]) < 0) {
+        scheme_threads[i].active = 0;
+        return -1;
+    }
+    unsigned int len = str_len(code);
+    char *copy = (char *)kmalloc(len + 1);
+    if (!copy) {
+        scheme_thread_release(&scheme_threads[i]);
+        scheme_threads[i].active = 0;
+        return -1;
+    }
+    for (unsigned int j = 0; j <= len; j++) {
+        copy[j] = code[j];
+    }
+    scheme_threads[i].program = copy;
+    SchemeQuota *q = &scheme_threads[i].quota;
+    q->arena_bytes = quota_limit(quota ? quota->arena_bytes : 0, SCHEME_THREAD_ARENA_QUOTA);
+    q->cpu_ticks = quota_limit(quota ? quota->cpu_ticks : 0, SCHEME_THREAD_CPU_QUOTA);
+    q->disk_bytes = quota_limit(quota ? quota->disk_bytes : 0, SCHEME_THREAD_DISK_QUOTA);
+    q->output_bytes = quota_limit(quota ? quota->output_bytes : 0, SCHEME_THREAD_OUTPUT_QUOTA);
+    if (thread_spawn_stack(scheme_thread, &scheme_threads[i], SCHEME_THREAD_STACK) < 0) {
+        scheme_thread_release(&scheme_threads[i]);
+        scheme_threads[i].active = 0;
+        return -1;
+    }
+    return i;
 }
 
-void kmain(void) {
-    static const char boot_msg[] = "SlopOS booting...\n";
-    extern char __kernel_end;
-    const BootInfo *info = boot_info();
-    ramdisk_base = (unsigned char *)info->ramdisk_base;
-    ramdisk_size = info->ramdisk_size;
-    ramdisk_lba = info->ramdisk_lba;
-
-    console_init();
-    console_write(boot_msg);
+// mkfs.py may place a heap image (see scheme_load_image) at the first
+// 16-byte boundary after boot.scm. It holds the state boot.scm builds by
+// evaluating fs.scm, so booting from it only runs boot.scm's final step.
+static const char scheme_image_entry[] = "(load \"init.scm\")";
 
-    mem_init(info, (unsigned int)&__kernel_end);
-
-    thread_init();
-    pic_remap();
-    outb(0x21, 0xFE);
-    outb(0xA1, 0xFF);
-    idt_init();
-    pit_init(100);
-    __asm__ volatile ("sti");
+// scheme_load_boot_image: adopt the ramdisk's heap image, if it has one.
+// Args: sc (boot interpreter), cfg (its buffers), boot_len (boot.scm bytes).
+// Returns: 0 if sc was loaded from the image, -1 to fall back to boot.scm.
+static int scheme_load_boot_image(Scheme *sc, const SchemeConfig *cfg, unsigned int boot_len) {
+    unsigned int start = (8 + boot_len + 15) & ~15u;
+    unsigned int end = read_u32_le(ramdisk_base + 4);
+    if (boot_len >= ramdisk_size || end > ramdisk_size || start >= end) {
+        return -1;
+    }
+    return scheme_load_image(sc, cfg, ramdisk_base + start, end - start);
+}
 
-    // Main Scheme instance that runs boot.scm out of the ramdisk.
+// boot_thread: run boot.scm in the main Scheme instance.
+// Args: arg (unused).
+// Returns: none; exits the thread when boot.scm finishes.
+static void boot_thread(void *arg) {
+    (void)arg;
     Scheme sc;
     SchemeConfig cfg;
     Cell *heap = (Cell *)kmalloc(sizeof(Cell) * SCHEME_HEAP_CELLS);
@@ -254,32 +474,71 @@ void kmain(void) {
     cfg.sym_buf_size = SCHEME_SYM_BUF;
     cfg.str_buf = str_buf;
     cfg.str_buf_size = SCHEME_STR_BUF;
-    cfg.platform.user = NULL;
-    cfg.platform.putc = scheme_putc;
-    cfg.platform.panic = scheme_panic;
-    cfg.platform.foreign_call = scheme_foreign_call;
-    cfg.platform.read_byte = scheme_read_byte;
-    cfg.platform.disk_size = scheme_disk_size;
-    cfg.platform.read_char = scheme_read_char;
-    cfg.platform.write_bytes = scheme_write_bytes;
-    cfg.platform.spawn_thread = scheme_spawn_program;
-
-    scheme_init(&sc, &cfg);
-    static char boot_buf[4096];
+    cfg.heap_grow_cells = SCHEME_HEAP_GROW_CELLS;
+    cfg.heap_max_cells = SCHEME_HEAP_MAX_CELLS;
+    cfg.arena_grow_bytes = SCHEME_ARENA_GROW;
+    // A copying pause still grows with what survives; the shell needs
+    // latency it can bound, so it collects incrementally.
+    cfg.gc_mode = SCHEME_GC_MARK_SWEEP;
+    cfg.gc_pause_cells = SCHEME_GC_PAUSE_CELLS;
+    scheme_quota_none(&cfg.quota);
+    scheme_platform_init(&cfg.platform);
+
+    scheme_template_init();
     unsigned int boot_len = read_u32_le(ramdisk_base);
-    if (boot_len >= sizeof(boot_buf)) {
-        scheme_panic("boot.scm too large");
+    const char *program = scheme_image_entry;
+    static char boot_buf[4096];
+    if (scheme_load_boot_image(&sc, &cfg, boot_len) < 0) {
+        scheme_init(&sc, &cfg);
+        if (boot_len >= sizeof(boot_buf)) {
+            scheme_panic("boot.scm too large");
+        }
+        // Copy boot.scm into a null-terminated buffer for the interpreter.
+        for (unsigned int i = 0; i < boot_len; i++) {
+            boot_buf[i] = (char)ramdisk_base[8 + i];
+        }
+        boot_buf[boot_len] = '\0';
+        program = boot_buf;
     }
-    // Copy boot.scm into a null-terminated buffer for the interpreter.
-    for (unsigned int i = 0; i < boot_len; i++) {
-        boot_buf[i] = (char)ramdisk_base[8 + i];
+    profile_attach(thread_current(), &sc);
+    scheme_eval_string(&sc, program);
+    profile_detach(thread_current());
+}
+
+void kmain(void) {
+    static const char boot_msg[] = "SlopOS booting...\n";
+    extern char __kernel_end;
+    const BootInfo *info = boot_info();
+    ramdisk_base = (unsigned char *)info->ramdisk_base;
+    ramdisk_size = info->ramdisk_size;
+    ramdisk_lba = info->ramdisk_lba;
+
+    console_init();
+    console_write(boot_msg);
+
+    mem_init(info, (unsigned int)&__kernel_end);
+
+    thread_init();
+    pic_remap();
+    outb(0x21, 0xFE);
+    outb(0xA1, 0xFF);
+    idt_init();
+    pit_init(TIMER_HZ);
+    time_init();
+    __asm__ volatile ("sti");
+    smp_init();
+
+    // The main Scheme instance gets its own large stack rather than the
+    // small boot stack below 0x9FC00 that ends just above the ramdisk.
+    if (thread_spawn_stack(boot_thread, NULL, SCHEME_BOOT_STACK) < 0) {
+        scheme_panic("cannot spawn boot thread");
     }
-    boot_buf[boot_len] = '\0';
-    scheme_eval_string(&sc, boot_buf);
 
-    // Wait for cooperative Scheme threads to finish, then power off.
+    // This is the BSP's idle thread: run whatever is queued, wait in
+    // thread_idle when nothing is, and power off once every thread is done.
     while (thread_active_count() > 0) {
         thread_yield();
+        thread_idle();
     }
 
     acpi_shutdown();
@@ -1,5 +1,6 @@
 #include "mem.h"
 #include "console.h"
+#include "spinlock.h"
 
 typedef struct E820Entry {
     unsigned int addr_low;
@@ -9,10 +10,39 @@ typedef struct E820Entry {
     unsigned int type;
 } E820Entry;
 
+// Every block handed out by kmalloc is preceded by a 16-byte header, so
+// payloads stay 16-byte aligned and kfree can find the block's class.
+typedef struct BlockHeader {
+    unsigned int magic;
+    unsigned int size;
+    unsigned int klass;
+    struct BlockHeader *next;
+} BlockHeader;
+
+#define BLOCK_MAGIC_USED 0xA110C8EDu
+#define BLOCK_MAGIC_FREE 0xF4EEB10Cu
+
+// Small requests are rounded up to a power-of-two size class and served
+// from slabs carved out of the bump region; freed blocks go back on the
+// class free list. Anything larger is a "large" block kept on an
+// address-ordered free list that coalesces with its neighbours.
+#define NUM_CLASSES 8
+#define MIN_CLASS_SIZE 16
+#define MAX_CLASS_SIZE (MIN_CLASS_SIZE << (NUM_CLASSES - 1))
+#define LARGE_CLASS 0xFFFFFFFFu
+#define SLAB_BYTES 16384
+#define MIN_SPLIT 64
+
 static unsigned int heap_base;
 static unsigned int heap_end;
 static unsigned int heap_curr;
 
+static BlockHeader *class_free[NUM_CLASSES];
+static BlockHeader *large_free;
+
+// Guards the bump pointer and every free list; shared by all CPUs.
+static Spinlock mem_lock = SPINLOCK_INIT;
+
 static unsigned int align_up(unsigned int value, unsigned int align) {
     return (value + align - 1) & ~(align - 1);
 }
@@ -25,6 +55,10 @@ void mem_init(const BootInfo *info, unsigned int kernel_end) {
     heap_base = 0;
     heap_end = 0;
     heap_curr = 0;
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        class_free[i] = 0;
+    }
+    large_free = 0;
 
     unsigned int ramdisk_end = info->ramdisk_base + info->ramdisk_size;
     unsigned int desired = max_u32(kernel_end, ramdisk_end);
@@ -66,18 +100,163 @@ void mem_init(const BootInfo *info, unsigned int kernel_end) {
     }
 }
 
+// bump_alloc: carve raw bytes off the top of the untouched heap region.
+// Args: size (bytes, multiple of 16).
+// Returns: address, or 0 if the region is exhausted.
+static unsigned int bump_alloc(unsigned int size) {
+    if (heap_curr == 0 || size > heap_end - heap_curr) {
+        return 0;
+    }
+    unsigned int addr = heap_curr;
+    heap_curr += size;
+    return addr;
+}
+
+static int size_class(unsigned int size) {
+    unsigned int cap = MIN_CLASS_SIZE;
+    for (int k = 0; k < NUM_CLASSES; k++) {
+        if (size <= cap) {
+            return k;
+        }
+        cap <<= 1;
+    }
+    return -1;
+}
+
+// slab_refill: split a fresh slab into blocks of one size class.
+// Args: k (size class index).
+// Returns: 0 on success, -1 if the heap is exhausted.
+static int slab_refill(int k) {
+    unsigned int payload = (unsigned int)MIN_CLASS_SIZE << k;
+    unsigned int stride = sizeof(BlockHeader) + payload;
+    unsigned int base = bump_alloc(SLAB_BYTES);
+    if (!base) {
+        return -1;
+    }
+    for (unsigned int off = 0; off + stride <= SLAB_BYTES; off += stride) {
+        BlockHeader *b = (BlockHeader *)(base + off);
+        b->magic = BLOCK_MAGIC_FREE;
+        b->size = payload;
+        b->klass = (unsigned int)k;
+        b->next = class_free[k];
+        class_free[k] = b;
+    }
+    return 0;
+}
+
+static void *small_alloc(int k) {
+    if (!class_free[k] && slab_refill(k) < 0) {
+        return 0;
+    }
+    BlockHeader *b = class_free[k];
+    class_free[k] = b->next;
+    b->magic = BLOCK_MAGIC_USED;
+    b->next = 0;
+    return b + 1;
+}
+
+static void *large_alloc(unsigned int size) {
+    BlockHeader **link = &large_free;
+    while (*link) {
+        BlockHeader *b = *link;
+        if (b->size >= size) {
+            unsigned int rest = b->size - size;
+            if (rest >= sizeof(BlockHeader) + MIN_SPLIT) {
+                BlockHeader *tail = (BlockHeader *)((unsigned int)(b + 1) + size);
+                tail->magic = BLOCK_MAGIC_FREE;
+                tail->size = rest - sizeof(BlockHeader);
+                tail->klass = LARGE_CLASS;
+                tail->next = b->next;
+                b->size = size;
+                *link = tail;
+            } else {
+                *link = b->next;
+            }
+            b->magic = BLOCK_MAGIC_USED;
+            b->next = 0;
+            return b + 1;
+        }
+        link = &b->next;
+    }
+    unsigned int addr = bump_alloc(sizeof(BlockHeader) + size);
+    if (!addr) {
+        return 0;
+    }
+    BlockHeader *b = (BlockHeader *)addr;
+    b->magic = BLOCK_MAGIC_USED;
+    b->size = size;
+    b->klass = LARGE_CLASS;
+    b->next = 0;
+    return b + 1;
+}
+
+static unsigned int block_end(const BlockHeader *b) {
+    return (unsigned int)(b + 1) + b->size;
+}
+
+// large_free_insert: return a large block, merging with adjacent free
+// blocks and giving the tail of the heap back to the bump region.
+// Args: b (block header).
+// Returns: none.
+static void large_free_insert(BlockHeader *b) {
+    BlockHeader *prev = 0;
+    BlockHeader *next = large_free;
+    while (next && next < b) {
+        prev = next;
+        next = next->next;
+    }
+    b->magic = BLOCK_MAGIC_FREE;
+    if (next && block_end(b) == (unsigned int)next) {
+        b->size += sizeof(BlockHeader) + next->size;
+        next = next->next;
+    }
+    if (prev && block_end(prev) == (unsigned int)b) {
+        prev->size += sizeof(BlockHeader) + b->size;
+        prev->next = next;
+        b = prev;
+    } else {
+        b->next = next;
+        if (prev) {
+            prev->next = b;
+        } else {
+            large_free = b;
+        }
+    }
+    if (block_end(b) != heap_curr) {
+        return;
+    }
+    // The merged block is the highest one below heap_curr, so it is the
+    // last entry of the address-ordered list.
+    if (large_free == b) {
+        large_free = 0;
+    } else {
+        BlockHeader *p = large_free;
+        while (p->next != b) {
+            p = p->next;
+        }
+        p->next = 0;
+    }
+    heap_curr = (unsigned int)b;
+}
+
 void *kmalloc(unsigned int size) {
     if (size == 0) {
         return 0;
     }
     size = align_up(size, 16);
-    if (heap_curr == 0 || heap_curr + size > heap_end) {
+    void *p;
+    int k = size <= MAX_CLASS_SIZE ? size_class(size) : -1;
+    unsigned int flags = spin_lock_irqsave(&mem_lock);
+    if (k >= 0) {
+        p = small_alloc(k);
+    } else {
+        p = large_alloc(size);
+    }
+    spin_unlock_irqrestore(&mem_lock, flags);
+    if (!p) {
         console_write("kmalloc: out of memory\n");
-        return 0;
     }
-    unsigned int addr = heap_curr;
-    heap_curr += size;
-    return (void *)addr;
+    return p;
 }
 
 void *kmalloc_zero(unsigned int size) {
@@ -90,3 +269,39 @@ void *kmalloc_zero(unsigned int size) {
     }
     return p;
 }
+
+void kfree(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    BlockHeader *b = (BlockHeader *)ptr - 1;
+    unsigned int flags = spin_lock_irqsave(&mem_lock);
+    if (b->magic != BLOCK_MAGIC_USED) {
+        spin_unlock_irqrestore(&mem_lock, flags);
+        console_write(b->magic == BLOCK_MAGIC_FREE ? "kfree: double free\n" : "kfree: bad pointer\n");
+        return;
+    }
+    if (b->klass == LARGE_CLASS) {
+        large_free_insert(b);
+    } else {
+        b->magic = BLOCK_MAGIC_FREE;
+        b->next = class_free[b->klass];
+        class_free[b->klass] = b;
+    }
+    spin_unlock_irqrestore(&mem_lock, flags);
+}
+
+unsigned int kmem_free_bytes(void) {
+    unsigned int flags = spin_lock_irqsave(&mem_lock);
+    unsigned int total = heap_end - heap_curr;
+    for (BlockHeader *b = large_free; b; b = b->next) {
+        total += b->size;
+    }
+    for (int k = 0; k < NUM_CLASSES; k++) {
+        for (BlockHeader *b = class_free[k]; b; b = b->next) {
+            total += b->size;
+        }
+    }
+    spin_unlock_irqrestore(&mem_lock, flags);
+    return total;
+}
@@ -6,5 +6,7 @@
 void mem_init(const BootInfo *info, unsigned int kernel_end);
 void *kmalloc(unsigned int size);
 void *kmalloc_zero(unsigned int size);
+void kfree(void *ptr);
+unsigned int kmem_free_bytes(void);
 
 #endif
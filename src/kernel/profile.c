@@ -0,0 +1,31 @@
+#include "profile.h"
+#include "scheme/scheme.h"
+#include "thread.h"
+
+// Interpreter running on each thread, if any. A thread only ever sets or
+// clears its own slot, and only the timer interrupt of the CPU it is
+// running on reads it, so no lock is needed.
+static Scheme *volatile thread_scheme[MAX_THREADS];
+
+// profile_attach: make a thread's interpreter visible to the sampler.
+// Args: tid (thread id), sc (interpreter owned by that thread).
+// Returns: none.
+void profile_attach(int tid, Scheme *sc) {
+    if (tid >= 0 && tid < MAX_THREADS) {
+        thread_scheme[tid] = sc;
+    }
+}
+
+void profile_detach(int tid) {
+    profile_attach(tid, 0);
+}
+
+// profile_tick: timer-interrupt hook; samples the interrupted thread and
+// charges the tick to its CPU quota.
+// Args: tid (thread running on this CPU).
+// Returns: none.
+void profile_tick(int tid) {
+    if (tid >= 0 && tid < MAX_THREADS) {
+        scheme_tick(thread_scheme[tid]);
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef SLOPOS_PROFILE_H
+#define SLOPOS_PROFILE_H
+
+struct Scheme;
+
+void profile_attach(int tid, struct Scheme *sc);
+void profile_detach(int tid);
+void profile_tick(int tid);
+
+#endif
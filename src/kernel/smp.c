@@ -0,0 +1,306 @@
+#include "smp.h"
+#include "console.h"
+#include "idt.h"
+#include "mem.h"
+#include "ports.h"
+#include "thread.h"
+
+// Local APIC registers, as byte offsets from the MMIO base.
+#define LAPIC_DEFAULT_BASE 0xFEE00000u
+#define LAPIC_ID 0x020
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_TIMER_PERIODIC 0x20000
+#define LAPIC_TIMER_MASKED 0x10000
+#define LAPIC_DIVIDE_16 0x3
+#define ICR_INIT 0x00004500
+#define ICR_STARTUP 0x00004600
+#define ICR_PENDING 0x00001000
+
+// The trampoline runs in real mode, so it must sit below 1MB on a page
+// boundary; 0x7000 is free once the boot sector and stage 2 are done.
+#define AP_TRAMPOLINE_ADDR 0x7000
+#define AP_STACK_SIZE 16384
+#define AP_START_TIMEOUT_TICKS 100
+
+typedef struct MpFloating {
+    char signature[4];
+    unsigned int config;
+    unsigned char length;
+    unsigned char revision;
+    unsigned char checksum;
+    unsigned char features[5];
+} __attribute__((packed)) MpFloating;
+
+typedef struct MpConfig {
+    char signature[4];
+    unsigned short length;
+    unsigned char revision;
+    unsigned char checksum;
+    char oem[8];
+    char product[12];
+    unsigned int oem_table;
+    unsigned short oem_size;
+    unsigned short entry_count;
+    unsigned int lapic;
+    unsigned short ext_length;
+    unsigned char ext_checksum;
+    unsigned char reserved;
+} __attribute__((packed)) MpConfig;
+
+typedef struct MpProcessor {
+    unsigned char type;
+    unsigned char apic_id;
+    unsigned char apic_version;
+    unsigned char flags;
+    unsigned int signature;
+    unsigned int features;
+    unsigned int reserved[2];
+} __attribute__((packed)) MpProcessor;
+
+#define MP_ENTRY_PROCESSOR 0
+#define MP_PROC_ENABLED 0x01
+#define MP_PROC_BSP 0x02
+
+// Parameter block at the start of the trampoline (see trampoline.asm).
+typedef struct ApParams {
+    unsigned int stack;
+    unsigned int entry;
+    unsigned int cpu;
+} ApParams;
+
+extern const unsigned char ap_trampoline_start[];
+extern const unsigned char ap_trampoline_end[];
+
+static volatile unsigned int *lapic;
+static int cpu_count = 1;
+static unsigned char apic_to_cpu[256];
+static volatile int ap_started[MAX_CPUS];
+static unsigned int lapic_timer_count;
+
+static unsigned int lapic_read(unsigned int reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(unsigned int reg, unsigned int value) {
+    lapic[reg / 4] = value;
+    (void)lapic[LAPIC_ID / 4];
+}
+
+static int mp_checksum_ok(const unsigned char *p, unsigned int len) {
+    unsigned char sum = 0;
+    for (unsigned int i = 0; i < len; i++) {
+        sum = (unsigned char)(sum + p[i]);
+    }
+    return sum == 0;
+}
+
+static const MpFloating *mp_scan(unsigned int base, unsigned int len) {
+    for (unsigned int addr = base; addr + sizeof(MpFloating) <= base + len; addr += 16) {
+        const MpFloating *mp = (const MpFloating *)addr;
+        if (mp->signature[0] == '_' && mp->signature[1] == 'M' && mp->signature[2] == 'P' &&
+            mp->signature[3] == '_' && mp_checksum_ok((const unsigned char *)mp, sizeof(MpFloating))) {
+            return mp;
+        }
+    }
+    return 0;
+}
+
+// mp_find: locate the MP floating pointer structure.
+// Args: none.
+// Returns: pointer to it, or 0 if the firmware published none.
+static const MpFloating *mp_find(void) {
+    // The BIOS data area holds the EBDA segment at 0x40E.
+    const volatile unsigned short *bda_ebda = (const volatile unsigned short *)0x40E;
+    __asm__ ("" : "+r"(bda_ebda));
+    unsigned int ebda = (unsigned int)*bda_ebda << 4;
+    const MpFloating *mp = 0;
+    if (ebda) {
+        mp = mp_scan(ebda, 1024);
+    }
+    if (!mp) {
+        mp = mp_scan(0x9FC00, 1024);
+    }
+    if (!mp) {
+        mp = mp_scan(0xF0000, 0x10000);
+    }
+    return mp;
+}
+
+static void io_delay_us(unsigned int us) {
+    while (us--) {
+        outb(0x80, 0);
+    }
+}
+
+static void wait_ticks(unsigned int n) {
+    unsigned int start = timer_ticks();
+    while (timer_ticks() - start < n) {
+        __asm__ volatile ("pause");
+    }
+}
+
+static void lapic_enable(void) {
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+}
+
+// lapic_calibrate: measure the LAPIC timer against one PIT tick.
+// Args: none.
+// Returns: none; the BSP must already be taking PIT interrupts.
+static void lapic_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_MASKED | LAPIC_TIMER_VECTOR);
+    wait_ticks(1);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFFu);
+    wait_ticks(1);
+    lapic_timer_count = 0xFFFFFFFFu - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    if (lapic_timer_count == 0) {
+        lapic_timer_count = 100000;
+    }
+}
+
+static void lapic_timer_start(void) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, lapic_timer_count);
+}
+
+void lapic_eoi(void) {
+    if (lapic) {
+        lapic_write(LAPIC_EOI, 0);
+    }
+}
+
+static void lapic_send_ipi(unsigned int apic_id, unsigned int command) {
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) {
+        __asm__ volatile ("pause");
+    }
+}
+
+// ap_main: C entry point of an application processor.
+// Args: cpu (index assigned by the BSP).
+// Returns: never; the boot stack becomes this CPU's idle thread.
+static void ap_main(unsigned int cpu) {
+    idt_load();
+    lapic_enable();
+    if (thread_cpu_init((int)cpu) < 0) {
+        console_write("smp: no thread slot for cpu ");
+        console_write_dec(cpu);
+        console_write("\n");
+        for (;;) {
+            __asm__ volatile ("cli; hlt");
+        }
+    }
+    lapic_timer_start();
+    ap_started[cpu] = 1;
+    __asm__ volatile ("sti");
+    // The LAPIC timer wakes the halted CPU to look for work to steal.
+    for (;;) {
+        thread_yield();
+        thread_idle();
+    }
+}
+
+// ap_start: bring one application processor online.
+// Args: cpu (index to assign), apic_id (target local APIC).
+// Returns: 0 once the AP reports in, -1 on failure or timeout.
+static int ap_start(int cpu, unsigned int apic_id) {
+    unsigned char *stack = (unsigned char *)kmalloc(AP_STACK_SIZE);
+    if (!stack) {
+        return -1;
+    }
+    ApParams *params = (ApParams *)(AP_TRAMPOLINE_ADDR + 4);
+    params->stack = (unsigned int)(stack + AP_STACK_SIZE);
+    params->entry = (unsigned int)ap_main;
+    params->cpu = (unsigned int)cpu;
+    apic_to_cpu[apic_id] = (unsigned char)cpu;
+
+    lapic_send_ipi(apic_id, ICR_INIT);
+    wait_ticks(2);
+    for (int attempt = 0; attempt < 2 && !ap_started[cpu]; attempt++) {
+        lapic_send_ipi(apic_id, ICR_STARTUP | (AP_TRAMPOLINE_ADDR >> 12));
+        io_delay_us(200);
+    }
+    unsigned int start = timer_ticks();
+    while (!ap_started[cpu] && timer_ticks() - start < AP_START_TIMEOUT_TICKS) {
+        __asm__ volatile ("pause");
+    }
+    if (!ap_started[cpu]) {
+        kfree(stack);
+        return -1;
+    }
+    return 0;
+}
+
+// smp_init: discover processors from the MP table and start the APs.
+// Args: none.
+// Returns: none; falls back to a single CPU if anything is missing.
+// Must run on the BSP after thread_init and with the PIT ticking.
+void smp_init(void) {
+    const MpFloating *mp = mp_find();
+    if (!mp || !mp->config || mp->features[0] != 0) {
+        return;
+    }
+    const MpConfig *cfg = (const MpConfig *)mp->config;
+    if (cfg->signature[0] != 'P' || cfg->signature[1] != 'C' || cfg->signature[2] != 'M' ||
+        cfg->signature[3] != 'P' || !mp_checksum_ok((const unsigned char *)cfg, cfg->length)) {
+        return;
+    }
+
+    lapic = (volatile unsigned int *)(cfg->lapic ? cfg->lapic : LAPIC_DEFAULT_BASE);
+    lapic_enable();
+    unsigned int bsp_id = lapic_read(LAPIC_ID) >> 24;
+    apic_to_cpu[bsp_id] = 0;
+    lapic_calibrate();
+
+    unsigned char *dst = (unsigned char *)AP_TRAMPOLINE_ADDR;
+    for (const unsigned char *src = ap_trampoline_start; src < ap_trampoline_end; src++) {
+        *dst++ = *src;
+    }
+
+    const unsigned char *entry = (const unsigned char *)(cfg + 1);
+    for (unsigned int i = 0; i < cfg->entry_count; i++) {
+        if (*entry != MP_ENTRY_PROCESSOR) {
+            entry += 8;
+            continue;
+        }
+        const MpProcessor *proc = (const MpProcessor *)entry;
+        entry += sizeof(MpProcessor);
+        if (!(proc->flags & MP_PROC_ENABLED) || (proc->flags & MP_PROC_BSP) || proc->apic_id == bsp_id ||
+            cpu_count >= MAX_CPUS) {
+            continue;
+        }
+        if (ap_start(cpu_count, proc->apic_id) == 0) {
+            cpu_count++;
+        } else {
+            console_write("smp: cpu with apic id ");
+            console_write_dec(proc->apic_id);
+            console_write(" did not start\n");
+        }
+    }
+}
+
+int smp_cpu_count(void) {
+    return cpu_count;
+}
+
+// smp_cpu_index: index of the CPU executing the caller.
+// Args: none.
+// Returns: 0 for the BSP (or before smp_init), 1.. for APs.
+int smp_cpu_index(void) {
+    if (!lapic) {
+        return 0;
+    }
+    return apic_to_cpu[lapic_read(LAPIC_ID) >> 24];
+}
@@ -0,0 +1,11 @@
+#ifndef SLOPOS_SMP_H
+#define SLOPOS_SMP_H
+
+#define MAX_CPUS 8
+
+void smp_init(void);
+int smp_cpu_count(void);
+int smp_cpu_index(void);
+void lapic_eoi(void);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SLOPOS_SPINLOCK_H
+#define SLOPOS_SPINLOCK_H
+
+typedef struct Spinlock {
+    volatile unsigned int locked;
+} Spinlock;
+
+#define SPINLOCK_INIT {0}
+
+static inline unsigned int irq_save(void) {
+    unsigned int flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned int flags) {
+    if (flags & 0x200) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
+static inline void spin_lock(Spinlock *lock) {
+    unsigned int one = 1;
+    for (;;) {
+        __asm__ volatile ("xchgl %0, %1" : "+r"(one), "+m"(lock->locked) : : "memory");
+        if (one == 0) {
+            return;
+        }
+        while (lock->locked) {
+            __asm__ volatile ("pause");
+        }
+        one = 1;
+    }
+}
+
+static inline void spin_unlock(Spinlock *lock) {
+    __asm__ volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+// Locks taken from both thread context and interrupt handlers must keep
+// interrupts off while held, or a handler on the same CPU would spin on
+// a lock its own CPU already owns.
+static inline unsigned int spin_lock_irqsave(Spinlock *lock) {
+    unsigned int flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(Spinlock *lock, unsigned int flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif
@@ -1,131 +1,531 @@
 #include "thread.h"
+#include "console.h"
+#include "mem.h"
 #include "ports.h"
+#include "profile.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "time.h"
+#include "trace.h"
 
-#define MAX_THREADS 8
-#define STACK_SIZE 4096
+// Each spawned stack is preceded by a guard region of canary words. The
+// stack grows down towards it, so a deep recursion that runs off the end
+// clobbers the canaries before it reaches the neighbouring allocation.
+#define STACK_GUARD_SIZE 256
+#define STACK_CANARY 0xDEADC0DEu
+#define STACK_FILL 0x5A5A5A5Au
 
 typedef enum {
     THREAD_UNUSED,
+    THREAD_STARTING,
     THREAD_RUNNABLE,
-    THREAD_SLEEPING
+    THREAD_RUNNING,
+    THREAD_SLEEPING,
+    THREAD_BLOCKED
 } thread_state;
 
 typedef struct Thread {
     unsigned int *esp;
     thread_state state;
-    unsigned int sleep_ticks;
+    unsigned long long wake_ns;
     thread_fn fn;
     void *arg;
+    unsigned int *guard;
+    unsigned int *stack;
+    unsigned int stack_size;
+    unsigned int alloc_size;
+    int wait_next;
+    int cpu;
+    int idle;
 } Thread;
 
+// Per-CPU scheduler state. Each CPU runs threads from its own FIFO and,
+// when that is empty, steals from the tail of the longest other queue.
+// The boot context of every CPU is its idle thread: it is never queued
+// and runs only when nothing else can.
+typedef struct CpuSched {
+    int online;
+    int current;
+    int idle;
+    int queue[MAX_THREADS];
+    int head;
+    int count;
+} CpuSched;
+
 static Thread threads[MAX_THREADS];
-static int current_thread = 0;
+static CpuSched cpus[MAX_CPUS];
+static volatile unsigned int ticks;
+
+// One lock covers the thread table, run queues and wait queues. It is
+// held across context_switch and released by the incoming thread, so no
+// CPU can pick up the outgoing thread before its registers are saved.
+static Spinlock sched_lock = SPINLOCK_INIT;
 
 extern void context_switch(unsigned int **old_esp, unsigned int *new_esp);
 extern void thread_start(void);
 
-static void schedule_next(void);
+static CpuSched *this_cpu(void) {
+    return &cpus[smp_cpu_index()];
+}
 
 void thread_init(void) {
     for (int i = 0; i < MAX_THREADS; i++) {
         threads[i].esp = 0;
         threads[i].state = THREAD_UNUSED;
-        threads[i].sleep_ticks = 0;
+        threads[i].wake_ns = 0;
         threads[i].fn = 0;
         threads[i].arg = 0;
+        threads[i].guard = 0;
+        threads[i].stack = 0;
+        threads[i].stack_size = 0;
+        threads[i].alloc_size = 0;
+        threads[i].wait_next = -1;
+        threads[i].cpu = 0;
+        threads[i].idle = 0;
+    }
+    for (int c = 0; c < MAX_CPUS; c++) {
+        cpus[c].online = 0;
+        cpus[c].current = 0;
+        cpus[c].idle = 0;
+        cpus[c].head = 0;
+        cpus[c].count = 0;
+    }
+    threads[0].state = THREAD_RUNNING;
+    threads[0].idle = 1;
+    cpus[0].online = 1;
+}
+
+// thread_cpu_init: adopt the calling AP's boot context as its idle thread.
+// Args: cpu (index of the calling CPU).
+// Returns: 0 on success, -1 if the thread table is full.
+int thread_cpu_init(int cpu) {
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    for (int i = 1; i < MAX_THREADS; i++) {
+        if (threads[i].state == THREAD_UNUSED && !threads[i].guard) {
+            threads[i].state = THREAD_RUNNING;
+            threads[i].idle = 1;
+            threads[i].cpu = cpu;
+            cpus[cpu].current = i;
+            cpus[cpu].idle = i;
+            cpus[cpu].online = 1;
+            spin_unlock_irqrestore(&sched_lock, flags);
+            return 0;
+        }
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return -1;
+}
+
+static void runqueue_push(int cpu, int tid) {
+    CpuSched *c = &cpus[cpu];
+    c->queue[(c->head + c->count) % MAX_THREADS] = tid;
+    c->count++;
+    threads[tid].state = THREAD_RUNNABLE;
+    threads[tid].cpu = cpu;
+}
+
+static int runqueue_pop(CpuSched *c) {
+    if (c->count == 0) {
+        return -1;
+    }
+    int tid = c->queue[c->head];
+    c->head = (c->head + 1) % MAX_THREADS;
+    c->count--;
+    return tid;
+}
+
+// runqueue_steal: take the most recently queued thread from the busiest CPU.
+// Args: self (index of the stealing CPU).
+// Returns: thread id, or -1 if every other queue is empty.
+static int runqueue_steal(int self) {
+    int victim = -1;
+    for (int c = 0; c < MAX_CPUS; c++) {
+        if (c != self && cpus[c].online && cpus[c].count > 0 &&
+            (victim < 0 || cpus[c].count > cpus[victim].count)) {
+            victim = c;
+        }
+    }
+    if (victim < 0) {
+        return -1;
+    }
+    CpuSched *v = &cpus[victim];
+    v->count--;
+    return v->queue[(v->head + v->count) % MAX_THREADS];
+}
+
+// stack_check: verify the guard canaries below a thread's stack.
+// Args: tid (thread index).
+// Returns: none; halts the machine if the guard was overwritten.
+static void stack_check(int tid) {
+    const Thread *t = &threads[tid];
+    if (!t->guard) {
+        return;
+    }
+    for (unsigned int i = 0; i < STACK_GUARD_SIZE / 4; i++) {
+        if (t->guard[i] != STACK_CANARY) {
+            __asm__ volatile ("cli");
+            console_write("thread ");
+            console_write_dec((unsigned int)tid);
+            console_write(": kernel stack overflow (stack size ");
+            console_write_dec(t->stack_size);
+            console_write(")\n");
+            for (;;) {
+                __asm__ volatile ("hlt");
+            }
+        }
+    }
+}
+
+// wake_sleepers_locked: queue every sleeping thread whose deadline passed.
+// Args: now (time_now_ns), target (CPU to queue them on, or -1 for the
+// CPU each last ran on).
+// Returns: none; sched_lock must be held.
+static void wake_sleepers_locked(unsigned long long now, int target) {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if (threads[i].state == THREAD_SLEEPING && threads[i].wake_ns <= now) {
+            runqueue_push(target < 0 ? threads[i].cpu : target, i);
+        }
+    }
+}
+
+// schedule_locked: switch this CPU to the next thread to run.
+// Args: none; sched_lock must be held with interrupts off, and the current
+// thread's state already set (RUNNING to stay runnable).
+// Returns: when the calling thread is next scheduled, still holding the lock.
+static void schedule_locked(void) {
+    int self = smp_cpu_index();
+    CpuSched *cpu = &cpus[self];
+    int prev = cpu->current;
+    Thread *p = &threads[prev];
+    wake_sleepers_locked(time_now_ns(), -1);
+    if (p->state == THREAD_RUNNING && !p->idle) {
+        runqueue_push(self, prev);
+    }
+    int next = runqueue_pop(cpu);
+    if (next < 0) {
+        next = runqueue_steal(self);
+    }
+    if (next < 0) {
+        if (p->state == THREAD_RUNNING) {
+            return;
+        }
+        next = cpu->idle;
+    }
+    threads[next].state = THREAD_RUNNING;
+    threads[next].cpu = self;
+    if (next == prev) {
+        return;
+    }
+    stack_check(prev);
+    trace_event(TRACE_CTX_SWITCH, (unsigned int)next);
+    cpu->current = next;
+    context_switch(&p->esp, threads[next].esp);
+}
+
+// stack_prepare: allocate (or reuse) a guarded stack for a thread slot.
+// Args: t (thread slot), stack_size (usable bytes, rounded up to 16).
+// Returns: 0 on success, -1 if the allocation failed.
+static int stack_prepare(Thread *t, unsigned int stack_size) {
+    stack_size = (stack_size + 15) & ~15u;
+    unsigned int alloc_size = STACK_GUARD_SIZE + stack_size;
+    if (!t->guard || t->alloc_size < alloc_size) {
+        kfree(t->guard);
+        t->guard = 0;
+        unsigned int *mem = (unsigned int *)kmalloc(alloc_size);
+        if (!mem) {
+            return -1;
+        }
+        t->guard = mem;
+        t->alloc_size = alloc_size;
+    }
+    t->stack = t->guard + STACK_GUARD_SIZE / 4;
+    t->stack_size = stack_size;
+    for (unsigned int i = 0; i < STACK_GUARD_SIZE / 4; i++) {
+        t->guard[i] = STACK_CANARY;
+    }
+    for (unsigned int i = 0; i < stack_size / 4; i++) {
+        t->stack[i] = STACK_FILL;
+    }
+    return 0;
+}
+
+// reap_stacks: free the stacks of threads that have exited.
+// Args: none.
+// Returns: none. An exited thread is off its stack once it is UNUSED and
+// sched_lock is free, since it gives up the lock only by switching away.
+static void reap_stacks(void) {
+    unsigned int *dead[MAX_THREADS];
+    int n = 0;
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    for (int i = 1; i < MAX_THREADS; i++) {
+        if (threads[i].state == THREAD_UNUSED && threads[i].guard) {
+            dead[n++] = threads[i].guard;
+            threads[i].guard = 0;
+            threads[i].stack = 0;
+            threads[i].stack_size = 0;
+            threads[i].alloc_size = 0;
+        }
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    for (int i = 0; i < n; i++) {
+        kfree(dead[i]);
     }
-    threads[0].state = THREAD_RUNNABLE;
-    threads[0].esp = 0;
-    current_thread = 0;
 }
 
 int thread_spawn(thread_fn fn, void *arg) {
-    static unsigned char stacks[MAX_THREADS][STACK_SIZE];
+    return thread_spawn_stack(fn, arg, THREAD_DEFAULT_STACK_SIZE);
+}
+
+int thread_spawn_stack(thread_fn fn, void *arg, unsigned int stack_size) {
+    if (stack_size < THREAD_MIN_STACK_SIZE) {
+        stack_size = THREAD_MIN_STACK_SIZE;
+    }
+    reap_stacks();
 
+    int tid = -1;
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
     for (int i = 1; i < MAX_THREADS; i++) {
         if (threads[i].state == THREAD_UNUSED) {
-            unsigned int *stack_top = (unsigned int *)(stacks[i] + STACK_SIZE);
-
-            *(--stack_top) = (unsigned int)thread_start; /* return addr */
-            *(--stack_top) = 0; /* saved ebp */
-            *(--stack_top) = 0; /* saved ebx */
-            *(--stack_top) = 0; /* saved esi */
-            *(--stack_top) = 0; /* saved edi */
-
-            threads[i].esp = stack_top;
-            threads[i].state = THREAD_RUNNABLE;
-            threads[i].sleep_ticks = 0;
-            threads[i].fn = fn;
-            threads[i].arg = arg;
-            return i;
+            threads[i].state = THREAD_STARTING;
+            tid = i;
+            break;
         }
     }
-    return -1;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if (tid < 0) {
+        return -1;
+    }
+
+    Thread *t = &threads[tid];
+    if (stack_prepare(t, stack_size) < 0) {
+        flags = spin_lock_irqsave(&sched_lock);
+        t->state = THREAD_UNUSED;
+        spin_unlock_irqrestore(&sched_lock, flags);
+        return -1;
+    }
+    unsigned int *stack_top = t->stack + t->stack_size / 4;
+
+    *(--stack_top) = (unsigned int)thread_start; /* return addr */
+    *(--stack_top) = 0; /* saved ebp */
+    *(--stack_top) = 0; /* saved ebx */
+    *(--stack_top) = 0; /* saved esi */
+    *(--stack_top) = 0; /* saved edi */
+
+    t->esp = stack_top;
+    t->wake_ns = 0;
+    t->fn = fn;
+    t->arg = arg;
+
+    // New work goes to the online CPU with the shortest queue.
+    flags = spin_lock_irqsave(&sched_lock);
+    int target = 0;
+    for (int c = 1; c < MAX_CPUS; c++) {
+        if (cpus[c].online && cpus[c].count < cpus[target].count) {
+            target = c;
+        }
+    }
+    runqueue_push(target, tid);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    trace_event(TRACE_THREAD_SPAWN, (unsigned int)tid);
+    return tid;
 }
 
 void thread_yield(void) {
-    schedule_next();
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    schedule_locked();
+    spin_unlock_irqrestore(&sched_lock, flags);
 }
 
-void thread_sleep(unsigned int ticks) {
-    threads[current_thread].sleep_ticks = ticks;
-    threads[current_thread].state = THREAD_SLEEPING;
-    schedule_next();
+void thread_sleep(unsigned int ticks_to_sleep) {
+    thread_sleep_ns((unsigned long long)ticks_to_sleep * (1000000000u / TIMER_HZ));
+}
+
+// thread_sleep_ns: block the calling thread for at least ns nanoseconds.
+// Args: ns (duration; 0 just yields).
+// Returns: once the deadline has passed and the thread is rescheduled.
+// Deadlines are absolute clock times, checked on every tick, every
+// scheduling decision and by idle CPUs, which spin instead of halting when
+// the next deadline falls before the next tick.
+void thread_sleep_ns(unsigned long long ns) {
+    if (ns == 0) {
+        thread_yield();
+        return;
+    }
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    Thread *t = &threads[this_cpu()->current];
+    t->wake_ns = time_now_ns() + ns;
+    t->state = THREAD_SLEEPING;
+    schedule_locked();
+    spin_unlock_irqrestore(&sched_lock, flags);
 }
 
 void scheduler_tick(void) {
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    ticks++;
+    wake_sleepers_locked(time_now_ns(), -1);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+// thread_idle: wait for work on an idle CPU.
+// Args: none.
+// Returns: when there may be something to run; the caller then yields.
+// Halts until the next interrupt unless a sleeper is due before the next
+// tick, in which case it polls the clock to wake it on time.
+void thread_idle(void) {
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    unsigned long long now = time_now_ns();
+    int self = smp_cpu_index();
+    wake_sleepers_locked(now, self);
+    int has_work = cpus[self].count > 0;
+    unsigned long long next = 0;
     for (int i = 0; i < MAX_THREADS; i++) {
-        if (threads[i].state == THREAD_SLEEPING && threads[i].sleep_ticks > 0) {
-            threads[i].sleep_ticks--;
-            if (threads[i].sleep_ticks == 0) {
-                threads[i].state = THREAD_RUNNABLE;
-            }
+        if (threads[i].state == THREAD_SLEEPING && (!next || threads[i].wake_ns < next)) {
+            next = threads[i].wake_ns;
         }
     }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if (has_work) {
+        return;
+    }
+    if (next && next - now < 1000000000u / TIMER_HZ) {
+        while (time_now_ns() < next) {
+            __asm__ volatile ("pause");
+        }
+        return;
+    }
+    __asm__ volatile ("sti; hlt");
 }
 
+// timer_tick: PIT interrupt, delivered to the BSP only.
 void timer_tick(void) {
+    stack_check(this_cpu()->current);
+    profile_tick(this_cpu()->current);
     scheduler_tick();
     outb(0x20, 0x20);
 }
 
+// lapic_timer_tick: per-CPU LAPIC timer interrupt on application processors.
+void lapic_timer_tick(void) {
+    stack_check(this_cpu()->current);
+    profile_tick(this_cpu()->current);
+    lapic_eoi();
+}
+
+unsigned int timer_ticks(void) {
+    return ticks;
+}
+
 void thread_exit(void) {
-    threads[current_thread].state = THREAD_UNUSED;
-    schedule_next();
+    trace_event(TRACE_THREAD_EXIT, 0);
+    (void)spin_lock_irqsave(&sched_lock);
+    threads[this_cpu()->current].state = THREAD_UNUSED;
+    schedule_locked();
     for (;;) {
     }
 }
 
 void thread_start(void) {
-    Thread *t = &threads[current_thread];
+    // First run of a spawned thread: finish the switch that got us here.
+    spin_unlock(&sched_lock);
+    __asm__ volatile ("sti");
+    Thread *t = &threads[this_cpu()->current];
     if (t->fn) {
         t->fn(t->arg);
     }
     thread_exit();
 }
 
+int thread_current(void) {
+    return this_cpu()->current;
+}
+
 int thread_active_count(void) {
     int count = 0;
-    for (int i = 1; i < MAX_THREADS; i++) {
-        if (threads[i].state != THREAD_UNUSED) {
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if (threads[i].state != THREAD_UNUSED && !threads[i].idle) {
             count++;
         }
     }
+    spin_unlock_irqrestore(&sched_lock, flags);
     return count;
 }
 
-static void schedule_next(void) {
-    int next = current_thread;
-    for (int i = 0; i < MAX_THREADS; i++) {
-        next = (next + 1) % MAX_THREADS;
-        if (threads[next].state == THREAD_RUNNABLE) {
-            if (next == current_thread) {
-                return;
-            }
-            int prev = current_thread;
-            current_thread = next;
-            context_switch(&threads[prev].esp, threads[next].esp);
-            return;
+unsigned int thread_stack_size(int tid) {
+    if (tid < 0 || tid >= MAX_THREADS) {
+        return 0;
+    }
+    return threads[tid].stack_size;
+}
+
+// thread_stack_high_water: deepest stack usage seen by a thread.
+// Args: tid (thread index).
+// Returns: bytes of stack touched since spawn (0 for idle threads).
+unsigned int thread_stack_high_water(int tid) {
+    if (tid < 0 || tid >= MAX_THREADS || !threads[tid].stack) {
+        return 0;
+    }
+    const Thread *t = &threads[tid];
+    unsigned int words = t->stack_size / 4;
+    unsigned int untouched = 0;
+    while (untouched < words && t->stack[untouched] == STACK_FILL) {
+        untouched++;
+    }
+    return (words - untouched) * 4;
+}
+
+void wait_queue_init(WaitQueue *q) {
+    q->head = -1;
+    q->tail = -1;
+}
+
+// thread_block: park the current thread on a wait queue until woken.
+// Args: q (queue to wait on), lock (caller's lock guarding the condition,
+// held with interrupts off; released while asleep and retaken on return).
+// Returns: once another thread wakes this one.
+void thread_block(WaitQueue *q, Spinlock *lock) {
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    int tid = this_cpu()->current;
+    Thread *t = &threads[tid];
+    t->state = THREAD_BLOCKED;
+    t->wait_next = -1;
+    if (q->tail < 0) {
+        q->head = tid;
+    } else {
+        threads[q->tail].wait_next = tid;
+    }
+    q->tail = tid;
+    // The caller's lock is dropped only once we are on the queue, so a
+    // waker that takes it afterwards cannot miss us.
+    if (lock) {
+        spin_unlock(lock);
+    }
+    schedule_locked();
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if (lock) {
+        spin_lock(lock);
+    }
+}
+
+// thread_wake_one: make the longest-waiting thread on a queue runnable.
+// Args: q (queue to wake from).
+// Returns: woken thread id, or -1 if the queue was empty.
+int thread_wake_one(WaitQueue *q) {
+    unsigned int flags = spin_lock_irqsave(&sched_lock);
+    int tid = q->head;
+    if (tid >= 0) {
+        q->head = threads[tid].wait_next;
+        if (q->head < 0) {
+            q->tail = -1;
         }
+        threads[tid].wait_next = -1;
+        runqueue_push(threads[tid].cpu, tid);
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return tid;
+}
+
+void thread_wake_all(WaitQueue *q) {
+    while (thread_wake_one(q) >= 0) {
     }
 }
@@ -1,15 +1,41 @@
 #ifndef SLOPOS_THREAD_H
 #define SLOPOS_THREAD_H
 
+#include "spinlock.h"
+
+#define MAX_THREADS 16
+#define THREAD_DEFAULT_STACK_SIZE 16384
+#define THREAD_MIN_STACK_SIZE 4096
+#define TIMER_HZ 100
+
 typedef void (*thread_fn)(void *arg);
 
+// FIFO of blocked thread ids, linked through the thread table.
+typedef struct WaitQueue {
+    int head;
+    int tail;
+} WaitQueue;
+
 void thread_init(void);
+int thread_cpu_init(int cpu);
 int thread_spawn(thread_fn fn, void *arg);
+int thread_spawn_stack(thread_fn fn, void *arg, unsigned int stack_size);
 void thread_yield(void);
 void thread_sleep(unsigned int ticks);
+void thread_sleep_ns(unsigned long long ns);
+void thread_idle(void);
 void scheduler_tick(void);
 void thread_exit(void);
 void timer_tick(void);
+void lapic_timer_tick(void);
+unsigned int timer_ticks(void);
+int thread_current(void);
 int thread_active_count(void);
+unsigned int thread_stack_size(int tid);
+unsigned int thread_stack_high_water(int tid);
+void wait_queue_init(WaitQueue *q);
+void thread_block(WaitQueue *q, Spinlock *lock);
+int thread_wake_one(WaitQueue *q);
+void thread_wake_all(WaitQueue *q);
 
 #endif
@@ -0,0 +1,101 @@
+#include "time.h"
+#include "ports.h"
+#include "thread.h"
+
+#define PIT_INPUT_HZ 1193182u
+#define PIT_GATE_PORT 0x61
+#define PIT_GATE_ENABLE 0x01
+#define PIT_SPEAKER_ENABLE 0x02
+#define PIT_OUT2 0x20
+// Each calibration pass times 10ms of PIT channel 2; the shortest of a few
+// passes wins, since interrupts or VM exits can only lengthen one.
+#define CALIBRATE_MS 10
+#define CALIBRATE_PASSES 3
+
+static unsigned int tsc_khz;
+static unsigned long long tsc_base;
+// Nanoseconds per TSC cycle as 32.32 fixed point, split so that the
+// conversion needs only 32x32->64 multiplies (no libgcc division).
+static unsigned int ns_per_cycle_int;
+static unsigned int ns_per_cycle_frac;
+
+unsigned long long time_rdtsc(void) {
+    unsigned int lo;
+    unsigned int hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+static int cpu_has_tsc(void) {
+    unsigned int eax = 1;
+    unsigned int ebx;
+    unsigned int ecx;
+    unsigned int edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 4) & 1;
+}
+
+// pit_measure_tsc: count TSC cycles across one PIT channel 2 one-shot.
+// Args: none.
+// Returns: cycles elapsed in CALIBRATE_MS milliseconds.
+// Channel 2 is polled through its OUT pin, so this works with interrupts
+// off and leaves the channel 0 tick untouched.
+static unsigned int pit_measure_tsc(void) {
+    unsigned int count = PIT_INPUT_HZ / (1000 / CALIBRATE_MS);
+    unsigned char gate = inb(PIT_GATE_PORT);
+    outb(PIT_GATE_PORT, (unsigned char)((gate & ~PIT_SPEAKER_ENABLE) & ~PIT_GATE_ENABLE));
+    outb(0x43, 0xB0);
+    outb(0x42, (unsigned char)(count & 0xFF));
+    outb(0x42, (unsigned char)((count >> 8) & 0xFF));
+    outb(PIT_GATE_PORT, (unsigned char)((gate & ~PIT_SPEAKER_ENABLE) | PIT_GATE_ENABLE));
+    unsigned long long start = time_rdtsc();
+    while (!(inb(PIT_GATE_PORT) & PIT_OUT2)) {
+    }
+    unsigned long long end = time_rdtsc();
+    outb(PIT_GATE_PORT, gate);
+    return (unsigned int)(end - start);
+}
+
+// time_init: calibrate the TSC against the PIT and start the clock.
+// Args: none.
+// Returns: none; without a TSC the clock falls back to PIT ticks.
+void time_init(void) {
+    if (!cpu_has_tsc()) {
+        return;
+    }
+    unsigned int best = 0xFFFFFFFFu;
+    for (int i = 0; i < CALIBRATE_PASSES; i++) {
+        unsigned int cycles = pit_measure_tsc();
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    unsigned int khz = best / CALIBRATE_MS;
+    if (khz == 0) {
+        return;
+    }
+    ns_per_cycle_int = 1000000u / khz;
+    unsigned int rem = 1000000u % khz;
+    // (rem << 32) / khz fits in 32 bits because rem < khz.
+    __asm__ ("divl %2" : "=a"(ns_per_cycle_frac), "+d"(rem) : "rm"(khz), "a"(0));
+    tsc_base = time_rdtsc();
+    tsc_khz = khz;
+}
+
+unsigned int time_tsc_khz(void) {
+    return tsc_khz;
+}
+
+// time_now_ns: monotonic nanoseconds since time_init.
+// Args: none.
+// Returns: TSC-derived time, or PIT-tick time if the TSC is unusable.
+unsigned long long time_now_ns(void) {
+    if (!tsc_khz) {
+        return (unsigned long long)timer_ticks() * (1000000000u / TIMER_HZ);
+    }
+    unsigned long long cycles = time_rdtsc() - tsc_base;
+    unsigned int hi = (unsigned int)(cycles >> 32);
+    unsigned int lo = (unsigned int)cycles;
+    return cycles * ns_per_cycle_int + (unsigned long long)hi * ns_per_cycle_frac +
+           (((unsigned long long)lo * ns_per_cycle_frac) >> 32);
+}
@@ -0,0 +1,9 @@
+#ifndef SLOPOS_TIME_H
+#define SLOPOS_TIME_H
+
+void time_init(void);
+unsigned long long time_now_ns(void);
+unsigned int time_tsc_khz(void);
+unsigned long long time_rdtsc(void);
+
+#endif
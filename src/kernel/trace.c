@@ -0,0 +1,65 @@
+#include "trace.h"
+#include "console.h"
+#include "smp.h"
+#include "thread.h"
+#include "time.h"
+
+// One fixed-size record; the dump writes these out unchanged, so the
+// layout is part of the SLOPTRC1 format.
+typedef struct TraceRecord {
+    unsigned long long tsc;
+    unsigned char type;
+    unsigned char cpu;
+    unsigned short thread;
+    unsigned int arg;
+} TraceRecord;
+
+typedef struct TraceHeader {
+    char magic[8];
+    unsigned int count;
+    unsigned int lost;
+    unsigned int tsc_khz;
+    unsigned int reserved;
+} TraceHeader;
+
+static TraceRecord trace_ring[TRACE_ENTRIES];
+// Total events ever claimed; the slot is the low bits. Writers on any CPU
+// claim a slot with one atomic add and never wait for each other.
+static volatile unsigned int trace_head;
+static volatile int trace_paused;
+
+// trace_event: append an event to the ring, overwriting the oldest.
+// Args: type (TRACE_* event), arg (event-specific value).
+// Returns: none. Safe from interrupt context and with locks held.
+void trace_event(unsigned int type, unsigned int arg) {
+    if (trace_paused) {
+        return;
+    }
+    unsigned int n = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+    TraceRecord *r = &trace_ring[n & (TRACE_ENTRIES - 1)];
+    r->tsc = time_rdtsc();
+    r->type = (unsigned char)type;
+    r->cpu = (unsigned char)smp_cpu_index();
+    r->thread = (unsigned short)thread_current();
+    r->arg = arg;
+}
+
+// trace_dump: write the ring to the serial port in SLOPTRC1 format.
+// Args: none.
+// Returns: number of records written.
+// Output is a 24-byte header (magic, count, lost, tsc_khz, reserved; all
+// little-endian u32) followed by count 16-byte records, oldest first.
+int trace_dump(void) {
+    trace_paused = 1;
+    __asm__ volatile ("" ::: "memory");
+    unsigned int head = trace_head;
+    unsigned int count = head < TRACE_ENTRIES ? head : TRACE_ENTRIES;
+    TraceHeader h = {{'S', 'L', 'O', 'P', 'T', 'R', 'C', '1'}, count, head - count, time_tsc_khz(), 0};
+    console_write_raw(&h, sizeof(h));
+    for (unsigned int i = head - count; i != head; i++) {
+        console_write_raw(&trace_ring[i & (TRACE_ENTRIES - 1)], sizeof(TraceRecord));
+    }
+    __asm__ volatile ("" ::: "memory");
+    trace_paused = 0;
+    return (int)count;
+}
@@ -0,0 +1,23 @@
+#ifndef SLOPOS_TRACE_H
+#define SLOPOS_TRACE_H
+
+// Event types; scripts/trace_decode.py mirrors these values.
+#define TRACE_CTX_SWITCH 1
+#define TRACE_THREAD_SPAWN 2
+#define TRACE_THREAD_EXIT 3
+#define TRACE_DISK_WRITE_START 4
+#define TRACE_DISK_WRITE_END 5
+#define TRACE_GC_START 6
+#define TRACE_GC_END 7
+#define TRACE_CONSOLE_RX 8
+
+// Set in the argument of TRACE_DISK_WRITE_END when the write failed.
+#define TRACE_DISK_FAILED 0x80000000u
+
+// Records kept; must be a power of two.
+#define TRACE_ENTRIES 4096
+
+void trace_event(unsigned int type, unsigned int arg);
+int trace_dump(void);
+
+#endif
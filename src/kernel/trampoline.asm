@@ -0,0 +1,61 @@
+; Application processor start-up code. smp.c copies this page to
+; AP_TRAMPOLINE_ADDR and points each AP at it with a STARTUP IPI; the AP
+; arrives in real mode, switches to flat 32-bit protected mode and calls
+; the C entry point on the stack the BSP prepared in the parameter block.
+
+BITS 16
+ORG 0x7000
+
+ap_start:
+    jmp short ap_real
+
+; Parameter block at offset 4, filled in by smp.c before each start-up.
+align 4
+ap_stack:
+    dd 0
+ap_entry:
+    dd 0
+ap_cpu:
+    dd 0
+
+ap_real:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [ap_gdt_descriptor]
+    mov eax, cr0
+    or eax, 0x1
+    mov cr0, eax
+    jmp dword CODE_SEL:ap_pmode
+
+BITS 32
+ap_pmode:
+    mov ax, DATA_SEL
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    mov esp, [ap_stack]
+    push dword [ap_cpu]
+    call [ap_entry]
+
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+ap_gdt:
+    dq 0x0000000000000000
+    dq 0x00CF9A000000FFFF
+    dq 0x00CF92000000FFFF
+ap_gdt_end:
+
+ap_gdt_descriptor:
+    dw ap_gdt_end - ap_gdt - 1
+    dd ap_gdt
+
+CODE_SEL equ 0x08
+DATA_SEL equ 0x10
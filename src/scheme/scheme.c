@@ -3,12 +3,79 @@
 #define ROOT_STACK_MAX 256
 
 typedef struct Cell *(*PrimFn)(struct Scheme *sc, struct Cell *args);
+typedef struct Cell *(*PrimFn1)(struct Scheme *sc, struct Cell *a);
+typedef struct Cell *(*PrimFn2)(struct Scheme *sc, struct Cell *a, struct Cell *b);
 
-static Cell *scheme_nil(Scheme *sc) { return &sc->nil_cell; }
-static Cell *scheme_true(Scheme *sc) { return &sc->true_cell; }
-static Cell *scheme_false(Scheme *sc) { return &sc->false_cell; }
+// Mark of the cells of a frozen heap (see scheme_freeze) and of the
+// constants below: the collectors take them as live and never scan, move
+// or clear them.
+#define MARK_FROZEN 3
 
+// The empty list and booleans are shared by every interpreter, so a frozen
+// heap and the interpreters using it agree on them.
+static Cell nil_cell = {T_NIL, MARK_FROZEN, {0}};
+static Cell true_cell = {T_BOOL, MARK_FROZEN, {1}};
+static Cell false_cell = {T_BOOL, MARK_FROZEN, {0}};
+
+static Cell *scheme_nil(Scheme *sc) { (void)sc; return &nil_cell; }
+static Cell *scheme_true(Scheme *sc) { (void)sc; return &true_cell; }
+static Cell *scheme_false(Scheme *sc) { (void)sc; return &false_cell; }
+
+// own_syms_end: where an interpreter's own symbols end in interned_syms; the
+// list of an interpreter sharing a frozen heap continues with the shared
+// heap's symbols.
+// Args: sc (interpreter state).
+// Returns: the first shared pair of the list, or nil.
+static Cell *own_syms_end(const Scheme *sc) {
+    return sc->shared ? sc->shared->interned_syms : &nil_cell;
+}
+
+// shared_cache_clear: forget the cached global bindings of shared symbols.
+// Args: sc (interpreter state).
+// Returns: none.
+static void shared_cache_clear(Scheme *sc) {
+    for (size_t i = 0; i < SCHEME_SHARED_CACHE; i++) {
+        sc->shared_syms[i] = NULL;
+        sc->shared_bindings[i] = NULL;
+    }
+}
+
+// Errors unwind to the innermost catch frame with __builtin_longjmp, which
+// needs no libc. A frame lives on the C stack of catch_errors and records
+// the interpreter state to restore; cells allocated since then are simply
+// left for the collector.
+typedef struct SchemeCatch {
+    void *jmp[5];
+    struct SchemeCatch *prev;
+    size_t root_top;
+    size_t env_top;
+    Cell *env;
+    const char *call_fn;
+    const char *call_caller;
+} SchemeCatch;
+
+static void throw_error(Scheme *sc) __attribute__((noreturn));
+
+static void throw_error(Scheme *sc) {
+    __builtin_longjmp(sc->catch_top->jmp, 1);
+}
+
+// panic: raise an interpreter error, or halt through platform.panic when no
+// handler is installed (only possible outside scheme_eval_string).
+// Args: sc (interpreter state), msg (error text; copied, so it may be a
+// temporary buffer).
+// Returns: never.
 static void panic(Scheme *sc, const char *msg) {
+    if (sc->catch_top) {
+        size_t i = 0;
+        while (msg[i] && i + 1 < SCHEME_ERROR_MAX) {
+            sc->error_msg[i] = msg[i];
+            i++;
+        }
+        sc->error_msg[i] = '\0';
+        sc->raised = NULL;
+        throw_error(sc);
+    }
     if (sc->platform.panic) {
         sc->platform.panic(msg);
     }
@@ -16,7 +83,45 @@ static void panic(Scheme *sc, const char *msg) {
     }
 }
 
+// raise_value: raise an arbitrary object to the innermost handler.
+// Args: sc (interpreter state), obj (object to raise).
+// Returns: never.
+static void raise_value(Scheme *sc, Cell *obj) {
+    if (!sc->catch_top) {
+        panic(sc, "uncaught raise");
+    }
+    sc->raised = obj;
+    throw_error(sc);
+}
+
+// scheme_stop: make the interpreter abandon its current evaluation.
+// Args: sc (interpreter state), reason (static error text).
+// Returns: none. Safe from an interrupt on the CPU running sc. At the next
+// procedure call the interpreter raises reason as an error that no guard
+// catches, so the outermost scheme_eval_string reports it and returns -1.
+void scheme_stop(Scheme *sc, const char *reason) {
+    sc->stop_reason = reason;
+}
+
+static void check_stop(Scheme *sc) {
+    if (sc->stop_reason) {
+        panic(sc, sc->stop_reason);
+    }
+}
+
+// quota_exceeded: stop the interpreter and abandon the current operation.
+static void quota_exceeded(Scheme *sc, const char *reason) {
+    scheme_stop(sc, reason);
+    panic(sc, reason);
+}
+
+// putc_out: write one byte of program output, charged to the output quota.
+// Output outside any evaluation (the final error report) is never refused.
 static void putc_out(Scheme *sc, char c) {
+    if (sc->quota.output_bytes && sc->stats.output_bytes >= sc->quota.output_bytes && sc->catch_top) {
+        quota_exceeded(sc, "output quota exceeded");
+    }
+    sc->stats.output_bytes++;
     if (sc->platform.putc) {
         sc->platform.putc(c);
     }
@@ -47,6 +152,29 @@ static void pop_roots(Scheme *sc, size_t n) {
 
 static Cell *alloc_cell(Scheme *sc);
 
+// Marks a removed hash table slot. It lives outside every heap and is never
+// marked, so interpreters on different CPUs can share it.
+static Cell hash_tombstone;
+#define HASH_TOMBSTONE (&hash_tombstone)
+
+static HashEntry *hash_entries(HashTable *t) {
+    return (HashEntry *)(t + 1);
+}
+
+static void mark_cell(Scheme *sc, Cell *c);
+
+static void mark_hash_table(Scheme *sc, HashTable *t) {
+    for (; t; t = t->old) {
+        HashEntry *e = hash_entries(t);
+        for (size_t i = 0; i < t->cap; i++) {
+            if (e[i].key && e[i].key != HASH_TOMBSTONE) {
+                mark_cell(sc, e[i].key);
+                mark_cell(sc, e[i].value);
+            }
+        }
+    }
+}
+
 static void mark_cell(Scheme *sc, Cell *c) {
     if (!c || c->mark) {
         return;
@@ -54,6 +182,7 @@ static void mark_cell(Scheme *sc, Cell *c) {
     c->mark = 1;
     switch (c->type) {
         case T_PAIR:
+        case T_ERROR:
             mark_cell(sc, c->as.pair.car);
             mark_cell(sc, c->as.pair.cdr);
             break;
@@ -62,6 +191,14 @@ static void mark_cell(Scheme *sc, Cell *c) {
             mark_cell(sc, c->as.closure.body);
             mark_cell(sc, c->as.closure.env);
             break;
+        case T_VECTOR:
+            for (size_t i = 0; i < c->as.vec.len; i++) {
+                mark_cell(sc, c->as.vec.items[i]);
+            }
+            break;
+        case T_HASHTABLE:
+            mark_hash_table(sc, c->as.hash.table);
+            break;
         default:
             break;
     }
@@ -81,1092 +218,6320 @@ static void env_stack_pop(Scheme *sc) {
     sc->env_top--;
 }
 
-// gc_collect: mark-and-sweep collector using global env, active envs, interned symbols, and root stack.
-// Args: sc (interpreter state).
+// Post-GC occupancy (percent live) above which the heap grows by another
+// segment, and below which fully empty grown segments are released.
+#define HEAP_GROW_PERCENT 75
+#define HEAP_SHRINK_PERCENT 25
+// The copying collector grows the heap until pages still in use after a
+// collection are at most this share of all pages. Half the heap is always
+// copy reserve, so this leaves at least a quarter of it to allocate from.
+#define COPY_GROW_PERCENT 25
+// Initial capacity of the copying collector's segment index.
+#define SEGMENT_INDEX_MIN_CAP 8
+
+static void segment_add_free(HeapSegment *seg, Cell *c) {
+    c->type = T_PAIR;
+    c->mark = 0;
+    c->as.pair.cdr = seg->free_head;
+    if (!seg->free_head) {
+        seg->free_tail = c;
+    }
+    seg->free_head = c;
+    seg->free_count++;
+}
+
+// Page spaces of the copying collector. While it runs, the pages in use
+// are from-space, and survivors are copied into PAGE_TO pages. A page that
+// something outside the heap may point into is PAGE_KEPT instead: it stays
+// in place, its live cells are marked as under mark-and-sweep and the rest
+// are cleared.
+#define PAGE_FREE 0
+#define PAGE_USED 1
+#define PAGE_TO 2
+#define PAGE_KEPT 3
+
+static size_t segment_page_count(const HeapSegment *seg) {
+    return (seg->count + SCHEME_PAGE_CELLS - 1) / SCHEME_PAGE_CELLS;
+}
+
+// segment_pages_init: describe a segment's cells as free pages, lowest first.
+// Args: sc (interpreter state), seg (segment whose pages array is allocated).
 // Returns: none.
-static void gc_collect(Scheme *sc) {
-    size_t i;
+static void segment_pages_init(Scheme *sc, HeapSegment *seg) {
+    size_t n = segment_page_count(seg);
+    for (size_t i = n; i > 0; i--) {
+        HeapPage *pg = &seg->pages[i - 1];
+        pg->cells = seg->cells + (i - 1) * SCHEME_PAGE_CELLS;
+        pg->count = i < n ? SCHEME_PAGE_CELLS : seg->count - (i - 1) * SCHEME_PAGE_CELLS;
+        pg->space = PAGE_FREE;
+        pg->next = sc->free_pages;
+        sc->free_pages = pg;
+    }
+    sc->page_count += n;
+}
 
-    mark_cell(sc, sc->global_env);
-    mark_cell(sc, sc->current_env);
-    for (i = 0; i < sc->env_top; i++) {
-        mark_cell(sc, sc->env_stack[i]);
+// page_of: find the copying collector's page holding an address.
+// Args: sc (interpreter state), p (any address; pointers into a cell count).
+// Returns: the page, or NULL if p is outside every heap segment.
+static HeapPage *page_of(Scheme *sc, const void *p) {
+    // Neighbouring cells tend to point into the same segment.
+    HeapSegment *s = sc->segment_hint;
+    size_t off = (size_t)p - (size_t)s->cells;
+    if (off < s->count * sizeof(Cell)) {
+        return &s->pages[off / (sizeof(Cell) * SCHEME_PAGE_CELLS)];
     }
-    mark_cell(sc, sc->interned_syms);
-    for (i = 0; i < sc->root_top; i++) {
-        mark_cell(sc, sc->root_stack[i]);
+    size_t lo = 0;
+    size_t hi = sc->segment_index_count;
+    if ((size_t)p < (size_t)sc->segment_index[0]->cells) {
+        return NULL;
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        s = sc->segment_index[mid];
+        if ((size_t)p < (size_t)s->cells) {
+            hi = mid;
+            continue;
+        }
+        off = (size_t)p - (size_t)s->cells;
+        if (off < s->count * sizeof(Cell)) {
+            sc->segment_hint = s;
+            return &s->pages[off / (sizeof(Cell) * SCHEME_PAGE_CELLS)];
+        }
+        lo = mid + 1;
     }
+    return NULL;
+}
 
-    sc->free_list = NULL;
-    for (i = 0; i < sc->heap_cells; i++) {
-        Cell *c = &sc->heap[i];
-        if (c->mark) {
-            c->mark = 0;
-        } else {
-            c->type = T_PAIR;
-            c->as.pair.cdr = sc->free_list;
-            sc->free_list = c;
+// segment_index_add: enter a segment into the address-sorted index that
+// page_of searches.
+// Args: sc (interpreter state), seg (segment with cells set).
+// Returns: 1 on success, 0 if the index could not grow.
+static int segment_index_add(Scheme *sc, HeapSegment *seg) {
+    if (sc->segment_index_count == sc->segment_index_cap) {
+        size_t cap = sc->segment_index_cap ? sc->segment_index_cap * 2 : SEGMENT_INDEX_MIN_CAP;
+        HeapSegment **index = (HeapSegment **)sc->platform.alloc(sc->platform.user, cap * sizeof(HeapSegment *));
+        if (!index) {
+            return 0;
+        }
+        for (size_t i = 0; i < sc->segment_index_count; i++) {
+            index[i] = sc->segment_index[i];
+        }
+        if (sc->segment_index) {
+            sc->platform.free(sc->platform.user, sc->segment_index);
+        }
+        sc->segment_index = index;
+        sc->segment_index_cap = cap;
+    }
+    size_t i = sc->segment_index_count++;
+    while (i > 0 && (size_t)sc->segment_index[i - 1]->cells > (size_t)seg->cells) {
+        sc->segment_index[i] = sc->segment_index[i - 1];
+        i--;
+    }
+    sc->segment_index[i] = seg;
+    return 1;
+}
+
+// segment_index_remove: drop a released segment from the index.
+// Args: sc (interpreter state), seg (indexed segment).
+// Returns: none.
+static void segment_index_remove(Scheme *sc, HeapSegment *seg) {
+    sc->segment_hint = sc->segments;
+    size_t j = 0;
+    for (size_t i = 0; i < sc->segment_index_count; i++) {
+        if (sc->segment_index[i] != seg) {
+            sc->segment_index[j++] = sc->segment_index[i];
         }
     }
+    sc->segment_index_count = j;
 }
 
-// alloc_cell: allocate a new cell from the freelist, collecting if needed.
+// page_take: start bump-allocating from a free page.
 // Args: sc (interpreter state).
-// Returns: pointer to a newly allocated cell.
-static Cell *alloc_cell(Scheme *sc) {
-    if (!sc->free_list) {
-        gc_collect(sc);
-        if (!sc->free_list) {
-            panic(sc, "out of memory");
+// Returns: 1 on success, 0 if no page is free or taking one would leave
+// fewer free pages than pages in use, which a collection may need to copy
+// every survivor.
+static int page_take(Scheme *sc) {
+    HeapPage *pg = sc->free_pages;
+    if (!pg || (sc->used_page_count + 1) * 2 > sc->page_count) {
+        return 0;
+    }
+    sc->free_pages = pg->next;
+    pg->space = PAGE_USED;
+    pg->next = sc->used_pages;
+    sc->used_pages = pg;
+    sc->used_page_count++;
+    sc->alloc_next = pg->cells;
+    sc->alloc_end = pg->cells + pg->count;
+    return 1;
+}
+
+// heap_grow: add a segment of heap_grow_cells from the platform allocator.
+// Args: sc (interpreter state).
+// Returns: 1 if the heap grew, 0 if growth is disabled or exhausted.
+static int heap_grow(Scheme *sc) {
+    size_t n = sc->heap_grow_cells;
+    if (!n || !sc->platform.alloc) {
+        return 0;
+    }
+    if (sc->heap_max_cells && sc->total_cells + n > sc->heap_max_cells) {
+        if (sc->total_cells >= sc->heap_max_cells) {
+            return 0;
         }
+        n = sc->heap_max_cells - sc->total_cells;
     }
-    Cell *c = sc->free_list;
-    sc->free_list = c->as.pair.cdr;
-    c->mark = 0;
-    return c;
+    // The copying collector's page table follows the cells.
+    size_t pages = sc->gc_mode == SCHEME_GC_COPYING ? (n + SCHEME_PAGE_CELLS - 1) / SCHEME_PAGE_CELLS : 0;
+    HeapSegment *seg = (HeapSegment *)sc->platform.alloc(
+        sc->platform.user, sizeof(HeapSegment) + n * sizeof(Cell) + pages * sizeof(HeapPage));
+    if (!seg) {
+        return 0;
+    }
+    seg->cells = (Cell *)(seg + 1);
+    seg->count = n;
+    seg->free_head = NULL;
+    seg->free_tail = NULL;
+    seg->free_count = 0;
+    seg->pages = NULL;
+    if (pages) {
+        if (!segment_index_add(sc, seg)) {
+            sc->platform.free(sc->platform.user, seg);
+            return 0;
+        }
+        seg->pages = (HeapPage *)(seg->cells + n);
+        segment_pages_init(sc, seg);
+    } else {
+        for (size_t i = n; i > 0; i--) {
+            segment_add_free(seg, &seg->cells[i - 1]);
+        }
+        seg->free_tail->as.pair.cdr = sc->free_list;
+        sc->free_list = seg->free_head;
+        sc->free_cells += n;
+    }
+    seg->next = sc->segments->next;
+    sc->segments->next = seg;
+    sc->total_cells += n;
+    return 1;
 }
 
-static Cell *make_int(Scheme *sc, int v) {
-    Cell *c = alloc_cell(sc);
-    c->type = T_INT;
-    c->as.i = v;
-    return c;
+static unsigned long long clock_ns(Scheme *sc) {
+    return sc->platform.now_ns ? sc->platform.now_ns(sc->platform.user) : 0;
 }
 
-static Cell *make_char(Scheme *sc, int v) {
-    Cell *c = alloc_cell(sc);
-    c->type = T_CHAR;
-    c->as.i = v;
-    return c;
+// Vector/bytevector storage below this many bytes never forces a collection.
+#define BLOB_MIN_LIMIT 65536
+
+static int is_blob(const Cell *c) {
+    return c->type == T_VECTOR || c->type == T_BYTEVECTOR || c->type == T_STRING_BUILDER ||
+           c->type == T_HASHTABLE || c->type == T_BIGNUM;
 }
 
-static Cell *make_bool(Scheme *sc, int v) {
-    return v ? scheme_true(sc) : scheme_false(sc);
+static size_t hash_table_bytes(size_t cap) {
+    return sizeof(HashTable) + cap * sizeof(HashEntry);
 }
 
-static char *alloc_str_bytes(Scheme *sc, size_t len) {
-    if (sc->str_buf_used + len + 1 > sc->str_buf_size) {
-        panic(sc, "string buffer full");
+static void *blob_ptr(const Cell *c) {
+    switch (c->type) {
+    case T_VECTOR:
+        return c->as.vec.items;
+    case T_BYTEVECTOR:
+        return c->as.bytes.data;
+    case T_HASHTABLE:
+        return c->as.hash.table;
+    case T_BIGNUM:
+        return c->as.big.digits;
+    default:
+        return c->as.sbuf.buf;
     }
-    char *p = sc->str_buf + sc->str_buf_used;
-    sc->str_buf_used += len + 1;
-    return p;
 }
 
-static Cell *make_string_len(Scheme *sc, const char *data, size_t len) {
-    Cell *c = alloc_cell(sc);
-    c->type = T_STRING;
-    char *dst = alloc_str_bytes(sc, len);
-    for (size_t i = 0; i < len; i++) {
-        dst[i] = data[i];
+static size_t blob_size(const Cell *c) {
+    switch (c->type) {
+    case T_VECTOR:
+        return c->as.vec.len * sizeof(Cell *);
+    case T_BYTEVECTOR:
+        return c->as.bytes.len;
+    case T_HASHTABLE:
+        return hash_table_bytes(c->as.hash.table->cap);
+    case T_BIGNUM:
+        return (size_t)(c->as.big.len < 0 ? -c->as.big.len : c->as.big.len) * sizeof(unsigned int);
+    default:
+        return sizeof(StringBuf) + c->as.sbuf.buf->cap;
     }
-    dst[len] = '\0';
-    c->as.str.data = dst;
-    c->as.str.len = len;
-    return c;
 }
 
-static Cell *make_string_from_int(Scheme *sc, int n) {
-    char tmp[12];
-    size_t len = 0;
-    unsigned int u = (unsigned int)n;
-    if (n == 0) {
-        tmp[len++] = '0';
-    } else {
-        if (n < 0) {
-            u = (unsigned int)(-n);
-        }
-        while (u > 0 && len < sizeof(tmp)) {
-            tmp[len++] = (char)('0' + (u % 10));
-            u /= 10;
-        }
-        if (n < 0 && len < sizeof(tmp)) {
-            tmp[len++] = '-';
-        }
+// blob_release: return a vector, bytevector, builder, hash table or bignum cell's storage.
+// Args: sc (interpreter state), c (cell with is_blob set).
+// Returns: none; c is left empty.
+static void blob_release(Scheme *sc, Cell *c) {
+    void *data = blob_ptr(c);
+    if (c->type == T_HASHTABLE && data && c->as.hash.table->old) {
+        HashTable *old = c->as.hash.table->old;
+        sc->blob_bytes -= hash_table_bytes(old->cap);
+        sc->platform.free(sc->platform.user, old);
     }
-    char *buf = alloc_str_bytes(sc, len);
-    for (size_t i = 0; i < len; i++) {
-        buf[i] = tmp[len - 1 - i];
+    if (data) {
+        sc->blob_bytes -= blob_size(c);
+        sc->platform.free(sc->platform.user, data);
     }
-    buf[len] = '\0';
-    Cell *c = alloc_cell(sc);
-    c->type = T_STRING;
-    c->as.str.data = buf;
-    c->as.str.len = len;
-    return c;
+    c->as.vec.items = NULL;
+    c->as.vec.len = 0;
 }
 
-static Cell *cons(Scheme *sc, Cell *a, Cell *d) {
-    Cell *c = alloc_cell(sc);
-    c->type = T_PAIR;
-    c->as.pair.car = a;
-    c->as.pair.cdr = d;
-    return c;
+static void trace_out(Scheme *sc, int event, size_t arg) {
+    if (sc->platform.trace) {
+        sc->platform.trace(sc->platform.user, event, (int)arg);
+    }
 }
 
-static Cell *make_prim(Scheme *sc, PrimFn fn) {
-    Cell *c = alloc_cell(sc);
-    c->type = T_PRIMITIVE;
-    c->as.prim.fn = fn;
-    return c;
+static void stats_reset(Scheme *sc) {
+    sc->stats.cells_allocated = 0;
+    sc->stats.cells_freed = 0;
+    sc->stats.gc_count = 0;
+    sc->stats.heap_cells = 0;
+    sc->stats.live_cells = 0;
+    sc->stats.str_arena_peak = 0;
+    sc->stats.sym_arena_peak = 0;
+    sc->stats.mark_ns = 0;
+    sc->stats.sweep_ns = 0;
+    sc->stats.max_pause_ns = 0;
+    sc->stats.arena_bytes = 0;
+    sc->stats.cpu_ticks = 0;
+    sc->stats.disk_bytes = 0;
+    sc->stats.output_bytes = 0;
 }
 
-static Cell *make_closure(Scheme *sc, Cell *params, Cell *body, Cell *env) {
-    push_root(sc, params);
-    push_root(sc, body);
-    push_root(sc, env);
-    Cell *c = alloc_cell(sc);
-    pop_roots(sc, 3);
-    c->type = T_CLOSURE;
-    c->as.closure.params = params;
-    c->as.closure.body = body;
-    c->as.closure.env = env;
-    return c;
+static void profile_reset(Scheme *sc) {
+    sc->call_site.fn = NULL;
+    sc->call_site.caller = NULL;
+    sc->prof_samples = NULL;
+    sc->prof_cap = 0;
+    sc->prof_count = 0;
+    sc->prof_dropped = 0;
+    sc->prof_active = 0;
 }
 
-static int is_nil(Scheme *sc, Cell *c) { return c == scheme_nil(sc); }
+// The stack scan reads every word between two frames, including slots the
+// compiler never initialized, so it is exempt from AddressSanitizer.
+#if defined(__SANITIZE_ADDRESS__)
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define NO_SANITIZE_ADDRESS
+#endif
 
-static Cell *car(Cell *c) { return c->as.pair.car; }
-static Cell *cdr(Cell *c) { return c->as.pair.cdr; }
+// State of one copying collection. Pages receiving copies are queued
+// head..tail, with tail filled up to next; scan/scan_index is the Cheney
+// scan position in that queue.
+typedef struct GcCopy {
+    Scheme *sc;
+    HeapPage *head;
+    HeapPage *tail;
+    Cell *next;
+    Cell *end;
+    HeapPage *scan;
+    size_t scan_index;
+    size_t pages;
+    size_t live;
+} GcCopy;
 
-static int streq(const char *a, const char *b) {
-    while (*a && *b) {
-        if (*a != *b) {
-            return 0;
-        }
-        a++;
-        b++;
-    }
-    return *a == *b;
-}
+static void gc_scan_cell(GcCopy *g, Cell *c);
 
-static int streq_len(const char *a, const char *b, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        if (a[i] != b[i]) {
-            return 0;
-        }
+// gc_keep_cell: mark a live cell of a kept page and scan it, recursing
+// through kept cells the way mark_cell does.
+// Args: g (collection state), c (cell in a kept page).
+// Returns: none.
+static void gc_keep_cell(GcCopy *g, Cell *c) {
+    if (c->mark) {
+        return;
     }
-    return a[len] == '\0';
+    c->mark = 1;
+    g->live++;
+    gc_scan_cell(g, c);
 }
 
-static const char *sym_alloc(Scheme *sc, const char *start, size_t len) {
-    if (sc->sym_buf_used + len + 1 > sc->sym_buf_size) {
-        panic(sc, "symbol buffer full");
+// gc_forward: find a cell's to-space address, copying it there the first
+// time a from-space cell is reached.
+// Args: g (collection state), c (any cell pointer, or NULL).
+// Returns: the new address; c itself if it is not in from-space.
+static Cell *gc_forward(GcCopy *g, Cell *c) {
+    HeapPage *pg = page_of(g->sc, c);
+    if (!pg) {
+        return c;
     }
-    char *dst = sc->sym_buf + sc->sym_buf_used;
-    for (size_t i = 0; i < len; i++) {
-        dst[i] = start[i];
+    if (pg->space == PAGE_KEPT) {
+        gc_keep_cell(g, c);
+        return c;
     }
-    dst[len] = '\0';
-    sc->sym_buf_used += len + 1;
-    return dst;
-}
-
-static Cell *intern_symbol_len(Scheme *sc, const char *start, size_t len) {
-    Cell *p = sc->interned_syms;
-    while (!is_nil(sc, p)) {
-        Cell *sym = car(p);
-        if (streq_len(sym->as.sym.name, start, len)) {
-            return sym;
+    if (pg->space != PAGE_USED) {
+        return c;
+    }
+    if (c->type == T_FORWARD) {
+        return c->as.pair.car;
+    }
+    if (g->next == g->end) {
+        // gc_copy checked that enough pages are free.
+        HeapPage *fresh = g->sc->free_pages;
+        g->sc->free_pages = fresh->next;
+        fresh->space = PAGE_TO;
+        fresh->next = NULL;
+        if (g->tail) {
+            g->tail->next = fresh;
+        } else {
+            g->head = fresh;
+            g->scan = fresh;
+            g->scan_index = 0;
         }
-        p = cdr(p);
+        g->tail = fresh;
+        g->pages++;
+        g->next = fresh->cells;
+        g->end = fresh->cells + fresh->count;
     }
-
-    const char *name = sym_alloc(sc, start, len);
-    Cell *sym = alloc_cell(sc);
-    sym->type = T_SYMBOL;
-    sym->as.sym.name = name;
-
-    push_root(sc, sym);
-    sc->interned_syms = cons(sc, sym, sc->interned_syms);
-    pop_roots(sc, 1);
-
-    return sym;
+    Cell *to = g->next++;
+    *to = *c;
+    c->type = T_FORWARD;
+    c->as.pair.car = to;
+    g->live++;
+    return to;
 }
 
-static Cell *intern_symbol(Scheme *sc, const char *name) {
-    size_t len = 0;
-    while (name[len]) {
-        len++;
+// gc_scan_cell: forward every cell a surviving cell refers to.
+// Args: g (collection state), c (copied or kept cell).
+// Returns: none. An eq? table whose keys moved is flagged for rehashing.
+static void gc_scan_cell(GcCopy *g, Cell *c) {
+    switch (c->type) {
+        case T_PAIR:
+        case T_ERROR:
+            c->as.pair.car = gc_forward(g, c->as.pair.car);
+            c->as.pair.cdr = gc_forward(g, c->as.pair.cdr);
+            break;
+        case T_CLOSURE:
+            c->as.closure.params = gc_forward(g, c->as.closure.params);
+            c->as.closure.body = gc_forward(g, c->as.closure.body);
+            c->as.closure.env = gc_forward(g, c->as.closure.env);
+            break;
+        case T_VECTOR:
+            for (size_t i = 0; i < c->as.vec.len; i++) {
+                c->as.vec.items[i] = gc_forward(g, c->as.vec.items[i]);
+            }
+            break;
+        case T_HASHTABLE:
+            for (HashTable *t = c->as.hash.table; t; t = t->old) {
+                HashEntry *e = hash_entries(t);
+                for (size_t i = 0; i < t->cap; i++) {
+                    Cell *key = gc_forward(g, e[i].key);
+                    if (key != e[i].key && t->kind == SCHEME_HASH_EQ) {
+                        t->moved = 1;
+                    }
+                    e[i].key = key;
+                    e[i].value = gc_forward(g, e[i].value);
+                }
+            }
+            break;
+        default:
+            break;
     }
-    return intern_symbol_len(sc, name, len);
 }
 
-static void skip_ws(const char **s) {
-    while (**s) {
-        if (**s == ';') {
-            while (**s && **s != '\n') {
-                (*s)++;
-            }
-        } else if (**s == ' ' || **s == '\t' || **s == '\r' || **s == '\n') {
-            (*s)++;
+// gc_drain: scan copied cells (Cheney) until no survivor is left
+// unscanned.
+// Args: g (collection state).
+// Returns: none.
+static void gc_drain(GcCopy *g) {
+    while (g->scan) {
+        size_t limit = g->scan == g->tail ? (size_t)(g->next - g->scan->cells) : g->scan->count;
+        if (g->scan_index < limit) {
+            gc_scan_cell(g, &g->scan->cells[g->scan_index++]);
+        } else if (g->scan->next) {
+            g->scan = g->scan->next;
+            g->scan_index = 0;
         } else {
-            break;
+            return;
         }
     }
 }
 
-static int is_delim(char c) {
-    return c == 0 || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '(' || c == ')' || c == '"';
+// gc_survivor: where a cell lives after the collection.
+// Args: sc (interpreter state), c (cell pointer from before it).
+// Returns: the cell's new address, or NULL if it died.
+static Cell *gc_survivor(Scheme *sc, Cell *c) {
+    HeapPage *pg = page_of(sc, c);
+    if (!pg || pg->space == PAGE_TO) {
+        return c;
+    }
+    if (pg->space == PAGE_KEPT) {
+        return c->mark ? c : NULL;
+    }
+    return c->type == T_FORWARD ? c->as.pair.car : NULL;
 }
 
-static Cell *read_expr(Scheme *sc, const char **s);
-static int eval_string_in_env(Scheme *sc, const char *input, Cell *env);
-
-static Cell *read_list(Scheme *sc, const char **s) {
-    skip_ws(s);
-    if (**s == ')') {
-        (*s)++;
-        return scheme_nil(sc);
+// gc_pin: keep in place the page a word of the C stack may point into.
+// Args: g (collection state), p (any value that may be a cell pointer).
+// Returns: none. The cells themselves live or die by reachability from
+// the precise roots, as under mark-and-sweep.
+static void gc_pin(GcCopy *g, const void *p) {
+    HeapPage *pg = page_of(g->sc, p);
+    if (pg && pg->space == PAGE_USED) {
+        pg->space = PAGE_KEPT;
     }
+}
 
-    Cell *head = NULL;
-    Cell *tail = NULL;
+// gc_pin_stack: pin every word of the C stack, so cell pointers held in C
+// locals stay valid.
+// Args: g (collection state).
+// Returns: none. Scans from this frame to stack_base; registers were saved
+// on the stack by the caller (see gc_copy).
+static NO_SANITIZE_ADDRESS __attribute__((noinline)) void gc_pin_stack(GcCopy *g) {
+    size_t lo = (size_t)__builtin_frame_address(0);
+    size_t hi = (size_t)g->sc->stack_base;
+    if (!hi) {
+        return;
+    }
+    if (lo > hi) {
+        size_t t = lo;
+        lo = hi;
+        hi = t;
+    }
+    lo = (lo + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    for (; lo + sizeof(void *) <= hi; lo += sizeof(void *)) {
+        gc_pin(g, *(void *const *)lo);
+    }
+}
 
-    while (**s && **s != ')') {
-        Cell *item = read_expr(sc, s);
-        if (!item) {
-            break;
+// gc_release_segments: return grown segments whose pages are all free while
+// the heap is mostly idle, as long as half the remaining pages stay free.
+// Args: sc (interpreter state), live (cells surviving the collection).
+// Returns: none.
+static void gc_release_segments(Scheme *sc, size_t live) {
+    HeapSegment **link = &sc->segments->next;
+    while (*link) {
+        HeapSegment *seg = *link;
+        size_t n = segment_page_count(seg);
+        size_t remaining = sc->total_cells - seg->count;
+        int idle = sc->platform.free && live * 100 < remaining * HEAP_SHRINK_PERCENT &&
+                   sc->used_page_count * 2 <= sc->page_count - n;
+        for (size_t i = 0; idle && i < n; i++) {
+            idle = seg->pages[i].space == PAGE_FREE;
+        }
+        if (!idle) {
+            link = &seg->next;
+            continue;
+        }
+        HeapPage **pl = &sc->free_pages;
+        while (*pl) {
+            if (*pl >= seg->pages && *pl < seg->pages + n) {
+                *pl = (*pl)->next;
+            } else {
+                pl = &(*pl)->next;
+            }
         }
+        *link = seg->next;
+        segment_index_remove(sc, seg);
+        sc->total_cells = remaining;
+        sc->page_count -= n;
+        sc->platform.free(sc->platform.user, seg);
+    }
+}
 
-        if (!head) {
-            push_root(sc, item);
-            head = cons(sc, item, scheme_nil(sc));
-            tail = head;
-            pop_roots(sc, 1);
+// gc_copy: mostly-copying collector for SCHEME_GC_COPYING. Cells reachable
+// from the same roots as mark-and-sweep are copied breadth-first (Cheney)
+// into free pages, which packs each list's cells together, and the pages
+// left behind become free. C code holds cell pointers in locals, so pages
+// that a word of the C stack may point into are kept in place instead,
+// with their reachable cells marked and the rest cleared. Dead cells are
+// never visited; their vector/bytevector/... storage is found through
+// blob_cells.
+// Args: sc (interpreter state).
+// Returns: none.
+static __attribute__((noinline)) void gc_copy(Scheme *sc) {
+    // Spill callee-saved registers into this frame so the stack scan sees
+    // cell pointers the callers keep in them.
+    __builtin_unwind_init();
+    size_t i;
+    HeapPage *pg;
+
+    // The unused rest of the allocation page holds stale cells; make them
+    // inert in case the page is kept.
+    size_t unused = sc->alloc_next ? (size_t)(sc->alloc_end - sc->alloc_next) : 0;
+    for (i = 0; i < unused; i++) {
+        sc->alloc_next[i].type = T_NIL;
+        sc->alloc_next[i].mark = 0;
+    }
+    sc->alloc_next = NULL;
+    sc->alloc_end = NULL;
+
+    GcCopy g = {sc, NULL, NULL, NULL, NULL, NULL, 0, 0, 0};
+    gc_pin_stack(&g);
+
+    // Copies out of the pages not kept need as many free pages in the
+    // worst case. page_take guarantees that, unless a heap image
+    // arrived fuller than half the heap and growth could not make up for it.
+    size_t kept_pages = 0;
+    for (pg = sc->used_pages; pg; pg = pg->next) {
+        kept_pages += pg->space != PAGE_USED;
+    }
+    if (sc->page_count - sc->used_page_count < sc->used_page_count - kept_pages) {
+        for (pg = sc->used_pages; pg; pg = pg->next) {
+            pg->space = PAGE_USED;
+        }
+        panic(sc, "out of memory");
+    }
+
+    sc->stats.gc_count++;
+    trace_out(sc, SCHEME_TRACE_GC_START, sc->total_cells);
+    unsigned long long start = clock_ns(sc);
+
+    HeapPage *from = NULL;
+    HeapPage *kept = NULL;
+    pg = sc->used_pages;
+    while (pg) {
+        HeapPage *next = pg->next;
+        if (pg->space == PAGE_USED) {
+            pg->next = from;
+            from = pg;
         } else {
-            push_root(sc, item);
-            Cell *node = cons(sc, item, scheme_nil(sc));
-            tail->as.pair.cdr = node;
-            tail = node;
-            pop_roots(sc, 1);
+            pg->next = kept;
+            kept = pg;
         }
-        skip_ws(s);
+        pg = next;
+    }
+    for (i = 0; i < sc->root_top; i++) {
+        sc->root_stack[i] = gc_forward(&g, sc->root_stack[i]);
+    }
+    for (i = 0; i < sc->env_top; i++) {
+        sc->env_stack[i] = gc_forward(&g, sc->env_stack[i]);
     }
+    sc->global_env = gc_forward(&g, sc->global_env);
+    sc->current_env = gc_forward(&g, sc->current_env);
+    sc->interned_syms = gc_forward(&g, sc->interned_syms);
+    sc->raised = gc_forward(&g, sc->raised);
+    gc_drain(&g);
 
-    if (**s != ')') {
-        panic(sc, "unterminated list");
+    // Cached global bindings move with their environment, or are forgotten
+    // with it.
+    for (Cell *p = sc->interned_syms; p != own_syms_end(sc); p = p->as.pair.cdr) {
+        Cell *sym = p->as.pair.car;
+        if (sym->as.sym.global_env) {
+            sym->as.sym.global_env = gc_survivor(sc, sym->as.sym.global_env);
+            sym->as.sym.global = sym->as.sym.global_env ? gc_survivor(sc, sym->as.sym.global) : NULL;
+        }
     }
-    (*s)++;
+    shared_cache_clear(sc);
+    if (sc->sym_index) {
+        for (i = 0; i < sc->sym_index_cap; i++) {
+            if (sc->sym_index[i]) {
+                sc->sym_index[i] = gc_survivor(sc, sc->sym_index[i]);
+            }
+        }
+    }
+    unsigned long long copied = clock_ns(sc);
 
-    return head ? head : scheme_nil(sc);
-}
+    // A surviving entry stays listed even if it is not a storage owner
+    // yet: reserve_cell's cell is still a pair while blob_alloc collects.
+    size_t live_blobs = 0;
+    for (i = 0; i < sc->blob_cell_count; i++) {
+        Cell *c = sc->blob_cells[i];
+        Cell *survivor = gc_survivor(sc, c);
+        if (survivor) {
+            sc->blob_cells[live_blobs++] = survivor;
+        } else if (is_blob(c)) {
+            blob_release(sc, c);
+        }
+    }
+    sc->blob_cell_count = live_blobs;
 
-static Cell *read_number(Scheme *sc, const char **s) {
-    int sign = 1;
-    int value = 0;
-    if (**s == '-') {
-        if ((*s)[1] < '0' || (*s)[1] > '9') {
-            return NULL;
+    // Dead cells of kept pages become inert, so an ambiguous root that
+    // later points at one finds nothing stale.
+    sc->used_pages = g.head;
+    while (kept) {
+        pg = kept->next;
+        for (i = 0; i < kept->count; i++) {
+            Cell *c = &kept->cells[i];
+            if (!c->mark) {
+                c->type = T_NIL;
+            }
+            c->mark = 0;
         }
-        sign = -1;
-        (*s)++;
+        kept->space = PAGE_USED;
+        kept->next = sc->used_pages;
+        sc->used_pages = kept;
+        kept = pg;
     }
-    if (**s < '0' || **s > '9') {
-        return NULL;
+    for (pg = g.head; pg; pg = pg->next) {
+        pg->space = PAGE_USED;
     }
-    while (**s >= '0' && **s <= '9') {
-        value = value * 10 + (**s - '0');
-        (*s)++;
+    while (from) {
+        pg = from->next;
+        from->space = PAGE_FREE;
+        from->next = sc->free_pages;
+        sc->free_pages = from;
+        from = pg;
     }
-    return make_int(sc, sign * value);
-}
+    sc->used_page_count = kept_pages + g.pages;
+    sc->alloc_next = g.next;
+    sc->alloc_end = g.end;
 
-static Cell *read_symbol(Scheme *sc, const char **s) {
-    const char *start = *s;
-    size_t len = 0;
-    while (!is_delim(**s)) {
-        (*s)++;
-        len++;
+    size_t live = g.live;
+    size_t before = sc->stats.live_cells + (sc->stats.cells_allocated - sc->copy_alloc_base);
+    sc->copy_alloc_base = sc->stats.cells_allocated;
+    sc->stats.live_cells = live;
+    sc->stats.cells_freed += before > live ? before - live : 0;
+    gc_release_segments(sc, live);
+    while (sc->used_page_count * 100 > sc->page_count * COPY_GROW_PERCENT && heap_grow(sc)) {
+    }
+    sc->blob_limit = sc->blob_bytes * 2 > BLOB_MIN_LIMIT ? sc->blob_bytes * 2 : BLOB_MIN_LIMIT;
+
+    unsigned long long end = clock_ns(sc);
+    sc->stats.mark_ns += copied - start;
+    sc->stats.sweep_ns += end - copied;
+    if (end - start > sc->stats.max_pause_ns) {
+        sc->stats.max_pause_ns = end - start;
     }
-    return intern_symbol_len(sc, start, len);
+    trace_out(sc, SCHEME_TRACE_GC_END, live);
 }
 
-static Cell *read_string(Scheme *sc, const char **s) {
-    (*s)++;
-    const char *start = *s;
-    size_t len = 0;
-    while (**s && **s != '"') {
-        (*s)++;
-        len++;
+// Incremental mark-and-sweep, when gc_pause_cells is nonzero. A cycle
+// shades the roots, then each step does up to gc_pause_cells cells of work
+// on the gray stack while the program runs: mark 2 is gray (queued) and 1
+// is black (scanned), as mark_cell leaves it. Storing a pointer into a
+// black cell shades the stored cell (gc_write_barrier), so nothing
+// reachable hides behind a scanned cell, and cells allocated while marking
+// start gray. Roots are stored without a barrier, so whenever the gray
+// stack runs dry a step shades them again, counting them as work; marking
+// ends once a rescan finds nothing new. The root and env stacks are
+// bounded, and only cells the program moved from the heap into a root can
+// turn up, so no pause has to drain the heap. Sweeping is lazy:
+// segments are swept a step at a time, newest first, and their free cells
+// are handed to the allocator as each segment is done or the free list
+// runs out. Segments added during the sweep are never swept by it.
+#define GC_IDLE 0
+#define GC_MARKING 1
+#define GC_SWEEPING 2
+#define MARK_BLACK 1
+#define MARK_GRAY 2
+// Cells of collector work per allocated cell, which sets how often steps
+// run and so how many cells a cycle needs to finish (gc_set_trigger).
+#define GC_WORK_RATIO 8
+#define GRAY_STACK_MIN_CAP 256
+
+static int gc_incremental(const Scheme *sc) {
+    return sc->gc_mode == SCHEME_GC_MARK_SWEEP && sc->gc_pause_cells;
+}
+
+// gc_gray_grow: double the gray stack.
+// Args: sc (interpreter state).
+// Returns: 1 on success, 0 if the allocation failed.
+static int gc_gray_grow(Scheme *sc) {
+    size_t cap = sc->gray_cap ? sc->gray_cap * 2 : GRAY_STACK_MIN_CAP;
+    Cell **gray = (Cell **)sc->platform.alloc(sc->platform.user, cap * sizeof(Cell *));
+    if (!gray) {
+        return 0;
     }
-    if (**s != '"') {
-        panic(sc, "unterminated string literal");
+    for (size_t i = 0; i < sc->gray_top; i++) {
+        gray[i] = sc->gray[i];
     }
-    (*s)++;
-    return make_string_len(sc, start, len);
+    if (sc->gray) {
+        sc->platform.free(sc->platform.user, sc->gray);
+    }
+    sc->gray = gray;
+    sc->gray_cap = cap;
+    return 1;
 }
 
-// read_expr: parse a single expression from the input cursor.
-// Args: sc (interpreter state), s (pointer to input cursor).
-// Returns: parsed expression cell, or NULL at end of input.
-static Cell *read_expr(Scheme *sc, const char **s) {
-    skip_ws(s);
-    if (**s == 0) {
-        return NULL;
+// gc_shade: mark a white cell gray, queuing it for a later scan.
+// Args: sc (interpreter state), c (cell or NULL).
+// Returns: none. If the gray stack cannot grow, c and everything it
+// reaches are marked black at once instead.
+static void gc_shade(Scheme *sc, Cell *c) {
+    if (!c || c->mark) {
+        return;
     }
-    if (**s == '(') {
-        (*s)++;
-        return read_list(sc, s);
+    // Cells without references are blackened at once.
+    if (c->type != T_PAIR && c->type != T_ERROR && c->type != T_CLOSURE && c->type != T_VECTOR &&
+        c->type != T_HASHTABLE) {
+        c->mark = MARK_BLACK;
+        sc->gc_marked++;
+        return;
     }
-    if (**s == ')') {
-        panic(sc, "unexpected )");
+    if (sc->gray_top == sc->gray_cap && !gc_gray_grow(sc)) {
+        mark_cell(sc, c);
+        return;
     }
-    if (**s == '\'') {
-        (*s)++;
-        Cell *expr = read_expr(sc, s);
-        push_root(sc, expr);
-        Cell *quote_sym = intern_symbol(sc, "quote");
-        Cell *res = cons(sc, quote_sym, cons(sc, expr, scheme_nil(sc)));
-        pop_roots(sc, 1);
-        return res;
+    c->mark = MARK_GRAY;
+    sc->gray[sc->gray_top++] = c;
+}
+
+// gc_write_barrier: keep the marking invariant across a pointer store.
+// Args: sc (interpreter state), obj (cell written into), val (cell stored).
+// Returns: none. Every store into a cell that was filled in earlier needs
+// this, including the tail of a list still being built: the list is rooted,
+// so a step may have scanned it already.
+static void gc_write_barrier(Scheme *sc, Cell *obj, Cell *val) {
+    if (sc->gc_phase == GC_MARKING && obj->mark == MARK_BLACK) {
+        gc_shade(sc, val);
     }
-    if (**s == '#') {
-        (*s)++;
-        if (**s == '\\') {
-            (*s)++;
-            const char *start = *s;
-            size_t len = 0;
-            while (**s && !is_delim(**s)) {
-                (*s)++;
-                len++;
+}
+
+// gc_scan: blacken a gray cell by shading the cells it refers to.
+// Args: sc (interpreter state), c (gray cell), budget (work allowed).
+// Returns: the work done, in cells and slots visited. A list's white tail
+// is blackened in the same call while the budget lasts, without queuing.
+static size_t gc_scan(Scheme *sc, Cell *c, size_t budget) {
+    size_t work = 1;
+    c->mark = MARK_BLACK;
+    sc->gc_marked++;
+    switch (c->type) {
+        case T_PAIR:
+        case T_ERROR:
+            gc_shade(sc, c->as.pair.car);
+            for (Cell *d = c->as.pair.cdr; d && !d->mark && d->type == T_PAIR && work < budget; work++) {
+                d->mark = MARK_BLACK;
+                sc->gc_marked++;
+                gc_shade(sc, d->as.pair.car);
+                c = d;
+                d = d->as.pair.cdr;
             }
-            if (len == 0) {
-                return NULL;
+            gc_shade(sc, c->as.pair.cdr);
+            break;
+        case T_CLOSURE:
+            gc_shade(sc, c->as.closure.params);
+            gc_shade(sc, c->as.closure.body);
+            gc_shade(sc, c->as.closure.env);
+            break;
+        case T_VECTOR:
+            for (size_t i = 0; i < c->as.vec.len; i++) {
+                gc_shade(sc, c->as.vec.items[i]);
+            }
+            work += c->as.vec.len;
+            break;
+        case T_HASHTABLE:
+            for (HashTable *t = c->as.hash.table; t; t = t->old) {
+                HashEntry *e = hash_entries(t);
+                for (size_t i = 0; i < t->cap; i++) {
+                    if (e[i].key && e[i].key != HASH_TOMBSTONE) {
+                        gc_shade(sc, e[i].key);
+                        gc_shade(sc, e[i].value);
+                    }
+                }
+                work += t->cap;
             }
-            if (len == 7 && streq_len("newline", start, len)) {
-                return make_char(sc, '\n');
+            break;
+        default:
+            break;
+    }
+    return work;
+}
+
+// gc_set_trigger: choose how many free cells may remain when the next
+// incremental cycle starts: twice what the program allocates while the
+// live cells are marked, but at most half the free cells. Sweeping needs
+// no reserve, since it frees cells as the program asks for them.
+// Args: sc (interpreter state), live (cells live after the last cycle).
+// Returns: none.
+static void gc_set_trigger(Scheme *sc, size_t live) {
+    size_t need = (live + sc->gc_pause_cells) / GC_WORK_RATIO * 2;
+    sc->gc_trigger = need < sc->free_cells / 2 ? need : sc->free_cells / 2;
+}
+
+// gc_shade_roots: shade every root.
+// Args: sc (interpreter state, marking).
+// Returns: the work done, one per root.
+static size_t gc_shade_roots(Scheme *sc) {
+    gc_shade(sc, sc->global_env);
+    gc_shade(sc, sc->current_env);
+    for (size_t i = 0; i < sc->env_top; i++) {
+        gc_shade(sc, sc->env_stack[i]);
+    }
+    gc_shade(sc, sc->interned_syms);
+    for (size_t i = 0; i < sc->root_top; i++) {
+        gc_shade(sc, sc->root_stack[i]);
+    }
+    gc_shade(sc, sc->raised);
+    return sc->env_top + sc->root_top + 4;
+}
+
+// gc_start: begin an incremental cycle by shading the roots.
+// Args: sc (interpreter state, idle collector).
+// Returns: none.
+static void gc_start(Scheme *sc) {
+    sc->stats.gc_count++;
+    trace_out(sc, SCHEME_TRACE_GC_START, sc->total_cells);
+    sc->gc_phase = GC_MARKING;
+    sc->gc_marked = 0;
+    sc->gc_debt = 0;
+    sc->gc_sym_scan = NULL;
+    gc_shade_roots(sc);
+}
+
+// gc_mark: do up to budget cells of marking work: scan gray cells, rescan
+// the roots when none are left, and once a rescan finds nothing new, forget
+// the global bindings cached for environments left white.
+// Args: sc (interpreter state, marking), budget (work allowed).
+// Returns: 1 once marking is complete, else 0.
+static int gc_mark(Scheme *sc, size_t budget) {
+    size_t work = 0;
+    while (work < budget) {
+        if (sc->gray_top) {
+            work += gc_scan(sc, sc->gray[--sc->gray_top], budget - work);
+        } else if (!sc->gc_sym_scan) {
+            // A rescan that would overrun the budget waits for the next step.
+            if (work && work + sc->env_top + sc->root_top + 4 > budget) {
+                return 0;
             }
-            if (len == 6 && streq_len("return", start, len)) {
-                return make_char(sc, '\r');
+            size_t marked = sc->gc_marked;
+            work += gc_shade_roots(sc);
+            if (!sc->gray_top && sc->gc_marked == marked) {
+                sc->gc_sym_scan = sc->interned_syms;
             }
-            if (len == 1) {
-                return make_char(sc, (unsigned char)start[0]);
+        } else if (sc->gc_sym_scan != own_syms_end(sc)) {
+            // Every cell reachable now is marked, so a white environment is
+            // dead and its cells may come back as a different one. Bindings
+            // cached from here on are in live environments.
+            Cell *sym = sc->gc_sym_scan->as.pair.car;
+            if (sym->as.sym.global_env && !sym->as.sym.global_env->mark) {
+                sym->as.sym.global_env = NULL;
+                sym->as.sym.global = NULL;
             }
-            panic(sc, "invalid character literal");
-            return scheme_nil(sc);
-        }
-        if (**s == 't') {
-            (*s)++;
-            return scheme_true(sc);
-        }
-        if (**s == 'f') {
-            (*s)++;
-            return scheme_false(sc);
+            sc->gc_sym_scan = sc->gc_sym_scan->as.pair.cdr;
+            work++;
+        } else {
+            return 1;
         }
     }
-    if (**s == '"') {
-        return read_string(sc, s);
+    return 0;
+}
+
+// gc_mark_finish: end the mark phase and set up the lazy sweep.
+// Args: sc (interpreter state, marking complete).
+// Returns: none.
+static void gc_mark_finish(Scheme *sc) {
+    // Cells on the old free list are white and come back through the sweep.
+    sc->gc_already_free = sc->free_cells;
+    sc->gc_swept_free = 0;
+    sc->free_list = NULL;
+    sc->free_cells = 0;
+    sc->gc_phase = GC_SWEEPING;
+    sc->sweep_seg = sc->segments->next ? sc->segments->next : sc->segments;
+    sc->sweep_left = sc->sweep_seg->count;
+    sc->sweep_spliced = 0;
+    sc->sweep_seg->free_head = NULL;
+    sc->sweep_seg->free_tail = NULL;
+    sc->sweep_seg->free_count = 0;
+}
+
+// gc_sweep_splice: hand the free cells swept so far in the current
+// segment to the allocator.
+// Args: sc (interpreter state, sweeping).
+// Returns: none.
+static void gc_sweep_splice(Scheme *sc) {
+    HeapSegment *seg = sc->sweep_seg;
+    if (seg->free_head) {
+        seg->free_tail->as.pair.cdr = sc->free_list;
+        sc->free_list = seg->free_head;
+        seg->free_head = NULL;
+        seg->free_tail = NULL;
+    }
+    sc->sweep_spliced = 1;
+}
+
+// gc_cycle_end: account for a finished incremental cycle and decide when
+// the next one starts.
+// Args: sc (interpreter state).
+// Returns: none.
+static void gc_cycle_end(Scheme *sc) {
+    size_t live = sc->gc_marked;
+    sc->stats.live_cells = live;
+    if (sc->gc_swept_free > sc->gc_already_free) {
+        sc->stats.cells_freed += sc->gc_swept_free - sc->gc_already_free;
+    }
+    sc->gc_phase = GC_IDLE;
+    if (live * 100 > sc->total_cells * HEAP_GROW_PERCENT) {
+        heap_grow(sc);
     }
+    gc_set_trigger(sc, live);
+    sc->blob_limit = sc->blob_bytes * 2 > BLOB_MIN_LIMIT ? sc->blob_bytes * 2 : BLOB_MIN_LIMIT;
+    trace_out(sc, SCHEME_TRACE_GC_END, live);
+}
 
-    Cell *num = read_number(sc, s);
-    if (num) {
-        return num;
+// gc_sweep_segment_end: finish sweeping a segment, releasing it if it is
+// a grown segment that came back empty while the heap is mostly idle.
+// Args: sc (interpreter state, sweeping with sweep_left 0).
+// Returns: 1 if another segment is left to sweep, 0 if the cycle ended.
+static int gc_sweep_segment_end(Scheme *sc) {
+    HeapSegment *seg = sc->sweep_seg;
+    HeapSegment *next = seg == sc->segments ? NULL : seg->next ? seg->next : sc->segments;
+    size_t remaining = sc->total_cells - seg->count;
+    if (seg != sc->segments && !sc->sweep_spliced && sc->platform.free && seg->free_count == seg->count &&
+        sc->gc_marked * 100 < remaining * HEAP_SHRINK_PERCENT) {
+        HeapSegment **link = &sc->segments->next;
+        while (*link != seg) {
+            link = &(*link)->next;
+        }
+        *link = seg->next;
+        sc->total_cells = remaining;
+        sc->free_cells -= seg->count;
+        sc->platform.free(sc->platform.user, seg);
+    } else {
+        gc_sweep_splice(sc);
+    }
+    if (!next) {
+        gc_cycle_end(sc);
+        return 0;
     }
-    return read_symbol(sc, s);
+    sc->sweep_seg = next;
+    sc->sweep_left = next->count;
+    sc->sweep_spliced = 0;
+    next->free_head = NULL;
+    next->free_tail = NULL;
+    next->free_count = 0;
+    return 1;
 }
 
-static Cell *env_lookup(Scheme *sc, Cell *env, Cell *sym) {
-    while (!is_nil(sc, env)) {
-        Cell *frame = car(env);
-        while (!is_nil(sc, frame)) {
-            Cell *binding = car(frame);
-            if (car(binding) == sym) {
-                return cdr(binding);
+// gc_sweep: sweep up to budget cells, stopping early once the allocator
+// has a free cell if want_free is set.
+// Args: sc (interpreter state, sweeping), budget (cells), want_free (flag).
+// Returns: none.
+static void gc_sweep(Scheme *sc, size_t budget, int want_free) {
+    while (sc->gc_phase == GC_SWEEPING) {
+        HeapSegment *seg = sc->sweep_seg;
+        size_t left = sc->sweep_left;
+        size_t n = left < budget ? left : budget;
+        size_t free_before = seg->free_count;
+        for (size_t stop = left - n; left > stop;) {
+            Cell *c = &seg->cells[--left];
+            if (c->mark) {
+                c->mark = 0;
+            } else {
+                if (is_blob(c)) {
+                    blob_release(sc, c);
+                }
+                segment_add_free(seg, c);
+            }
+        }
+        budget -= n;
+        sc->sweep_left = left;
+        sc->free_cells += seg->free_count - free_before;
+        sc->gc_swept_free += seg->free_count - free_before;
+        if (!sc->sweep_left) {
+            if (!gc_sweep_segment_end(sc)) {
+                return;
+            }
+        } else if (want_free && !sc->free_list) {
+            if (seg->free_head) {
+                gc_sweep_splice(sc);
             }
-            frame = cdr(frame);
         }
-        env = cdr(env);
+        if (!budget || (want_free && sc->free_list)) {
+            return;
+        }
     }
-    return NULL;
 }
 
-static void env_define(Scheme *sc, Cell *env, Cell *sym, Cell *val) {
-    Cell *frame = car(env);
-    push_root(sc, frame);
-    push_root(sc, sym);
-    push_root(sc, val);
-    Cell *binding = cons(sc, sym, val);
-    frame = cons(sc, binding, frame);
-    env->as.pair.car = frame;
-    pop_roots(sc, 3);
+// gc_step: do one increment of collector work.
+// Args: sc (interpreter state, collecting incrementally).
+// Returns: none.
+static void gc_step(Scheme *sc) {
+    unsigned long long start = clock_ns(sc);
+    sc->gc_debt = 0;
+    int phase = sc->gc_phase;
+    if (phase == GC_MARKING) {
+        if (gc_mark(sc, sc->gc_pause_cells)) {
+            gc_mark_finish(sc);
+        }
+    } else if (phase == GC_SWEEPING) {
+        gc_sweep(sc, sc->gc_pause_cells, 0);
+    }
+    unsigned long long end = clock_ns(sc);
+    if (phase == GC_MARKING) {
+        sc->stats.mark_ns += end - start;
+    } else {
+        sc->stats.sweep_ns += end - start;
+    }
+    if (end - start > sc->stats.max_pause_ns) {
+        sc->stats.max_pause_ns = end - start;
+    }
 }
 
-static int env_set(Scheme *sc, Cell *env, Cell *sym, Cell *val) {
-    while (!is_nil(sc, env)) {
-        Cell *frame = car(env);
-        while (!is_nil(sc, frame)) {
-            Cell *binding = car(frame);
-            if (car(binding) == sym) {
-                binding->as.pair.cdr = val;
-                return 1;
-            }
-            frame = cdr(frame);
+// gc_finish: complete the incremental cycle in progress, if any.
+// Args: sc (interpreter state).
+// Returns: none. Afterwards every mark is clear, as mark_cell expects.
+static void gc_finish(Scheme *sc) {
+    if (sc->gc_phase == GC_IDLE) {
+        return;
+    }
+    unsigned long long start = clock_ns(sc);
+    if (sc->gc_phase == GC_MARKING) {
+        gc_mark(sc, (size_t)-1);
+        gc_mark_finish(sc);
+    }
+    unsigned long long marked = clock_ns(sc);
+    gc_sweep(sc, (size_t)-1, 0);
+    unsigned long long end = clock_ns(sc);
+    sc->stats.mark_ns += marked - start;
+    sc->stats.sweep_ns += end - marked;
+    if (end - start > sc->stats.max_pause_ns) {
+        sc->stats.max_pause_ns = end - start;
+    }
+}
+
+// gc_refill: find free cells for an incremental collector whose free list
+// ran dry: sweep for one step if sweeping, else grow the heap. Only when
+// the heap cannot grow is the rest of the cycle done in this pause, until a
+// free cell turns up.
+// Args: sc (interpreter state, collecting incrementally).
+// Returns: none; the free list may still be empty if the cycle ended.
+static void gc_refill(Scheme *sc) {
+    if (sc->gc_phase == GC_SWEEPING) {
+        unsigned long long start = clock_ns(sc);
+        gc_sweep(sc, sc->gc_pause_cells, 1);
+        unsigned long long end = clock_ns(sc);
+        sc->stats.sweep_ns += end - start;
+        if (end - start > sc->stats.max_pause_ns) {
+            sc->stats.max_pause_ns = end - start;
         }
-        env = cdr(env);
     }
-    return 0;
+    if (sc->free_list || sc->gc_phase == GC_IDLE || heap_grow(sc)) {
+        return;
+    }
+    unsigned long long start = clock_ns(sc);
+    if (sc->gc_phase == GC_MARKING) {
+        gc_mark(sc, (size_t)-1);
+        gc_mark_finish(sc);
+    }
+    unsigned long long marked = clock_ns(sc);
+    if (sc->gc_phase == GC_SWEEPING) {
+        gc_sweep(sc, (size_t)-1, 1);
+    }
+    unsigned long long end = clock_ns(sc);
+    sc->stats.mark_ns += marked - start;
+    sc->stats.sweep_ns += end - marked;
+    if (end - start > sc->stats.max_pause_ns) {
+        sc->stats.max_pause_ns = end - start;
+    }
 }
 
-static Cell *eval(Scheme *sc, Cell *expr, Cell *env);
+// gc_collect: collect with the configured collector. Mark-and-sweep roots are
+// the global env, active envs, interned symbols, root stack and raised object.
+// Args: sc (interpreter state).
+// Returns: none.
+static void gc_collect(Scheme *sc) {
+    if (sc->gc_mode == SCHEME_GC_COPYING) {
+        gc_copy(sc);
+        return;
+    }
+    if (sc->gc_phase != GC_IDLE) {
+        gc_finish(sc);
+        return;
+    }
+    size_t i;
+    size_t already_free = 0;
 
-// eval_list: evaluate each element of a list in order.
-// Args: sc (interpreter state), list (list of expressions), env (environment).
-// Returns: list of evaluated values.
-static Cell *eval_list(Scheme *sc, Cell *list, Cell *env) {
-    if (is_nil(sc, list)) {
-        return scheme_nil(sc);
+    sc->stats.gc_count++;
+    // Vector allocation may collect before the free list runs dry; cells
+    // that were already free are not counted as reclaimed.
+    for (Cell *c = sc->free_list; c; c = c->as.pair.cdr) {
+        already_free++;
     }
-    Cell *head = NULL;
-    Cell *tail = NULL;
-    while (!is_nil(sc, list)) {
-        int pushed_head = 0;
-        if (head) {
-            push_root(sc, head);
-            pushed_head = 1;
-        }
-        Cell *val = eval(sc, car(list), env);
-        push_root(sc, val);
-        Cell *node = cons(sc, val, scheme_nil(sc));
-        if (!head) {
-            head = node;
-            tail = node;
-        } else {
-            tail->as.pair.cdr = node;
-            tail = node;
+    trace_out(sc, SCHEME_TRACE_GC_START, sc->total_cells);
+    unsigned long long start = clock_ns(sc);
+
+    mark_cell(sc, sc->global_env);
+    mark_cell(sc, sc->current_env);
+    for (i = 0; i < sc->env_top; i++) {
+        mark_cell(sc, sc->env_stack[i]);
+    }
+    mark_cell(sc, sc->interned_syms);
+    for (i = 0; i < sc->root_top; i++) {
+        mark_cell(sc, sc->root_stack[i]);
+    }
+    mark_cell(sc, sc->raised);
+    // Forget global bindings cached for environments about to be freed,
+    // whose cells may come back as a different environment.
+    for (Cell *p = sc->interned_syms; p != own_syms_end(sc); p = p->as.pair.cdr) {
+        Cell *sym = p->as.pair.car;
+        if (sym->as.sym.global_env && !sym->as.sym.global_env->mark) {
+            sym->as.sym.global_env = NULL;
+            sym->as.sym.global = NULL;
         }
-        pop_roots(sc, pushed_head ? 2 : 1);
-        list = cdr(list);
     }
-    return head ? head : scheme_nil(sc);
-}
+    unsigned long long marked = clock_ns(sc);
 
-// apply: apply a primitive or closure to evaluated arguments.
-// Args: sc (interpreter state), fn (function), args (argument list).
-// Returns: result cell.
-static Cell *apply(Scheme *sc, Cell *fn, Cell *args) {
-    if (fn->type == T_PRIMITIVE) {
-        push_root(sc, fn);
-        push_root(sc, args);
-        Cell *result = fn->as.prim.fn(sc, args);
-        pop_roots(sc, 2);
-        return result;
+    size_t free_cells = 0;
+    for (HeapSegment *seg = sc->segments; seg; seg = seg->next) {
+        seg->free_head = NULL;
+        seg->free_tail = NULL;
+        seg->free_count = 0;
+        for (i = seg->count; i > 0; i--) {
+            Cell *c = &seg->cells[i - 1];
+            if (c->mark) {
+                c->mark = 0;
+            } else {
+                if (is_blob(c)) {
+                    blob_release(sc, c);
+                }
+                segment_add_free(seg, c);
+            }
+        }
+        free_cells += seg->free_count;
     }
-    if (fn->type == T_CLOSURE) {
-        push_root(sc, fn);
-        push_root(sc, args);
-        Cell *new_env = cons(sc, scheme_nil(sc), fn->as.closure.env);
-        Cell *prev_env = sc->current_env;
-        sc->current_env = new_env;
-        env_stack_push(sc, new_env);
-        Cell *params = fn->as.closure.params;
-        Cell *vals = args;
-        while (!is_nil(sc, params) && !is_nil(sc, vals)) {
-            env_define(sc, new_env, car(params), car(vals));
-            params = cdr(params);
-            vals = cdr(vals);
+
+    sc->stats.cells_freed += free_cells - already_free;
+
+    // Release grown segments that came back entirely empty while the heap
+    // is mostly idle; the first segment belongs to the embedder.
+    size_t live = sc->total_cells - free_cells;
+    sc->stats.live_cells = live;
+    HeapSegment **link = &sc->segments->next;
+    while (*link) {
+        HeapSegment *seg = *link;
+        size_t remaining = sc->total_cells - seg->count;
+        if (sc->platform.free && seg->free_count == seg->count &&
+            live * 100 < remaining * HEAP_SHRINK_PERCENT) {
+            *link = seg->next;
+            sc->total_cells = remaining;
+            free_cells -= seg->count;
+            sc->platform.free(sc->platform.user, seg);
+            continue;
         }
-        pop_roots(sc, 1);
-        Cell *body = fn->as.closure.body;
-        Cell *result = scheme_nil(sc);
-        while (!is_nil(sc, body)) {
-            result = eval(sc, car(body), new_env);
-            body = cdr(body);
+        link = &seg->next;
+    }
+
+    sc->free_list = NULL;
+    for (HeapSegment *seg = sc->segments; seg; seg = seg->next) {
+        if (seg->free_head) {
+            seg->free_tail->as.pair.cdr = sc->free_list;
+            sc->free_list = seg->free_head;
         }
-        env_stack_pop(sc);
-        sc->current_env = prev_env;
-        pop_roots(sc, 1);
-        return result;
     }
-    panic(sc, "attempt to call non-function");
-    return scheme_nil(sc);
-}
+    sc->free_cells = free_cells;
 
-static int is_symbol(Cell *c, const char *name) {
-    return c->type == T_SYMBOL && streq(c->as.sym.name, name);
-}
+    if (live * 100 > sc->total_cells * HEAP_GROW_PERCENT) {
+        heap_grow(sc);
+    }
+    gc_set_trigger(sc, live);
+    sc->blob_limit = sc->blob_bytes * 2 > BLOB_MIN_LIMIT ? sc->blob_bytes * 2 : BLOB_MIN_LIMIT;
 
-// eval: evaluate an expression in the given environment.
-// Args: sc (interpreter state), expr (expression), env (environment).
-// Returns: result cell.
-static Cell *eval(Scheme *sc, Cell *expr, Cell *env) {
-    sc->current_env = env;
-    if (!expr) {
-        return scheme_nil(sc);
+    unsigned long long end = clock_ns(sc);
+    sc->stats.mark_ns += marked - start;
+    sc->stats.sweep_ns += end - marked;
+    if (end - start > sc->stats.max_pause_ns) {
+        sc->stats.max_pause_ns = end - start;
     }
-    switch (expr->type) {
-        case T_INT:
-        case T_BOOL:
-        case T_STRING:
-        case T_CHAR:
-        case T_PRIMITIVE:
-        case T_CLOSURE:
-            return expr;
-        case T_SYMBOL: {
-            Cell *val = env_lookup(sc, env, expr);
-            if (!val) {
-                write_str(sc, "unbound symbol: ");
-                write_str(sc, expr->as.sym.name);
-                write_str(sc, "\n");
-                panic(sc, "unbound symbol");
+    trace_out(sc, SCHEME_TRACE_GC_END, live);
+}
+
+// alloc_cell: allocate a new cell from the freelist or current page, collecting if needed.
+// Args: sc (interpreter state).
+// Returns: pointer to a newly allocated cell.
+static Cell *alloc_cell(Scheme *sc) {
+    if (sc->gc_mode == SCHEME_GC_COPYING) {
+        if (sc->alloc_next == sc->alloc_end && !page_take(sc)) {
+            gc_collect(sc);
+            if (sc->alloc_next == sc->alloc_end && !page_take(sc) && !(heap_grow(sc) && page_take(sc))) {
+                panic(sc, "out of memory");
             }
-            return val;
         }
-        case T_PAIR: {
-            Cell *op = car(expr);
-            if (is_symbol(op, "quote")) {
-                return car(cdr(expr));
+        Cell *c = sc->alloc_next++;
+        c->mark = 0;
+        sc->stats.cells_allocated++;
+        return c;
+    }
+    if (sc->gc_pause_cells) {
+        if (sc->gc_phase == GC_IDLE) {
+            if (sc->free_cells <= sc->gc_trigger) {
+                gc_start(sc);
             }
-            if (is_symbol(op, "if")) {
-                Cell *test = eval(sc, car(cdr(expr)), env);
-                if (test != scheme_false(sc)) {
-                    return eval(sc, car(cdr(cdr(expr))), env);
-                }
-                return eval(sc, car(cdr(cdr(cdr(expr)))), env);
+        } else if (++sc->gc_debt * GC_WORK_RATIO >= sc->gc_pause_cells) {
+            gc_step(sc);
+        }
+        if (!sc->free_list && sc->gc_phase != GC_IDLE) {
+            gc_refill(sc);
+        }
+        // The new cell goes on the gray stack; without room for it the
+        // cycle ends at once.
+        if (sc->gc_phase == GC_MARKING && sc->gray_top == sc->gray_cap && !gc_gray_grow(sc)) {
+            gc_finish(sc);
+        }
+    }
+    if (!sc->free_list) {
+        gc_collect(sc);
+        if (!sc->free_list && !heap_grow(sc)) {
+            panic(sc, "out of memory");
+        }
+    }
+    Cell *c = sc->free_list;
+    sc->free_list = c->as.pair.cdr;
+    sc->free_cells--;
+    c->mark = 0;
+    if (sc->gc_phase == GC_MARKING) {
+        // Scanned once the caller has filled it in.
+        c->mark = MARK_GRAY;
+        sc->gray[sc->gray_top++] = c;
+    }
+    sc->stats.cells_allocated++;
+    return c;
+}
+
+// blob_alloc: allocate storage for a vector, bytevector or string builder.
+// Args: sc (interpreter state), size (bytes; 0 gives NULL).
+// Returns: the storage; panics when no allocator is configured or memory runs out.
+// May collect, so callers must root any cells they still need.
+static void *blob_alloc(Scheme *sc, size_t size) {
+    if (!sc->platform.alloc || !sc->platform.free) {
+        panic(sc, "vector: no platform allocator");
+    }
+    if (!size) {
+        return NULL;
+    }
+    if (sc->blob_bytes + size > sc->blob_limit) {
+        // An incremental collector gets until twice the limit to catch up.
+        if (gc_incremental(sc) && sc->blob_bytes + size <= sc->blob_limit * 2) {
+            if (sc->gc_phase == GC_IDLE) {
+                gc_start(sc);
+            } else {
+                gc_step(sc);
+            }
+        } else {
+            gc_collect(sc);
+        }
+    }
+    if (sc->quota.arena_bytes && sc->arena_grown + sc->blob_bytes + size > sc->quota.arena_bytes) {
+        gc_collect(sc);
+        if (sc->arena_grown + sc->blob_bytes + size > sc->quota.arena_bytes) {
+            quota_exceeded(sc, "arena quota exceeded");
+        }
+    }
+    void *p = sc->platform.alloc(sc->platform.user, size);
+    if (!p) {
+        gc_collect(sc);
+        p = sc->platform.alloc(sc->platform.user, size);
+        if (!p) {
+            panic(sc, "out of memory");
+        }
+    }
+    sc->blob_bytes += size;
+    return p;
+}
+
+// arena_grow: retire the current symbol or string arena chunk and start a
+// new one large enough for need bytes.
+// Args: sc (interpreter state), buf/size/used/chunks (the arena's fields), need (bytes).
+// Returns: 1 on success, 0 if growth is disabled or the allocation failed.
+static int arena_grow(Scheme *sc, char **buf, size_t *size, size_t *used, ArenaChunk **chunks, size_t need) {
+    if (!sc->arena_grow_bytes || !sc->platform.alloc) {
+        return 0;
+    }
+    size_t bytes = sc->arena_grow_bytes;
+    if (bytes < need) {
+        bytes = need;
+    }
+    if (sc->quota.arena_bytes && sc->arena_grown + sc->blob_bytes + bytes > sc->quota.arena_bytes) {
+        quota_exceeded(sc, "arena quota exceeded");
+    }
+    ArenaChunk *chunk = (ArenaChunk *)sc->platform.alloc(sc->platform.user, sizeof(ArenaChunk) + bytes);
+    if (!chunk) {
+        return 0;
+    }
+    sc->arena_grown += bytes;
+    chunk->size = bytes;
+    chunk->next = *chunks;
+    *chunks = chunk;
+    *buf = (char *)(chunk + 1);
+    *size = bytes;
+    *used = 0;
+    return 1;
+}
+
+static Cell *make_int(Scheme *sc, int v) {
+    Cell *c = alloc_cell(sc);
+    c->type = T_INT;
+    c->as.i = v;
+    return c;
+}
+
+static Cell *make_char(Scheme *sc, int v) {
+    Cell *c = alloc_cell(sc);
+    c->type = T_CHAR;
+    c->as.i = v;
+    return c;
+}
+
+static Cell *make_bool(Scheme *sc, int v) {
+    return v ? scheme_true(sc) : scheme_false(sc);
+}
+
+static char *alloc_str_bytes(Scheme *sc, size_t len) {
+    if (sc->str_buf_used + len + 1 > sc->str_buf_size &&
+        !arena_grow(sc, &sc->str_buf, &sc->str_buf_size, &sc->str_buf_used, &sc->str_chunks, len + 1)) {
+        panic(sc, "string buffer full");
+    }
+    char *p = sc->str_buf + sc->str_buf_used;
+    sc->str_buf_used += len + 1;
+    // Strings are never reclaimed, so usage only grows and is its own peak.
+    sc->stats.str_arena_peak += len + 1;
+    return p;
+}
+
+static Cell *make_string_len(Scheme *sc, const char *data, size_t len) {
+    Cell *c = alloc_cell(sc);
+    c->type = T_STRING;
+    char *dst = alloc_str_bytes(sc, len);
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = data[i];
+    }
+    dst[len] = '\0';
+    c->as.str.data = dst;
+    c->as.str.len = len;
+    return c;
+}
+
+static Cell *make_string_from_int(Scheme *sc, int n) {
+    char tmp[12];
+    size_t len = 0;
+    unsigned int u = (unsigned int)n;
+    if (n == 0) {
+        tmp[len++] = '0';
+    } else {
+        if (n < 0) {
+            u = (unsigned int)(-n);
+        }
+        while (u > 0 && len < sizeof(tmp)) {
+            tmp[len++] = (char)('0' + (u % 10));
+            u /= 10;
+        }
+        if (n < 0 && len < sizeof(tmp)) {
+            tmp[len++] = '-';
+        }
+    }
+    char *buf = alloc_str_bytes(sc, len);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = tmp[len - 1 - i];
+    }
+    buf[len] = '\0';
+    Cell *c = alloc_cell(sc);
+    c->type = T_STRING;
+    c->as.str.data = buf;
+    c->as.str.len = len;
+    return c;
+}
+
+static Cell *cons(Scheme *sc, Cell *a, Cell *d) {
+    Cell *c = alloc_cell(sc);
+    c->type = T_PAIR;
+    c->as.pair.car = a;
+    c->as.pair.cdr = d;
+    return c;
+}
+
+static Cell *make_prim(Scheme *sc, PrimFn fn) {
+    Cell *c = alloc_cell(sc);
+    c->type = T_PRIMITIVE;
+    c->as.prim.fn = fn;
+    c->as.prim.fn1 = NULL;
+    c->as.prim.fn2 = NULL;
+    return c;
+}
+
+static Cell *make_closure(Scheme *sc, Cell *params, Cell *body, Cell *env) {
+    push_root(sc, params);
+    push_root(sc, body);
+    push_root(sc, env);
+    Cell *c = alloc_cell(sc);
+    pop_roots(sc, 3);
+    c->type = T_CLOSURE;
+    c->as.closure.params = params;
+    c->as.closure.body = body;
+    c->as.closure.env = env;
+    return c;
+}
+
+// blob_cell_add: record a cell that may come to own storage, so the copying
+// collector frees that storage once the cell dies.
+// Args: sc (interpreter state), c (cell).
+// Returns: none; panics if the list cannot grow.
+static void blob_cell_add(Scheme *sc, Cell *c) {
+    if (sc->blob_cell_count == sc->blob_cell_cap) {
+        size_t cap = sc->blob_cell_cap * 2;
+        Cell **cells = (Cell **)sc->platform.alloc(sc->platform.user, cap * sizeof(Cell *));
+        if (!cells) {
+            panic(sc, "out of memory");
+        }
+        for (size_t i = 0; i < sc->blob_cell_count; i++) {
+            cells[i] = sc->blob_cells[i];
+        }
+        sc->platform.free(sc->platform.user, sc->blob_cells);
+        sc->blob_cells = cells;
+        sc->blob_cell_cap = cap;
+    }
+    sc->blob_cells[sc->blob_cell_count++] = c;
+}
+
+// reserve_cell: allocate the cell for a vector, bytevector, builder or hash
+// table before its storage, so an error raised while allocating the storage
+// cannot strand it.
+// Args: sc (interpreter state).
+// Returns: an empty pair, left on the root stack for the caller to pop once
+// it has installed the storage.
+static Cell *reserve_cell(Scheme *sc) {
+    Cell *c = cons(sc, scheme_nil(sc), scheme_nil(sc));
+    push_root(sc, c);
+    if (sc->gc_mode == SCHEME_GC_COPYING) {
+        blob_cell_add(sc, c);
+    }
+    return c;
+}
+
+// make_vector: allocate a vector of n slots, each set to fill.
+// Args: sc (interpreter state), n (length), fill (initial element).
+// Returns: the vector cell.
+static Cell *make_vector(Scheme *sc, size_t n, Cell *fill) {
+    if (n > ((size_t)-1) / sizeof(Cell *)) {
+        panic(sc, "make-vector: too large");
+    }
+    push_root(sc, fill);
+    Cell *c = reserve_cell(sc);
+    Cell **items = (Cell **)blob_alloc(sc, n * sizeof(Cell *));
+    for (size_t i = 0; i < n; i++) {
+        items[i] = fill;
+    }
+    pop_roots(sc, 2);
+    // The reserved pair may already have been scanned.
+    gc_write_barrier(sc, c, fill);
+    c->type = T_VECTOR;
+    c->as.vec.items = items;
+    c->as.vec.len = n;
+    return c;
+}
+
+// make_bytevector: allocate a bytevector of n bytes, each set to fill.
+// Args: sc (interpreter state), n (length), fill (initial byte).
+// Returns: the bytevector cell.
+static Cell *make_bytevector(Scheme *sc, size_t n, unsigned char fill) {
+    Cell *c = reserve_cell(sc);
+    unsigned char *data = (unsigned char *)blob_alloc(sc, n);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = fill;
+    }
+    pop_roots(sc, 1);
+    c->type = T_BYTEVECTOR;
+    c->as.bytes.data = data;
+    c->as.bytes.len = n;
+    return c;
+}
+
+// Limb count of the smaller operand from which multiplication splits with
+// Karatsuba instead of the schoolbook loop.
+#define KARATSUBA_THRESHOLD 32
+// Largest bignum, in limbs; keeps sizes within int and size_t arithmetic.
+#define BIG_MAX_LIMBS 0x1000000u
+
+// A number's sign and magnitude as limbs. A fixnum is viewed through the
+// one-limb buffer small, so the slow paths handle both representations.
+typedef struct BigNum {
+    const unsigned int *d;
+    size_t n;
+    int neg;
+    unsigned int small;
+} BigNum;
+
+// big_view: describe a fixnum or bignum as a BigNum.
+// Args: sc (interpreter state), v (value), b (filled in), who (error message
+// for anything else).
+// Returns: none; b borrows v's storage, so v must stay reachable.
+static void big_view(Scheme *sc, Cell *v, BigNum *b, const char *who) {
+    if (v->type == T_INT) {
+        b->neg = v->as.i < 0;
+        b->small = b->neg ? 0u - (unsigned int)v->as.i : (unsigned int)v->as.i;
+        b->d = &b->small;
+        b->n = b->small != 0;
+    } else if (v->type == T_BIGNUM) {
+        b->neg = v->as.big.len < 0;
+        b->d = v->as.big.digits;
+        b->n = (size_t)(b->neg ? -v->as.big.len : v->as.big.len);
+    } else {
+        panic(sc, who);
+    }
+}
+
+// big_alloc: allocate a bignum cell with room for n limbs.
+// Args: sc (interpreter state), n (limbs, at least 1).
+// Returns: the cell with uninitialized limbs, left on the root stack for
+// big_finish (or the caller) to pop.
+static Cell *big_alloc(Scheme *sc, size_t n) {
+    if (n > BIG_MAX_LIMBS) {
+        panic(sc, "integer too large");
+    }
+    Cell *c = reserve_cell(sc);
+    unsigned int *digits = (unsigned int *)blob_alloc(sc, n * sizeof(unsigned int));
+    c->type = T_BIGNUM;
+    c->as.big.digits = digits;
+    c->as.big.len = (int)n;
+    return c;
+}
+
+// big_finish: normalize a result from big_alloc and pop its root.
+// Args: sc (interpreter state), c (result cell), neg (sign of the result).
+// Returns: c, or a fixnum when the value fits in one.
+static Cell *big_finish(Scheme *sc, Cell *c, int neg) {
+    size_t cap = (size_t)c->as.big.len;
+    size_t n = cap;
+    unsigned int *d = c->as.big.digits;
+    while (n > 0 && d[n - 1] == 0) {
+        n--;
+    }
+    pop_roots(sc, 1);
+    if (n == 0 || (n == 1 && d[0] <= (neg ? 0x80000000u : 0x7FFFFFFFu))) {
+        int v = n ? (int)(neg ? 0u - d[0] : d[0]) : 0;
+        blob_release(sc, c);
+        c->type = T_INT;
+        c->as.i = v;
+        return c;
+    }
+    // The dropped limbs stay allocated until the cell is freed, uncounted.
+    sc->blob_bytes -= (cap - n) * sizeof(unsigned int);
+    c->as.big.len = neg ? -(int)n : (int)n;
+    return c;
+}
+
+static int limbs_cmp(const unsigned int *a, size_t an, const unsigned int *b, size_t bn) {
+    if (an != bn) {
+        return an < bn ? -1 : 1;
+    }
+    while (an-- > 0) {
+        if (a[an] != b[an]) {
+            return a[an] < b[an] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// limbs_add: r = a + b with an >= bn; r has room for an limbs.
+// Returns: the carry out of the top limb.
+static unsigned int limbs_add(unsigned int *r, const unsigned int *a, size_t an, const unsigned int *b, size_t bn) {
+    unsigned long long carry = 0;
+    size_t i = 0;
+    for (; i < bn; i++) {
+        carry += (unsigned long long)a[i] + b[i];
+        r[i] = (unsigned int)carry;
+        carry >>= 32;
+    }
+    for (; i < an; i++) {
+        carry += a[i];
+        r[i] = (unsigned int)carry;
+        carry >>= 32;
+    }
+    return (unsigned int)carry;
+}
+
+// limbs_sub: r = a - b for a >= b (so an >= bn); r has room for an limbs.
+static void limbs_sub(unsigned int *r, const unsigned int *a, size_t an, const unsigned int *b, size_t bn) {
+    unsigned int borrow = 0;
+    size_t i = 0;
+    for (; i < bn; i++) {
+        unsigned long long d = (unsigned long long)a[i] - b[i] - borrow;
+        r[i] = (unsigned int)d;
+        borrow = (unsigned int)(d >> 32) & 1u;
+    }
+    for (; i < an; i++) {
+        unsigned long long d = (unsigned long long)a[i] - borrow;
+        r[i] = (unsigned int)d;
+        borrow = (unsigned int)(d >> 32) & 1u;
+    }
+}
+
+// limbs_add_into: r += a for an <= rn; the sum must fit in rn limbs.
+static void limbs_add_into(unsigned int *r, size_t rn, const unsigned int *a, size_t an) {
+    unsigned int carry = limbs_add(r, r, an, a, an);
+    for (size_t i = an; carry && i < rn; i++) {
+        carry = ++r[i] == 0;
+    }
+}
+
+// limbs_sub_into: r -= a for an <= rn and r >= a.
+static void limbs_sub_into(unsigned int *r, size_t rn, const unsigned int *a, size_t an) {
+    limbs_sub(r, r, rn, a, an);
+}
+
+// limbs_mul_basic: schoolbook r = a * b; r has room for an + bn limbs.
+static void limbs_mul_basic(unsigned int *r, const unsigned int *a, size_t an, const unsigned int *b, size_t bn) {
+    for (size_t i = 0; i < an + bn; i++) {
+        r[i] = 0;
+    }
+    for (size_t j = 0; j < bn; j++) {
+        unsigned long long carry = 0;
+        unsigned int bj = b[j];
+        if (!bj) {
+            continue;
+        }
+        for (size_t i = 0; i < an; i++) {
+            carry += (unsigned long long)a[i] * bj + r[i + j];
+            r[i + j] = (unsigned int)carry;
+            carry >>= 32;
+        }
+        r[an + j] = (unsigned int)carry;
+    }
+}
+
+// limbs_mul_scratch: scratch limbs limbs_mul needs for an an-by-bn product.
+static size_t limbs_mul_scratch(size_t an, size_t bn) {
+    if (an < bn) {
+        size_t t = an;
+        an = bn;
+        bn = t;
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        return 0;
+    }
+    if (2 * bn <= an) {
+        size_t need = 2 * bn + limbs_mul_scratch(bn, bn);
+        size_t last = an % bn;
+        if (last) {
+            size_t tail = last + bn + limbs_mul_scratch(last, bn);
+            need = tail > need ? tail : need;
+        }
+        return need;
+    }
+    size_t m = an / 2;
+    size_t h = an - m;
+    size_t sbn = (bn - m > m ? bn - m : m) + 1;
+    size_t need = limbs_mul_scratch(h + 1, sbn);
+    size_t z0 = limbs_mul_scratch(m, m);
+    size_t z2 = limbs_mul_scratch(h, bn - m);
+    need = z0 > need ? z0 : need;
+    need = z2 > need ? z2 : need;
+    return 2 * (h + 1) + (h + 1 + sbn) + need;
+}
+
+// limbs_mul: r = a * b, by Karatsuba once both operands reach
+// KARATSUBA_THRESHOLD limbs.
+// Args: r (an + bn limbs, not overlapping the inputs), a/an and b/bn (the
+// operands), t (limbs_mul_scratch(an, bn) limbs of scratch).
+// Returns: none.
+static void limbs_mul(unsigned int *r, const unsigned int *a, size_t an, const unsigned int *b, size_t bn, unsigned int *t) {
+    if (an < bn) {
+        const unsigned int *tp = a;
+        a = b;
+        b = tp;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        limbs_mul_basic(r, a, an, b, bn);
+        return;
+    }
+    if (2 * bn <= an) {
+        // Lopsided: multiply b by bn-limb slices of a.
+        for (size_t i = 0; i < an + bn; i++) {
+            r[i] = 0;
+        }
+        for (size_t i = 0; i < an; i += bn) {
+            size_t c = an - i < bn ? an - i : bn;
+            limbs_mul(t, a + i, c, b, bn, t + c + bn);
+            limbs_add_into(r + i, an + bn - i, t, c + bn);
+        }
+        return;
+    }
+    // a = a1*B^m + a0 and b = b1*B^m + b0, with bn > m so b1 is nonempty:
+    // a*b = z2*B^2m + (z1 - z2 - z0)*B^m + z0 where z1 = (a0+a1)(b0+b1).
+    size_t m = an / 2;
+    size_t h = an - m;
+    unsigned int *sa = t;
+    unsigned int *sb = t + h + 1;
+    unsigned int *z1 = t + 2 * (h + 1);
+    sa[h] = limbs_add(sa, a + m, h, a, m);
+    size_t sbn;
+    if (bn - m >= m) {
+        sbn = bn - m + 1;
+        sb[bn - m] = limbs_add(sb, b + m, bn - m, b, m);
+    } else {
+        sbn = m + 1;
+        sb[m] = limbs_add(sb, b, m, b + m, bn - m);
+    }
+    size_t zn = h + 1 + sbn;
+    unsigned int *next = z1 + zn;
+    limbs_mul(z1, sa, h + 1, sb, sbn, next);
+    limbs_mul(r, a, m, b, m, next);
+    limbs_mul(r + 2 * m, a + m, h, b + m, bn - m, next);
+    limbs_sub_into(z1, zn, r, 2 * m);
+    limbs_sub_into(z1, zn, r + 2 * m, an + bn - 2 * m);
+    // z1's top limbs past the product's width are zero.
+    if (zn > an + bn - m) {
+        zn = an + bn - m;
+    }
+    limbs_add_into(r + m, an + bn - m, z1, zn);
+}
+
+// div_limb: divide the two-limb value hi:lo by d, for hi < d.
+// Args: hi/lo (dividend), d (divisor), rem (receives the remainder).
+// Returns: the quotient limb.
+static unsigned int div_limb(unsigned int hi, unsigned int lo, unsigned int d, unsigned int *rem) {
+#if defined(__i386__)
+    // Without libgcc there is no 64-bit division; divl is exactly this step.
+    unsigned int q;
+    __asm__ ("divl %3" : "=a"(q), "+d"(hi) : "a"(lo), "rm"(d));
+    *rem = hi;
+    return q;
+#else
+    unsigned long long n = ((unsigned long long)hi << 32) | lo;
+    *rem = (unsigned int)(n % d);
+    return (unsigned int)(n / d);
+#endif
+}
+
+// limbs_div_1: q = a / d in place of a's limbs; a may equal q.
+// Returns: the remainder.
+static unsigned int limbs_div_1(unsigned int *q, const unsigned int *a, size_t an, unsigned int d) {
+    unsigned int rem = 0;
+    for (size_t i = an; i-- > 0;) {
+        q[i] = div_limb(rem, a[i], d, &rem);
+    }
+    return rem;
+}
+
+// limbs_divmod: Knuth's algorithm D, q = a / b and r = a % b.
+// Args: q (an - bn + 1 limbs), r (bn limbs), a/an and b/bn (an >= bn >= 1,
+// b[bn - 1] nonzero), t (an + bn + 1 limbs of scratch).
+// Returns: none.
+static void limbs_divmod(unsigned int *q, unsigned int *r, const unsigned int *a, size_t an, const unsigned int *b,
+                         size_t bn, unsigned int *t) {
+    if (bn == 1) {
+        r[0] = limbs_div_1(q, a, an, b[0]);
+        return;
+    }
+    // Shift both so the divisor's top bit is set, which keeps each
+    // quotient estimate within two of the true digit.
+    int s = __builtin_clz(b[bn - 1]);
+    unsigned int *u = t;
+    unsigned int *v = t + an + 1;
+    for (size_t i = bn; i-- > 0;) {
+        v[i] = (b[i] << s) | (s && i ? b[i - 1] >> (32 - s) : 0);
+    }
+    u[an] = s ? a[an - 1] >> (32 - s) : 0;
+    for (size_t i = an; i-- > 0;) {
+        u[i] = (a[i] << s) | (s && i ? a[i - 1] >> (32 - s) : 0);
+    }
+    unsigned int vtop = v[bn - 1];
+    for (size_t j = an - bn + 1; j-- > 0;) {
+        unsigned int qhat;
+        unsigned long long rhat;
+        if (u[j + bn] >= vtop) {
+            qhat = 0xFFFFFFFFu;
+            rhat = (unsigned long long)u[j + bn - 1] + vtop;
+        } else {
+            unsigned int rem;
+            qhat = div_limb(u[j + bn], u[j + bn - 1], vtop, &rem);
+            rhat = rem;
+        }
+        while (rhat < 0x100000000ull &&
+               (unsigned long long)qhat * v[bn - 2] > ((rhat << 32) | u[j + bn - 2])) {
+            qhat--;
+            rhat += vtop;
+        }
+        unsigned long long carry = 0;
+        unsigned int borrow = 0;
+        for (size_t i = 0; i < bn; i++) {
+            carry += (unsigned long long)qhat * v[i];
+            unsigned long long d = (unsigned long long)u[i + j] - (unsigned int)carry - borrow;
+            u[i + j] = (unsigned int)d;
+            borrow = (unsigned int)(d >> 32) & 1u;
+            carry >>= 32;
+        }
+        unsigned long long top = (unsigned long long)u[j + bn] - carry - borrow;
+        u[j + bn] = (unsigned int)top;
+        if (top >> 32) {
+            // The estimate was one too large: add the divisor back.
+            qhat--;
+            u[j + bn] += limbs_add(u + j, u + j, bn, v, bn);
+        }
+        q[j] = qhat;
+    }
+    for (size_t i = 0; i < bn; i++) {
+        r[i] = (u[i] >> s) | (s ? u[i + 1] << (32 - s) : 0);
+    }
+}
+
+// big_add: a + b for fixnums or bignums.
+// Args: sc (interpreter state), a/b (operands; their cells must be rooted).
+// Returns: the sum.
+static Cell *big_add(Scheme *sc, const BigNum *a, const BigNum *b) {
+    if (a->n < b->n || (a->n == b->n && a->neg != b->neg && limbs_cmp(a->d, a->n, b->d, b->n) < 0)) {
+        const BigNum *t = a;
+        a = b;
+        b = t;
+    }
+    // Now |a| >= |b| whenever the signs differ, so a's sign wins.
+    Cell *c = big_alloc(sc, a->n + 1);
+    unsigned int *d = c->as.big.digits;
+    if (a->neg == b->neg) {
+        d[a->n] = limbs_add(d, a->d, a->n, b->d, b->n);
+    } else {
+        limbs_sub(d, a->d, a->n, b->d, b->n);
+        d[a->n] = 0;
+    }
+    return big_finish(sc, c, a->neg);
+}
+
+static Cell *big_sub(Scheme *sc, const BigNum *a, const BigNum *b) {
+    BigNum nb = *b;
+    nb.neg = !b->neg;
+    return big_add(sc, a, &nb);
+}
+
+static Cell *big_mul(Scheme *sc, const BigNum *a, const BigNum *b) {
+    if (!a->n || !b->n) {
+        return make_int(sc, 0);
+    }
+    size_t scratch = limbs_mul_scratch(a->n, b->n);
+    Cell *c = big_alloc(sc, a->n + b->n);
+    Cell *t = scratch ? big_alloc(sc, scratch) : NULL;
+    limbs_mul(c->as.big.digits, a->d, a->n, b->d, b->n, t ? t->as.big.digits : NULL);
+    if (t) {
+        blob_release(sc, t);
+        pop_roots(sc, 1);
+    }
+    return big_finish(sc, c, a->neg != b->neg);
+}
+
+// big_divide: truncated quotient, or the remainder with the divisor's
+// magnitude added when negative (modulo's convention for fixnums).
+// Args: sc (interpreter state), a/b (operands, b nonzero), want_rem (1 for
+// the remainder).
+// Returns: the result.
+static Cell *big_divide(Scheme *sc, const BigNum *a, const BigNum *b, int want_rem) {
+    if (limbs_cmp(a->d, a->n, b->d, b->n) < 0) {
+        if (!want_rem) {
+            return make_int(sc, 0);
+        }
+        Cell *c = big_alloc(sc, b->n + 1);
+        unsigned int *d = c->as.big.digits;
+        if (a->neg && a->n) {
+            limbs_sub(d, b->d, b->n, a->d, a->n);
+        } else {
+            for (size_t i = 0; i < b->n; i++) {
+                d[i] = i < a->n ? a->d[i] : 0;
+            }
+        }
+        d[b->n] = 0;
+        return big_finish(sc, c, 0);
+    }
+    size_t qn = a->n - b->n + 1;
+    Cell *c = big_alloc(sc, want_rem ? b->n : qn);
+    Cell *t = big_alloc(sc, a->n + b->n + 1 + (want_rem ? qn : b->n));
+    unsigned int *scratch = t->as.big.digits;
+    unsigned int *q = want_rem ? scratch + a->n + b->n + 1 : c->as.big.digits;
+    unsigned int *r = want_rem ? c->as.big.digits : scratch + a->n + b->n + 1;
+    limbs_divmod(q, r, a->d, a->n, b->d, b->n, scratch);
+    if (want_rem && a->neg) {
+        size_t rn = b->n;
+        while (rn > 0 && r[rn - 1] == 0) {
+            rn--;
+        }
+        if (rn) {
+            limbs_sub(r, b->d, b->n, r, rn);
+        }
+    }
+    blob_release(sc, t);
+    pop_roots(sc, 1);
+    return big_finish(sc, c, want_rem ? 0 : a->neg != b->neg);
+}
+
+// big_compare: order two fixnums or bignums.
+// Returns: -1, 0 or 1.
+static int big_compare(const BigNum *a, const BigNum *b) {
+    if (a->neg != b->neg && (a->n || b->n)) {
+        return a->neg ? -1 : 1;
+    }
+    int c = limbs_cmp(a->d, a->n, b->d, b->n);
+    return a->neg ? -c : c;
+}
+
+// big_from_decimal: parse a run of decimal digits.
+// Args: sc (interpreter state), p/end (digits only), neg (sign).
+// Returns: the integer, as a fixnum when it fits.
+static Cell *big_from_decimal(Scheme *sc, const char *p, const char *end, int neg) {
+    // Each limb holds at least nine digits.
+    Cell *c = big_alloc(sc, (size_t)(end - p) / 9 + 1);
+    unsigned int *d = c->as.big.digits;
+    size_t n = 0;
+    while (p < end) {
+        unsigned int chunk = 0;
+        unsigned int scale = 1;
+        for (int k = 0; k < 9 && p < end; k++, p++) {
+            chunk = chunk * 10 + (unsigned int)(*p - '0');
+            scale *= 10;
+        }
+        unsigned long long carry = chunk;
+        for (size_t i = 0; i < n; i++) {
+            carry += (unsigned long long)d[i] * scale;
+            d[i] = (unsigned int)carry;
+            carry >>= 32;
+        }
+        if (carry) {
+            d[n++] = (unsigned int)carry;
+        }
+    }
+    for (size_t i = n; i < (size_t)c->as.big.len; i++) {
+        d[i] = 0;
+    }
+    return big_finish(sc, c, neg);
+}
+
+// big_to_string: format a bignum in decimal.
+// Args: sc (interpreter state), v (bignum cell, rooted).
+// Returns: a new string.
+static Cell *big_to_string(Scheme *sc, Cell *v) {
+    BigNum b;
+    big_view(sc, v, &b, "number->string: expected int");
+    // Each limb yields at most ten digits; the text goes after a working
+    // copy of the magnitude.
+    size_t max = b.n * 10 + 1;
+    Cell *t = big_alloc(sc, b.n + (max + sizeof(unsigned int) - 1) / sizeof(unsigned int));
+    unsigned int *w = t->as.big.digits;
+    char *text = (char *)(w + b.n);
+    size_t n = b.n;
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        w[i] = b.d[i];
+    }
+    while (n > 0) {
+        unsigned int rem = limbs_div_1(w, w, n, 1000000000u);
+        while (n > 0 && w[n - 1] == 0) {
+            n--;
+        }
+        for (int k = 0; k < 9 && (n > 0 || rem); k++) {
+            text[len++] = (char)('0' + rem % 10);
+            rem /= 10;
+        }
+    }
+    if (b.neg) {
+        text[len++] = '-';
+    }
+    char *buf = alloc_str_bytes(sc, len);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = text[len - 1 - i];
+    }
+    buf[len] = '\0';
+    blob_release(sc, t);
+    Cell *c = alloc_cell(sc);
+    pop_roots(sc, 1);
+    c->type = T_STRING;
+    c->as.str.data = buf;
+    c->as.str.len = len;
+    return c;
+}
+
+// make_error: allocate an error object.
+// Args: sc (interpreter state), msg (message string), irritants (list).
+// Returns: the error cell.
+static Cell *make_error(Scheme *sc, Cell *msg, Cell *irritants) {
+    Cell *c = cons(sc, msg, irritants);
+    c->type = T_ERROR;
+    return c;
+}
+
+typedef Cell *(*CatchBody)(Scheme *sc, void *data);
+
+// catch_errors: run body with an error handler frame installed.
+// Args: sc (interpreter state), body/data (code to run), result (receives
+// body's value when it returns normally).
+// Returns: NULL if body returned, else the object it raised (an interpreter
+// error becomes an error object), pushed on the root stack for the caller
+// to pop. The root, env and call-site state is back to its value on entry.
+static Cell *catch_errors(Scheme *sc, CatchBody body, void *data, Cell **result) {
+    SchemeCatch frame;
+    frame.prev = sc->catch_top;
+    frame.root_top = sc->root_top;
+    frame.env_top = sc->env_top;
+    frame.env = sc->current_env;
+    frame.call_fn = sc->call_site.fn;
+    frame.call_caller = sc->call_site.caller;
+    sc->catch_top = &frame;
+    if (__builtin_setjmp(frame.jmp)) {
+        sc->catch_top = frame.prev;
+        sc->root_top = frame.root_top;
+        sc->env_top = frame.env_top;
+        sc->current_env = frame.env;
+        sc->call_site.fn = frame.call_fn;
+        sc->call_site.caller = frame.call_caller;
+        if (sc->stop_reason && sc->catch_top) {
+            // A stop passes every handler on its way to the outermost one.
+            panic(sc, sc->stop_reason);
+        }
+        Cell *obj = sc->raised;
+        if (!obj) {
+            size_t len = 0;
+            while (sc->error_msg[len]) {
+                len++;
+            }
+            Cell *msg = make_string_len(sc, sc->error_msg, len);
+            push_root(sc, msg);
+            obj = make_error(sc, msg, scheme_nil(sc));
+            pop_roots(sc, 1);
+        }
+        push_root(sc, obj);
+        sc->raised = NULL;
+        return obj;
+    }
+    *result = body(sc, data);
+    sc->catch_top = frame.prev;
+    return NULL;
+}
+
+static int is_nil(Scheme *sc, Cell *c) { return c == scheme_nil(sc); }
+
+static Cell *car(Cell *c) { return c->as.pair.car; }
+static Cell *cdr(Cell *c) { return c->as.pair.cdr; }
+
+static int streq(const char *a, const char *b) {
+    while (*a && *b) {
+        if (*a != *b) {
+            return 0;
+        }
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static int streq_len(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return a[len] == '\0';
+}
+
+static const char *sym_alloc(Scheme *sc, const char *start, size_t len) {
+    if (sc->sym_buf_used + len + 1 > sc->sym_buf_size &&
+        !arena_grow(sc, &sc->sym_buf, &sc->sym_buf_size, &sc->sym_buf_used, &sc->sym_chunks, len + 1)) {
+        panic(sc, "symbol buffer full");
+    }
+    char *dst = sc->sym_buf + sc->sym_buf_used;
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = start[i];
+    }
+    dst[len] = '\0';
+    sc->sym_buf_used += len + 1;
+    sc->stats.sym_arena_peak += len + 1;
+    return dst;
+}
+
+static unsigned int hash_string(const char *p, size_t len);
+
+#define SYM_INDEX_MIN_CAP 256
+
+static void sym_index_insert(Cell **index, size_t cap, Cell *sym) {
+    const char *name = sym->as.sym.name;
+    size_t len = 0;
+    while (name[len]) {
+        len++;
+    }
+    size_t i = hash_string(name, len) & (cap - 1);
+    while (index[i]) {
+        i = (i + 1) & (cap - 1);
+    }
+    index[i] = sym;
+}
+
+// sym_index_rebuild: index every symbol of the interpreter's own in a table
+// with room for need.
+// Args: sc (interpreter state), need (symbols the table must hold).
+// Returns: none; keeps the current index (or none) if there is no allocator or memory.
+static void sym_index_rebuild(Scheme *sc, size_t need) {
+    if (!sc->platform.alloc || !sc->platform.free) {
+        return;
+    }
+    size_t count = 0;
+    for (Cell *p = sc->interned_syms; p != own_syms_end(sc); p = cdr(p)) {
+        count++;
+    }
+    if (need < count * 2) {
+        need = count * 2;
+    }
+    size_t cap = SYM_INDEX_MIN_CAP;
+    while (cap * 3 < need * 4) {
+        cap *= 2;
+    }
+    Cell **index = (Cell **)sc->platform.alloc(sc->platform.user, cap * sizeof(Cell *));
+    if (!index) {
+        return;
+    }
+    for (size_t i = 0; i < cap; i++) {
+        index[i] = NULL;
+    }
+    for (Cell *p = sc->interned_syms; p != own_syms_end(sc); p = cdr(p)) {
+        sym_index_insert(index, cap, car(p));
+    }
+    if (sc->sym_index) {
+        sc->platform.free(sc->platform.user, sc->sym_index);
+    }
+    sc->sym_index = index;
+    sc->sym_index_cap = cap;
+    sc->sym_count = count;
+}
+
+// sym_find: look a name up among an interpreter's own symbols.
+// Args: sc (interpreter state), start/len (name bytes).
+// Returns: the symbol, or NULL if sc has not interned it.
+static Cell *sym_find(const Scheme *sc, const char *start, size_t len) {
+    if (sc->sym_index) {
+        size_t mask = sc->sym_index_cap - 1;
+        for (size_t i = hash_string(start, len) & mask; sc->sym_index[i]; i = (i + 1) & mask) {
+            if (streq_len(sc->sym_index[i]->as.sym.name, start, len)) {
+                return sc->sym_index[i];
+            }
+        }
+        return NULL;
+    }
+    for (Cell *p = sc->interned_syms; p != own_syms_end(sc); p = p->as.pair.cdr) {
+        Cell *sym = p->as.pair.car;
+        if (streq_len(sym->as.sym.name, start, len)) {
+            return sym;
+        }
+    }
+    return NULL;
+}
+
+// intern_symbol_len: find or create the symbol with the given name.
+// Args: sc (interpreter state), start/len (name bytes).
+// Returns: the unique symbol cell for that name; the shared heap's, if it
+// has one.
+static Cell *intern_symbol_len(Scheme *sc, const char *start, size_t len) {
+    if (!sc->sym_index) {
+        sym_index_rebuild(sc, 0);
+    }
+    Cell *found = sc->shared ? sym_find(sc->shared, start, len) : NULL;
+    if (!found) {
+        found = sym_find(sc, start, len);
+    }
+    if (found) {
+        return found;
+    }
+
+    const char *name = sym_alloc(sc, start, len);
+    Cell *sym = alloc_cell(sc);
+    sym->type = T_SYMBOL;
+    sym->as.sym.name = name;
+    sym->as.sym.global_env = NULL;
+    sym->as.sym.global = NULL;
+
+    push_root(sc, sym);
+    sc->interned_syms = cons(sc, sym, sc->interned_syms);
+    pop_roots(sc, 1);
+
+    if (sc->sym_index) {
+        // The load stays at or below 3/4, so there is always a free slot.
+        sym_index_insert(sc->sym_index, sc->sym_index_cap, sym);
+        sc->sym_count++;
+        if (sc->sym_count * 4 > sc->sym_index_cap * 3) {
+            sym_index_rebuild(sc, sc->sym_count * 2);
+        }
+    }
+    return sym;
+}
+
+static Cell *intern_symbol(Scheme *sc, const char *name) {
+    size_t len = 0;
+    while (name[len]) {
+        len++;
+    }
+    return intern_symbol_len(sc, name, len);
+}
+
+// Reader character classes, indexed by byte. Bytes with no class, including
+// everything above 0x7F, are symbol constituents. NUL ends the text and is a
+// delimiter, so scanning loops stop at it without a separate check.
+#define CC_SPACE 1
+#define CC_DELIM 2
+#define CC_DIGIT 4
+
+static const unsigned char char_class[256] = {
+    [0] = CC_DELIM,
+    [' '] = CC_SPACE | CC_DELIM,
+    ['\t'] = CC_SPACE | CC_DELIM,
+    ['\n'] = CC_SPACE | CC_DELIM,
+    ['\r'] = CC_SPACE | CC_DELIM,
+    ['('] = CC_DELIM,
+    [')'] = CC_DELIM,
+    ['"'] = CC_DELIM,
+    [';'] = CC_DELIM,
+    ['0'] = CC_DIGIT,
+    ['1'] = CC_DIGIT,
+    ['2'] = CC_DIGIT,
+    ['3'] = CC_DIGIT,
+    ['4'] = CC_DIGIT,
+    ['5'] = CC_DIGIT,
+    ['6'] = CC_DIGIT,
+    ['7'] = CC_DIGIT,
+    ['8'] = CC_DIGIT,
+    ['9'] = CC_DIGIT,
+};
+
+// Reader state. Error positions are computed from start only when an error
+// is reported, so the scanning loops track nothing but the cursor.
+typedef struct Reader {
+    const char *start;
+    const char *p;
+} Reader;
+
+static void reader_init(Reader *rd, const char *text) {
+    rd->start = text;
+    rd->p = text;
+}
+
+static size_t append_text(char *buf, size_t len, size_t cap, const char *s) {
+    while (*s && len + 1 < cap) {
+        buf[len++] = *s++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static size_t append_uint(char *buf, size_t len, size_t cap, size_t n) {
+    char tmp[20];
+    size_t k = 0;
+    do {
+        tmp[k++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+    while (k && len + 1 < cap) {
+        buf[len++] = tmp[--k];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+// reader_error: report a syntax error with its line and column.
+// Args: sc (interpreter state), rd (reader), at (offending position), msg.
+// Returns: never.
+static void reader_error(Scheme *sc, Reader *rd, const char *at, const char *msg) {
+    size_t line = 1;
+    size_t col = 1;
+    for (const char *q = rd->start; q < at; q++) {
+        if (*q == '\n') {
+            line++;
+            col = 1;
+        } else {
+            col++;
+        }
+    }
+    char buf[128];
+    size_t len = append_text(buf, 0, sizeof(buf), "parse error at line ");
+    len = append_uint(buf, len, sizeof(buf), line);
+    len = append_text(buf, len, sizeof(buf), ", column ");
+    len = append_uint(buf, len, sizeof(buf), col);
+    len = append_text(buf, len, sizeof(buf), ": ");
+    append_text(buf, len, sizeof(buf), msg);
+    panic(sc, buf);
+}
+
+// skip_ws: move past whitespace and ; comments.
+static void skip_ws(Reader *rd) {
+    const unsigned char *p = (const unsigned char *)rd->p;
+    for (;;) {
+        while (char_class[*p] & CC_SPACE) {
+            p++;
+        }
+        if (*p != ';') {
+            break;
+        }
+        while (*p && *p != '\n') {
+            p++;
+        }
+    }
+    rd->p = (const char *)p;
+}
+
+// scan_token: find the end of the run of constituents starting at s.
+// Four class lookups per iteration; each stops at the first delimiter, so
+// nothing past the terminating NUL is read.
+static const char *scan_token(const char *s) {
+    const unsigned char *p = (const unsigned char *)s;
+    for (;; p += 4) {
+        if (char_class[p[0]] & CC_DELIM) {
+            return (const char *)p;
+        }
+        if (char_class[p[1]] & CC_DELIM) {
+            return (const char *)p + 1;
+        }
+        if (char_class[p[2]] & CC_DELIM) {
+            return (const char *)p + 2;
+        }
+        if (char_class[p[3]] & CC_DELIM) {
+            return (const char *)p + 3;
+        }
+    }
+}
+
+static Cell *read_expr(Scheme *sc, Reader *rd);
+static int eval_string_in_env(Scheme *sc, const char *input, Cell *env);
+
+// read_list: read list items up to the closing parenthesis.
+// Args: sc (interpreter state), rd (reader, just past the '('), open (the '(').
+// Returns: the list.
+static Cell *read_list(Scheme *sc, Reader *rd, const char *open) {
+    Cell *head = NULL;
+    Cell *tail = NULL;
+
+    for (;;) {
+        skip_ws(rd);
+        if (*rd->p == ')') {
+            rd->p++;
+            break;
+        }
+        if (*rd->p == '\0') {
+            reader_error(sc, rd, open, "unterminated list");
+        }
+        Cell *item = read_expr(sc, rd);
+
+        push_root(sc, item);
+        Cell *node = cons(sc, item, scheme_nil(sc));
+        pop_roots(sc, 1);
+        if (!head) {
+            head = node;
+            // Keep the partially read list alive while later items allocate.
+            push_root(sc, head);
+        } else {
+            gc_write_barrier(sc, tail, node);
+            tail->as.pair.cdr = node;
+        }
+        tail = node;
+    }
+
+    if (head) {
+        pop_roots(sc, 1);
+    }
+    return head ? head : scheme_nil(sc);
+}
+
+// read_atom: classify a token as an integer or a symbol.
+// Args: sc (interpreter state), start/end (the token).
+// Returns: an integer for an optional '-' followed by digits, else a symbol.
+static Cell *read_atom(Scheme *sc, const char *start, const char *end) {
+    const char *p = start;
+    int negative = *p == '-';
+    if (negative) {
+        p++;
+    }
+    if (p == end) {
+        return intern_symbol_len(sc, start, (size_t)(end - start));
+    }
+    // Magnitudes up to 2^31 fit before the sign is applied; anything
+    // larger becomes a bignum.
+    unsigned int limit = negative ? 2147483648u : 2147483647u;
+    unsigned int value = 0;
+    int big = 0;
+    for (const char *q = p; q < end; q++) {
+        if (!(char_class[(unsigned char)*q] & CC_DIGIT)) {
+            return intern_symbol_len(sc, start, (size_t)(end - start));
+        }
+        unsigned int digit = (unsigned int)(*q - '0');
+        if (value > (limit - digit) / 10) {
+            big = 1;
+        }
+        value = value * 10 + digit;
+    }
+    if (big) {
+        return big_from_decimal(sc, p, end, negative);
+    }
+    return make_int(sc, negative ? (int)(0u - value) : (int)value);
+}
+
+static Cell *read_string(Scheme *sc, Reader *rd) {
+    const char *open = rd->p;
+    const char *p = open + 1;
+    while (*p && *p != '"') {
+        p++;
+    }
+    if (*p != '"') {
+        reader_error(sc, rd, open, "unterminated string literal");
+    }
+    rd->p = p + 1;
+    return make_string_len(sc, open + 1, (size_t)(p - open - 1));
+}
+
+// read_hash: read #t, #f or a #\ character literal.
+static Cell *read_hash(Scheme *sc, Reader *rd) {
+    const char *at = rd->p;
+    if (at[1] == '\\' && at[2] != '\0') {
+        // The first character may itself be a delimiter, as in #\( or #\ .
+        const char *start = at + 2;
+        const char *end = scan_token(start + 1);
+        size_t len = (size_t)(end - start);
+        rd->p = end;
+        if (len == 1) {
+            return make_char(sc, (unsigned char)start[0]);
+        }
+        if (len == 7 && streq_len("newline", start, len)) {
+            return make_char(sc, '\n');
+        }
+        if (len == 6 && streq_len("return", start, len)) {
+            return make_char(sc, '\r');
+        }
+        if (len == 5 && streq_len("space", start, len)) {
+            return make_char(sc, ' ');
+        }
+        if (len == 3 && streq_len("tab", start, len)) {
+            return make_char(sc, '\t');
+        }
+        reader_error(sc, rd, at, "invalid character literal");
+    }
+    const char *end = scan_token(at + 1);
+    if (end == at + 2 && (at[1] == 't' || at[1] == 'f')) {
+        rd->p = end;
+        return at[1] == 't' ? scheme_true(sc) : scheme_false(sc);
+    }
+    reader_error(sc, rd, at, "invalid # syntax");
+    return scheme_nil(sc);
+}
+
+// read_expr: parse a single expression from the reader.
+// Args: sc (interpreter state), rd (reader).
+// Returns: parsed expression cell, or NULL at end of input.
+static Cell *read_expr(Scheme *sc, Reader *rd) {
+    skip_ws(rd);
+    const char *at = rd->p;
+    switch (*at) {
+        case '\0':
+            return NULL;
+        case '(':
+            rd->p++;
+            return read_list(sc, rd, at);
+        case ')':
+            reader_error(sc, rd, at, "unexpected )");
+            return NULL;
+        case '\'': {
+            rd->p++;
+            Cell *expr = read_expr(sc, rd);
+            if (!expr) {
+                reader_error(sc, rd, at, "nothing to quote");
+            }
+            push_root(sc, expr);
+            Cell *quote_sym = intern_symbol(sc, "quote");
+            Cell *tail = cons(sc, expr, scheme_nil(sc));
+            push_root(sc, tail);
+            Cell *res = cons(sc, quote_sym, tail);
+            pop_roots(sc, 2);
+            return res;
+        }
+        case '"':
+            return read_string(sc, rd);
+        case '#':
+            return read_hash(sc, rd);
+        default: {
+            const char *end = scan_token(at);
+            rd->p = end;
+            return read_atom(sc, at, end);
+        }
+    }
+}
+
+static Cell *frame_binding(Scheme *sc, Cell *frame, Cell *sym) {
+    for (; !is_nil(sc, frame); frame = cdr(frame)) {
+        Cell *binding = car(frame);
+        if (car(binding) == sym) {
+            return binding;
+        }
+    }
+    return NULL;
+}
+
+static size_t shared_slot(const Cell *sym) {
+    return ((size_t)sym / sizeof(Cell)) & (SCHEME_SHARED_CACHE - 1);
+}
+
+// shared_binding: find a symbol of the shared heap in an outermost frame.
+// Args: sc (interpreter state), env (outermost environment), sym (shared symbol).
+// Returns: the (symbol . value) pair, or NULL if unbound.
+// scheme_freeze fixed sym's own cache to its binding in the shared
+// environment, whose frame is the tail of sc's global frame; the binding sc's
+// global environment gives it is cached in sc->shared_syms instead, and
+// env_define refreshes that entry.
+static Cell *shared_binding(Scheme *sc, Cell *env, Cell *sym) {
+    if (sym->as.sym.global_env == env) {
+        return sym->as.sym.global;
+    }
+    size_t slot = shared_slot(sym);
+    if (env == sc->global_env && sc->shared_syms[slot] == sym) {
+        return sc->shared_bindings[slot];
+    }
+    Cell *binding = NULL;
+    Cell *p = car(env);
+    for (; p->mark != MARK_FROZEN; p = p->as.pair.cdr) {
+        if (car(p->as.pair.car) == sym) {
+            binding = p->as.pair.car;
+            break;
+        }
+    }
+    if (!binding && p->type == T_PAIR) {
+        // The frame went on into the shared one.
+        binding = sym->as.sym.global;
+    }
+    if (env == sc->global_env) {
+        sc->shared_syms[slot] = sym;
+        sc->shared_bindings[slot] = binding;
+    }
+    return binding;
+}
+
+// env_binding: find the innermost binding of a symbol.
+// Args: sc (interpreter state), env (environment), sym (name).
+// Returns: the (symbol . value) pair, or NULL if unbound.
+// Local frames are short and searched every time; the outermost frame,
+// which holds every global, is skipped while sym's cached binding is for
+// the same environment. Bindings are never removed and set! updates them
+// in place, so only a define in that frame can make the cache stale, and
+// env_define refreshes it.
+static Cell *env_binding(Scheme *sc, Cell *env, Cell *sym) {
+    for (; !is_nil(sc, env); env = cdr(env)) {
+        if (!is_nil(sc, cdr(env))) {
+            Cell *binding = frame_binding(sc, car(env), sym);
+            if (binding) {
+                return binding;
+            }
+            continue;
+        }
+        if (sym->type != T_SYMBOL) {
+            return frame_binding(sc, car(env), sym);
+        }
+        if (sym->mark == MARK_FROZEN) {
+            return shared_binding(sc, env, sym);
+        }
+        if (sym->as.sym.global_env != env) {
+            Cell *binding = frame_binding(sc, car(env), sym);
+            if (!binding) {
+                return NULL;
+            }
+            sym->as.sym.global_env = env;
+            sym->as.sym.global = binding;
+        }
+        return sym->as.sym.global;
+    }
+    return NULL;
+}
+
+static Cell *env_lookup(Scheme *sc, Cell *env, Cell *sym) {
+    Cell *binding = env_binding(sc, env, sym);
+    return binding ? cdr(binding) : NULL;
+}
+
+static void env_define(Scheme *sc, Cell *env, Cell *sym, Cell *val) {
+    if (env->mark == MARK_FROZEN) {
+        panic(sc, "define: shared environment is read-only");
+    }
+    Cell *frame = car(env);
+    push_root(sc, frame);
+    push_root(sc, sym);
+    push_root(sc, val);
+    Cell *binding = cons(sc, sym, val);
+    push_root(sc, binding);
+    frame = cons(sc, binding, frame);
+    gc_write_barrier(sc, env, frame);
+    env->as.pair.car = frame;
+    pop_roots(sc, 4);
+    // A new global shadows the one sym may have cached.
+    if (sym->type != T_SYMBOL) {
+        return;
+    }
+    if (sym->mark == MARK_FROZEN) {
+        if (env == sc->global_env) {
+            sc->shared_syms[shared_slot(sym)] = sym;
+            sc->shared_bindings[shared_slot(sym)] = binding;
+        }
+    } else if (sym->as.sym.global_env == env) {
+        sym->as.sym.global = binding;
+    }
+}
+
+static int env_set(Scheme *sc, Cell *env, Cell *sym, Cell *val) {
+    Cell *binding = env_binding(sc, env, sym);
+    if (!binding) {
+        return 0;
+    }
+    if (binding->mark == MARK_FROZEN) {
+        // Setting a global of the shared environment defines this
+        // interpreter's own in its place; other shared bindings are fixed.
+        if (sym->as.sym.global != binding) {
+            panic(sc, "set!: shared binding is read-only");
+        }
+        env_define(sc, sc->global_env, sym, val);
+        return 1;
+    }
+    gc_write_barrier(sc, binding, val);
+    binding->as.pair.cdr = val;
+    return 1;
+}
+
+static Cell *eval(Scheme *sc, Cell *expr, Cell *env);
+
+// eval_list: evaluate each element of a list in order.
+// Args: sc (interpreter state), list (list of expressions), env (environment).
+// Returns: list of evaluated values.
+static Cell *eval_list(Scheme *sc, Cell *list, Cell *env) {
+    if (is_nil(sc, list)) {
+        return scheme_nil(sc);
+    }
+    Cell *head = NULL;
+    Cell *tail = NULL;
+    while (!is_nil(sc, list)) {
+        int pushed_head = 0;
+        if (head) {
+            push_root(sc, head);
+            pushed_head = 1;
+        }
+        Cell *val = eval(sc, car(list), env);
+        push_root(sc, val);
+        Cell *node = cons(sc, val, scheme_nil(sc));
+        if (!head) {
+            head = node;
+            tail = node;
+        } else {
+            gc_write_barrier(sc, tail, node);
+            tail->as.pair.cdr = node;
+            tail = node;
+        }
+        pop_roots(sc, pushed_head ? 2 : 1);
+        list = cdr(list);
+    }
+    return head ? head : scheme_nil(sc);
+}
+
+// apply: apply a primitive or closure to evaluated arguments.
+// Args: sc (interpreter state), fn (function), args (argument list).
+// Returns: result cell.
+static Cell *apply(Scheme *sc, Cell *fn, Cell *args) {
+    if (fn->type == T_PRIMITIVE) {
+        push_root(sc, fn);
+        push_root(sc, args);
+        Cell *result = fn->as.prim.fn(sc, args);
+        pop_roots(sc, 2);
+        return result;
+    }
+    if (fn->type == T_CLOSURE) {
+        push_root(sc, fn);
+        push_root(sc, args);
+        Cell *new_env = cons(sc, scheme_nil(sc), fn->as.closure.env);
+        Cell *prev_env = sc->current_env;
+        sc->current_env = new_env;
+        env_stack_push(sc, new_env);
+        Cell *params = fn->as.closure.params;
+        Cell *vals = args;
+        while (!is_nil(sc, params) && !is_nil(sc, vals)) {
+            env_define(sc, new_env, car(params), car(vals));
+            params = cdr(params);
+            vals = cdr(vals);
+        }
+        pop_roots(sc, 1);
+        Cell *body = fn->as.closure.body;
+        Cell *result = scheme_nil(sc);
+        while (!is_nil(sc, body)) {
+            result = eval(sc, car(body), new_env);
+            body = cdr(body);
+        }
+        env_stack_pop(sc);
+        sc->current_env = prev_env;
+        pop_roots(sc, 1);
+        return result;
+    }
+    panic(sc, "attempt to call non-function");
+    return scheme_nil(sc);
+}
+
+static int is_symbol(Cell *c, const char *name) {
+    return c->type == T_SYMBOL && streq(c->as.sym.name, name);
+}
+
+static void unbound_error(Scheme *sc, const char *msg, Cell *sym) {
+    char buf[SCHEME_ERROR_MAX];
+    size_t len = append_text(buf, 0, sizeof(buf), msg);
+    append_text(buf, len, sizeof(buf), sym->type == T_SYMBOL ? sym->as.sym.name : "?");
+    panic(sc, buf);
+}
+
+typedef struct EvalBody {
+    Cell *body;
+    Cell *env;
+} EvalBody;
+
+static Cell *eval_body(Scheme *sc, void *data) {
+    EvalBody *b = (EvalBody *)data;
+    Cell *result = scheme_nil(sc);
+    for (Cell *seq = b->body; !is_nil(sc, seq); seq = cdr(seq)) {
+        result = eval(sc, car(seq), b->env);
+    }
+    return result;
+}
+
+// eval_guard: (guard (var clause ...) body ...). If body raises, var is
+// bound to the raised object and the first clause whose test is true (or
+// an else clause) supplies the value; with no match the object is raised
+// again. A clause without expressions yields its test's value.
+// Args: sc (interpreter state), expr (the guard form), env (environment).
+// Returns: result cell.
+static Cell *eval_guard(Scheme *sc, Cell *expr, Cell *env) {
+    Cell *spec = car(cdr(expr));
+    if (spec->type != T_PAIR || car(spec)->type != T_SYMBOL) {
+        panic(sc, "guard: expected (var clause ...)");
+    }
+    EvalBody b = {cdr(cdr(expr)), env};
+    Cell *result;
+    Cell *obj = catch_errors(sc, eval_body, &b, &result);
+    if (!obj) {
+        return result;
+    }
+    Cell *handler_env = cons(sc, scheme_nil(sc), env);
+    push_root(sc, handler_env);
+    env_define(sc, handler_env, car(spec), obj);
+    for (Cell *clauses = cdr(spec); clauses->type == T_PAIR; clauses = cdr(clauses)) {
+        Cell *clause = car(clauses);
+        if (clause->type != T_PAIR) {
+            panic(sc, "guard: invalid clause");
+        }
+        Cell *test = is_symbol(car(clause), "else") ? scheme_true(sc) : eval(sc, car(clause), handler_env);
+        if (test != scheme_false(sc)) {
+            b.body = cdr(clause);
+            b.env = handler_env;
+            result = is_nil(sc, b.body) ? test : eval_body(sc, &b);
+            pop_roots(sc, 2);
+            // handler_env is unrooted now; apply and catch_errors restore
+            // current_env from saved copies, so it must not stay there.
+            sc->current_env = env;
+            return result;
+        }
+    }
+    pop_roots(sc, 2);
+    raise_value(sc, obj);
+    return scheme_nil(sc);
+}
+
+// eval: evaluate an expression in the given environment.
+// Args: sc (interpreter state), expr (expression), env (environment).
+// Returns: result cell.
+static Cell *eval(Scheme *sc, Cell *expr, Cell *env) {
+    sc->current_env = env;
+    if (!expr) {
+        return scheme_nil(sc);
+    }
+    switch (expr->type) {
+        case T_INT:
+        case T_BOOL:
+        case T_STRING:
+        case T_CHAR:
+        case T_PRIMITIVE:
+        case T_CLOSURE:
+            return expr;
+        case T_SYMBOL: {
+            Cell *val = env_lookup(sc, env, expr);
+            if (!val) {
+                unbound_error(sc, "unbound symbol: ", expr);
+            }
+            return val;
+        }
+        case T_PAIR: {
+            Cell *op = car(expr);
+            if (is_symbol(op, "quote")) {
+                return car(cdr(expr));
+            }
+            if (is_symbol(op, "if")) {
+                Cell *test = eval(sc, car(cdr(expr)), env);
+                if (test != scheme_false(sc)) {
+                    return eval(sc, car(cdr(cdr(expr))), env);
+                }
+                return eval(sc, car(cdr(cdr(cdr(expr)))), env);
+            }
+            if (is_symbol(op, "begin")) {
+                Cell *seq = cdr(expr);
+                Cell *result = scheme_nil(sc);
+                while (!is_nil(sc, seq)) {
+                    result = eval(sc, car(seq), env);
+                    seq = cdr(seq);
+                }
+                return result;
+            }
+            if (is_symbol(op, "define")) {
+                Cell *name = car(cdr(expr));
+                if (name->type == T_PAIR) {
+                    Cell *fname = car(name);
+                    Cell *params = cdr(name);
+                    Cell *body = cdr(cdr(expr));
+                    Cell *closure = make_closure(sc, params, body, env);
+                    env_define(sc, env, fname, closure);
+                    return fname;
+                } else {
+                    Cell *value = eval(sc, car(cdr(cdr(expr))), env);
+                    env_define(sc, env, name, value);
+                    return name;
+                }
+            }
+            if (is_symbol(op, "set!")) {
+                Cell *name = car(cdr(expr));
+                Cell *value = eval(sc, car(cdr(cdr(expr))), env);
+                if (!env_set(sc, env, name, value)) {
+                    unbound_error(sc, "set!: unbound symbol: ", name);
+                }
+                return value;
+            }
+            if (is_symbol(op, "lambda")) {
+                Cell *params = car(cdr(expr));
+                Cell *body = cdr(cdr(expr));
+                return make_closure(sc, params, body, env);
+            }
+            if (is_symbol(op, "guard")) {
+                return eval_guard(sc, expr, env);
+            }
+
+            check_stop(sc);
+            Cell *fn = eval(sc, op, env);
+            Cell *operands = cdr(expr);
+            PrimFn1 fn1 = NULL;
+            PrimFn2 fn2 = NULL;
+            if (fn->type == T_PRIMITIVE && operands->type == T_PAIR) {
+                Cell *more = cdr(operands);
+                if (is_nil(sc, more)) {
+                    fn1 = fn->as.prim.fn1;
+                } else if (more->type == T_PAIR && is_nil(sc, cdr(more))) {
+                    fn2 = fn->as.prim.fn2;
+                }
+            }
+            Cell *a = NULL;
+            Cell *b = NULL;
+            Cell *args = NULL;
+            if (fn1 || fn2) {
+                // Operands stay on the root stack instead of in a list.
+                a = eval(sc, car(operands), env);
+                push_root(sc, a);
+                if (fn2) {
+                    b = eval(sc, car(cdr(operands)), env);
+                    push_root(sc, b);
+                }
+            } else {
+                push_root(sc, fn);
+                args = eval_list(sc, operands, env);
+            }
+            // Publish the call for the profiler; caller before callee so a
+            // sample taken in between never pairs a callee with itself.
+            const char *outer_fn = sc->call_site.fn;
+            const char *outer_caller = sc->call_site.caller;
+            sc->call_site.caller = outer_fn;
+            sc->call_site.fn = op->type == T_SYMBOL ? op->as.sym.name : "<lambda>";
+            Cell *result;
+            if (fn2) {
+                result = fn2(sc, a, b);
+                pop_roots(sc, 2);
+            } else if (fn1) {
+                result = fn1(sc, a);
+                pop_roots(sc, 1);
+            } else if (fn->type == T_PRIMITIVE) {
+                // Call it directly: only args needs to stay rooted, so it
+                // takes fn's slot instead of going through apply.
+                sc->root_stack[sc->root_top - 1] = args;
+                result = fn->as.prim.fn(sc, args);
+                pop_roots(sc, 1);
+            } else {
+                pop_roots(sc, 1);
+                result = apply(sc, fn, args);
+            }
+            sc->call_site.fn = outer_fn;
+            sc->call_site.caller = outer_caller;
+            return result;
+        }
+        default:
+            return expr;
+    }
+}
+
+typedef Cell *(*BigOp)(Scheme *sc, const BigNum *a, const BigNum *b);
+
+// arith_fold: finish a +, - or * in general arithmetic once the fixnum
+// loop meets an overflow or a bignum.
+// Args: sc (interpreter state), op (operation), acc (result so far),
+// rest (remaining operands, rooted), who (error message for non-numbers).
+// Returns: the result.
+static Cell *arith_fold(Scheme *sc, BigOp op, Cell *acc, Cell *rest, const char *who) {
+    for (; !is_nil(sc, rest); rest = cdr(rest)) {
+        BigNum a;
+        BigNum b;
+        push_root(sc, acc);
+        big_view(sc, acc, &a, who);
+        big_view(sc, car(rest), &b, who);
+        acc = op(sc, &a, &b);
+        pop_roots(sc, 1);
+    }
+    return acc;
+}
+
+// The fixnum loops below test for overflow with the CPU's flags
+// (__builtin_*_overflow) and hand off to arith_fold only when it fires
+// or a bignum shows up.
+static Cell *prim_add(Scheme *sc, Cell *args) {
+    int sum = 0;
+    for (; !is_nil(sc, args); args = cdr(args)) {
+        Cell *x = car(args);
+        int next;
+        if (x->type != T_INT || __builtin_add_overflow(sum, x->as.i, &next)) {
+            return arith_fold(sc, big_add, make_int(sc, sum), args, "+: expected number");
+        }
+        sum = next;
+    }
+    return make_int(sc, sum);
+}
+
+static Cell *prim_sub(Scheme *sc, Cell *args) {
+    if (is_nil(sc, args)) {
+        return make_int(sc, 0);
+    }
+    Cell *first = car(args);
+    Cell *rest = cdr(args);
+    if (is_nil(sc, rest)) {
+        if (first->type == T_INT && first->as.i != (int)0x80000000u) {
+            return make_int(sc, -first->as.i);
+        }
+        return arith_fold(sc, big_sub, make_int(sc, 0), args, "-: expected number");
+    }
+    if (first->type != T_INT) {
+        return arith_fold(sc, big_sub, first, rest, "-: expected number");
+    }
+    int result = first->as.i;
+    for (; !is_nil(sc, rest); rest = cdr(rest)) {
+        Cell *x = car(rest);
+        int next;
+        if (x->type != T_INT || __builtin_sub_overflow(result, x->as.i, &next)) {
+            return arith_fold(sc, big_sub, make_int(sc, result), rest, "-: expected number");
+        }
+        result = next;
+    }
+    return make_int(sc, result);
+}
+
+static Cell *prim_mul(Scheme *sc, Cell *args) {
+    int result = 1;
+    for (; !is_nil(sc, args); args = cdr(args)) {
+        Cell *x = car(args);
+        int next;
+        if (x->type != T_INT || __builtin_mul_overflow(result, x->as.i, &next)) {
+            return arith_fold(sc, big_mul, make_int(sc, result), args, "*: expected number");
+        }
+        result = next;
+    }
+    return make_int(sc, result);
+}
+
+// arith2: apply a bignum operation to two numbers.
+// Args: sc (interpreter state), op (operation), x/y (operands, rooted),
+// who (error message for non-numbers).
+// Returns: the result.
+static Cell *arith2(Scheme *sc, BigOp op, Cell *x, Cell *y, const char *who) {
+    BigNum a;
+    BigNum b;
+    big_view(sc, x, &a, who);
+    big_view(sc, y, &b, who);
+    return op(sc, &a, &b);
+}
+
+// Two-argument forms of +, - and *, called by eval without an argument list.
+static Cell *add2(Scheme *sc, Cell *x, Cell *y) {
+    int r;
+    if (x->type == T_INT && y->type == T_INT && !__builtin_add_overflow(x->as.i, y->as.i, &r)) {
+        return make_int(sc, r);
+    }
+    return arith2(sc, big_add, x, y, "+: expected number");
+}
+
+static Cell *sub2(Scheme *sc, Cell *x, Cell *y) {
+    int r;
+    if (x->type == T_INT && y->type == T_INT && !__builtin_sub_overflow(x->as.i, y->as.i, &r)) {
+        return make_int(sc, r);
+    }
+    return arith2(sc, big_sub, x, y, "-: expected number");
+}
+
+static Cell *mul2(Scheme *sc, Cell *x, Cell *y) {
+    int r;
+    if (x->type == T_INT && y->type == T_INT && !__builtin_mul_overflow(x->as.i, y->as.i, &r)) {
+        return make_int(sc, r);
+    }
+    return arith2(sc, big_mul, x, y, "*: expected number");
+}
+
+// num_compare: order two numbers.
+// Args: sc (interpreter state), x/y (numbers), who (error message).
+// Returns: -1, 0 or 1.
+static int num_compare(Scheme *sc, Cell *x, Cell *y, const char *who) {
+    if (x->type == T_INT && y->type == T_INT) {
+        return (x->as.i > y->as.i) - (x->as.i < y->as.i);
+    }
+    BigNum a;
+    BigNum b;
+    big_view(sc, x, &a, who);
+    big_view(sc, y, &b, who);
+    return big_compare(&a, &b);
+}
+
+// Comparison outcomes accepted by num_chain, as bits indexed by
+// num_compare's result + 1.
+#define CMP_LT 1
+#define CMP_EQ 2
+#define CMP_GT 4
+
+// num_chain: test that each adjacent pair of arguments compares as allowed.
+// Args: sc (interpreter state), args (numbers), allowed (CMP_* bits), who
+// (error message).
+// Returns: #t or #f.
+static Cell *num_chain(Scheme *sc, Cell *args, int allowed, const char *who) {
+    int ok = 1;
+    for (; !is_nil(sc, args) && !is_nil(sc, cdr(args)); args = cdr(args)) {
+        if (!(allowed & (1 << (num_compare(sc, car(args), car(cdr(args)), who) + 1)))) {
+            ok = 0;
+        }
+    }
+    return make_bool(sc, ok);
+}
+
+static Cell *prim_lt(Scheme *sc, Cell *args) {
+    return num_chain(sc, args, CMP_LT, "<: expected number");
+}
+
+static Cell *prim_gt(Scheme *sc, Cell *args) {
+    return num_chain(sc, args, CMP_GT, ">: expected number");
+}
+
+static Cell *prim_le(Scheme *sc, Cell *args) {
+    return num_chain(sc, args, CMP_LT | CMP_EQ, "<=: expected number");
+}
+
+static Cell *prim_ge(Scheme *sc, Cell *args) {
+    return num_chain(sc, args, CMP_GT | CMP_EQ, ">=: expected number");
+}
+
+static Cell *prim_num_eq(Scheme *sc, Cell *args) {
+    return num_chain(sc, args, CMP_EQ, "=: expected number");
+}
+
+// Two-argument comparisons; fixnums never reach num_compare.
+static Cell *lt2(Scheme *sc, Cell *x, Cell *y) {
+    if (x->type == T_INT && y->type == T_INT) {
+        return make_bool(sc, x->as.i < y->as.i);
+    }
+    return make_bool(sc, num_compare(sc, x, y, "<: expected number") < 0);
+}
+
+static Cell *gt2(Scheme *sc, Cell *x, Cell *y) {
+    if (x->type == T_INT && y->type == T_INT) {
+        return make_bool(sc, x->as.i > y->as.i);
+    }
+    return make_bool(sc, num_compare(sc, x, y, ">: expected number") > 0);
+}
+
+static Cell *le2(Scheme *sc, Cell *x, Cell *y) {
+    if (x->type == T_INT && y->type == T_INT) {
+        return make_bool(sc, x->as.i <= y->as.i);
+    }
+    return make_bool(sc, num_compare(sc, x, y, "<=: expected number") <= 0);
+}
+
+static Cell *ge2(Scheme *sc, Cell *x, Cell *y) {
+    if (x->type == T_INT && y->type == T_INT) {
+        return make_bool(sc, x->as.i >= y->as.i);
+    }
+    return make_bool(sc, num_compare(sc, x, y, ">=: expected number") >= 0);
+}
+
+static Cell *num_eq2(Scheme *sc, Cell *x, Cell *y) {
+    if (x->type == T_INT && y->type == T_INT) {
+        return make_bool(sc, x->as.i == y->as.i);
+    }
+    return make_bool(sc, num_compare(sc, x, y, "=: expected number") == 0);
+}
+
+// num_divide: general path of quotient and modulo.
+// Args: sc (interpreter state), x/y (dividend and divisor), want_rem (1 for
+// modulo), who (error message for non-numbers).
+// Returns: the result.
+static Cell *num_divide(Scheme *sc, Cell *x, Cell *y, int want_rem, const char *who) {
+    BigNum a;
+    BigNum b;
+    big_view(sc, x, &a, who);
+    big_view(sc, y, &b, who);
+    if (!b.n) {
+        panic(sc, want_rem ? "modulo: divide by zero" : "quotient: divide by zero");
+    }
+    return big_divide(sc, &a, &b, want_rem);
+}
+
+static Cell *quotient2(Scheme *sc, Cell *x, Cell *y) {
+    // -1 is left to the general path: INT_MIN / -1 overflows.
+    if (x->type == T_INT && y->type == T_INT && y->as.i != 0 && y->as.i != -1) {
+        return make_int(sc, x->as.i / y->as.i);
+    }
+    return num_divide(sc, x, y, 0, "quotient: expected number");
+}
+
+static Cell *modulo2(Scheme *sc, Cell *x, Cell *y) {
+    if (x->type == T_INT && y->type == T_INT && y->as.i != 0 && y->as.i != -1) {
+        int b = y->as.i;
+        int r = x->as.i % b;
+        if (r < 0) {
+            r = (int)((unsigned int)r + (b < 0 ? 0u - (unsigned int)b : (unsigned int)b));
+        }
+        return make_int(sc, r);
+    }
+    return num_divide(sc, x, y, 1, "modulo: expected number");
+}
+
+static Cell *prim_quotient(Scheme *sc, Cell *args) {
+    return quotient2(sc, car(args), car(cdr(args)));
+}
+
+static Cell *prim_modulo(Scheme *sc, Cell *args) {
+    return modulo2(sc, car(args), car(cdr(args)));
+}
+
+static Cell *not1(Scheme *sc, Cell *x) {
+    return make_bool(sc, x == scheme_false(sc));
+}
+
+static Cell *zerop1(Scheme *sc, Cell *x) {
+    if (x->type != T_INT && x->type != T_BIGNUM) {
+        panic(sc, "zero?: expected number");
+    }
+    return make_bool(sc, x->type == T_INT && x->as.i == 0);
+}
+
+static Cell *one_plus1(Scheme *sc, Cell *x) {
+    int r;
+    if (x->type == T_INT && !__builtin_add_overflow(x->as.i, 1, &r)) {
+        return make_int(sc, r);
+    }
+    BigNum a;
+    BigNum one = {NULL, 1, 0, 1};
+    one.d = &one.small;
+    big_view(sc, x, &a, "1+: expected number");
+    return big_add(sc, &a, &one);
+}
+
+static Cell *prim_not(Scheme *sc, Cell *args) {
+    return not1(sc, car(args));
+}
+
+static Cell *prim_zerop(Scheme *sc, Cell *args) {
+    return zerop1(sc, car(args));
+}
+
+static Cell *prim_one_plus(Scheme *sc, Cell *args) {
+    return one_plus1(sc, car(args));
+}
+
+static Cell *prim_cons(Scheme *sc, Cell *args) {
+    Cell *a = car(args);
+    Cell *d = car(cdr(args));
+    return cons(sc, a, d);
+}
+
+static Cell *prim_car(Scheme *sc, Cell *args) {
+    if (car(args)->type != T_PAIR) {
+        panic(sc, "car: expected pair");
+    }
+    return car(car(args));
+}
+
+static Cell *prim_cdr(Scheme *sc, Cell *args) {
+    if (car(args)->type != T_PAIR) {
+        panic(sc, "cdr: expected pair");
+    }
+    return cdr(car(args));
+}
+
+static Cell *prim_nullp(Scheme *sc, Cell *args) {
+    return make_bool(sc, is_nil(sc, car(args)));
+}
+
+static Cell *prim_pairp(Scheme *sc, Cell *args) {
+    return make_bool(sc, car(args)->type == T_PAIR);
+}
+
+static Cell *prim_eqp(Scheme *sc, Cell *args) {
+    return make_bool(sc, car(args) == car(cdr(args)));
+}
+
+static Cell *prim_string_len(Scheme *sc, Cell *args) {
+    Cell *v = car(args);
+    if (v->type != T_STRING) {
+        panic(sc, "string-length: expected string");
+    }
+    return make_int(sc, (int)v->as.str.len);
+}
+
+static Cell *prim_string_ref(Scheme *sc, Cell *args) {
+    Cell *s = car(args);
+    Cell *i = car(cdr(args));
+    if (s->type != T_STRING || i->type != T_INT) {
+        panic(sc, "string-ref: expected string and int");
+    }
+    if (i->as.i < 0 || (size_t)i->as.i >= s->as.str.len) {
+        panic(sc, "string-ref: index out of range");
+    }
+    return make_char(sc, (unsigned char)s->as.str.data[i->as.i]);
+}
+
+static Cell *prim_string_eq(Scheme *sc, Cell *args) {
+    Cell *a = car(args);
+    Cell *b = car(cdr(args));
+    if (a->type != T_STRING || b->type != T_STRING) {
+        panic(sc, "string=?: expected strings");
+    }
+    if (a->as.str.len != b->as.str.len) {
+        return scheme_false(sc);
+    }
+    for (size_t i = 0; i < a->as.str.len; i++) {
+        if (a->as.str.data[i] != b->as.str.data[i]) {
+            return scheme_false(sc);
+        }
+    }
+    return scheme_true(sc);
+}
+
+// check_index: validate an index for an access of width elements.
+// Args: sc (interpreter state), i (index cell), len (object length), width (elements accessed), msg (panic text).
+// Returns: the index; panics unless 0 <= i and i + width <= len.
+static size_t check_index(Scheme *sc, Cell *i, size_t len, size_t width, const char *msg) {
+    if (i->type != T_INT || i->as.i < 0 || width > len || (size_t)i->as.i > len - width) {
+        panic(sc, msg);
+    }
+    return (size_t)i->as.i;
+}
+
+// check_mutable: refuse to modify an object of a frozen heap.
+// Args: sc (interpreter state), c (object about to change), msg (panic text).
+// Returns: none; panics if c is shared.
+static void check_mutable(Scheme *sc, Cell *c, const char *msg) {
+    if (c->mark == MARK_FROZEN) {
+        panic(sc, msg);
+    }
+}
+
+// check_length: validate a length argument.
+// Args: sc (interpreter state), n (length cell), msg (panic text).
+// Returns: the length; panics unless it is a non-negative int.
+static size_t check_length(Scheme *sc, Cell *n, const char *msg) {
+    if (n->type != T_INT || n->as.i < 0) {
+        panic(sc, msg);
+    }
+    return (size_t)n->as.i;
+}
+
+// make_string_cell: wrap arena bytes (already NUL-terminated) in a string cell.
+// Args: sc (interpreter state), buf (from alloc_str_bytes), len (bytes).
+// Returns: the string cell.
+static Cell *make_string_cell(Scheme *sc, char *buf, size_t len) {
+    Cell *c = alloc_cell(sc);
+    c->type = T_STRING;
+    c->as.str.data = buf;
+    c->as.str.len = len;
+    return c;
+}
+
+// prim_substring: (substring s start [end]).
+// Args: sc (interpreter state), args (string, start, optional end).
+// Returns: a new string with bytes [start, end).
+static Cell *prim_substring(Scheme *sc, Cell *args) {
+    Cell *s = car(args);
+    if (s->type != T_STRING) {
+        panic(sc, "substring: expected string");
+    }
+    size_t start = check_index(sc, car(cdr(args)), s->as.str.len, 0, "substring: start out of range");
+    size_t end = s->as.str.len;
+    if (!is_nil(sc, cdr(cdr(args)))) {
+        end = check_index(sc, car(cdr(cdr(args))), s->as.str.len, 0, "substring: end out of range");
+    }
+    if (end < start) {
+        panic(sc, "substring: end before start");
+    }
+    return make_string_len(sc, s->as.str.data + start, end - start);
+}
+
+// prim_string_append: concatenate any number of strings with one copy.
+// Args: sc (interpreter state), args (strings).
+// Returns: the new string.
+static Cell *prim_string_append(Scheme *sc, Cell *args) {
+    size_t len = 0;
+    for (Cell *p = args; !is_nil(sc, p); p = cdr(p)) {
+        if (car(p)->type != T_STRING) {
+            panic(sc, "string-append: expected strings");
+        }
+        len += car(p)->as.str.len;
+    }
+    char *buf = alloc_str_bytes(sc, len);
+    size_t pos = 0;
+    for (Cell *p = args; !is_nil(sc, p); p = cdr(p)) {
+        const char *src = car(p)->as.str.data;
+        for (size_t i = 0; i < car(p)->as.str.len; i++) {
+            buf[pos++] = src[i];
+        }
+    }
+    buf[len] = '\0';
+    return make_string_cell(sc, buf, len);
+}
+
+// prim_string_index: (string-index s ch [start]).
+// Args: sc (interpreter state), args (string, char, optional start index).
+// Returns: index of the first ch at or after start, or #f.
+static Cell *prim_string_index(Scheme *sc, Cell *args) {
+    Cell *s = car(args);
+    Cell *ch = car(cdr(args));
+    if (s->type != T_STRING || ch->type != T_CHAR) {
+        panic(sc, "string-index: expected string and char");
+    }
+    size_t i = 0;
+    if (!is_nil(sc, cdr(cdr(args)))) {
+        i = check_index(sc, car(cdr(cdr(args))), s->as.str.len, 0, "string-index: start out of range");
+    }
+    for (; i < s->as.str.len; i++) {
+        if ((unsigned char)s->as.str.data[i] == ch->as.i) {
+            return make_int(sc, (int)i);
+        }
+    }
+    return scheme_false(sc);
+}
+
+// prim_make_string: (make-string n [ch]); ch defaults to a space.
+// Args: sc (interpreter state), args (length, optional char).
+// Returns: the new string.
+static Cell *prim_make_string(Scheme *sc, Cell *args) {
+    size_t n = check_length(sc, car(args), "make-string: expected non-negative int");
+    char fill = ' ';
+    if (!is_nil(sc, cdr(args))) {
+        Cell *ch = car(cdr(args));
+        if (ch->type != T_CHAR) {
+            panic(sc, "make-string: expected char");
+        }
+        fill = (char)ch->as.i;
+    }
+    char *buf = alloc_str_bytes(sc, n);
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = fill;
+    }
+    buf[n] = '\0';
+    return make_string_cell(sc, buf, n);
+}
+
+// String builders accumulate text in collector-managed storage that doubles
+// when full, so appends are amortized O(1). Only string-builder->string
+// copies into the (never reclaimed) string arena.
+#define STRING_BUILDER_MIN_CAP 16
+
+static char *sbuf_data(StringBuf *buf) {
+    return (char *)(buf + 1);
+}
+
+static StringBuf *sbuf_alloc(Scheme *sc, size_t cap) {
+    if (cap > ((size_t)-1) - sizeof(StringBuf)) {
+        panic(sc, "string builder: too large");
+    }
+    StringBuf *buf = (StringBuf *)blob_alloc(sc, sizeof(StringBuf) + cap);
+    buf->cap = cap;
+    buf->len = 0;
+    return buf;
+}
+
+static Cell *expect_builder(Scheme *sc, Cell *b, const char *msg) {
+    if (b->type != T_STRING_BUILDER) {
+        panic(sc, msg);
+    }
+    return b;
+}
+
+// sbuf_reserve: make room for extra more bytes in a builder.
+// Args: sc (interpreter state), b (builder cell, rooted), extra (bytes).
+// Returns: the builder's storage, possibly reallocated.
+static StringBuf *sbuf_reserve(Scheme *sc, Cell *b, size_t extra) {
+    StringBuf *buf = b->as.sbuf.buf;
+    if (buf->cap - buf->len >= extra) {
+        return buf;
+    }
+    size_t cap = buf->cap * 2;
+    if (cap < buf->len + extra) {
+        cap = buf->len + extra;
+    }
+    StringBuf *grown = sbuf_alloc(sc, cap);
+    // The old storage stays owned by b until the swap, so a collection
+    // inside sbuf_alloc cannot free it out from under us.
+    buf = b->as.sbuf.buf;
+    char *from = sbuf_data(buf);
+    char *to = sbuf_data(grown);
+    for (size_t i = 0; i < buf->len; i++) {
+        to[i] = from[i];
+    }
+    grown->len = buf->len;
+    sc->blob_bytes -= sizeof(StringBuf) + buf->cap;
+    sc->platform.free(sc->platform.user, buf);
+    b->as.sbuf.buf = grown;
+    return grown;
+}
+
+// prim_make_string_builder: (make-string-builder [capacity]).
+// Args: sc (interpreter state), args (optional initial capacity).
+// Returns: an empty builder.
+static Cell *prim_make_string_builder(Scheme *sc, Cell *args) {
+    size_t cap = STRING_BUILDER_MIN_CAP;
+    if (!is_nil(sc, args)) {
+        cap = check_length(sc, car(args), "make-string-builder: expected non-negative int");
+        if (cap < STRING_BUILDER_MIN_CAP) {
+            cap = STRING_BUILDER_MIN_CAP;
+        }
+    }
+    Cell *c = reserve_cell(sc);
+    StringBuf *buf = sbuf_alloc(sc, cap);
+    pop_roots(sc, 1);
+    c->type = T_STRING_BUILDER;
+    c->as.sbuf.buf = buf;
+    return c;
+}
+
+// prim_string_builder_append: (string-builder-append! b x) for a string or char.
+// Args: sc (interpreter state), args (builder, string or char).
+// Returns: the builder.
+static Cell *prim_string_builder_append(Scheme *sc, Cell *args) {
+    Cell *b = expect_builder(sc, car(args), "string-builder-append!: expected builder");
+    check_mutable(sc, b, "string-builder-append!: shared builder is read-only");
+    Cell *x = car(cdr(args));
+    if (x->type == T_CHAR) {
+        StringBuf *buf = sbuf_reserve(sc, b, 1);
+        sbuf_data(buf)[buf->len++] = (char)x->as.i;
+    } else if (x->type == T_STRING) {
+        StringBuf *buf = sbuf_reserve(sc, b, x->as.str.len);
+        char *dst = sbuf_data(buf) + buf->len;
+        for (size_t i = 0; i < x->as.str.len; i++) {
+            dst[i] = x->as.str.data[i];
+        }
+        buf->len += x->as.str.len;
+    } else {
+        panic(sc, "string-builder-append!: expected string or char");
+    }
+    return b;
+}
+
+static Cell *prim_string_builder_length(Scheme *sc, Cell *args) {
+    Cell *b = expect_builder(sc, car(args), "string-builder-length: expected builder");
+    return make_int(sc, (int)b->as.sbuf.buf->len);
+}
+
+// prim_string_builder_truncate: (string-builder-truncate! b n) keeps the first n bytes.
+// Args: sc (interpreter state), args (builder, length).
+// Returns: the builder.
+static Cell *prim_string_builder_truncate(Scheme *sc, Cell *args) {
+    Cell *b = expect_builder(sc, car(args), "string-builder-truncate!: expected builder");
+    check_mutable(sc, b, "string-builder-truncate!: shared builder is read-only");
+    StringBuf *buf = b->as.sbuf.buf;
+    buf->len = check_index(sc, car(cdr(args)), buf->len, 0, "string-builder-truncate!: length out of range");
+    return b;
+}
+
+static Cell *prim_string_builder_to_string(Scheme *sc, Cell *args) {
+    Cell *b = expect_builder(sc, car(args), "string-builder->string: expected builder");
+    return make_string_len(sc, sbuf_data(b->as.sbuf.buf), b->as.sbuf.buf->len);
+}
+
+// Hash tables use open addressing with linear probing. Growing allocates the
+// larger table at once but moves entries across a few slots per operation,
+// so no single hash-set! pays for rehashing everything.
+#define HASH_MIN_CAP 8
+#define HASH_MIGRATE_STEP 8
+
+// 32-bit FNV-1a, used for string keys and disk-hash.
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static unsigned int hash_string(const char *p, size_t len) {
+    unsigned int h = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+// hash_key: hash a key for a table of the given kind. Fixnums and chars are
+// boxed, so eq? tables compare them by value; other keys hash by address.
+static unsigned int hash_key(int kind, Cell *key) {
+    if (kind == SCHEME_HASH_STRING) {
+        return hash_string(key->as.str.data, key->as.str.len);
+    }
+    unsigned int h;
+    if (key->type == T_INT || key->type == T_CHAR) {
+        h = (unsigned int)key->as.i * 2u + (key->type == T_CHAR);
+    } else {
+        h = (unsigned int)(size_t)key >> 3;
+    }
+    h *= 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static int hash_key_eq(int kind, Cell *a, Cell *b) {
+    if (a == b) {
+        return 1;
+    }
+    if (kind == SCHEME_HASH_STRING) {
+        return a->as.str.len == b->as.str.len && streq_len(a->as.str.data, b->as.str.data, a->as.str.len);
+    }
+    return (a->type == T_INT || a->type == T_CHAR) && a->type == b->type && a->as.i == b->as.i;
+}
+
+static void hash_table_init(HashTable *t, size_t cap, int kind) {
+    t->cap = cap;
+    t->count = 0;
+    t->used = 0;
+    t->kind = kind;
+    t->moved = 0;
+    t->old = NULL;
+    t->migrate = 0;
+    HashEntry *e = hash_entries(t);
+    for (size_t i = 0; i < cap; i++) {
+        e[i].key = NULL;
+        e[i].value = NULL;
+    }
+}
+
+// hash_slot: find the slot holding key in one table (not its old table).
+// Returns: the slot, or NULL if key is absent.
+static HashEntry *hash_slot(HashTable *t, Cell *key) {
+    HashEntry *e = hash_entries(t);
+    size_t mask = t->cap - 1;
+    size_t i = hash_key(t->kind, key) & mask;
+    for (size_t n = 0; n < t->cap; n++, i = (i + 1) & mask) {
+        if (!e[i].key) {
+            return NULL;
+        }
+        if (e[i].key != HASH_TOMBSTONE && hash_key_eq(t->kind, e[i].key, key)) {
+            return &e[i];
+        }
+    }
+    return NULL;
+}
+
+// hash_put_new: insert a key that is known to be absent.
+// Args: t (table with at least one empty or deleted slot), key, value.
+// Returns: none.
+static void hash_put_new(HashTable *t, Cell *key, Cell *value) {
+    HashEntry *e = hash_entries(t);
+    size_t mask = t->cap - 1;
+    size_t i = hash_key(t->kind, key) & mask;
+    while (e[i].key && e[i].key != HASH_TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (!e[i].key) {
+        t->used++;
+    }
+    e[i].key = key;
+    e[i].value = value;
+    t->count++;
+}
+
+// hash_migrate: move up to steps slots of the old table into t, and free
+// the old table once it is empty.
+// Args: sc (interpreter state), t (current table), steps (slots to visit).
+// Returns: none.
+static void hash_migrate(Scheme *sc, HashTable *t, size_t steps) {
+    HashTable *old = t->old;
+    if (!old) {
+        return;
+    }
+    HashEntry *e = hash_entries(old);
+    for (; steps > 0 && t->migrate < old->cap; steps--, t->migrate++) {
+        HashEntry *slot = &e[t->migrate];
+        if (slot->key && slot->key != HASH_TOMBSTONE) {
+            hash_put_new(t, slot->key, slot->value);
+            slot->key = HASH_TOMBSTONE;
+            old->count--;
+        }
+    }
+    if (t->migrate == old->cap) {
+        sc->blob_bytes -= hash_table_bytes(old->cap);
+        sc->platform.free(sc->platform.user, old);
+        t->old = NULL;
+        t->migrate = 0;
+    }
+}
+
+// hash_find: look a key up in a table and, while it grows, its old table.
+// Returns: the slot, or NULL.
+static HashEntry *hash_find(HashTable *t, Cell *key) {
+    HashEntry *slot = hash_slot(t, key);
+    if (!slot && t->old) {
+        slot = hash_slot(t->old, key);
+    }
+    return slot;
+}
+
+static HashTable *hash_alloc(Scheme *sc, size_t cap, int kind) {
+    if (cap > (((size_t)-1) - sizeof(HashTable)) / sizeof(HashEntry)) {
+        panic(sc, "hash table: too large");
+    }
+    HashTable *t = (HashTable *)blob_alloc(sc, hash_table_bytes(cap));
+    hash_table_init(t, cap, kind);
+    return t;
+}
+
+// hash_reserve: make room for one more key, starting a resize if needed.
+// Args: sc (interpreter state), h (hash table cell, rooted).
+// Returns: the current table.
+static HashTable *hash_reserve(Scheme *sc, Cell *h) {
+    HashTable *t = h->as.hash.table;
+    size_t pending = t->old ? t->old->count : 0;
+    if ((t->used + pending + 1) * 4 <= t->cap * 3) {
+        return t;
+    }
+    // Finish any resize in progress, then size for twice the live keys;
+    // a table full of deleted slots is rebuilt at the same size or smaller.
+    hash_migrate(sc, t, t->old ? t->old->cap : 0);
+    size_t cap = HASH_MIN_CAP;
+    while (cap < (t->count + 1) * 2) {
+        cap *= 2;
+    }
+    HashTable *grown = hash_alloc(sc, cap, t->kind);
+    t = h->as.hash.table;
+    grown->old = t;
+    h->as.hash.table = grown;
+    hash_migrate(sc, grown, HASH_MIGRATE_STEP);
+    return grown;
+}
+
+// hash_rehash: rebuild a table, and any old table it is draining, into one
+// table, rehashing every key at its current address.
+// Args: sc (interpreter state), h (hash table cell).
+// Returns: none.
+static void hash_rehash(Scheme *sc, Cell *h) {
+    HashTable *t = h->as.hash.table;
+    size_t count = t->count + (t->old ? t->old->count : 0);
+    size_t cap = HASH_MIN_CAP;
+    while (cap < (count + 1) * 2) {
+        cap *= 2;
+    }
+    push_root(sc, h);
+    // Allocating may collect and move keys again; they are read afterwards.
+    HashTable *fresh = hash_alloc(sc, cap, h->as.hash.table->kind);
+    pop_roots(sc, 1);
+    t = h->as.hash.table;
+    while (t) {
+        HashEntry *e = hash_entries(t);
+        for (size_t i = 0; i < t->cap; i++) {
+            if (e[i].key && e[i].key != HASH_TOMBSTONE) {
+                hash_put_new(fresh, e[i].key, e[i].value);
+            }
+        }
+        HashTable *old = t->old;
+        sc->blob_bytes -= hash_table_bytes(t->cap);
+        sc->platform.free(sc->platform.user, t);
+        t = old;
+    }
+    h->as.hash.table = fresh;
+}
+
+static HashTable *expect_hash(Scheme *sc, Cell *h, Cell *key, const char *msg) {
+    if (h->type != T_HASHTABLE) {
+        panic(sc, msg);
+    }
+    HashTable *t = h->as.hash.table;
+    if (key && t->kind == SCHEME_HASH_STRING && key->type != T_STRING) {
+        panic(sc, msg);
+    }
+    // scheme_freeze left shared tables fully migrated.
+    if (h->mark == MARK_FROZEN) {
+        return t;
+    }
+    if (t->moved || (t->old && t->old->moved)) {
+        hash_rehash(sc, h);
+        t = h->as.hash.table;
+    }
+    hash_migrate(sc, t, HASH_MIGRATE_STEP);
+    return h->as.hash.table;
+}
+
+static Cell *make_hash_table(Scheme *sc, int kind) {
+    Cell *c = reserve_cell(sc);
+    HashTable *t = hash_alloc(sc, HASH_MIN_CAP, kind);
+    pop_roots(sc, 1);
+    c->type = T_HASHTABLE;
+    c->as.hash.table = t;
+    return c;
+}
+
+// prim_make_hash_table: (make-hash-table), keyed by eq?.
+// Args: sc (interpreter state), args (ignored).
+// Returns: an empty table.
+static Cell *prim_make_hash_table(Scheme *sc, Cell *args) {
+    (void)args;
+    return make_hash_table(sc, SCHEME_HASH_EQ);
+}
+
+// prim_make_string_hash_table: (make-string-hash-table), keyed by string=?.
+// Args: sc (interpreter state), args (ignored).
+// Returns: an empty table.
+static Cell *prim_make_string_hash_table(Scheme *sc, Cell *args) {
+    (void)args;
+    return make_hash_table(sc, SCHEME_HASH_STRING);
+}
+
+static Cell *prim_hash_tablep(Scheme *sc, Cell *args) {
+    return make_bool(sc, car(args)->type == T_HASHTABLE);
+}
+
+// prim_hash_ref: (hash-ref table key [default]); default is #f.
+// Args: sc (interpreter state), args (table, key, optional default).
+// Returns: the stored value or the default.
+static Cell *prim_hash_ref(Scheme *sc, Cell *args) {
+    Cell *key = car(cdr(args));
+    HashTable *t = expect_hash(sc, car(args), key, "hash-ref: expected table and key");
+    HashEntry *slot = hash_find(t, key);
+    if (slot) {
+        return slot->value;
+    }
+    return is_nil(sc, cdr(cdr(args))) ? scheme_false(sc) : car(cdr(cdr(args)));
+}
+
+static Cell *prim_hash_set(Scheme *sc, Cell *args) {
+    Cell *h = car(args);
+    Cell *key = car(cdr(args));
+    Cell *value = car(cdr(cdr(args)));
+    HashTable *t = expect_hash(sc, h, key, "hash-set!: expected table and key");
+    check_mutable(sc, h, "hash-set!: shared table is read-only");
+    HashEntry *slot = hash_find(t, key);
+    if (slot) {
+        gc_write_barrier(sc, h, value);
+        slot->value = value;
+    } else {
+        // Reserving may run a collector step, so shade afterwards.
+        t = hash_reserve(sc, h);
+        gc_write_barrier(sc, h, key);
+        gc_write_barrier(sc, h, value);
+        hash_put_new(t, key, value);
+    }
+    return scheme_nil(sc);
+}
+
+// prim_hash_remove: (hash-remove! table key).
+// Args: sc (interpreter state), args (table, key).
+// Returns: #t if the key was present.
+static Cell *prim_hash_remove(Scheme *sc, Cell *args) {
+    Cell *key = car(cdr(args));
+    HashTable *t = expect_hash(sc, car(args), key, "hash-remove!: expected table and key");
+    check_mutable(sc, car(args), "hash-remove!: shared table is read-only");
+    HashTable *owner = t;
+    HashEntry *slot = hash_slot(t, key);
+    if (!slot && t->old) {
+        owner = t->old;
+        slot = hash_slot(owner, key);
+    }
+    if (!slot) {
+        return scheme_false(sc);
+    }
+    slot->key = HASH_TOMBSTONE;
+    slot->value = NULL;
+    owner->count--;
+    return scheme_true(sc);
+}
+
+static Cell *prim_hash_count(Scheme *sc, Cell *args) {
+    HashTable *t = expect_hash(sc, car(args), NULL, "hash-count: expected table");
+    return make_int(sc, (int)(t->count + (t->old ? t->old->count : 0)));
+}
+
+// prim_hash_keys: list the keys of a table in no particular order.
+// Args: sc (interpreter state), args (table).
+// Returns: list of keys.
+static Cell *prim_hash_keys(Scheme *sc, Cell *args) {
+    Cell *h = car(args);
+    expect_hash(sc, h, NULL, "hash-keys: expected table");
+    Cell *list = scheme_nil(sc);
+    push_root(sc, list);
+    for (HashTable *t = h->as.hash.table; t; t = t->old) {
+        HashEntry *e = hash_entries(t);
+        for (size_t i = 0; i < t->cap; i++) {
+            // cons cannot resize the table, so e stays valid.
+            if (e[i].key && e[i].key != HASH_TOMBSTONE) {
+                list = cons(sc, e[i].key, list);
+                pop_roots(sc, 1);
+                push_root(sc, list);
+            }
+        }
+    }
+    pop_roots(sc, 1);
+    return list;
+}
+
+static Cell *prim_char_eq(Scheme *sc, Cell *args) {
+    Cell *a = car(args);
+    Cell *b = car(cdr(args));
+    if (a->type != T_CHAR || b->type != T_CHAR) {
+        panic(sc, "char=?: expected chars");
+    }
+    return make_bool(sc, a->as.i == b->as.i);
+}
+
+static Cell *prim_list_alloc(Scheme *sc, Cell *args) {
+    Cell *ncell = car(args);
+    if (ncell->type != T_INT) {
+        panic(sc, "list-alloc: expected int");
+    }
+    int n = ncell->as.i;
+    if (n < 0) {
+        panic(sc, "list-alloc: negative length");
+    }
+    Cell *list = scheme_nil(sc);
+    for (int i = n - 1; i >= 0; i--) {
+        push_root(sc, list);
+        Cell *val = make_int(sc, i);
+        push_root(sc, val);
+        list = cons(sc, val, list);
+        pop_roots(sc, 2);
+    }
+    return list;
+}
+
+// prim_make_vector: (make-vector n [fill]); fill defaults to '().
+// Args: sc (interpreter state), args (length, optional fill).
+// Returns: the new vector.
+static Cell *prim_make_vector(Scheme *sc, Cell *args) {
+    size_t n = check_length(sc, car(args), "make-vector: expected non-negative int");
+    Cell *fill = is_nil(sc, cdr(args)) ? scheme_nil(sc) : car(cdr(args));
+    return make_vector(sc, n, fill);
+}
+
+static Cell *prim_vector(Scheme *sc, Cell *args) {
+    size_t n = 0;
+    for (Cell *p = args; !is_nil(sc, p); p = cdr(p)) {
+        n++;
+    }
+    Cell *v = make_vector(sc, n, scheme_nil(sc));
+    for (size_t i = 0; i < n; i++, args = cdr(args)) {
+        gc_write_barrier(sc, v, car(args));
+        v->as.vec.items[i] = car(args);
+    }
+    return v;
+}
+
+static Cell *prim_vectorp(Scheme *sc, Cell *args) {
+    return make_bool(sc, car(args)->type == T_VECTOR);
+}
+
+static Cell *prim_vector_length(Scheme *sc, Cell *args) {
+    Cell *v = car(args);
+    if (v->type != T_VECTOR) {
+        panic(sc, "vector-length: expected vector");
+    }
+    return make_int(sc, (int)v->as.vec.len);
+}
+
+static Cell *prim_vector_ref(Scheme *sc, Cell *args) {
+    Cell *v = car(args);
+    if (v->type != T_VECTOR) {
+        panic(sc, "vector-ref: expected vector");
+    }
+    size_t i = check_index(sc, car(cdr(args)), v->as.vec.len, 1, "vector-ref: index out of range");
+    return v->as.vec.items[i];
+}
+
+static Cell *prim_vector_set(Scheme *sc, Cell *args) {
+    Cell *v = car(args);
+    if (v->type != T_VECTOR) {
+        panic(sc, "vector-set!: expected vector");
+    }
+    size_t i = check_index(sc, car(cdr(args)), v->as.vec.len, 1, "vector-set!: index out of range");
+    check_mutable(sc, v, "vector-set!: shared vector is read-only");
+    gc_write_barrier(sc, v, car(cdr(cdr(args))));
+    v->as.vec.items[i] = car(cdr(cdr(args)));
+    return scheme_nil(sc);
+}
+
+// prim_make_bytevector: (make-bytevector n [byte]); byte defaults to 0.
+// Args: sc (interpreter state), args (length, optional fill byte).
+// Returns: the new bytevector.
+static Cell *prim_make_bytevector(Scheme *sc, Cell *args) {
+    size_t n = check_length(sc, car(args), "make-bytevector: expected non-negative int");
+    int fill = 0;
+    if (!is_nil(sc, cdr(args))) {
+        Cell *b = car(cdr(args));
+        if (b->type != T_INT || b->as.i < 0 || b->as.i > 255) {
+            panic(sc, "make-bytevector: fill must be a byte");
+        }
+        fill = b->as.i;
+    }
+    return make_bytevector(sc, n, (unsigned char)fill);
+}
+
+static Cell *prim_bytevectorp(Scheme *sc, Cell *args) {
+    return make_bool(sc, car(args)->type == T_BYTEVECTOR);
+}
+
+static Cell *prim_bytevector_length(Scheme *sc, Cell *args) {
+    Cell *bv = car(args);
+    if (bv->type != T_BYTEVECTOR) {
+        panic(sc, "bytevector-length: expected bytevector");
+    }
+    return make_int(sc, (int)bv->as.bytes.len);
+}
+
+static Cell *prim_bytevector_u8_ref(Scheme *sc, Cell *args) {
+    Cell *bv = car(args);
+    if (bv->type != T_BYTEVECTOR) {
+        panic(sc, "bytevector-u8-ref: expected bytevector");
+    }
+    size_t i = check_index(sc, car(cdr(args)), bv->as.bytes.len, 1, "bytevector-u8-ref: index out of range");
+    return make_int(sc, bv->as.bytes.data[i]);
+}
+
+static Cell *prim_bytevector_u8_set(Scheme *sc, Cell *args) {
+    Cell *bv = car(args);
+    Cell *v = car(cdr(cdr(args)));
+    if (bv->type != T_BYTEVECTOR || v->type != T_INT) {
+        panic(sc, "bytevector-u8-set!: expected bytevector, index, int");
+    }
+    size_t i = check_index(sc, car(cdr(args)), bv->as.bytes.len, 1, "bytevector-u8-set!: index out of range");
+    check_mutable(sc, bv, "bytevector-u8-set!: shared bytevector is read-only");
+    bv->as.bytes.data[i] = (unsigned char)v->as.i;
+    return scheme_nil(sc);
+}
+
+// prim_bytevector_u32_le_ref: read a little-endian u32. Fixnums are 32-bit,
+// so values from 2^31 up come back negative.
+// Args: sc (interpreter state), args (bytevector, byte offset).
+// Returns: int cell.
+static Cell *prim_bytevector_u32_le_ref(Scheme *sc, Cell *args) {
+    Cell *bv = car(args);
+    if (bv->type != T_BYTEVECTOR) {
+        panic(sc, "bytevector-u32-le-ref: expected bytevector");
+    }
+    size_t i = check_index(sc, car(cdr(args)), bv->as.bytes.len, 4, "bytevector-u32-le-ref: index out of range");
+    const unsigned char *p = bv->as.bytes.data + i;
+    unsigned int v = (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) |
+                     ((unsigned int)p[3] << 24);
+    return make_int(sc, (int)v);
+}
+
+static Cell *prim_bytevector_u32_le_set(Scheme *sc, Cell *args) {
+    Cell *bv = car(args);
+    Cell *v = car(cdr(cdr(args)));
+    if (bv->type != T_BYTEVECTOR || v->type != T_INT) {
+        panic(sc, "bytevector-u32-le-set!: expected bytevector, index, int");
+    }
+    size_t i = check_index(sc, car(cdr(args)), bv->as.bytes.len, 4, "bytevector-u32-le-set!: index out of range");
+    check_mutable(sc, bv, "bytevector-u32-le-set!: shared bytevector is read-only");
+    unsigned int u = (unsigned int)v->as.i;
+    unsigned char *p = bv->as.bytes.data + i;
+    p[0] = (unsigned char)u;
+    p[1] = (unsigned char)(u >> 8);
+    p[2] = (unsigned char)(u >> 16);
+    p[3] = (unsigned char)(u >> 24);
+    return scheme_nil(sc);
+}
+
+// prim_bytevector_copy: (bytevector-copy! to at from [start [end]]); the
+// ranges may overlap.
+// Args: sc (interpreter state), args (destination, offset, source, optional range).
+// Returns: '().
+static Cell *prim_bytevector_copy(Scheme *sc, Cell *args) {
+    Cell *to = car(args);
+    Cell *from = car(cdr(cdr(args)));
+    if (to->type != T_BYTEVECTOR || from->type != T_BYTEVECTOR) {
+        panic(sc, "bytevector-copy!: expected bytevectors");
+    }
+    Cell *range = cdr(cdr(cdr(args)));
+    size_t start = 0;
+    size_t end = from->as.bytes.len;
+    if (!is_nil(sc, range)) {
+        start = check_index(sc, car(range), end, 0, "bytevector-copy!: start out of range");
+        if (!is_nil(sc, cdr(range))) {
+            end = check_index(sc, car(cdr(range)), end, 0, "bytevector-copy!: end out of range");
+        }
+    }
+    if (end < start) {
+        panic(sc, "bytevector-copy!: end before start");
+    }
+    size_t n = end - start;
+    size_t at = check_index(sc, car(cdr(args)), to->as.bytes.len, n, "bytevector-copy!: destination too small");
+    check_mutable(sc, to, "bytevector-copy!: shared bytevector is read-only");
+    unsigned char *dst = to->as.bytes.data + at;
+    const unsigned char *src = from->as.bytes.data + start;
+    if (dst < src) {
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = src[i];
+        }
+    } else {
+        for (size_t i = n; i > 0; i--) {
+            dst[i - 1] = src[i - 1];
+        }
+    }
+    return scheme_nil(sc);
+}
+
+static Cell *prim_string_to_utf8(Scheme *sc, Cell *args) {
+    Cell *s = car(args);
+    if (s->type != T_STRING) {
+        panic(sc, "string->utf8: expected string");
+    }
+    Cell *bv = make_bytevector(sc, s->as.str.len, 0);
+    for (size_t i = 0; i < s->as.str.len; i++) {
+        bv->as.bytes.data[i] = (unsigned char)s->as.str.data[i];
+    }
+    return bv;
+}
+
+// prim_utf8_to_string: (utf8->string bv [start [end]]); bytes are copied
+// unchanged, as strings are byte strings.
+// Args: sc (interpreter state), args (bytevector, optional range).
+// Returns: the new string.
+static Cell *prim_utf8_to_string(Scheme *sc, Cell *args) {
+    Cell *bv = car(args);
+    if (bv->type != T_BYTEVECTOR) {
+        panic(sc, "utf8->string: expected bytevector");
+    }
+    Cell *range = cdr(args);
+    size_t start = 0;
+    size_t end = bv->as.bytes.len;
+    if (!is_nil(sc, range)) {
+        start = check_index(sc, car(range), end, 0, "utf8->string: start out of range");
+        if (!is_nil(sc, cdr(range))) {
+            end = check_index(sc, car(cdr(range)), end, 0, "utf8->string: end out of range");
+        }
+    }
+    if (end < start) {
+        panic(sc, "utf8->string: end before start");
+    }
+    return make_string_len(sc, (const char *)bv->as.bytes.data + start, end - start);
+}
+
+static int clamp_int(size_t v) {
+    return v > 0x7FFFFFFF ? 0x7FFFFFFF : (int)v;
+}
+
+// ns_to_us: convert nanoseconds to microseconds for display as a fixnum.
+// Args: ns (duration).
+// Returns: whole microseconds, saturated at the fixnum maximum.
+// Divides in 16-bit digits so 32-bit kernels need no libgcc helper.
+static int ns_to_us(unsigned long long ns) {
+    unsigned long long q = 0;
+    unsigned int rem = 0;
+    for (int shift = 48; shift >= 0; shift -= 16) {
+        unsigned int cur = (rem << 16) | (unsigned int)((ns >> shift) & 0xFFFF);
+        q = (q << 16) | (cur / 1000);
+        rem = cur % 1000;
+    }
+    return q > 0x7FFFFFFF ? 0x7FFFFFFF : (int)q;
+}
+
+static Cell *stats_entry(Scheme *sc, const char *name, int value, Cell *rest) {
+    push_root(sc, rest);
+    Cell *key = intern_symbol(sc, name);
+    push_root(sc, key);
+    Cell *val = make_int(sc, value);
+    push_root(sc, val);
+    Cell *entry = cons(sc, key, val);
+    push_root(sc, entry);
+    Cell *list = cons(sc, entry, rest);
+    pop_roots(sc, 4);
+    return list;
+}
+
+// prim_current_time_ns: read the platform's monotonic clock.
+// Args: none.
+// Returns: nanoseconds since boot, a bignum once past the fixnum range.
+static Cell *prim_current_time_ns(Scheme *sc, Cell *args) {
+    (void)args;
+    if (!sc->platform.now_ns) {
+        panic(sc, "current-time-ns: not supported");
+    }
+    unsigned long long ns = sc->platform.now_ns(sc->platform.user);
+    if (ns <= 0x7FFFFFFFu) {
+        return make_int(sc, (int)ns);
+    }
+    Cell *c = big_alloc(sc, 2);
+    c->as.big.digits[0] = (unsigned int)ns;
+    c->as.big.digits[1] = (unsigned int)(ns >> 32);
+    return big_finish(sc, c, 0);
+}
+
+// prim_gc_stats: report allocator and collector counters.
+// Args: none.
+// Returns: an association list of (name . count); times are in microseconds.
+static Cell *prim_gc_stats(Scheme *sc, Cell *args) {
+    (void)args;
+    SchemeStats st;
+    scheme_get_stats(sc, &st);
+    Cell *list = scheme_nil(sc);
+    list = stats_entry(sc, "max-pause-us", ns_to_us(st.max_pause_ns), list);
+    list = stats_entry(sc, "sweep-us", ns_to_us(st.sweep_ns), list);
+    list = stats_entry(sc, "mark-us", ns_to_us(st.mark_ns), list);
+    list = stats_entry(sc, "sym-arena-peak", clamp_int(st.sym_arena_peak), list);
+    list = stats_entry(sc, "str-arena-peak", clamp_int(st.str_arena_peak), list);
+    list = stats_entry(sc, "live-cells", clamp_int(st.live_cells), list);
+    list = stats_entry(sc, "heap-cells", clamp_int(st.heap_cells), list);
+    list = stats_entry(sc, "cells-freed", clamp_int(st.cells_freed), list);
+    list = stats_entry(sc, "cells-allocated", clamp_int(st.cells_allocated), list);
+    list = stats_entry(sc, "collections", clamp_int(st.gc_count), list);
+    return list;
+}
+
+// prim_thread_stats: report this interpreter's usage against its quotas.
+// Args: none.
+// Returns: an association list of (name . value); a limit of 0 means none.
+static Cell *prim_thread_stats(Scheme *sc, Cell *args) {
+    (void)args;
+    SchemeStats st;
+    scheme_get_stats(sc, &st);
+    Cell *list = scheme_nil(sc);
+    list = stats_entry(sc, "output-limit", clamp_int(sc->quota.output_bytes), list);
+    list = stats_entry(sc, "output-bytes", clamp_int(st.output_bytes), list);
+    list = stats_entry(sc, "disk-limit", clamp_int(sc->quota.disk_bytes), list);
+    list = stats_entry(sc, "disk-bytes", clamp_int(st.disk_bytes), list);
+    list = stats_entry(sc, "cpu-limit", clamp_int(sc->quota.cpu_ticks), list);
+    list = stats_entry(sc, "cpu-ticks", clamp_int(st.cpu_ticks), list);
+    list = stats_entry(sc, "arena-limit", clamp_int(sc->quota.arena_bytes), list);
+    list = stats_entry(sc, "arena-bytes", clamp_int(st.arena_bytes), list);
+    list = stats_entry(sc, "cell-limit", clamp_int(sc->heap_max_cells), list);
+    list = stats_entry(sc, "cells", clamp_int(st.heap_cells), list);
+    return list;
+}
+
+// Samples kept per profiling run when profile-start is given no size;
+// at the 100Hz timer this covers about 40 seconds.
+#define PROFILE_DEFAULT_SAMPLES 4096
+#define PROFILE_TOP_ENTRIES 24
+
+typedef struct ProfileEntry {
+    const char *fn;
+    const char *caller;
+    unsigned int count;
+} ProfileEntry;
+
+static void write_uint(Scheme *sc, unsigned int n) {
+    char buf[10];
+    int i = 0;
+    do {
+        buf[i++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) {
+        putc_out(sc, buf[--i]);
+    }
+}
+
+static void write_padded(Scheme *sc, unsigned int n, unsigned int width) {
+    unsigned int digits = 1;
+    for (unsigned int v = n; v >= 10; v /= 10) {
+        digits++;
+    }
+    while (digits++ < width) {
+        putc_out(sc, ' ');
+    }
+    write_uint(sc, n);
+}
+
+static const char *profile_name(const char *name) {
+    return name ? name : "<top>";
+}
+
+// profile_tally: count one sample into a fixed table, folding overflow
+// into a final "<other>" entry.
+// Args: table/used/cap (table state), fn and caller (key; caller NULL for flat counts).
+// Returns: none.
+static void profile_tally(ProfileEntry *table, size_t *used, size_t cap, const char *fn, const char *caller) {
+    for (size_t i = 0; i < *used; i++) {
+        if (table[i].fn == fn && table[i].caller == caller) {
+            table[i].count++;
+            return;
+        }
+    }
+    if (*used + 1 < cap) {
+        table[*used].fn = fn;
+        table[*used].caller = caller;
+        table[*used].count = 1;
+        (*used)++;
+        return;
+    }
+    if (*used + 1 == cap) {
+        table[*used].fn = "<other>";
+        table[*used].caller = NULL;
+        table[*used].count = 0;
+        (*used)++;
+    }
+    table[cap - 1].count++;
+}
+
+static void profile_sort(ProfileEntry *table, size_t used) {
+    for (size_t i = 1; i < used; i++) {
+        ProfileEntry e = table[i];
+        size_t j = i;
+        while (j > 0 && table[j - 1].count < e.count) {
+            table[j] = table[j - 1];
+            j--;
+        }
+        table[j] = e;
+    }
+}
+
+// scheme_profile_sample: record the published call site if profiling is on.
+// Args: sc (interpreter state).
+// Returns: none. Safe to call from a timer interrupt or signal handler
+// that preempts the interpreter on the same CPU; it never allocates.
+void scheme_profile_sample(Scheme *sc) {
+    if (!sc || !sc->prof_active) {
+        return;
+    }
+    size_t n = sc->prof_count;
+    if (n >= sc->prof_cap) {
+        sc->prof_dropped++;
+        return;
+    }
+    sc->prof_samples[n].fn = sc->call_site.fn;
+    sc->prof_samples[n].caller = sc->call_site.caller;
+    sc->prof_count = n + 1;
+}
+
+// scheme_tick: timer hook; charges one tick of CPU time, stopping the
+// interpreter once it passes its CPU quota, and takes a profile sample.
+// Args: sc (interpreter state, or NULL).
+// Returns: none. Same calling rules as scheme_profile_sample.
+void scheme_tick(Scheme *sc) {
+    if (!sc) {
+        return;
+    }
+    sc->stats.cpu_ticks++;
+    if (sc->quota.cpu_ticks && sc->stats.cpu_ticks > sc->quota.cpu_ticks && !sc->stop_reason) {
+        scheme_stop(sc, "cpu quota exceeded");
+    }
+    scheme_profile_sample(sc);
+}
+
+// prim_profile_start: begin sampling this interpreter's call sites.
+// Args: optional sample capacity.
+// Returns: #t, or #f if the sample buffer could not be allocated.
+static Cell *prim_profile_start(Scheme *sc, Cell *args) {
+    size_t cap = PROFILE_DEFAULT_SAMPLES;
+    if (!is_nil(sc, args)) {
+        Cell *n = car(args);
+        if (n->type != T_INT || n->as.i <= 0) {
+            panic(sc, "profile-start: expected positive int");
+        }
+        cap = (size_t)n->as.i;
+    }
+    sc->prof_active = 0;
+    __asm__ volatile ("" ::: "memory");
+    if (sc->prof_samples && sc->prof_cap < cap && sc->platform.free) {
+        sc->platform.free(sc->platform.user, sc->prof_samples);
+        sc->prof_samples = NULL;
+    }
+    if (!sc->prof_samples) {
+        if (!sc->platform.alloc) {
+            return scheme_false(sc);
+        }
+        sc->prof_samples = (SchemeCallSite *)sc->platform.alloc(sc->platform.user, cap * sizeof(SchemeCallSite));
+        if (!sc->prof_samples) {
+            return scheme_false(sc);
+        }
+        sc->prof_cap = cap;
+    }
+    sc->prof_count = 0;
+    sc->prof_dropped = 0;
+    __asm__ volatile ("" ::: "memory");
+    sc->prof_active = 1;
+    return scheme_true(sc);
+}
+
+// prim_profile_dump: stop sampling and print a flat profile followed by
+// the hottest caller -> callee edges.
+// Args: none.
+// Returns: number of samples recorded.
+static Cell *prim_profile_dump(Scheme *sc, Cell *args) {
+    (void)args;
+    sc->prof_active = 0;
+    __asm__ volatile ("" ::: "memory");
+    size_t total = sc->prof_count;
+    ProfileEntry flat[PROFILE_TOP_ENTRIES];
+    ProfileEntry edges[PROFILE_TOP_ENTRIES];
+    size_t flat_used = 0;
+    size_t edge_used = 0;
+    for (size_t i = 0; i < total; i++) {
+        const char *fn = profile_name(sc->prof_samples[i].fn);
+        const char *caller = profile_name(sc->prof_samples[i].caller);
+        profile_tally(flat, &flat_used, PROFILE_TOP_ENTRIES, fn, NULL);
+        profile_tally(edges, &edge_used, PROFILE_TOP_ENTRIES, fn, caller);
+    }
+    profile_sort(flat, flat_used);
+    profile_sort(edges, edge_used);
+
+    write_str(sc, "profile: ");
+    write_uint(sc, (unsigned int)total);
+    write_str(sc, " samples");
+    if (sc->prof_dropped) {
+        write_str(sc, ", ");
+        write_uint(sc, (unsigned int)sc->prof_dropped);
+        write_str(sc, " dropped");
+    }
+    write_str(sc, "\n");
+    for (size_t i = 0; i < flat_used; i++) {
+        write_padded(sc, flat[i].count, 7);
+        write_padded(sc, (unsigned int)(flat[i].count * 100 / total), 4);
+        write_str(sc, "% ");
+        write_str(sc, flat[i].fn);
+        write_str(sc, "\n");
+    }
+    write_str(sc, "edges:\n");
+    for (size_t i = 0; i < edge_used; i++) {
+        write_padded(sc, edges[i].count, 7);
+        write_str(sc, " ");
+        if (edges[i].caller) {
+            write_str(sc, edges[i].caller);
+            write_str(sc, " -> ");
+        }
+        write_str(sc, edges[i].fn);
+        write_str(sc, "\n");
+    }
+    return make_int(sc, (int)total);
+}
+
+static Cell *prim_list_to_string(Scheme *sc, Cell *args) {
+    Cell *list = car(args);
+    size_t len = 0;
+    Cell *p = list;
+    while (!is_nil(sc, p)) {
+        Cell *ch = car(p);
+        if (ch->type != T_CHAR) {
+            panic(sc, "list->string: expected list of chars");
+        }
+        len++;
+        p = cdr(p);
+    }
+    char *buf = alloc_str_bytes(sc, len);
+    p = list;
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (char)car(p)->as.i;
+        p = cdr(p);
+    }
+    buf[len] = '\0';
+    Cell *c = alloc_cell(sc);
+    c->type = T_STRING;
+    c->as.str.data = buf;
+    c->as.str.len = len;
+    return c;
+}
+
+// prim_eval_string: evaluate a string in the global environment.
+// Args: sc (interpreter state), args (string cell).
+// Returns: int cell with number of expressions evaluated.
+static Cell *prim_eval_string(Scheme *sc, Cell *args) {
+    Cell *s = car(args);
+    if (s->type != T_STRING) {
+        panic(sc, "eval-string: expected string");
+    }
+    int count = eval_string_in_env(sc, s->as.str.data, sc->global_env);
+    return make_int(sc, count);
+}
+
+// prim_parse_string: read every expression in a string without evaluating
+// them, so the forms can be cached and evaluated repeatedly.
+// Args: sc (interpreter state), args (string cell).
+// Returns: list of forms in source order.
+static Cell *prim_parse_string(Scheme *sc, Cell *args) {
+    Cell *s = car(args);
+    if (s->type != T_STRING) {
+        panic(sc, "parse-string: expected string");
+    }
+    Reader rd;
+    reader_init(&rd, s->as.str.data);
+    Cell *head = scheme_nil(sc);
+    Cell *tail = NULL;
+    push_root(sc, head);
+    while (1) {
+        Cell *expr = read_expr(sc, &rd);
+        if (!expr) {
+            break;
+        }
+        push_root(sc, expr);
+        Cell *node = cons(sc, expr, scheme_nil(sc));
+        pop_roots(sc, 1);
+        if (!tail) {
+            head = node;
+            pop_roots(sc, 1);
+            push_root(sc, head);
+        } else {
+            gc_write_barrier(sc, tail, node);
+            tail->as.pair.cdr = node;
+        }
+        tail = node;
+    }
+    pop_roots(sc, 1);
+    return head;
+}
+
+static int eval_forms_in_env(Scheme *sc, Cell *forms, Cell *env) {
+    int count = 0;
+    for (; forms->type == T_PAIR; forms = cdr(forms)) {
+        eval(sc, car(forms), env);
+        count++;
+    }
+    return count;
+}
+
+// prim_eval_forms: evaluate parsed forms in the global environment.
+// Args: sc (interpreter state), args (list from parse-string).
+// Returns: int cell with number of forms evaluated.
+static Cell *prim_eval_forms(Scheme *sc, Cell *args) {
+    return make_int(sc, eval_forms_in_env(sc, car(args), sc->global_env));
+}
+
+// scoped_env: build a fresh environment holding only the given bindings.
+// Args: sc (interpreter state), alist (symbol . value pairs, rooted by the caller).
+// Returns: the environment.
+static Cell *scoped_env(Scheme *sc, Cell *alist) {
+    Cell *env = cons(sc, scheme_nil(sc), scheme_nil(sc));
+    push_root(sc, env);
+    while (!is_nil(sc, alist)) {
+        Cell *binding = car(alist);
+        if (binding->type != T_PAIR) {
+            panic(sc, "eval-scoped: invalid binding");
+        }
+        Cell *sym = car(binding);
+        Cell *val = cdr(binding);
+        if (sym->type != T_SYMBOL) {
+            panic(sc, "eval-scoped: binding name must be symbol");
+        }
+        env_define(sc, env, sym, val);
+        alist = cdr(alist);
+    }
+    pop_roots(sc, 1);
+    return env;
+}
+
+static void report_error(Scheme *sc, Cell *obj);
+
+typedef struct ScopedRun {
+    Cell *code;
+    Cell *env;
+} ScopedRun;
+
+static Cell *run_scoped_string(Scheme *sc, void *data) {
+    ScopedRun *run = (ScopedRun *)data;
+    return make_int(sc, eval_string_in_env(sc, run->code->as.str.data, run->env));
+}
+
+static Cell *run_scoped_forms(Scheme *sc, void *data) {
+    ScopedRun *run = (ScopedRun *)data;
+    return make_int(sc, eval_forms_in_env(sc, run->code, run->env));
+}
+
+// run_scoped: evaluate untrusted code so that an error it does not catch
+// is reported and ends only that code, not its caller.
+// Args: sc (interpreter state), body (runner), run (code and environment).
+// Returns: the runner's count, or #f after an uncaught error.
+static Cell *run_scoped(Scheme *sc, CatchBody body, ScopedRun *run) {
+    Cell *env = sc->current_env;
+    push_root(sc, run->env);
+    Cell *result;
+    Cell *obj = catch_errors(sc, body, run, &result);
+    if (obj) {
+        report_error(sc, obj);
+        pop_roots(sc, 1);
+        result = scheme_false(sc);
+    }
+    pop_roots(sc, 1);
+    // As in eval_guard: leave no unrooted environment in current_env.
+    sc->current_env = env;
+    return result;
+}
+
+// prim_eval_scoped: evaluate a string in a fresh environment with given bindings.
+// Args: sc (interpreter state), args (alist, string).
+// Returns: int cell with number of expressions evaluated, or #f if one
+// raised an error it did not catch (the error is printed).
+static Cell *prim_eval_scoped(Scheme *sc, Cell *args) {
+    Cell *code = car(cdr(args));
+    if (code->type != T_STRING) {
+        panic(sc, "eval-scoped: expected string");
+    }
+    ScopedRun run = {code, scoped_env(sc, car(args))};
+    return run_scoped(sc, run_scoped_string, &run);
+}
+
+// prim_eval_scoped_forms: eval-scoped for forms from parse-string.
+// Args: sc (interpreter state), args (alist, list of forms).
+// Returns: int cell with number of forms evaluated, or #f as for eval-scoped.
+static Cell *prim_eval_scoped_forms(Scheme *sc, Cell *args) {
+    ScopedRun run = {car(cdr(args)), scoped_env(sc, car(args))};
+    return run_scoped(sc, run_scoped_forms, &run);
+}
+
+static Cell *call_thunk(Scheme *sc, void *data) {
+    return apply(sc, (Cell *)data, scheme_nil(sc));
+}
+
+static int is_procedure(Cell *c) {
+    return c->type == T_PRIMITIVE || c->type == T_CLOSURE;
+}
+
+// prim_with_exception_handler: (with-exception-handler handler thunk).
+// Unlike R7RS, the handler runs after the stacks unwind to this call, so
+// its value is returned from with-exception-handler (raise never resumes).
+// Args: sc (interpreter state), args (handler, thunk).
+// Returns: thunk's value, or handler's value for the raised object.
+static Cell *prim_with_exception_handler(Scheme *sc, Cell *args) {
+    Cell *handler = car(args);
+    Cell *thunk = car(cdr(args));
+    if (!is_procedure(handler) || !is_procedure(thunk)) {
+        panic(sc, "with-exception-handler: expected procedures");
+    }
+    Cell *result;
+    Cell *obj = catch_errors(sc, call_thunk, thunk, &result);
+    if (!obj) {
+        return result;
+    }
+    Cell *handler_args = cons(sc, obj, scheme_nil(sc));
+    pop_roots(sc, 1);
+    return apply(sc, handler, handler_args);
+}
+
+static Cell *prim_raise(Scheme *sc, Cell *args) {
+    raise_value(sc, car(args));
+    return scheme_nil(sc);
+}
+
+// prim_error: (error message irritant ...) raises a new error object.
+// Args: sc (interpreter state), args (message string, irritants).
+// Returns: never.
+static Cell *prim_error(Scheme *sc, Cell *args) {
+    if (car(args)->type != T_STRING) {
+        panic(sc, "error: expected message string");
+    }
+    raise_value(sc, make_error(sc, car(args), cdr(args)));
+    return scheme_nil(sc);
+}
+
+static Cell *prim_error_objectp(Scheme *sc, Cell *args) {
+    return make_bool(sc, car(args)->type == T_ERROR);
+}
+
+static Cell *expect_error(Scheme *sc, Cell *e, const char *msg) {
+    if (e->type != T_ERROR) {
+        panic(sc, msg);
+    }
+    return e;
+}
+
+static Cell *prim_error_object_message(Scheme *sc, Cell *args) {
+    return car(expect_error(sc, car(args), "error-object-message: expected error object"));
+}
+
+static Cell *prim_error_object_irritants(Scheme *sc, Cell *args) {
+    return cdr(expect_error(sc, car(args), "error-object-irritants: expected error object"));
+}
+
+static int platform_read_byte(Scheme *sc, int offset) {
+    if (!sc->platform.read_byte) {
+        panic(sc, "disk-read-byte: not supported");
+    }
+    return sc->platform.read_byte(sc->platform.user, offset);
+}
+
+static int platform_disk_size(Scheme *sc) {
+    if (!sc->platform.disk_size) {
+        panic(sc, "disk-size: not supported");
+    }
+    return sc->platform.disk_size(sc->platform.user);
+}
+
+static int platform_read_char(Scheme *sc) {
+    if (!sc->platform.read_char) {
+        panic(sc, "read-char: not supported");
+    }
+    return sc->platform.read_char(sc->platform.user);
+}
+
+static int platform_write_bytes(Scheme *sc, int offset, const char *data, int len) {
+    if (!sc->platform.write_bytes) {
+        panic(sc, "disk-write-bytes: not supported");
+    }
+    if (sc->quota.disk_bytes && len > 0 && sc->stats.disk_bytes + (size_t)len > sc->quota.disk_bytes) {
+        quota_exceeded(sc, "disk quota exceeded");
+    }
+    int written = sc->platform.write_bytes(sc->platform.user, offset, data, len);
+    if (written > 0) {
+        sc->stats.disk_bytes += (size_t)written;
+    }
+    return written;
+}
+
+static int platform_spawn_thread(Scheme *sc, const char *code, const SchemeQuota *quota) {
+    if (!sc->platform.spawn_thread) {
+        panic(sc, "spawn-thread: not supported");
+    }
+    return sc->platform.spawn_thread(sc->platform.user, code, quota);
+}
+
+static Cell *prim_disk_read_byte(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    if (off->type != T_INT) {
+        panic(sc, "disk-read-byte: expected int");
+    }
+    return make_int(sc, platform_read_byte(sc, off->as.i));
+}
+
+static Cell *prim_disk_size(Scheme *sc, Cell *args) {
+    (void)args;
+    return make_int(sc, platform_disk_size(sc));
+}
+
+static Cell *prim_disk_read_bytes(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    Cell *len = car(cdr(args));
+    if (off->type != T_INT || len->type != T_INT) {
+        panic(sc, "disk-read-bytes: expected int int");
+    }
+    if (len->as.i < 0) {
+        panic(sc, "disk-read-bytes: negative length");
+    }
+    size_t n = (size_t)len->as.i;
+    char *buf = alloc_str_bytes(sc, n);
+    for (size_t i = 0; i < n; i++) {
+        int v = platform_read_byte(sc, off->as.i + (int)i);
+        if (v < 0) {
+            buf[i] = 0;
+        } else {
+            buf[i] = (char)v;
+        }
+    }
+    buf[n] = '\0';
+    Cell *c = alloc_cell(sc);
+    c->type = T_STRING;
+    c->as.str.data = buf;
+    c->as.str.len = n;
+    return c;
+}
+
+static Cell *prim_disk_read_cstring(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    Cell *maxlen = car(cdr(args));
+    if (off->type != T_INT || maxlen->type != T_INT) {
+        panic(sc, "disk-read-cstring: expected int int");
+    }
+    if (maxlen->as.i < 0) {
+        panic(sc, "disk-read-cstring: negative length");
+    }
+    size_t n = (size_t)maxlen->as.i;
+    char *buf = alloc_str_bytes(sc, n);
+    size_t actual = 0;
+    for (; actual < n; actual++) {
+        int v = platform_read_byte(sc, off->as.i + (int)actual);
+        if (v <= 0) {
+            break;
+        }
+        buf[actual] = (char)v;
+    }
+    buf[actual] = '\0';
+    Cell *c = alloc_cell(sc);
+    c->type = T_STRING;
+    c->as.str.data = buf;
+    c->as.str.len = actual;
+    return c;
+}
+
+// prim_disk_write_bytes: write a string to disk at an absolute offset.
+// Args: sc (interpreter state), args (offset int, string).
+// Returns: int cell with bytes written.
+static Cell *prim_disk_write_bytes(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    Cell *data = car(cdr(args));
+    if (off->type != T_INT || data->type != T_STRING) {
+        panic(sc, "disk-write-bytes: expected int string");
+    }
+    int written = platform_write_bytes(sc, off->as.i, data->as.str.data, (int)data->as.str.len);
+    return make_int(sc, written);
+}
+
+// prim_disk_hash: FNV-1a hash of len disk bytes at an absolute offset,
+// computed without copying them into the heap.
+// Args: sc (interpreter state), args (offset int, length int).
+// Returns: int cell with the 32-bit hash.
+static Cell *prim_disk_hash(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    if (off->type != T_INT) {
+        panic(sc, "disk-hash: expected int int");
+    }
+    size_t n = check_length(sc, car(cdr(args)), "disk-hash: expected int int");
+    unsigned int h = FNV_OFFSET;
+    for (size_t i = 0; i < n; i++) {
+        int v = platform_read_byte(sc, off->as.i + (int)i);
+        h ^= (unsigned char)(v < 0 ? 0 : v);
+        h *= FNV_PRIME;
+    }
+    return make_int(sc, (int)h);
+}
+
+// prim_disk_read_bytevector: read len bytes at an absolute offset in one
+// call; bytes past the end of the disk read as 0.
+// Args: sc (interpreter state), args (offset int, length int).
+// Returns: the new bytevector.
+static Cell *prim_disk_read_bytevector(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    if (off->type != T_INT) {
+        panic(sc, "disk-read-bytevector: expected int int");
+    }
+    size_t n = check_length(sc, car(cdr(args)), "disk-read-bytevector: expected int int");
+    Cell *bv = make_bytevector(sc, n, 0);
+    for (size_t i = 0; i < n; i++) {
+        int v = platform_read_byte(sc, off->as.i + (int)i);
+        if (v > 0) {
+            bv->as.bytes.data[i] = (unsigned char)v;
+        }
+    }
+    return bv;
+}
+
+// prim_disk_write_bytevector: write a whole bytevector at an absolute offset.
+// Args: sc (interpreter state), args (offset int, bytevector).
+// Returns: int cell with bytes written.
+static Cell *prim_disk_write_bytevector(Scheme *sc, Cell *args) {
+    Cell *off = car(args);
+    Cell *bv = car(cdr(args));
+    if (off->type != T_INT || bv->type != T_BYTEVECTOR) {
+        panic(sc, "disk-write-bytevector: expected int bytevector");
+    }
+    int written = platform_write_bytes(sc, off->as.i, (const char *)bv->as.bytes.data, (int)bv->as.bytes.len);
+    return make_int(sc, written);
+}
+
+// parse_quota: read an alist such as ((cpu-ticks . 50) (output-bytes . 4096)).
+// Args: sc (interpreter state), alist (quota entries), out (receives limits;
+// fields not mentioned are 0).
+// Returns: none; panics on an unknown name or a negative limit.
+static void parse_quota(Scheme *sc, Cell *alist, SchemeQuota *out) {
+    out->arena_bytes = 0;
+    out->cpu_ticks = 0;
+    out->disk_bytes = 0;
+    out->output_bytes = 0;
+    for (; alist->type == T_PAIR; alist = cdr(alist)) {
+        Cell *entry = car(alist);
+        if (entry->type != T_PAIR || car(entry)->type != T_SYMBOL || cdr(entry)->type != T_INT ||
+            cdr(entry)->as.i < 0) {
+            panic(sc, "spawn-thread: quota entries are (name . non-negative int)");
+        }
+        const char *name = car(entry)->as.sym.name;
+        size_t limit = (size_t)cdr(entry)->as.i;
+        if (streq(name, "arena-bytes")) {
+            out->arena_bytes = limit;
+        } else if (streq(name, "cpu-ticks")) {
+            out->cpu_ticks = limit;
+        } else if (streq(name, "disk-bytes")) {
+            out->disk_bytes = limit;
+        } else if (streq(name, "output-bytes")) {
+            out->output_bytes = limit;
+        } else {
+            panic(sc, "spawn-thread: unknown quota");
+        }
+    }
+}
+
+// prim_spawn_thread: spawn a new Scheme thread to eval a string.
+// Args: sc (interpreter state), args (code string, optional quota alist as
+// for parse_quota; the platform may cap the limits further).
+// Returns: int cell with thread id or -1.
+static Cell *prim_spawn_thread(Scheme *sc, Cell *args) {
+    Cell *code = car(args);
+    if (code->type != T_STRING) {
+        panic(sc, "spawn-thread: expected string");
+    }
+    SchemeQuota quota;
+    parse_quota(sc, is_nil(sc, cdr(args)) ? scheme_nil(sc) : car(cdr(args)), &quota);
+    int tid = platform_spawn_thread(sc, code->as.str.data, &quota);
+    return make_int(sc, tid);
+}
+
+// Channel messages are a compact, self-contained encoding of a value: a tag
+// byte, with integers and lengths as zigzag/LEB128 varints. A list is its
+// element count, the elements, then its tail, so long lists are walked
+// iteratively and only nesting through car recurses.
+#define MSG_NIL 0
+#define MSG_TRUE 1
+#define MSG_FALSE 2
+#define MSG_INT 3
+#define MSG_CHAR 4
+#define MSG_STRING 5
+#define MSG_SYMBOL 6
+#define MSG_LIST 7
+#define MSG_VECTOR 8
+#define MSG_BYTEVECTOR 9
+#define MSG_BIGNUM 10
+#define MSG_MAX_DEPTH 64
+
+typedef struct MsgWriter {
+    char *buf;
+    size_t cap;
+    size_t pos;
+} MsgWriter;
+
+typedef struct MsgReader {
+    const char *buf;
+    size_t len;
+    size_t pos;
+} MsgReader;
+
+static int msg_put(MsgWriter *w, unsigned int b) {
+    if (w->pos >= w->cap) {
+        return -1;
+    }
+    w->buf[w->pos++] = (char)b;
+    return 0;
+}
+
+static int msg_put_varint(MsgWriter *w, unsigned int v) {
+    while (v >= 0x80) {
+        if (msg_put(w, (v & 0x7F) | 0x80) < 0) {
+            return -1;
+        }
+        v >>= 7;
+    }
+    return msg_put(w, v);
+}
+
+static int msg_put_bytes(MsgWriter *w, const char *data, size_t len) {
+    if (msg_put_varint(w, (unsigned int)len) < 0 || w->cap - w->pos < len) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        w->buf[w->pos++] = data[i];
+    }
+    return 0;
+}
+
+// msg_write: append the encoding of a value to a message buffer.
+// Args: sc (interpreter state), w (writer), v (value), depth (car nesting).
+// Returns: 0 on success, -1 if the value does not fit; panics on procedures.
+static int msg_write(Scheme *sc, MsgWriter *w, Cell *v, int depth) {
+    if (depth > MSG_MAX_DEPTH) {
+        return -1;
+    }
+    switch (v->type) {
+    case T_NIL:
+        return msg_put(w, MSG_NIL);
+    case T_BOOL:
+        return msg_put(w, v == scheme_true(sc) ? MSG_TRUE : MSG_FALSE);
+    case T_INT: {
+        unsigned int u = (unsigned int)v->as.i;
+        if (msg_put(w, MSG_INT) < 0) {
+            return -1;
+        }
+        return msg_put_varint(w, (u << 1) ^ (v->as.i < 0 ? 0xFFFFFFFFu : 0));
+    }
+    case T_CHAR:
+        if (msg_put(w, MSG_CHAR) < 0) {
+            return -1;
+        }
+        return msg_put_varint(w, (unsigned int)v->as.i);
+    case T_STRING:
+        if (msg_put(w, MSG_STRING) < 0) {
+            return -1;
+        }
+        return msg_put_bytes(w, v->as.str.data, v->as.str.len);
+    case T_SYMBOL: {
+        size_t len = 0;
+        while (v->as.sym.name[len]) {
+            len++;
+        }
+        if (msg_put(w, MSG_SYMBOL) < 0) {
+            return -1;
+        }
+        return msg_put_bytes(w, v->as.sym.name, len);
+    }
+    case T_PAIR: {
+        // Every element takes at least one byte, so a cyclic list runs out
+        // of buffer rather than looping here forever.
+        unsigned int count = 0;
+        Cell *p = v;
+        while (p->type == T_PAIR && count <= w->cap) {
+            count++;
+            p = cdr(p);
+        }
+        if (msg_put(w, MSG_LIST) < 0 || msg_put_varint(w, count) < 0) {
+            return -1;
+        }
+        for (p = v; count > 0; count--, p = cdr(p)) {
+            if (msg_write(sc, w, car(p), depth + 1) < 0) {
+                return -1;
             }
-            if (is_symbol(op, "begin")) {
-                Cell *seq = cdr(expr);
-                Cell *result = scheme_nil(sc);
-                while (!is_nil(sc, seq)) {
-                    result = eval(sc, car(seq), env);
-                    seq = cdr(seq);
-                }
-                return result;
+        }
+        return msg_write(sc, w, p, depth + 1);
+    }
+    case T_VECTOR:
+        if (msg_put(w, MSG_VECTOR) < 0 || msg_put_varint(w, (unsigned int)v->as.vec.len) < 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < v->as.vec.len; i++) {
+            if (msg_write(sc, w, v->as.vec.items[i], depth + 1) < 0) {
+                return -1;
             }
-            if (is_symbol(op, "define")) {
-                Cell *name = car(cdr(expr));
-                if (name->type == T_PAIR) {
-                    Cell *fname = car(name);
-                    Cell *params = cdr(name);
-                    Cell *body = cdr(cdr(expr));
-                    Cell *closure = make_closure(sc, params, body, env);
-                    env_define(sc, env, fname, closure);
-                    return fname;
-                } else {
-                    Cell *value = eval(sc, car(cdr(cdr(expr))), env);
-                    env_define(sc, env, name, value);
-                    return name;
+        }
+        return 0;
+    case T_STRING_BUILDER:
+        // A builder is sent as a snapshot of its contents.
+        if (msg_put(w, MSG_STRING) < 0) {
+            return -1;
+        }
+        return msg_put_bytes(w, sbuf_data(v->as.sbuf.buf), v->as.sbuf.buf->len);
+    case T_BYTEVECTOR:
+        if (msg_put(w, MSG_BYTEVECTOR) < 0) {
+            return -1;
+        }
+        return msg_put_bytes(w, (const char *)v->as.bytes.data, v->as.bytes.len);
+    case T_BIGNUM: {
+        // Limb count and sign, then each limb little-endian.
+        unsigned int n = (unsigned int)(v->as.big.len < 0 ? -v->as.big.len : v->as.big.len);
+        if (msg_put(w, MSG_BIGNUM) < 0 || msg_put_varint(w, (n << 1) | (v->as.big.len < 0)) < 0) {
+            return -1;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int limb = v->as.big.digits[i];
+            for (int k = 0; k < 32; k += 8) {
+                if (msg_put(w, (limb >> k) & 0xFF) < 0) {
+                    return -1;
                 }
             }
-            if (is_symbol(op, "set!")) {
-                Cell *name = car(cdr(expr));
-                Cell *value = eval(sc, car(cdr(cdr(expr))), env);
-                if (!env_set(sc, env, name, value)) {
-                    panic(sc, "set!: unbound symbol");
+        }
+        return 0;
+    }
+    default:
+        panic(sc, "channel-send: cannot send procedures, hash tables or error objects");
+        return -1;
+    }
+}
+
+static int msg_get(MsgReader *r) {
+    if (r->pos >= r->len) {
+        return -1;
+    }
+    return (unsigned char)r->buf[r->pos++];
+}
+
+static int msg_get_varint(MsgReader *r, unsigned int *out) {
+    unsigned int v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int b = msg_get(r);
+        if (b < 0) {
+            return -1;
+        }
+        v |= (unsigned int)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// msg_read: decode one value from a message into the current heap.
+// Args: sc (interpreter state), r (reader), depth (car nesting).
+// Returns: the decoded value, or NULL if the message is malformed.
+static Cell *msg_read(Scheme *sc, MsgReader *r, int depth) {
+    unsigned int n = 0;
+    if (depth > MSG_MAX_DEPTH) {
+        return NULL;
+    }
+    switch (msg_get(r)) {
+    case MSG_NIL:
+        return scheme_nil(sc);
+    case MSG_TRUE:
+        return scheme_true(sc);
+    case MSG_FALSE:
+        return scheme_false(sc);
+    case MSG_INT:
+        if (msg_get_varint(r, &n) < 0) {
+            return NULL;
+        }
+        return make_int(sc, (int)((n >> 1) ^ (0u - (n & 1))));
+    case MSG_CHAR:
+        if (msg_get_varint(r, &n) < 0) {
+            return NULL;
+        }
+        return make_char(sc, (int)n);
+    case MSG_STRING:
+    case MSG_SYMBOL: {
+        int tag = (unsigned char)r->buf[r->pos - 1];
+        if (msg_get_varint(r, &n) < 0 || r->len - r->pos < n) {
+            return NULL;
+        }
+        const char *data = r->buf + r->pos;
+        r->pos += n;
+        return tag == MSG_STRING ? make_string_len(sc, data, n) : intern_symbol_len(sc, data, n);
+    }
+    case MSG_LIST: {
+        if (msg_get_varint(r, &n) < 0 || n == 0) {
+            return NULL;
+        }
+        Cell *head = NULL;
+        Cell *tail = NULL;
+        for (unsigned int i = 0; i < n; i++) {
+            Cell *item = msg_read(sc, r, depth + 1);
+            if (!item) {
+                if (head) {
+                    pop_roots(sc, 1);
                 }
-                return value;
+                return NULL;
             }
-            if (is_symbol(op, "lambda")) {
-                Cell *params = car(cdr(expr));
-                Cell *body = cdr(cdr(expr));
-                return make_closure(sc, params, body, env);
+            push_root(sc, item);
+            Cell *node = cons(sc, item, scheme_nil(sc));
+            pop_roots(sc, 1);
+            if (!head) {
+                head = node;
+                push_root(sc, head);
+            } else {
+                gc_write_barrier(sc, tail, node);
+                tail->as.pair.cdr = node;
             }
-
-            Cell *fn = eval(sc, op, env);
-            Cell *args = eval_list(sc, cdr(expr), env);
-            return apply(sc, fn, args);
+            tail = node;
         }
-        default:
-            return expr;
+        Cell *rest = msg_read(sc, r, depth + 1);
+        pop_roots(sc, 1);
+        if (!rest) {
+            return NULL;
+        }
+        gc_write_barrier(sc, tail, rest);
+        tail->as.pair.cdr = rest;
+        return head;
+    }
+    case MSG_VECTOR: {
+        // Each element is at least one byte, which bounds the allocation.
+        if (msg_get_varint(r, &n) < 0 || r->len - r->pos < n) {
+            return NULL;
+        }
+        Cell *vec = make_vector(sc, n, scheme_nil(sc));
+        push_root(sc, vec);
+        for (unsigned int i = 0; i < n; i++) {
+            Cell *item = msg_read(sc, r, depth + 1);
+            if (!item) {
+                pop_roots(sc, 1);
+                return NULL;
+            }
+            gc_write_barrier(sc, vec, item);
+            vec->as.vec.items[i] = item;
+        }
+        pop_roots(sc, 1);
+        return vec;
+    }
+    case MSG_BYTEVECTOR: {
+        if (msg_get_varint(r, &n) < 0 || r->len - r->pos < n) {
+            return NULL;
+        }
+        Cell *bv = make_bytevector(sc, n, 0);
+        for (unsigned int i = 0; i < n; i++) {
+            bv->as.bytes.data[i] = (unsigned char)r->buf[r->pos + i];
+        }
+        r->pos += n;
+        return bv;
+    }
+    case MSG_BIGNUM: {
+        if (msg_get_varint(r, &n) < 0 || n < 2 || (r->len - r->pos) / 4 < (n >> 1)) {
+            return NULL;
+        }
+        Cell *c = big_alloc(sc, n >> 1);
+        for (unsigned int i = 0; i < (n >> 1); i++) {
+            const unsigned char *b = (const unsigned char *)r->buf + r->pos + 4 * i;
+            c->as.big.digits[i] = b[0] | (unsigned int)b[1] << 8 | (unsigned int)b[2] << 16 | (unsigned int)b[3] << 24;
+        }
+        r->pos += 4 * (n >> 1);
+        return big_finish(sc, c, n & 1);
+    }
+    default:
+        return NULL;
     }
 }
 
-static Cell *prim_add(Scheme *sc, Cell *args) {
-    int sum = 0;
-    while (!is_nil(sc, args)) {
-        sum += car(args)->as.i;
-        args = cdr(args);
+// prim_make_channel: create a bounded channel shared by all threads.
+// Args: sc (interpreter state), args (capacity int).
+// Returns: int cell with the channel id or -1.
+static Cell *prim_make_channel(Scheme *sc, Cell *args) {
+    Cell *capacity = car(args);
+    if (capacity->type != T_INT) {
+        panic(sc, "make-channel: expected int");
     }
-    return make_int(sc, sum);
+    if (!sc->platform.channel_make) {
+        panic(sc, "make-channel: not supported");
+    }
+    return make_int(sc, sc->platform.channel_make(sc->platform.user, capacity->as.i));
 }
 
-static Cell *prim_sub(Scheme *sc, Cell *args) {
-    if (is_nil(sc, args)) {
-        return make_int(sc, 0);
+// prim_channel_send: copy a value into a channel, blocking while it is full.
+// Args: sc (interpreter state), args (channel int, value).
+// Returns: int cell with the encoded message size.
+static Cell *prim_channel_send(Scheme *sc, Cell *args) {
+    Cell *ch = car(args);
+    Cell *value = car(cdr(args));
+    if (ch->type != T_INT) {
+        panic(sc, "channel-send: expected int");
     }
-    int result = car(args)->as.i;
-    args = cdr(args);
-    if (is_nil(sc, args)) {
-        return make_int(sc, -result);
+    if (!sc->platform.channel_send) {
+        panic(sc, "channel-send: not supported");
     }
-    while (!is_nil(sc, args)) {
-        result -= car(args)->as.i;
-        args = cdr(args);
+    char buf[SCHEME_MESSAGE_MAX];
+    MsgWriter w = {buf, sizeof(buf), 0};
+    if (msg_write(sc, &w, value, 0) < 0) {
+        panic(sc, "channel-send: value too large");
     }
-    return make_int(sc, result);
+    if (sc->platform.channel_send(sc->platform.user, ch->as.i, buf, (int)w.pos) < 0) {
+        panic(sc, "channel-send: bad channel");
+    }
+    return make_int(sc, (int)w.pos);
 }
 
-static Cell *prim_mul(Scheme *sc, Cell *args) {
-    int result = 1;
-    while (!is_nil(sc, args)) {
-        result *= car(args)->as.i;
-        args = cdr(args);
+// prim_channel_recv: take the next value from a channel, blocking while empty.
+// Args: sc (interpreter state), args (channel int).
+// Returns: a fresh copy of the sent value in this interpreter's heap.
+static Cell *prim_channel_recv(Scheme *sc, Cell *args) {
+    Cell *ch = car(args);
+    if (ch->type != T_INT) {
+        panic(sc, "channel-recv: expected int");
     }
-    return make_int(sc, result);
+    if (!sc->platform.channel_recv) {
+        panic(sc, "channel-recv: not supported");
+    }
+    char buf[SCHEME_MESSAGE_MAX];
+    int len = sc->platform.channel_recv(sc->platform.user, ch->as.i, buf, (int)sizeof(buf));
+    if (len < 0) {
+        panic(sc, "channel-recv: bad channel");
+    }
+    MsgReader r = {buf, (size_t)len, 0};
+    Cell *value = msg_read(sc, &r, 0);
+    if (!value || r.pos != r.len) {
+        panic(sc, "channel-recv: malformed message");
+    }
+    return value;
 }
 
-static Cell *prim_lt(Scheme *sc, Cell *args) {
-    int a = car(args)->as.i;
-    int b = car(cdr(args))->as.i;
-    return make_bool(sc, a < b);
+static Cell *prim_char_to_int(Scheme *sc, Cell *args) {
+    Cell *c = car(args);
+    if (c->type != T_CHAR) {
+        panic(sc, "char->int: expected char");
+    }
+    return make_int(sc, c->as.i);
 }
 
-static Cell *prim_num_eq(Scheme *sc, Cell *args) {
-    int a = car(args)->as.i;
-    int b = car(cdr(args))->as.i;
-    return make_bool(sc, a == b);
+static Cell *prim_int_to_char(Scheme *sc, Cell *args) {
+    Cell *v = car(args);
+    if (v->type != T_INT) {
+        panic(sc, "int->char: expected int");
+    }
+    return make_char(sc, v->as.i & 0xFF);
 }
 
-static Cell *prim_quotient(Scheme *sc, Cell *args) {
-    int a = car(args)->as.i;
-    int b = car(cdr(args))->as.i;
-    if (b == 0) {
-        panic(sc, "quotient: divide by zero");
-    }
-    return make_int(sc, a / b);
+// prim_read_char: read a single character from the platform.
+// Args: sc (interpreter state), args (ignored).
+// Returns: one-character string.
+static Cell *prim_read_char(Scheme *sc, Cell *args) {
+    (void)args;
+    int ch = platform_read_char(sc);
+    return make_char(sc, ch);
 }
 
-static Cell *prim_modulo(Scheme *sc, Cell *args) {
-    int a = car(args)->as.i;
-    int b = car(cdr(args))->as.i;
-    if (b == 0) {
-        panic(sc, "modulo: divide by zero");
+// prim_yield: yield the current thread (cooperative scheduling).
+// Args: sc (interpreter state), args (ignored).
+// Returns: int cell (0).
+static Cell *prim_yield(Scheme *sc, Cell *args) {
+    (void)args;
+    if (sc->platform.foreign_call) {
+        sc->platform.foreign_call("yield", 0, NULL);
     }
-    int r = a % b;
-    if (r < 0) {
-        r += (b < 0) ? -b : b;
+    check_stop(sc);
+    return make_int(sc, 0);
+}
+
+static void display_value(Scheme *sc, Cell *v) {
+    if (v->type == T_INT) {
+        unsigned int n = (unsigned int)v->as.i;
+        char buf[12];
+        int i = 0;
+        if (n == 0) {
+            putc_out(sc, '0');
+            return;
+        }
+        if (v->as.i < 0) {
+            putc_out(sc, '-');
+            n = 0u - n;
+        }
+        while (n > 0 && i < 11) {
+            buf[i++] = (char)('0' + (n % 10));
+            n /= 10;
+        }
+        while (i > 0) {
+            putc_out(sc, buf[--i]);
+        }
+    } else if (v->type == T_BIGNUM) {
+        display_value(sc, big_to_string(sc, v));
+    } else if (v->type == T_SYMBOL) {
+        const char *p = v->as.sym.name;
+        while (*p) {
+            putc_out(sc, *p++);
+        }
+    } else if (v->type == T_STRING) {
+        const char *p = v->as.str.data;
+        size_t len = v->as.str.len;
+        for (size_t i = 0; i < len; i++) {
+            putc_out(sc, p[i]);
+        }
+    } else if (v->type == T_CHAR) {
+        putc_out(sc, (char)v->as.i);
+    } else if (is_nil(sc, v)) {
+        putc_out(sc, '(');
+        putc_out(sc, ')');
+    } else if (v == scheme_true(sc)) {
+        putc_out(sc, '#');
+        putc_out(sc, 't');
+    } else if (v == scheme_false(sc)) {
+        putc_out(sc, '#');
+        putc_out(sc, 'f');
+    } else if (v->type == T_ERROR) {
+        // The message, then each irritant after a space.
+        display_value(sc, car(v));
+        for (Cell *p = cdr(v); p->type == T_PAIR; p = cdr(p)) {
+            putc_out(sc, ' ');
+            display_value(sc, car(p));
+        }
     }
-    return make_int(sc, r);
 }
 
-static Cell *prim_cons(Scheme *sc, Cell *args) {
-    Cell *a = car(args);
-    Cell *d = car(cdr(args));
-    return cons(sc, a, d);
+static Cell *prim_display(Scheme *sc, Cell *args) {
+    display_value(sc, car(args));
+    return scheme_nil(sc);
 }
 
-static Cell *prim_car(Scheme *sc, Cell *args) {
-    return car(car(args));
+static Cell *prim_number_to_string(Scheme *sc, Cell *args) {
+    Cell *v = car(args);
+    if (v->type == T_BIGNUM) {
+        return big_to_string(sc, v);
+    }
+    if (v->type != T_INT) {
+        panic(sc, "number->string: expected int");
+    }
+    return make_string_from_int(sc, v->as.i);
 }
 
-static Cell *prim_cdr(Scheme *sc, Cell *args) {
-    return cdr(car(args));
+static Cell *prim_newline(Scheme *sc, Cell *args) {
+    (void)args;
+    putc_out(sc, '\n');
+    return scheme_nil(sc);
 }
 
-static Cell *prim_nullp(Scheme *sc, Cell *args) {
-    return make_bool(sc, is_nil(sc, car(args)));
+static Cell *prim_foreign_call(Scheme *sc, Cell *args) {
+    if (is_nil(sc, args)) {
+        panic(sc, "foreign-call: missing symbol");
+    }
+    Cell *name_cell = car(args);
+    if (name_cell->type != T_SYMBOL) {
+        panic(sc, "foreign-call: name must be symbol");
+    }
+    if (!sc->platform.foreign_call) {
+        panic(sc, "foreign-call: not supported");
+    }
+
+    int argv[8];
+    int argc = 0;
+    args = cdr(args);
+    while (!is_nil(sc, args)) {
+        if (argc >= (int)(sizeof(argv) / sizeof(argv[0]))) {
+            panic(sc, "foreign-call: too many args");
+        }
+        Cell *v = car(args);
+        if (v->type != T_INT) {
+            panic(sc, "foreign-call: args must be int");
+        }
+        argv[argc++] = v->as.i;
+        args = cdr(args);
+    }
+
+    int ret = sc->platform.foreign_call(name_cell->as.sym.name, argc, argv);
+    return make_int(sc, ret);
 }
 
-static Cell *prim_pairp(Scheme *sc, Cell *args) {
-    return make_bool(sc, car(args)->type == T_PAIR);
+// Primitives bound in the global environment by scheme_init. Heap images
+// refer to a primitive by its position here and record a hash of the names,
+// so an image is only loaded by an interpreter with the same table.
+typedef struct PrimDef {
+    const char *name;
+    PrimFn fn;
+} PrimDef;
+
+static const PrimDef prim_table[] = {
+    {"+", prim_add},
+    {"-", prim_sub},
+    {"*", prim_mul},
+    {"<", prim_lt},
+    {"=", prim_num_eq},
+    {">", prim_gt},
+    {"<=", prim_le},
+    {">=", prim_ge},
+    {"not", prim_not},
+    {"zero?", prim_zerop},
+    {"1+", prim_one_plus},
+    {"quotient", prim_quotient},
+    {"modulo", prim_modulo},
+    {"cons", prim_cons},
+    {"car", prim_car},
+    {"cdr", prim_cdr},
+    {"null?", prim_nullp},
+    {"pair?", prim_pairp},
+    {"eq?", prim_eqp},
+    {"string-length", prim_string_len},
+    {"string-ref", prim_string_ref},
+    {"string=?", prim_string_eq},
+    {"char=?", prim_char_eq},
+    {"substring", prim_substring},
+    {"string-append", prim_string_append},
+    {"string-index", prim_string_index},
+    {"make-string", prim_make_string},
+    {"make-hash-table", prim_make_hash_table},
+    {"make-string-hash-table", prim_make_string_hash_table},
+    {"hash-table?", prim_hash_tablep},
+    {"hash-ref", prim_hash_ref},
+    {"hash-set!", prim_hash_set},
+    {"hash-remove!", prim_hash_remove},
+    {"hash-count", prim_hash_count},
+    {"hash-keys", prim_hash_keys},
+    {"make-string-builder", prim_make_string_builder},
+    {"string-builder-append!", prim_string_builder_append},
+    {"string-builder-length", prim_string_builder_length},
+    {"string-builder-truncate!", prim_string_builder_truncate},
+    {"string-builder->string", prim_string_builder_to_string},
+    {"char->int", prim_char_to_int},
+    {"int->char", prim_int_to_char},
+    {"list-alloc", prim_list_alloc},
+    {"list->string", prim_list_to_string},
+    {"eval-string", prim_eval_string},
+    {"eval-scoped", prim_eval_scoped},
+    {"parse-string", prim_parse_string},
+    {"eval-forms", prim_eval_forms},
+    {"eval-scoped-forms", prim_eval_scoped_forms},
+    {"with-exception-handler", prim_with_exception_handler},
+    {"raise", prim_raise},
+    {"error", prim_error},
+    {"error-object?", prim_error_objectp},
+    {"error-object-message", prim_error_object_message},
+    {"error-object-irritants", prim_error_object_irritants},
+    {"disk-hash", prim_disk_hash},
+    {"disk-read-byte", prim_disk_read_byte},
+    {"disk-read-bytes", prim_disk_read_bytes},
+    {"disk-read-cstring", prim_disk_read_cstring},
+    {"disk-write-bytes", prim_disk_write_bytes},
+    {"disk-size", prim_disk_size},
+    {"disk-read-bytevector", prim_disk_read_bytevector},
+    {"disk-write-bytevector", prim_disk_write_bytevector},
+    {"make-vector", prim_make_vector},
+    {"vector", prim_vector},
+    {"vector?", prim_vectorp},
+    {"vector-length", prim_vector_length},
+    {"vector-ref", prim_vector_ref},
+    {"vector-set!", prim_vector_set},
+    {"make-bytevector", prim_make_bytevector},
+    {"bytevector?", prim_bytevectorp},
+    {"bytevector-length", prim_bytevector_length},
+    {"bytevector-u8-ref", prim_bytevector_u8_ref},
+    {"bytevector-u8-set!", prim_bytevector_u8_set},
+    {"bytevector-u32-le-ref", prim_bytevector_u32_le_ref},
+    {"bytevector-u32-le-set!", prim_bytevector_u32_le_set},
+    {"bytevector-copy!", prim_bytevector_copy},
+    {"string->utf8", prim_string_to_utf8},
+    {"utf8->string", prim_utf8_to_string},
+    {"gc-stats", prim_gc_stats},
+    {"thread-stats", prim_thread_stats},
+    {"current-time-ns", prim_current_time_ns},
+    {"profile-start", prim_profile_start},
+    {"profile-dump", prim_profile_dump},
+    {"read-char", prim_read_char},
+    {"spawn-thread", prim_spawn_thread},
+    {"make-channel", prim_make_channel},
+    {"channel-send", prim_channel_send},
+    {"channel-recv", prim_channel_recv},
+    {"yield", prim_yield},
+    {"display", prim_display},
+    {"newline", prim_newline},
+    {"number->string", prim_number_to_string},
+    {"foreign-call", prim_foreign_call},
+};
+
+#define PRIM_COUNT (sizeof(prim_table) / sizeof(prim_table[0]))
+
+// Fixed-arity entry points of primitives (see Cell.as.prim).
+typedef struct PrimFixed {
+    PrimFn fn;
+    PrimFn1 fn1;
+    PrimFn2 fn2;
+} PrimFixed;
+
+static const PrimFixed prim_fixed_table[] = {
+    {prim_add, NULL, add2},
+    {prim_sub, NULL, sub2},
+    {prim_mul, NULL, mul2},
+    {prim_lt, NULL, lt2},
+    {prim_num_eq, NULL, num_eq2},
+    {prim_gt, NULL, gt2},
+    {prim_le, NULL, le2},
+    {prim_ge, NULL, ge2},
+    {prim_quotient, NULL, quotient2},
+    {prim_modulo, NULL, modulo2},
+    {prim_not, not1, NULL},
+    {prim_zerop, zerop1, NULL},
+    {prim_one_plus, one_plus1, NULL},
+};
+
+// prim_set_fixed: fill in a primitive cell's fixed-arity entry points.
+// Args: c (primitive cell with as.prim.fn set).
+// Returns: none.
+static void prim_set_fixed(Cell *c) {
+    c->as.prim.fn1 = NULL;
+    c->as.prim.fn2 = NULL;
+    for (size_t i = 0; i < sizeof(prim_fixed_table) / sizeof(prim_fixed_table[0]); i++) {
+        if (prim_fixed_table[i].fn == c->as.prim.fn) {
+            c->as.prim.fn1 = prim_fixed_table[i].fn1;
+            c->as.prim.fn2 = prim_fixed_table[i].fn2;
+        }
+    }
+}
+
+static void add_prim(Scheme *sc, const char *name, PrimFn fn) {
+    Cell *sym = intern_symbol(sc, name);
+    Cell *prim = make_prim(sc, fn);
+    prim_set_fixed(prim);
+    env_define(sc, sc->global_env, sym, prim);
 }
 
-static Cell *prim_eqp(Scheme *sc, Cell *args) {
-    return make_bool(sc, car(args) == car(cdr(args)));
+// heap_config_init: set up the first heap segment and growth limits.
+// Args: sc (interpreter state), cfg (configuration).
+// Returns: none.
+static void heap_config_init(Scheme *sc, const SchemeConfig *cfg) {
+    sc->first_segment.next = NULL;
+    sc->first_segment.cells = cfg->heap;
+    sc->first_segment.count = cfg->heap_cells;
+    sc->first_segment.free_head = NULL;
+    sc->first_segment.free_tail = NULL;
+    sc->first_segment.free_count = 0;
+    sc->first_segment.pages = NULL;
+    sc->segments = &sc->first_segment;
+    sc->total_cells = cfg->heap_cells;
+    sc->heap_grow_cells = cfg->heap_grow_cells;
+    sc->heap_max_cells = cfg->heap_max_cells;
+    sc->arena_grow_bytes = cfg->arena_grow_bytes;
+    sc->arena_grown = 0;
+    sc->quota = cfg->quota;
+    sc->stop_reason = NULL;
+    sc->sym_chunks = NULL;
+    sc->str_chunks = NULL;
+    sc->blob_bytes = 0;
+    sc->blob_limit = BLOB_MIN_LIMIT;
+    sc->gc_mode = SCHEME_GC_MARK_SWEEP;
+    sc->used_pages = NULL;
+    sc->free_pages = NULL;
+    sc->used_page_count = 0;
+    sc->page_count = 0;
+    sc->alloc_next = NULL;
+    sc->alloc_end = NULL;
+    sc->blob_cells = NULL;
+    sc->blob_cell_count = 0;
+    sc->blob_cell_cap = 0;
+    sc->segment_index = NULL;
+    sc->segment_index_count = 0;
+    sc->segment_index_cap = 0;
+    sc->segment_hint = NULL;
+    sc->copy_alloc_base = 0;
+    sc->stack_base = NULL;
+    sc->gc_pause_cells = cfg->gc_mode == SCHEME_GC_MARK_SWEEP && sc->platform.alloc ? cfg->gc_pause_cells : 0;
+    sc->gc_phase = GC_IDLE;
+    sc->gray = NULL;
+    sc->gray_top = 0;
+    sc->gray_cap = 0;
+    sc->gc_sym_scan = NULL;
+    sc->sweep_seg = NULL;
+    sc->sweep_left = 0;
+    sc->sweep_spliced = 0;
+    sc->free_cells = 0;
+    sc->gc_trigger = 0;
+    sc->gc_debt = 0;
+    sc->gc_marked = 0;
+    sc->gc_already_free = 0;
+    sc->gc_swept_free = 0;
+    sc->shared = NULL;
+    sc->frozen = 0;
+    shared_cache_clear(sc);
 }
 
-static Cell *prim_string_len(Scheme *sc, Cell *args) {
-    Cell *v = car(args);
-    if (v->type != T_STRING) {
-        panic(sc, "string-length: expected string");
-    }
-    return make_int(sc, (int)v->as.str.len);
-}
+// Initial capacity of the copying collector's list of storage-owning cells.
+#define BLOB_CELLS_MIN_CAP 64
 
-static Cell *prim_string_ref(Scheme *sc, Cell *args) {
-    Cell *s = car(args);
-    Cell *i = car(cdr(args));
-    if (s->type != T_STRING || i->type != T_INT) {
-        panic(sc, "string-ref: expected string and int");
+// heap_pages_adopt: hand a freshly built first segment over to the copying
+// collector when cfg asks for it. Pages holding no live cell become free
+// pages; free cells in the others become inert until their page is
+// evacuated.
+// Args: sc (interpreter state whose free list covers every unused cell),
+// cfg (configuration).
+// Returns: none. sc keeps the mark-and-sweep collector if the page tables
+// cannot be allocated.
+static void heap_pages_adopt(Scheme *sc, const SchemeConfig *cfg) {
+    HeapSegment *seg = sc->segments;
+    if (cfg->gc_mode != SCHEME_GC_COPYING || !sc->platform.alloc || !sc->platform.free || seg->next) {
+        return;
     }
-    if (i->as.i < 0 || (size_t)i->as.i >= s->as.str.len) {
-        panic(sc, "string-ref: index out of range");
+    for (Cell *c = sc->free_list; c; c = c->as.pair.cdr) {
+        c->mark = 1;
     }
-    return make_char(sc, (unsigned char)s->as.str.data[i->as.i]);
-}
-
-static Cell *prim_string_eq(Scheme *sc, Cell *args) {
-    Cell *a = car(args);
-    Cell *b = car(cdr(args));
-    if (a->type != T_STRING || b->type != T_STRING) {
-        panic(sc, "string=?: expected strings");
+    size_t n = segment_page_count(seg);
+    size_t blobs = 0;
+    for (size_t i = 0; i < seg->count; i++) {
+        blobs += !seg->cells[i].mark && is_blob(&seg->cells[i]);
     }
-    if (a->as.str.len != b->as.str.len) {
-        return scheme_false(sc);
+    size_t cap = BLOB_CELLS_MIN_CAP;
+    while (cap < blobs * 2) {
+        cap *= 2;
     }
-    for (size_t i = 0; i < a->as.str.len; i++) {
-        if (a->as.str.data[i] != b->as.str.data[i]) {
-            return scheme_false(sc);
+    HeapPage *pages = (HeapPage *)sc->platform.alloc(sc->platform.user, n * sizeof(HeapPage));
+    Cell **blob_cells = pages ? (Cell **)sc->platform.alloc(sc->platform.user, cap * sizeof(Cell *)) : NULL;
+    if (!blob_cells || !segment_index_add(sc, seg)) {
+        if (blob_cells) {
+            sc->platform.free(sc->platform.user, blob_cells);
+        }
+        if (pages) {
+            sc->platform.free(sc->platform.user, pages);
         }
+        for (Cell *c = sc->free_list; c; c = c->as.pair.cdr) {
+            c->mark = 0;
+        }
+        return;
+    }
+    sc->gc_mode = SCHEME_GC_COPYING;
+    sc->segment_hint = seg;
+    sc->blob_cells = blob_cells;
+    sc->blob_cell_cap = cap;
+    seg->pages = pages;
+    segment_pages_init(sc, seg);
+    sc->free_pages = NULL;
+    for (size_t p = n; p > 0; p--) {
+        HeapPage *pg = &pages[p - 1];
+        size_t in_use = 0;
+        for (size_t k = 0; k < pg->count; k++) {
+            in_use += !pg->cells[k].mark;
+        }
+        for (size_t k = 0; k < pg->count; k++) {
+            Cell *c = &pg->cells[k];
+            if (c->mark) {
+                c->type = T_NIL;
+                c->mark = 0;
+            } else if (is_blob(c)) {
+                sc->blob_cells[sc->blob_cell_count++] = c;
+            }
+        }
+        if (in_use) {
+            sc->stats.live_cells += in_use;
+            pg->space = PAGE_USED;
+            pg->next = sc->used_pages;
+            sc->used_pages = pg;
+            sc->used_page_count++;
+        } else {
+            pg->next = sc->free_pages;
+            sc->free_pages = pg;
+        }
+    }
+    sc->free_list = NULL;
+    // Restore the copy reserve if live cells fill more than half the pages.
+    while (sc->used_page_count * 2 > sc->page_count && heap_grow(sc)) {
     }
-    return scheme_true(sc);
 }
 
-static Cell *prim_char_eq(Scheme *sc, Cell *args) {
-    Cell *a = car(args);
-    Cell *b = car(cdr(args));
-    if (a->type != T_CHAR || b->type != T_CHAR) {
-        panic(sc, "char=?: expected chars");
+// heap_init: set up interpreter state with an empty heap and buffers.
+// Args: sc (interpreter state), cfg (configuration pointers/sizes).
+// Returns: none; sc has no symbols and no global environment yet.
+static void heap_init(Scheme *sc, const SchemeConfig *cfg) {
+    sc->heap = cfg->heap;
+    sc->heap_cells = cfg->heap_cells;
+    sc->sym_buf = cfg->sym_buf;
+    sc->sym_buf_size = cfg->sym_buf_size;
+    sc->sym_buf_used = 0;
+    sc->str_buf = cfg->str_buf;
+    sc->str_buf_size = cfg->str_buf_size;
+    sc->str_buf_used = 0;
+    sc->platform = cfg->platform;
+    sc->root_top = 0;
+    sc->env_top = 0;
+    sc->catch_top = NULL;
+    sc->raised = NULL;
+    heap_config_init(sc, cfg);
+    stats_reset(sc);
+    profile_reset(sc);
+
+    sc->free_list = NULL;
+    for (size_t i = 0; i < sc->heap_cells; i++) {
+        Cell *c = &sc->heap[i];
+        c->type = T_PAIR;
+        c->mark = 0;
+        c->as.pair.cdr = sc->free_list;
+        sc->free_list = c;
     }
-    return make_bool(sc, a->as.i == b->as.i);
+    sc->free_cells = sc->heap_cells;
+    sc->gc_trigger = sc->free_cells / 2;
+    heap_pages_adopt(sc, cfg);
+
+    sc->interned_syms = scheme_nil(sc);
+    sc->sym_index = NULL;
 }
 
-static Cell *prim_list_alloc(Scheme *sc, Cell *args) {
-    Cell *ncell = car(args);
-    if (ncell->type != T_INT) {
-        panic(sc, "list-alloc: expected int");
-    }
-    int n = ncell->as.i;
-    if (n < 0) {
-        panic(sc, "list-alloc: negative length");
-    }
-    Cell *list = scheme_nil(sc);
-    for (int i = n - 1; i >= 0; i--) {
-        push_root(sc, list);
-        Cell *val = make_int(sc, i);
-        push_root(sc, val);
-        list = cons(sc, val, list);
-        pop_roots(sc, 2);
+// scheme_init: initialize interpreter state, heap, buffers, and primitives.
+// Args: sc (interpreter state), cfg (configuration pointers/sizes).
+// Returns: none.
+void scheme_init(Scheme *sc, const SchemeConfig *cfg) {
+    heap_init(sc, cfg);
+    // Allocating below may collect; this frame bounds the stack scan.
+    sc->stack_base = __builtin_frame_address(0);
+    sc->global_env = cons(sc, scheme_nil(sc), scheme_nil(sc));
+    sc->current_env = sc->global_env;
+
+    for (size_t i = 0; i < PRIM_COUNT; i++) {
+        add_prim(sc, prim_table[i].name, prim_table[i].fn);
     }
-    return list;
+    sc->stack_base = NULL;
 }
 
-static Cell *prim_list_to_string(Scheme *sc, Cell *args) {
-    Cell *list = car(args);
-    size_t len = 0;
-    Cell *p = list;
-    while (!is_nil(sc, p)) {
-        Cell *ch = car(p);
-        if (ch->type != T_CHAR) {
-            panic(sc, "list->string: expected list of chars");
+// scheme_freeze: turn an idle interpreter into a heap that others share
+// (see scheme_init_shared).
+// Args: sc (idle mark-and-sweep interpreter not itself sharing a heap).
+// Returns: 0 on success, -1 if sc is busy, copying or already shared.
+// Every cell reachable from the global environment is marked frozen for
+// good, so no collector of sc or of its users scans or frees it again. sc
+// must not evaluate or be dumped afterwards, and must outlive the
+// interpreters sharing it.
+int scheme_freeze(Scheme *sc) {
+    if (sc->root_top != 0 || sc->env_top != 0 || sc->frozen || sc->shared ||
+        sc->gc_mode != SCHEME_GC_MARK_SWEEP) {
+        return -1;
+    }
+    gc_finish(sc);
+    if (!sc->sym_index) {
+        sym_index_rebuild(sc, 0);
+    }
+    mark_cell(sc, sc->global_env);
+    mark_cell(sc, sc->current_env);
+    mark_cell(sc, sc->interned_syms);
+    for (HeapSegment *s = sc->segments; s; s = s->next) {
+        for (size_t i = 0; i < s->count; i++) {
+            Cell *c = &s->cells[i];
+            if (!c->mark) {
+                continue;
+            }
+            c->mark = MARK_FROZEN;
+            // Lookups must not migrate a shared table's entries.
+            if (c->type == T_HASHTABLE && c->as.hash.table->old) {
+                hash_migrate(sc, c->as.hash.table, c->as.hash.table->old->cap);
+            }
         }
-        len++;
-        p = cdr(p);
     }
-    char *buf = alloc_str_bytes(sc, len);
-    p = list;
-    for (size_t i = 0; i < len; i++) {
-        buf[i] = (char)car(p)->as.i;
-        p = cdr(p);
+    // Each symbol's cache is fixed to its binding in the shared environment.
+    for (Cell *p = sc->interned_syms; p->type == T_PAIR; p = p->as.pair.cdr) {
+        Cell *sym = p->as.pair.car;
+        sym->as.sym.global = frame_binding(sc, car(sc->global_env), sym);
+        sym->as.sym.global_env = sym->as.sym.global ? sc->global_env : NULL;
     }
-    buf[len] = '\0';
-    Cell *c = alloc_cell(sc);
-    c->type = T_STRING;
-    c->as.str.data = buf;
-    c->as.str.len = len;
-    return c;
+    sc->frozen = 1;
+    return 0;
 }
 
-// prim_eval_string: evaluate a string in the global environment.
-// Args: sc (interpreter state), args (string cell).
-// Returns: int cell with number of expressions evaluated.
-static Cell *prim_eval_string(Scheme *sc, Cell *args) {
-    Cell *s = car(args);
-    if (s->type != T_STRING) {
-        panic(sc, "eval-string: expected string");
+// scheme_init_shared: initialize an interpreter on top of a frozen heap.
+// Args: sc (interpreter state), shared (interpreter frozen by
+// scheme_freeze), cfg (sc's buffers/platform).
+// Returns: 0 on success, -1 if shared is not frozen.
+// sc starts with every symbol and global of shared, and its own heap holds
+// only the cells it allocates from then on. Its definitions shadow the
+// shared globals for sc alone; shared closures keep seeing the shared ones.
+int scheme_init_shared(Scheme *sc, const Scheme *shared, const SchemeConfig *cfg) {
+    if (!shared->frozen) {
+        return -1;
     }
-    int count = eval_string_in_env(sc, s->as.str.data, sc->global_env);
-    return make_int(sc, count);
+    heap_init(sc, cfg);
+    sc->shared = shared;
+    sc->interned_syms = shared->interned_syms;
+    // The global frame starts out as the shared one; definitions go in
+    // front of it.
+    sc->stack_base = __builtin_frame_address(0);
+    sc->global_env = cons(sc, car(shared->global_env), scheme_nil(sc));
+    sc->current_env = sc->global_env;
+    sc->stack_base = NULL;
+    return 0;
 }
 
-// prim_eval_scoped: evaluate a string in a fresh environment with given bindings.
-// Args: sc (interpreter state), args (alist, string).
-// Returns: int cell with number of expressions evaluated.
-static Cell *prim_eval_scoped(Scheme *sc, Cell *args) {
-    Cell *alist = car(args);
-    Cell *code = car(cdr(args));
-    if (code->type != T_STRING) {
-        panic(sc, "eval-scoped: expected string");
-    }
+// Heap images: a snapshot of an idle interpreter's live cells that a fresh
+// interpreter adopts instead of re-evaluating the code that built them.
+// The image is a header of little-endian u32 fields (IMAGE_HDR_*) followed
+// by one record per cell: a type byte, then LEB128 fields. References are
+// stored relative to the referring cell's index, so nothing depends on where
+// either heap lives. Hash tables are numbered after every other cell, so
+// their keys are decoded by the time the tables are rebuilt.
+#define IMAGE_MAGIC "SLOPIMG1"
+#define IMAGE_VERSION 1
+#define IMAGE_HDR_VERSION 8
+#define IMAGE_HDR_TOTAL_LEN 12
+#define IMAGE_HDR_CELLS 16
+#define IMAGE_HDR_SYM_BYTES 20
+#define IMAGE_HDR_STR_BYTES 24
+#define IMAGE_HDR_PRIM_HASH 28
+#define IMAGE_HDR_GLOBAL_ENV 32
+#define IMAGE_HDR_INTERNED 36
+#define IMAGE_HEADER_SIZE 40
+// Encoded references below IMAGE_REF_CELL name the shared constants.
+#define IMAGE_REF_NIL 0
+#define IMAGE_REF_TRUE 1
+#define IMAGE_REF_FALSE 2
+#define IMAGE_REF_CELL 3
+#define IMAGE_NO_CELL 0xFFFFFFFFu
 
-    Cell *env = cons(sc, scheme_nil(sc), scheme_nil(sc));
-    push_root(sc, alist);
-    push_root(sc, code);
-    push_root(sc, env);
-    while (!is_nil(sc, alist)) {
-        Cell *binding = car(alist);
-        if (binding->type != T_PAIR) {
-            panic(sc, "eval-scoped: invalid binding");
-        }
-        Cell *sym = car(binding);
-        Cell *val = cdr(binding);
-        if (sym->type != T_SYMBOL) {
-            panic(sc, "eval-scoped: binding name must be symbol");
+static unsigned int prim_table_hash(void) {
+    unsigned int h = FNV_OFFSET;
+    for (size_t i = 0; i < PRIM_COUNT; i++) {
+        for (const char *p = prim_table[i].name;; p++) {
+            h ^= (unsigned char)*p;
+            h *= FNV_PRIME;
+            if (!*p) {
+                break;
+            }
         }
-        env_define(sc, env, sym, val);
-        alist = cdr(alist);
     }
+    return h;
+}
 
-    int count = eval_string_in_env(sc, code->as.str.data, env);
-    pop_roots(sc, 3);
-    return make_int(sc, count);
+static unsigned int zigzag(int v) {
+    return v < 0 ? ((unsigned int)(-(v + 1)) << 1) | 1u : (unsigned int)v << 1;
 }
 
-static int platform_read_byte(Scheme *sc, int offset) {
-    if (!sc->platform.read_byte) {
-        panic(sc, "disk-read-byte: not supported");
-    }
-    return sc->platform.read_byte(sc->platform.user, offset);
+static int unzigzag(unsigned int v) {
+    return (v & 1u) ? -(int)(v >> 1) - 1 : (int)(v >> 1);
 }
 
-static int platform_disk_size(Scheme *sc) {
-    if (!sc->platform.disk_size) {
-        panic(sc, "disk-size: not supported");
+// heap_position: index of a cell across all heap segments, in segment order.
+// Returns: the position, or (size_t)-1 if p is not a heap cell.
+static size_t heap_position(Scheme *sc, const Cell *p) {
+    size_t base = 0;
+    for (HeapSegment *s = sc->segments; s; s = s->next) {
+        if (p >= s->cells && p < s->cells + s->count) {
+            return base + (size_t)(p - s->cells);
+        }
+        base += s->count;
     }
-    return sc->platform.disk_size(sc->platform.user);
+    return (size_t)-1;
 }
 
-static int platform_read_char(Scheme *sc) {
-    if (!sc->platform.read_char) {
-        panic(sc, "read-char: not supported");
+// Writes an image, or with buf NULL only measures it.
+typedef struct ImageWriter {
+    Scheme *sc;
+    unsigned int *index;
+    unsigned char *buf;
+    size_t pos;
+    size_t sym_bytes;
+    size_t str_bytes;
+    int bad;
+} ImageWriter;
+
+static void image_put_byte(ImageWriter *w, unsigned int b) {
+    if (w->buf) {
+        w->buf[w->pos] = (unsigned char)b;
     }
-    return sc->platform.read_char(sc->platform.user);
+    w->pos++;
 }
 
-static int platform_write_bytes(Scheme *sc, int offset, const char *data, int len) {
-    if (!sc->platform.write_bytes) {
-        panic(sc, "disk-write-bytes: not supported");
+static void image_put_uint(ImageWriter *w, size_t v) {
+    while (v >= 0x80) {
+        image_put_byte(w, (unsigned int)(v & 0x7F) | 0x80);
+        v >>= 7;
     }
-    return sc->platform.write_bytes(sc->platform.user, offset, data, len);
+    image_put_byte(w, (unsigned int)v);
 }
 
-static int platform_spawn_thread(Scheme *sc, const char *code) {
-    if (!sc->platform.spawn_thread) {
-        panic(sc, "spawn-thread: not supported");
+static void image_put_bytes(ImageWriter *w, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    image_put_uint(w, len);
+    for (size_t i = 0; i < len; i++) {
+        image_put_byte(w, p[i]);
     }
-    return sc->platform.spawn_thread(sc->platform.user, code);
 }
 
-static Cell *prim_disk_read_byte(Scheme *sc, Cell *args) {
-    Cell *off = car(args);
-    if (off->type != T_INT) {
-        panic(sc, "disk-read-byte: expected int");
-    }
-    return make_int(sc, platform_read_byte(sc, off->as.i));
+static void image_put_u32(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
 }
 
-static Cell *prim_disk_size(Scheme *sc, Cell *args) {
-    (void)args;
-    return make_int(sc, platform_disk_size(sc));
+static unsigned int image_get_u32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
 }
 
-static Cell *prim_disk_read_bytes(Scheme *sc, Cell *args) {
-    Cell *off = car(args);
-    Cell *len = car(cdr(args));
-    if (off->type != T_INT || len->type != T_INT) {
-        panic(sc, "disk-read-bytes: expected int int");
-    }
-    if (len->as.i < 0) {
-        panic(sc, "disk-read-bytes: negative length");
-    }
-    size_t n = (size_t)len->as.i;
-    char *buf = alloc_str_bytes(sc, n);
-    for (size_t i = 0; i < n; i++) {
-        int v = platform_read_byte(sc, off->as.i + (int)i);
-        if (v < 0) {
-            buf[i] = 0;
-        } else {
-            buf[i] = (char)v;
-        }
+static unsigned int image_index(ImageWriter *w, Cell *p) {
+    size_t pos = heap_position(w->sc, p);
+    if (pos == (size_t)-1 || w->index[pos] == IMAGE_NO_CELL) {
+        w->bad = 1;
+        return 0;
     }
-    buf[n] = '\0';
-    Cell *c = alloc_cell(sc);
-    c->type = T_STRING;
-    c->as.str.data = buf;
-    c->as.str.len = n;
-    return c;
+    return w->index[pos];
 }
 
-static Cell *prim_disk_read_cstring(Scheme *sc, Cell *args) {
-    Cell *off = car(args);
-    Cell *maxlen = car(cdr(args));
-    if (off->type != T_INT || maxlen->type != T_INT) {
-        panic(sc, "disk-read-cstring: expected int int");
-    }
-    if (maxlen->as.i < 0) {
-        panic(sc, "disk-read-cstring: negative length");
+static void image_put_ref(ImageWriter *w, unsigned int self, Cell *p) {
+    if (p == &nil_cell) {
+        image_put_uint(w, IMAGE_REF_NIL);
+    } else if (p == &true_cell) {
+        image_put_uint(w, IMAGE_REF_TRUE);
+    } else if (p == &false_cell) {
+        image_put_uint(w, IMAGE_REF_FALSE);
+    } else {
+        image_put_uint(w, IMAGE_REF_CELL + (size_t)zigzag((int)(image_index(w, p) - self)));
     }
-    size_t n = (size_t)maxlen->as.i;
-    char *buf = alloc_str_bytes(sc, n);
-    size_t actual = 0;
-    for (; actual < n; actual++) {
-        int v = platform_read_byte(sc, off->as.i + (int)actual);
-        if (v <= 0) {
+}
+
+// image_put_cell: append the record of one dumped cell.
+// Args: w (writer), self (the cell's image index), c (the cell).
+// Returns: none; sets w->bad for cells that cannot be dumped.
+static void image_put_cell(ImageWriter *w, unsigned int self, Cell *c) {
+    image_put_byte(w, c->type);
+    switch (c->type) {
+        case T_BOOL:
+        case T_INT:
+        case T_CHAR:
+            image_put_uint(w, zigzag(c->as.i));
+            break;
+        case T_STRING:
+            image_put_bytes(w, c->as.str.data, c->as.str.len);
+            w->str_bytes += c->as.str.len + 1;
+            break;
+        case T_SYMBOL: {
+            size_t len = 0;
+            while (c->as.sym.name[len]) {
+                len++;
+            }
+            image_put_bytes(w, c->as.sym.name, len);
+            w->sym_bytes += len + 1;
+            break;
+        }
+        case T_PAIR:
+        case T_ERROR:
+            image_put_ref(w, self, c->as.pair.car);
+            image_put_ref(w, self, c->as.pair.cdr);
+            break;
+        case T_PRIMITIVE: {
+            size_t i = 0;
+            while (i < PRIM_COUNT && prim_table[i].fn != c->as.prim.fn) {
+                i++;
+            }
+            if (i == PRIM_COUNT) {
+                w->bad = 1;
+            }
+            image_put_uint(w, i);
+            break;
+        }
+        case T_CLOSURE:
+            image_put_ref(w, self, c->as.closure.params);
+            image_put_ref(w, self, c->as.closure.body);
+            image_put_ref(w, self, c->as.closure.env);
+            break;
+        case T_VECTOR:
+            image_put_uint(w, c->as.vec.len);
+            for (size_t i = 0; i < c->as.vec.len; i++) {
+                image_put_ref(w, self, c->as.vec.items[i]);
+            }
+            break;
+        case T_BYTEVECTOR:
+            image_put_bytes(w, c->as.bytes.data, c->as.bytes.len);
+            break;
+        case T_STRING_BUILDER:
+            image_put_uint(w, c->as.sbuf.buf->cap);
+            image_put_bytes(w, sbuf_data(c->as.sbuf.buf), c->as.sbuf.buf->len);
+            break;
+        case T_BIGNUM: {
+            size_t n = blob_size(c) / sizeof(unsigned int);
+            image_put_uint(w, zigzag(c->as.big.len));
+            for (size_t i = 0; i < n; i++) {
+                image_put_uint(w, c->as.big.digits[i]);
+            }
             break;
         }
-        buf[actual] = (char)v;
+        case T_HASHTABLE: {
+            HashTable *t = c->as.hash.table;
+            size_t count = t->count + (t->old ? t->old->count : 0);
+            image_put_uint(w, (size_t)t->kind);
+            image_put_uint(w, count);
+            for (; t; t = t->old) {
+                HashEntry *e = hash_entries(t);
+                for (size_t i = 0; i < t->cap; i++) {
+                    if (e[i].key && e[i].key != HASH_TOMBSTONE) {
+                        image_put_ref(w, self, e[i].key);
+                        image_put_ref(w, self, e[i].value);
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            w->bad = 1;
+            break;
     }
-    buf[actual] = '\0';
-    Cell *c = alloc_cell(sc);
-    c->type = T_STRING;
-    c->as.str.data = buf;
-    c->as.str.len = actual;
-    return c;
 }
 
-// prim_disk_write_bytes: write a string to disk at an absolute offset.
-// Args: sc (interpreter state), args (offset int, string).
-// Returns: int cell with bytes written.
-static Cell *prim_disk_write_bytes(Scheme *sc, Cell *args) {
-    Cell *off = car(args);
-    Cell *data = car(cdr(args));
-    if (off->type != T_INT || data->type != T_STRING) {
-        panic(sc, "disk-write-bytes: expected int string");
+// image_put_cells: number the marked cells, or append their records in that order.
+// Args: w (writer), number (1 to assign indices, 0 to write records).
+// Returns: the number of cells.
+static unsigned int image_put_cells(ImageWriter *w, int number) {
+    unsigned int n = 0;
+    for (int tables = 0; tables < 2; tables++) {
+        size_t pos = 0;
+        for (HeapSegment *s = w->sc->segments; s; s = s->next) {
+            for (size_t i = 0; i < s->count; i++, pos++) {
+                Cell *c = &s->cells[i];
+                if (!c->mark || (c->type == T_HASHTABLE) != tables) {
+                    continue;
+                }
+                if (number) {
+                    w->index[pos] = n;
+                } else {
+                    image_put_cell(w, n, c);
+                }
+                n++;
+            }
+        }
     }
-    int written = platform_write_bytes(sc, off->as.i, data->as.str.data, (int)data->as.str.len);
-    return make_int(sc, written);
+    return n;
 }
 
-// prim_spawn_thread: spawn a new Scheme thread to eval a string.
-// Args: sc (interpreter state), args (code string).
-// Returns: int cell with thread id or -1.
-static Cell *prim_spawn_thread(Scheme *sc, Cell *args) {
-    Cell *code = car(args);
-    if (code->type != T_STRING) {
-        panic(sc, "spawn-thread: expected string");
+// scheme_dump_image: serialize everything reachable from the global environment.
+// Args: sc (idle interpreter), out/out_len (receive a buffer from platform.alloc).
+// Returns: 0 on success, -1 if sc is busy, has no allocator, is frozen or
+// shares a frozen heap, or holds a cell that cannot be dumped.
+int scheme_dump_image(Scheme *sc, unsigned char **out, size_t *out_len) {
+    if (sc->root_top != 0 || sc->env_top != 0 || sc->frozen || sc->shared || !sc->platform.alloc ||
+        !sc->platform.free) {
+        return -1;
     }
-    int tid = platform_spawn_thread(sc, code->as.str.data);
-    return make_int(sc, tid);
-}
+    gc_finish(sc);
+    ImageWriter w;
+    w.sc = sc;
+    w.index = (unsigned int *)sc->platform.alloc(sc->platform.user, sc->total_cells * sizeof(unsigned int));
+    if (!w.index) {
+        return -1;
+    }
+    for (size_t i = 0; i < sc->total_cells; i++) {
+        w.index[i] = IMAGE_NO_CELL;
+    }
+    mark_cell(sc, sc->global_env);
+    mark_cell(sc, sc->current_env);
+    mark_cell(sc, sc->interned_syms);
+    unsigned int cells = image_put_cells(&w, 1);
 
-static Cell *prim_char_to_int(Scheme *sc, Cell *args) {
-    Cell *c = car(args);
-    if (c->type != T_CHAR) {
-        panic(sc, "char->int: expected char");
+    // Measure first, then write into a buffer of exactly that size.
+    w.buf = NULL;
+    w.bad = 0;
+    w.pos = IMAGE_HEADER_SIZE;
+    w.sym_bytes = 0;
+    w.str_bytes = 0;
+    image_put_cells(&w, 0);
+    size_t len = w.pos;
+    if (!w.bad) {
+        w.buf = (unsigned char *)sc->platform.alloc(sc->platform.user, len);
+        w.bad = !w.buf;
+    }
+    if (!w.bad) {
+        w.pos = IMAGE_HEADER_SIZE;
+        w.sym_bytes = 0;
+        w.str_bytes = 0;
+        image_put_cells(&w, 0);
+        for (int i = 0; i < 8; i++) {
+            w.buf[i] = (unsigned char)IMAGE_MAGIC[i];
+        }
+        image_put_u32(w.buf + IMAGE_HDR_VERSION, IMAGE_VERSION);
+        image_put_u32(w.buf + IMAGE_HDR_TOTAL_LEN, (unsigned int)len);
+        image_put_u32(w.buf + IMAGE_HDR_CELLS, cells);
+        image_put_u32(w.buf + IMAGE_HDR_SYM_BYTES, (unsigned int)w.sym_bytes);
+        image_put_u32(w.buf + IMAGE_HDR_STR_BYTES, (unsigned int)w.str_bytes);
+        image_put_u32(w.buf + IMAGE_HDR_PRIM_HASH, prim_table_hash());
+        image_put_u32(w.buf + IMAGE_HDR_GLOBAL_ENV, image_index(&w, sc->global_env));
+        image_put_u32(w.buf + IMAGE_HDR_INTERNED, image_index(&w, sc->interned_syms));
     }
-    return make_int(sc, c->as.i);
-}
 
-static Cell *prim_int_to_char(Scheme *sc, Cell *args) {
-    Cell *v = car(args);
-    if (v->type != T_INT) {
-        panic(sc, "int->char: expected int");
+    for (HeapSegment *s = sc->segments; s; s = s->next) {
+        for (size_t i = 0; i < s->count; i++) {
+            s->cells[i].mark = 0;
+        }
     }
-    return make_char(sc, v->as.i & 0xFF);
+    sc->platform.free(sc->platform.user, w.index);
+    if (w.bad) {
+        if (w.buf) {
+            sc->platform.free(sc->platform.user, w.buf);
+        }
+        return -1;
+    }
+    *out = w.buf;
+    *out_len = len;
+    return 0;
 }
 
-// prim_read_char: read a single character from the platform.
-// Args: sc (interpreter state), args (ignored).
-// Returns: one-character string.
-static Cell *prim_read_char(Scheme *sc, Cell *args) {
-    (void)args;
-    int ch = platform_read_char(sc);
-    return make_char(sc, ch);
-}
+typedef struct ImageReader {
+    Scheme *sc;
+    const unsigned char *p;
+    const unsigned char *end;
+    size_t cells;
+    int bad;
+} ImageReader;
 
-// prim_yield: yield the current thread (cooperative scheduling).
-// Args: sc (interpreter state), args (ignored).
-// Returns: int cell (0).
-static Cell *prim_yield(Scheme *sc, Cell *args) {
-    (void)args;
-    if (sc->platform.foreign_call) {
-        sc->platform.foreign_call("yield", 0, NULL);
+static unsigned int image_get_byte(ImageReader *r) {
+    if (r->p >= r->end) {
+        r->bad = 1;
+        return 0;
     }
-    return make_int(sc, 0);
+    return *r->p++;
 }
 
-static Cell *prim_display(Scheme *sc, Cell *args) {
-    Cell *v = car(args);
-    if (v->type == T_INT) {
-        int n = v->as.i;
-        char buf[12];
-        int i = 0;
-        if (n == 0) {
-            putc_out(sc, '0');
-            return scheme_nil(sc);
-        }
-        if (n < 0) {
-            putc_out(sc, '-');
-            n = -n;
-        }
-        while (n > 0 && i < 11) {
-            buf[i++] = (char)('0' + (n % 10));
-            n /= 10;
-        }
-        while (i > 0) {
-            putc_out(sc, buf[--i]);
-        }
-    } else if (v->type == T_SYMBOL) {
-        const char *p = v->as.sym.name;
-        while (*p) {
-            putc_out(sc, *p++);
+static size_t image_get_uint(ImageReader *r) {
+    unsigned int v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        unsigned int b = image_get_byte(r);
+        if (shift == 28 && b > 0x0F) {
+            break;
         }
-    } else if (v->type == T_STRING) {
-        const char *p = v->as.str.data;
-        size_t len = v->as.str.len;
-        for (size_t i = 0; i < len; i++) {
-            putc_out(sc, p[i]);
+        v |= (b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return v;
         }
-    } else if (v->type == T_CHAR) {
-        putc_out(sc, (char)v->as.i);
-    } else if (is_nil(sc, v)) {
-        putc_out(sc, '(');
-        putc_out(sc, ')');
-    } else if (v == scheme_true(sc)) {
-        putc_out(sc, '#');
-        putc_out(sc, 't');
-    } else if (v == scheme_false(sc)) {
-        putc_out(sc, '#');
-        putc_out(sc, 'f');
     }
-    return scheme_nil(sc);
+    r->bad = 1;
+    return 0;
 }
 
-static Cell *prim_number_to_string(Scheme *sc, Cell *args) {
-    Cell *v = car(args);
-    if (v->type != T_INT) {
-        panic(sc, "number->string: expected int");
+// image_get_len: read a length and check that many bytes (at least) remain.
+static size_t image_get_len(ImageReader *r) {
+    size_t len = image_get_uint(r);
+    if (len > (size_t)(r->end - r->p)) {
+        r->bad = 1;
+        return 0;
     }
-    return make_string_from_int(sc, v->as.i);
+    return len;
 }
 
-static Cell *prim_newline(Scheme *sc, Cell *args) {
-    (void)args;
-    putc_out(sc, '\n');
-    return scheme_nil(sc);
+static Cell *image_get_ref(ImageReader *r, size_t self) {
+    size_t v = image_get_uint(r);
+    if (v == IMAGE_REF_NIL) {
+        return &nil_cell;
+    }
+    if (v == IMAGE_REF_TRUE) {
+        return &true_cell;
+    }
+    if (v == IMAGE_REF_FALSE) {
+        return &false_cell;
+    }
+    size_t target = self + (size_t)unzigzag((unsigned int)(v - IMAGE_REF_CELL));
+    if (target >= r->cells) {
+        r->bad = 1;
+        return &nil_cell;
+    }
+    return &r->sc->heap[target];
 }
 
-static Cell *prim_foreign_call(Scheme *sc, Cell *args) {
-    if (is_nil(sc, args)) {
-        panic(sc, "foreign-call: missing symbol");
+// image_get_text: copy a length-prefixed name or string into an arena.
+// Returns: the NUL-terminated copy, or NULL if it does not fit.
+static char *image_get_text(ImageReader *r, char *buf, size_t size, size_t *used, size_t *len_out) {
+    size_t len = image_get_len(r);
+    if (r->bad || len + 1 > size - *used) {
+        r->bad = 1;
+        return NULL;
     }
-    Cell *name_cell = car(args);
-    if (name_cell->type != T_SYMBOL) {
-        panic(sc, "foreign-call: name must be symbol");
+    char *dst = buf + *used;
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (char)r->p[i];
     }
-    if (!sc->platform.foreign_call) {
-        panic(sc, "foreign-call: not supported");
+    dst[len] = '\0';
+    r->p += len;
+    *used += len + 1;
+    *len_out = len;
+    return dst;
+}
+
+static void *image_alloc(ImageReader *r, size_t size) {
+    Scheme *sc = r->sc;
+    void *p = sc->platform.alloc ? sc->platform.alloc(sc->platform.user, size) : NULL;
+    if (!p) {
+        r->bad = 1;
+        return NULL;
     }
+    sc->blob_bytes += size;
+    return p;
+}
 
-    int argv[8];
-    int argc = 0;
-    args = cdr(args);
-    while (!is_nil(sc, args)) {
-        if (argc >= (int)(sizeof(argv) / sizeof(argv[0]))) {
-            panic(sc, "foreign-call: too many args");
+// image_get_cell: decode one record into heap[self].
+// Args: r (reader), self (cell index).
+// Returns: none; sets r->bad on malformed input, leaving the cell an empty pair.
+static void image_get_cell(ImageReader *r, size_t self) {
+    Scheme *sc = r->sc;
+    Cell *c = &sc->heap[self];
+    CellType type = (CellType)image_get_byte(r);
+    size_t len;
+    switch (type) {
+        case T_BOOL:
+        case T_INT:
+        case T_CHAR:
+            c->as.i = unzigzag((unsigned int)image_get_uint(r));
+            break;
+        case T_STRING:
+            c->as.str.data = image_get_text(r, sc->str_buf, sc->str_buf_size, &sc->str_buf_used, &len);
+            c->as.str.len = len;
+            break;
+        case T_SYMBOL:
+            c->as.sym.name = image_get_text(r, sc->sym_buf, sc->sym_buf_size, &sc->sym_buf_used, &len);
+            c->as.sym.global_env = NULL;
+            c->as.sym.global = NULL;
+            break;
+        case T_PAIR:
+        case T_ERROR:
+            c->as.pair.car = image_get_ref(r, self);
+            c->as.pair.cdr = image_get_ref(r, self);
+            break;
+        case T_PRIMITIVE: {
+            size_t i = image_get_uint(r);
+            if (i >= PRIM_COUNT) {
+                r->bad = 1;
+                break;
+            }
+            c->as.prim.fn = prim_table[i].fn;
+            prim_set_fixed(c);
+            break;
         }
-        Cell *v = car(args);
-        if (v->type != T_INT) {
-            panic(sc, "foreign-call: args must be int");
+        case T_CLOSURE:
+            c->as.closure.params = image_get_ref(r, self);
+            c->as.closure.body = image_get_ref(r, self);
+            c->as.closure.env = image_get_ref(r, self);
+            break;
+        case T_VECTOR: {
+            len = image_get_len(r);
+            Cell **items = len && !r->bad ? (Cell **)image_alloc(r, len * sizeof(Cell *)) : NULL;
+            if (r->bad) {
+                break;
+            }
+            c->type = T_VECTOR;
+            c->as.vec.items = items;
+            c->as.vec.len = len;
+            for (size_t i = 0; i < len; i++) {
+                items[i] = image_get_ref(r, self);
+            }
+            return;
         }
-        argv[argc++] = v->as.i;
-        args = cdr(args);
+        case T_BYTEVECTOR: {
+            len = image_get_len(r);
+            unsigned char *data = len && !r->bad ? (unsigned char *)image_alloc(r, len) : NULL;
+            if (r->bad) {
+                break;
+            }
+            for (size_t i = 0; i < len; i++) {
+                data[i] = r->p[i];
+            }
+            r->p += len;
+            c->as.bytes.data = data;
+            c->as.bytes.len = len;
+            break;
+        }
+        case T_STRING_BUILDER: {
+            size_t cap = image_get_uint(r);
+            len = image_get_len(r);
+            if (r->bad || len > cap || cap > ((size_t)-1) - sizeof(StringBuf)) {
+                r->bad = 1;
+                break;
+            }
+            StringBuf *buf = (StringBuf *)image_alloc(r, sizeof(StringBuf) + cap);
+            if (!buf) {
+                break;
+            }
+            buf->cap = cap;
+            buf->len = len;
+            for (size_t i = 0; i < len; i++) {
+                sbuf_data(buf)[i] = (char)r->p[i];
+            }
+            r->p += len;
+            c->as.sbuf.buf = buf;
+            break;
+        }
+        case T_BIGNUM: {
+            // Every limb takes at least one byte, which bounds the count.
+            int slen = unzigzag((unsigned int)image_get_uint(r));
+            len = slen < 0 ? (size_t)(0u - (unsigned int)slen) : (size_t)slen;
+            if (r->bad || len < 1 || len > BIG_MAX_LIMBS || len > (size_t)(r->end - r->p)) {
+                r->bad = 1;
+                break;
+            }
+            unsigned int *digits = (unsigned int *)image_alloc(r, len * sizeof(unsigned int));
+            if (!digits) {
+                break;
+            }
+            for (size_t i = 0; i < len; i++) {
+                digits[i] = (unsigned int)image_get_uint(r);
+            }
+            c->as.big.digits = digits;
+            c->as.big.len = slen;
+            break;
+        }
+        case T_HASHTABLE: {
+            size_t kind = image_get_uint(r);
+            size_t count = image_get_len(r);
+            if (r->bad || (kind != SCHEME_HASH_EQ && kind != SCHEME_HASH_STRING)) {
+                r->bad = 1;
+                break;
+            }
+            size_t cap = HASH_MIN_CAP;
+            while (cap < (count + 1) * 2) {
+                cap *= 2;
+            }
+            HashTable *t = (HashTable *)image_alloc(r, hash_table_bytes(cap));
+            if (!t) {
+                break;
+            }
+            hash_table_init(t, cap, (int)kind);
+            // Install the table first so an error below still frees it.
+            c->type = T_HASHTABLE;
+            c->as.hash.table = t;
+            for (size_t i = 0; i < count && !r->bad; i++) {
+                Cell *key = image_get_ref(r, self);
+                Cell *value = image_get_ref(r, self);
+                if (kind == SCHEME_HASH_STRING && key->type != T_STRING) {
+                    r->bad = 1;
+                }
+                if (!r->bad) {
+                    hash_put_new(t, key, value);
+                }
+            }
+            return;
+        }
+        default:
+            r->bad = 1;
+            break;
+    }
+    if (!r->bad) {
+        c->type = type;
     }
-
-    int ret = sc->platform.foreign_call(name_cell->as.sym.name, argc, argv);
-    return make_int(sc, ret);
 }
 
-static void add_prim(Scheme *sc, const char *name, PrimFn fn) {
-    Cell *sym = intern_symbol(sc, name);
-    Cell *prim = make_prim(sc, fn);
-    env_define(sc, sc->global_env, sym, prim);
-}
+// scheme_load_image: initialize an interpreter from a heap image.
+// Args: sc (interpreter to initialize), cfg (buffers/platform), img/len (image bytes).
+// Returns: 0 on success, -1 if the image is malformed, was made with a
+// different primitive table, or does not fit cfg's buffers. On failure sc
+// holds nothing that needs freeing and may be passed to scheme_init.
+int scheme_load_image(Scheme *sc, const SchemeConfig *cfg, const unsigned char *img, size_t len) {
+    if (len < IMAGE_HEADER_SIZE) {
+        return -1;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (img[i] != (unsigned char)IMAGE_MAGIC[i]) {
+            return -1;
+        }
+    }
+    size_t total = image_get_u32(img + IMAGE_HDR_TOTAL_LEN);
+    size_t cells = image_get_u32(img + IMAGE_HDR_CELLS);
+    size_t global_env = image_get_u32(img + IMAGE_HDR_GLOBAL_ENV);
+    size_t interned = image_get_u32(img + IMAGE_HDR_INTERNED);
+    if (image_get_u32(img + IMAGE_HDR_VERSION) != IMAGE_VERSION || total < IMAGE_HEADER_SIZE || total > len ||
+        image_get_u32(img + IMAGE_HDR_PRIM_HASH) != prim_table_hash() || cells > cfg->heap_cells ||
+        image_get_u32(img + IMAGE_HDR_SYM_BYTES) > cfg->sym_buf_size ||
+        image_get_u32(img + IMAGE_HDR_STR_BYTES) > cfg->str_buf_size || global_env >= cells || interned >= cells) {
+        return -1;
+    }
 
-// scheme_init: initialize interpreter state, heap, buffers, and primitives.
-// Args: sc (interpreter state), cfg (configuration pointers/sizes).
-// Returns: none.
-void scheme_init(Scheme *sc, const SchemeConfig *cfg) {
     sc->heap = cfg->heap;
     sc->heap_cells = cfg->heap_cells;
     sc->sym_buf = cfg->sym_buf;
@@ -1178,71 +6543,186 @@ void scheme_init(Scheme *sc, const SchemeConfig *cfg) {
     sc->platform = cfg->platform;
     sc->root_top = 0;
     sc->env_top = 0;
+    sc->catch_top = NULL;
+    sc->raised = NULL;
+    heap_config_init(sc, cfg);
+    stats_reset(sc);
+    profile_reset(sc);
 
-    sc->nil_cell.type = T_NIL;
-    sc->true_cell.type = T_BOOL;
-    sc->true_cell.as.b = 1;
-    sc->false_cell.type = T_BOOL;
-    sc->false_cell.as.b = 0;
+    sc->sym_index = NULL;
 
+    // Image cells start out as empty pairs, so a decoding error leaves
+    // nothing for scheme_destroy to misread.
     sc->free_list = NULL;
-    for (size_t i = 0; i < sc->heap_cells; i++) {
-        Cell *c = &sc->heap[i];
+    for (size_t i = sc->heap_cells; i > 0; i--) {
+        Cell *c = &sc->heap[i - 1];
         c->type = T_PAIR;
-        c->as.pair.cdr = sc->free_list;
-        sc->free_list = c;
+        c->mark = 0;
+        c->as.pair.car = &nil_cell;
+        c->as.pair.cdr = i > cells ? sc->free_list : &nil_cell;
+        if (i > cells) {
+            sc->free_list = c;
+            sc->free_cells++;
+        }
     }
 
-    sc->interned_syms = scheme_nil(sc);
-    sc->global_env = cons(sc, scheme_nil(sc), scheme_nil(sc));
+    ImageReader r;
+    r.sc = sc;
+    r.p = img + IMAGE_HEADER_SIZE;
+    r.end = img + total;
+    r.cells = cells;
+    r.bad = 0;
+    for (size_t i = 0; i < cells && !r.bad; i++) {
+        image_get_cell(&r, i);
+    }
+    if (r.bad || r.p != r.end) {
+        scheme_destroy(sc);
+        return -1;
+    }
+    sc->stats.str_arena_peak = sc->str_buf_used;
+    sc->stats.sym_arena_peak = sc->sym_buf_used;
+    sc->interned_syms = &sc->heap[interned];
+    sc->global_env = &sc->heap[global_env];
     sc->current_env = sc->global_env;
+    sc->gc_trigger = sc->free_cells / 2;
+    heap_pages_adopt(sc, cfg);
+    return 0;
+}
 
-    add_prim(sc, "+", prim_add);
-    add_prim(sc, "-", prim_sub);
-    add_prim(sc, "*", prim_mul);
-    add_prim(sc, "<", prim_lt);
-    add_prim(sc, "=", prim_num_eq);
-    add_prim(sc, "quotient", prim_quotient);
-    add_prim(sc, "modulo", prim_modulo);
-    add_prim(sc, "cons", prim_cons);
-    add_prim(sc, "car", prim_car);
-    add_prim(sc, "cdr", prim_cdr);
-    add_prim(sc, "null?", prim_nullp);
-    add_prim(sc, "pair?", prim_pairp);
-    add_prim(sc, "eq?", prim_eqp);
-    add_prim(sc, "string-length", prim_string_len);
-    add_prim(sc, "string-ref", prim_string_ref);
-    add_prim(sc, "string=?", prim_string_eq);
-    add_prim(sc, "char=?", prim_char_eq);
-    add_prim(sc, "char->int", prim_char_to_int);
-    add_prim(sc, "int->char", prim_int_to_char);
-    add_prim(sc, "list-alloc", prim_list_alloc);
-    add_prim(sc, "list->string", prim_list_to_string);
-    add_prim(sc, "eval-string", prim_eval_string);
-    add_prim(sc, "eval-scoped", prim_eval_scoped);
-    add_prim(sc, "disk-read-byte", prim_disk_read_byte);
-    add_prim(sc, "disk-read-bytes", prim_disk_read_bytes);
-    add_prim(sc, "disk-read-cstring", prim_disk_read_cstring);
-    add_prim(sc, "disk-write-bytes", prim_disk_write_bytes);
-    add_prim(sc, "disk-size", prim_disk_size);
-    add_prim(sc, "read-char", prim_read_char);
-    add_prim(sc, "spawn-thread", prim_spawn_thread);
-    add_prim(sc, "yield", prim_yield);
-    add_prim(sc, "display", prim_display);
-    add_prim(sc, "newline", prim_newline);
-    add_prim(sc, "number->string", prim_number_to_string);
-    add_prim(sc, "foreign-call", prim_foreign_call);
+// scheme_destroy: return grown heap segments and arena chunks to the platform.
+// Args: sc (interpreter state).
+// Returns: none. The buffers from SchemeConfig remain owned by the embedder.
+void scheme_destroy(Scheme *sc) {
+    if (!sc->platform.free) {
+        return;
+    }
+    if (sc->gc_mode == SCHEME_GC_COPYING) {
+        // Cells in free pages may be stale copies of storage owners.
+        for (size_t i = 0; i < sc->blob_cell_count; i++) {
+            if (is_blob(sc->blob_cells[i])) {
+                blob_release(sc, sc->blob_cells[i]);
+            }
+        }
+        sc->platform.free(sc->platform.user, sc->blob_cells);
+        sc->platform.free(sc->platform.user, sc->segments->pages);
+        sc->platform.free(sc->platform.user, sc->segment_index);
+        sc->segment_index = NULL;
+        sc->segment_index_count = 0;
+        sc->segment_index_cap = 0;
+        sc->segment_hint = NULL;
+        sc->blob_cells = NULL;
+        sc->blob_cell_count = 0;
+        sc->blob_cell_cap = 0;
+        sc->segments->pages = NULL;
+        sc->gc_mode = SCHEME_GC_MARK_SWEEP;
+    } else {
+        for (HeapSegment *s = sc->segments; s; s = s->next) {
+            for (size_t i = 0; i < s->count; i++) {
+                Cell *c = &s->cells[i];
+                if (is_blob(c)) {
+                    blob_release(sc, c);
+                }
+            }
+        }
+    }
+    if (sc->gray) {
+        sc->platform.free(sc->platform.user, sc->gray);
+        sc->gray = NULL;
+        sc->gray_top = 0;
+        sc->gray_cap = 0;
+    }
+    HeapSegment *seg = sc->segments->next;
+    while (seg) {
+        HeapSegment *next = seg->next;
+        sc->platform.free(sc->platform.user, seg);
+        seg = next;
+    }
+    sc->segments->next = NULL;
+    sc->total_cells = sc->heap_cells;
+    ArenaChunk *lists[2] = {sc->sym_chunks, sc->str_chunks};
+    for (int k = 0; k < 2; k++) {
+        ArenaChunk *chunk = lists[k];
+        while (chunk) {
+            ArenaChunk *next = chunk->next;
+            sc->platform.free(sc->platform.user, chunk);
+            chunk = next;
+        }
+    }
+    sc->sym_chunks = NULL;
+    sc->str_chunks = NULL;
+    if (sc->sym_index) {
+        sc->platform.free(sc->platform.user, sc->sym_index);
+        sc->sym_index = NULL;
+    }
+    sc->prof_active = 0;
+    if (sc->prof_samples) {
+        sc->platform.free(sc->platform.user, sc->prof_samples);
+        sc->prof_samples = NULL;
+    }
 }
 
+// scheme_get_stats: snapshot the interpreter's allocation counters.
+// Args: sc (interpreter state), out (destination).
+// Returns: none.
+void scheme_get_stats(const Scheme *sc, SchemeStats *out) {
+    *out = sc->stats;
+    out->heap_cells = sc->total_cells;
+    out->arena_bytes = sc->arena_grown + sc->blob_bytes;
+}
+
+// report_error: print an error that no handler caught.
+// Args: sc (interpreter state), obj (raised object).
+// Returns: none.
+static void report_error(Scheme *sc, Cell *obj) {
+    write_str(sc, obj->type == T_ERROR ? "scheme error: " : "scheme error: uncaught ");
+    display_value(sc, obj);
+    putc_out(sc, '\n');
+}
+
+typedef struct TopLevelRun {
+    const char *input;
+    int count;
+} TopLevelRun;
+
+static Cell *run_top_level(Scheme *sc, void *data) {
+    TopLevelRun *run = (TopLevelRun *)data;
+    run->count = eval_string_in_env(sc, run->input, sc->global_env);
+    return scheme_nil(sc);
+}
+
+// scheme_eval_string: evaluate every expression in input at top level.
+// Args: sc (interpreter state), input (source text).
+// Returns: the number of expressions evaluated, or -1 if one raised an error
+// that nothing caught (the error is printed and sc remains usable) or sc is
+// frozen.
 int scheme_eval_string(Scheme *sc, const char *input) {
-    return eval_string_in_env(sc, input, sc->global_env);
+    if (sc->frozen) {
+        return -1;
+    }
+    TopLevelRun run = {input, 0};
+    Cell *result;
+    // The outermost call's frame bounds the copying collector's stack scan.
+    void *outer = sc->stack_base;
+    if (!outer) {
+        sc->stack_base = __builtin_frame_address(0);
+    }
+    Cell *obj = catch_errors(sc, run_top_level, &run, &result);
+    if (obj) {
+        report_error(sc, obj);
+        pop_roots(sc, 1);
+        sc->stop_reason = NULL;
+        run.count = -1;
+    }
+    sc->stack_base = outer;
+    return run.count;
 }
 
 static int eval_string_in_env(Scheme *sc, const char *input, Cell *env) {
-    const char *p = input;
+    Reader rd;
+    reader_init(&rd, input);
     int count = 0;
     while (1) {
-        Cell *expr = read_expr(sc, &p);
+        Cell *expr = read_expr(sc, &rd);
         if (!expr) {
             break;
         }
@@ -1251,9 +6731,5 @@ static int eval_string_in_env(Scheme *sc, const char *input, Cell *env) {
         pop_roots(sc, 1);
         count++;
     }
-    skip_ws(&p);
-    if (*p != '\0') {
-        panic(sc, "trailing garbage after last expression");
-    }
     return count;
 }
@@ -16,6 +16,18 @@ extern "C" {
 
 struct Scheme;
 
+// Per-interpreter resource limits; 0 means unlimited. arena_bytes covers
+// symbol/string arena growth beyond the initial buffers plus vector,
+// bytevector, builder, hash table and bignum storage; cpu_ticks counts
+// scheme_tick calls. Running past a limit stops the interpreter (see
+// scheme_stop).
+typedef struct SchemeQuota {
+    size_t arena_bytes;
+    size_t cpu_ticks;
+    size_t disk_bytes;
+    size_t output_bytes;
+} SchemeQuota;
+
 typedef enum {
     T_NIL,
     T_BOOL,
@@ -25,9 +37,50 @@ typedef enum {
     T_SYMBOL,
     T_PAIR,
     T_PRIMITIVE,
-    T_CLOSURE
+    T_CLOSURE,
+    T_VECTOR,
+    T_BYTEVECTOR,
+    T_STRING_BUILDER,
+    T_HASHTABLE,
+    // Error object: message string in pair.car, irritant list in pair.cdr.
+    T_ERROR,
+    // Integer outside the fixnum range (see big.digits).
+    T_BIGNUM,
+    // Left behind by the copying collector in a cell it moved; pair.car is
+    // the new address. Never reachable from a live value.
+    T_FORWARD
 } CellType;
 
+// Backing store of a string builder: this header, then cap bytes.
+typedef struct StringBuf {
+    size_t cap;
+    size_t len;
+} StringBuf;
+
+// Hash table key comparison: eq? (ints and chars by value) or string=?.
+#define SCHEME_HASH_EQ 0
+#define SCHEME_HASH_STRING 1
+
+typedef struct HashEntry {
+    struct Cell *key;
+    struct Cell *value;
+} HashEntry;
+
+// Open-addressed table: this header, then cap HashEntry slots (cap is a
+// power of two). While growing, old holds the previous table, which is
+// drained a few slots per operation starting at slot migrate. moved is set
+// when the copying collector relocates a key, whose slot then no longer
+// matches its address hash; the next lookup rebuilds the table.
+typedef struct HashTable {
+    size_t cap;
+    size_t count;
+    size_t used;
+    int kind;
+    int moved;
+    struct HashTable *old;
+    size_t migrate;
+} HashTable;
+
 typedef struct Cell {
     CellType type;
     unsigned char mark;
@@ -38,21 +91,55 @@ typedef struct Cell {
             struct Cell *car;
             struct Cell *cdr;
         } pair;
+        // global caches the binding (symbol . value) found for this symbol
+        // in global_env, the outermost frame of the environment it was last
+        // looked up in (see env_binding); both are NULL until then.
         struct {
             const char *name;
+            struct Cell *global_env;
+            struct Cell *global;
         } sym;
         struct {
             const char *data;
             size_t len;
         } str;
+        // fn1/fn2 take the arguments of a one- or two-argument call
+        // directly, so eval can skip consing an argument list; NULL for
+        // primitives without that form.
         struct {
             struct Cell *(*fn)(struct Scheme *sc, struct Cell *args);
+            struct Cell *(*fn1)(struct Scheme *sc, struct Cell *a);
+            struct Cell *(*fn2)(struct Scheme *sc, struct Cell *a, struct Cell *b);
         } prim;
         struct {
             struct Cell *params;
             struct Cell *body;
             struct Cell *env;
         } closure;
+        // Vector, bytevector, string builder, hash table and bignum storage
+        // comes from platform.alloc and is released when the collector
+        // reclaims the cell.
+        struct {
+            struct Cell **items;
+            size_t len;
+        } vec;
+        struct {
+            unsigned char *data;
+            size_t len;
+        } bytes;
+        struct {
+            StringBuf *buf;
+        } sbuf;
+        struct {
+            HashTable *table;
+        } hash;
+        // Bignum magnitude in base 2^32, least significant limb first, with
+        // no leading zero limbs; len is negated for negative values. Values
+        // that fit in an int are always fixnums instead.
+        struct {
+            unsigned int *digits;
+            int len;
+        } big;
     } as;
 } Cell;
 
@@ -63,7 +150,25 @@ typedef int (*scheme_read_byte_fn)(void *user, int offset);
 typedef int (*scheme_disk_size_fn)(void *user);
 typedef int (*scheme_read_char_fn)(void *user);
 typedef int (*scheme_write_bytes_fn)(void *user, int offset, const char *data, int len);
-typedef int (*scheme_spawn_thread_fn)(void *user, const char *code);
+// quota holds limits requested by the spawner, 0 where it asked for none.
+typedef int (*scheme_spawn_thread_fn)(void *user, const char *code, const SchemeQuota *quota);
+typedef void *(*scheme_alloc_fn)(void *user, size_t size);
+typedef void (*scheme_free_fn)(void *user, void *ptr);
+typedef int (*scheme_channel_make_fn)(void *user, int capacity);
+typedef int (*scheme_channel_send_fn)(void *user, int channel, const char *data, int len);
+typedef int (*scheme_channel_recv_fn)(void *user, int channel, char *buf, int cap);
+typedef unsigned long long (*scheme_now_ns_fn)(void *user);
+typedef void (*scheme_trace_fn)(void *user, int event, int arg);
+
+// Events reported through platform.trace.
+#define SCHEME_TRACE_GC_START 1
+#define SCHEME_TRACE_GC_END 2
+
+// Longest interpreter error message kept for the error object it becomes.
+#define SCHEME_ERROR_MAX 128
+
+// Largest serialized value that can travel through a channel.
+#define SCHEME_MESSAGE_MAX 4096
 
 typedef struct SchemePlatform {
     void *user;
@@ -75,22 +180,186 @@ typedef struct SchemePlatform {
     scheme_read_char_fn read_char;
     scheme_write_bytes_fn write_bytes;
     scheme_spawn_thread_fn spawn_thread;
+    scheme_alloc_fn alloc;
+    scheme_free_fn free;
+    scheme_channel_make_fn channel_make;
+    scheme_channel_send_fn channel_send;
+    scheme_channel_recv_fn channel_recv;
+    // Monotonic clock for GC timing; NULL leaves the time counters at 0.
+    scheme_now_ns_fn now_ns;
+    // Optional event hook (SCHEME_TRACE_*); must not re-enter the interpreter.
+    scheme_trace_fn trace;
 } SchemePlatform;
 
+// Collectors selectable through SchemeConfig.gc_mode.
+#define SCHEME_GC_MARK_SWEEP 0
+#define SCHEME_GC_COPYING 1
+
+// Cells per page of the copying collector's heap.
+#define SCHEME_PAGE_CELLS 128
+
+// Slots of the cache an interpreter sharing a frozen heap keeps for the
+// global bindings of shared symbols (a power of two).
+#define SCHEME_SHARED_CACHE 256
+
+// A page of the copying collector's heap. Cells are handed out from one
+// page at a time by pointer bump; a collection copies the survivors of each
+// page in use to free pages, except that a page the C stack may point into
+// stays in place (see gc_copy in scheme.c).
+typedef struct HeapPage {
+    struct HeapPage *next;
+    Cell *cells;
+    size_t count;
+    int space;
+} HeapPage;
+
+// A contiguous run of cells. The heap passed in SchemeConfig is the first
+// segment; further segments are requested from platform.alloc as it grows.
+// pages describes the segment under the copying collector, NULL otherwise.
+typedef struct HeapSegment {
+    struct HeapSegment *next;
+    Cell *cells;
+    size_t count;
+    Cell *free_head;
+    Cell *free_tail;
+    size_t free_count;
+    HeapPage *pages;
+} HeapSegment;
+
+// Retired symbol/string arena chunk. Strings and symbol names are never
+// moved, so a full chunk is kept alive and a new one becomes current.
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;
+} ArenaChunk;
+
+// Allocator and collector counters; read them with scheme_get_stats or the
+// gc-stats primitive. Arenas never shrink, so their peaks are bytes used.
+typedef struct SchemeStats {
+    size_t cells_allocated;
+    size_t cells_freed;
+    size_t gc_count;
+    size_t heap_cells;
+    size_t live_cells;
+    size_t str_arena_peak;
+    size_t sym_arena_peak;
+    unsigned long long mark_ns;
+    unsigned long long sweep_ns;
+    unsigned long long max_pause_ns;
+    // Usage charged against SchemeQuota.
+    size_t arena_bytes;
+    size_t cpu_ticks;
+    size_t disk_bytes;
+    size_t output_bytes;
+} SchemeStats;
+
+// Operator names of the innermost call and its caller, published by the
+// interpreter at every application for the sampling profiler. Profile
+// samples use the same layout.
+typedef struct SchemeCallSite {
+    const char *fn;
+    const char *caller;
+} SchemeCallSite;
+
 typedef struct Scheme {
     Cell *heap;
     size_t heap_cells;
     Cell *free_list;
 
+    HeapSegment first_segment;
+    HeapSegment *segments;
+    size_t total_cells;
+    size_t heap_grow_cells;
+    size_t heap_max_cells;
+
+    // Copying collector state, used when gc_mode is SCHEME_GC_COPYING:
+    // pages holding cells are on used_pages, empty ones on free_pages, and
+    // alloc_next..alloc_end is the unused rest of the page being filled.
+    // blob_cells lists every cell that may own vector/bytevector/builder/
+    // hash table/bignum storage, so a collection can free the storage of
+    // the dead ones without visiting them. segment_index holds the segments
+    // sorted by address, for finding the page of a pointer, and
+    // segment_hint the segment last found there. stack_base is the stack
+    // frame of the outermost API call, the far end of the conservative
+    // stack scan. copy_alloc_base is stats.cells_allocated as of the last
+    // collection, for counting the cells freed by the next.
+    int gc_mode;
+    HeapPage *used_pages;
+    HeapPage *free_pages;
+    size_t used_page_count;
+    size_t page_count;
+    HeapSegment **segment_index;
+    size_t segment_index_count;
+    size_t segment_index_cap;
+    HeapSegment *segment_hint;
+    size_t copy_alloc_base;
+    Cell *alloc_next;
+    Cell *alloc_end;
+    Cell **blob_cells;
+    size_t blob_cell_count;
+    size_t blob_cell_cap;
+    void *stack_base;
+
+    // Incremental mark-and-sweep state, used when gc_pause_cells is nonzero
+    // (see gc_step in scheme.c). gray holds the cells marked but not yet
+    // scanned; gc_sym_scan is the next symbol whose cache marking checks,
+    // NULL until a root rescan finds nothing new; sweep_seg/sweep_left is
+    // the position of the lazy sweep.
+    // free_cells counts the free list, and a cycle starts once it falls to
+    // gc_trigger. gc_debt counts allocations since the last step.
+    size_t gc_pause_cells;
+    int gc_phase;
+    Cell **gray;
+    size_t gray_top;
+    size_t gray_cap;
+    Cell *gc_sym_scan;
+    HeapSegment *sweep_seg;
+    size_t sweep_left;
+    int sweep_spliced;
+    size_t free_cells;
+    size_t gc_trigger;
+    size_t gc_debt;
+    size_t gc_marked;
+    size_t gc_already_free;
+    size_t gc_swept_free;
+
     char *sym_buf;
     size_t sym_buf_size;
     size_t sym_buf_used;
+    ArenaChunk *sym_chunks;
 
     char *str_buf;
     size_t str_buf_size;
     size_t str_buf_used;
+    ArenaChunk *str_chunks;
+    size_t arena_grow_bytes;
+    // Bytes of arena chunks added by growth.
+    size_t arena_grown;
+
+    // Bytes held by vector/bytevector/builder/hash table storage; allocating past blob_limit
+    // collects first so unreachable storage is returned promptly.
+    size_t blob_bytes;
+    size_t blob_limit;
 
     Cell *interned_syms;
+    // Open-addressed index of interned_syms by name hash, rebuilt from the
+    // list on demand; NULL until then or without a platform allocator.
+    Cell **sym_index;
+    size_t sym_index_cap;
+    size_t sym_count;
+
+    // Frozen heap shared with other interpreters (scheme_init_shared), or
+    // NULL. Its cells are never marked, moved or written: interned_syms
+    // and the outermost frame of global_env continue into its lists, and
+    // sym_index covers only this interpreter's own symbols. Shared symbols
+    // cache their binding in the shared environment, so the bindings this
+    // interpreter's global environment gives them are cached in
+    // shared_syms/shared_bindings instead, by symbol address. frozen is set
+    // on the interpreter that scheme_freeze turned into such a heap.
+    const struct Scheme *shared;
+    int frozen;
+    Cell *shared_syms[SCHEME_SHARED_CACHE];
+    Cell *shared_bindings[SCHEME_SHARED_CACHE];
 
     Cell *root_stack[256];
     size_t root_top;
@@ -101,11 +370,26 @@ typedef struct Scheme {
     Cell *global_env;
     Cell *current_env;
 
+    // Innermost error handler frame (see catch_errors in scheme.c); an error
+    // raised with none installed goes to platform.panic. While the stacks
+    // unwind, raised holds the object thrown, or NULL for an interpreter
+    // error whose text is in error_msg.
+    struct SchemeCatch *catch_top;
+    Cell *raised;
+    char error_msg[SCHEME_ERROR_MAX];
+
     SchemePlatform platform;
+    SchemeStats stats;
+    SchemeQuota quota;
+    // Set by scheme_stop, possibly from an interrupt; checked at every call.
+    const char *volatile stop_reason;
 
-    Cell nil_cell;
-    Cell true_cell;
-    Cell false_cell;
+    volatile SchemeCallSite call_site;
+    SchemeCallSite *prof_samples;
+    size_t prof_cap;
+    volatile size_t prof_count;
+    volatile size_t prof_dropped;
+    volatile int prof_active;
 } Scheme;
 
 typedef struct SchemeConfig {
@@ -115,10 +399,34 @@ typedef struct SchemeConfig {
     size_t sym_buf_size;
     char *str_buf;
     size_t str_buf_size;
+    // Growth is enabled when platform.alloc/free are set and these are
+    // nonzero; heap_max_cells of 0 means the heap may grow without bound.
+    size_t heap_grow_cells;
+    size_t heap_max_cells;
+    size_t arena_grow_bytes;
+    // SCHEME_GC_MARK_SWEEP, or SCHEME_GC_COPYING to compact live cells on
+    // every collection so its cost follows live data rather than heap size;
+    // the copying collector needs platform.alloc/free and keeps half the
+    // heap free as the space it copies into.
+    int gc_mode;
+    // Mark-and-sweep only: collect incrementally while the program runs,
+    // doing at most this many cells of marking or sweeping per pause; 0
+    // collects in a single pause whenever the free list runs dry.
+    size_t gc_pause_cells;
+    SchemeQuota quota;
     SchemePlatform platform;
 } SchemeConfig;
 
 void scheme_init(Scheme *sc, const SchemeConfig *cfg);
+int scheme_freeze(Scheme *sc);
+int scheme_init_shared(Scheme *sc, const Scheme *shared, const SchemeConfig *cfg);
+int scheme_dump_image(Scheme *sc, unsigned char **out, size_t *out_len);
+int scheme_load_image(Scheme *sc, const SchemeConfig *cfg, const unsigned char *img, size_t len);
+void scheme_destroy(Scheme *sc);
+void scheme_get_stats(const Scheme *sc, SchemeStats *out);
+void scheme_profile_sample(Scheme *sc);
+void scheme_tick(Scheme *sc);
+void scheme_stop(Scheme *sc, const char *reason);
 int scheme_eval_string(Scheme *sc, const char *input);
 
 #ifdef __cplusplus
@@ -1,6 +1,9 @@
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "scheme/scheme.h"
 
@@ -13,6 +16,39 @@ static void host_panic(const char *msg) {
     exit(1);
 }
 
+// Interpreter sampled by the SIGPROF handler, standing in for the
+// kernel's timer interrupt.
+static Scheme *profiled;
+
+static void host_profile_signal(int sig) {
+    (void)sig;
+    scheme_tick(profiled);
+}
+
+// host_profile_init: sample the interpreter 100 times per CPU second,
+// matching the kernel timer rate.
+static void host_profile_init(Scheme *sc) {
+    profiled = sc;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = host_profile_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+    struct itimerval it;
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = 10000;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+static unsigned long long host_now_ns(void *user) {
+    (void)user;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
 static int host_read_char(void *user) {
     (void)user;
     return getchar();
@@ -30,9 +66,27 @@ static int host_foreign_call(const char *name, int argc, const int *argv) {
         int code = argc >= 1 ? argv[0] : 0;
         exit(code);
     }
+    if (strcmp(name, "sleep-ns") == 0) {
+        if (argc >= 1 && argv[0] >= 0) {
+            struct timespec ts = {argv[0] / 1000000000, argv[0] % 1000000000};
+            nanosleep(&ts, NULL);
+            return 0;
+        }
+        return -1;
+    }
     return -1;
 }
 
+static void *host_alloc(void *user, size_t size) {
+    (void)user;
+    return malloc(size);
+}
+
+static void host_free(void *user, void *ptr) {
+    (void)user;
+    free(ptr);
+}
+
 typedef struct HostDisk {
     unsigned char *data;
     size_t size;
@@ -68,6 +122,36 @@ static int host_write_bytes(void *user, int offset, const char *data, int len) {
     return len;
 }
 
+// read_file: load a whole file, NUL-terminated.
+// Args: path, size (receives the length without the terminator).
+// Returns: a malloc'd buffer, or NULL after printing an error.
+static char *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror("fopen");
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = (char *)malloc((size_t)n + 1);
+    if (!buf) {
+        perror("malloc");
+        fclose(f);
+        return NULL;
+    }
+    if (fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        perror("fread");
+        fclose(f);
+        free(buf);
+        return NULL;
+    }
+    buf[n] = '\0';
+    fclose(f);
+    *size = (size_t)n;
+    return buf;
+}
+
 int main(int argc, char **argv) {
     const char *default_program =
         "(begin\n"
@@ -75,30 +159,55 @@ int main(int argc, char **argv) {
         "  (display (fact 5))\n"
         "  (newline))\n";
 
-    char *input = NULL;
-    if (argc > 1) {
-        FILE *f = fopen(argv[1], "rb");
-        if (!f) {
-            perror("fopen");
-            return 1;
+    // Usage: scheme-host [--stats] [--copying-gc] [--gc-pause CELLS] [--shared-heap] [--image IN]
+    //                    [--dump-image OUT] [program.scm [disk.img]]
+    // --image starts from a heap image instead of a fresh interpreter;
+    // --dump-image writes the heap left behind by the program;
+    // --copying-gc selects the copying collector (SCHEME_GC_COPYING);
+    // --gc-pause makes mark-and-sweep incremental with that many cells of
+    // work per pause (SchemeConfig.gc_pause_cells);
+    // --shared-heap takes the primitives from a frozen interpreter, the way
+    // the kernel's spawned threads share theirs (scheme_init_shared).
+    const char *program_path = NULL;
+    const char *disk_path = NULL;
+    const char *image_path = NULL;
+    const char *dump_path = NULL;
+    int show_stats = 0;
+    int shared_heap = 0;
+    int gc_mode = SCHEME_GC_MARK_SWEEP;
+    size_t gc_pause_cells = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "--copying-gc") == 0) {
+            gc_mode = SCHEME_GC_COPYING;
+        } else if (strcmp(argv[i], "--shared-heap") == 0) {
+            shared_heap = 1;
+        } else if (strcmp(argv[i], "--gc-pause") == 0 && i + 1 < argc) {
+            gc_pause_cells = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            image_path = argv[++i];
+        } else if (strcmp(argv[i], "--dump-image") == 0 && i + 1 < argc) {
+            dump_path = argv[++i];
+        } else if (!program_path) {
+            program_path = argv[i];
+        } else if (!disk_path) {
+            disk_path = argv[i];
         }
-        fseek(f, 0, SEEK_END);
-        long size = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        input = (char *)malloc((size_t)size + 1);
+    }
+
+    char *input = NULL;
+    if (program_path) {
+        size_t size;
+        input = read_file(program_path, &size);
         if (!input) {
-            perror("malloc");
-            fclose(f);
             return 1;
         }
-        if (fread(input, 1, (size_t)size, f) != (size_t)size) {
-            perror("fread");
-            fclose(f);
-            free(input);
-            return 1;
-        }
-        input[size] = '\0';
-        fclose(f);
+    }
+    size_t image_len = 0;
+    char *image = image_path ? read_file(image_path, &image_len) : NULL;
+    if (image_path && !image) {
+        return 1;
     }
 
     const size_t heap_cells = 4096;
@@ -113,8 +222,8 @@ int main(int argc, char **argv) {
     }
 
     HostDisk disk = {0};
-    if (argc > 2) {
-        FILE *df = fopen(argv[2], "rb");
+    if (disk_path) {
+        FILE *df = fopen(disk_path, "rb");
         if (!df) {
             perror("fopen");
             return 1;
@@ -146,7 +255,16 @@ int main(int argc, char **argv) {
     cfg.sym_buf_size = sym_buf_size;
     cfg.str_buf = str_buf;
     cfg.str_buf_size = str_buf_size;
-    cfg.platform.user = argc > 2 ? &disk : NULL;
+    cfg.heap_grow_cells = heap_cells;
+    cfg.heap_max_cells = 0;
+    cfg.arena_grow_bytes = str_buf_size;
+    cfg.gc_mode = gc_mode;
+    cfg.gc_pause_cells = gc_pause_cells;
+    cfg.quota.arena_bytes = 0;
+    cfg.quota.cpu_ticks = 0;
+    cfg.quota.disk_bytes = 0;
+    cfg.quota.output_bytes = 0;
+    cfg.platform.user = disk_path ? &disk : NULL;
     cfg.platform.putc = host_putc;
     cfg.platform.panic = host_panic;
     cfg.platform.foreign_call = host_foreign_call;
@@ -155,14 +273,94 @@ int main(int argc, char **argv) {
     cfg.platform.read_char = host_read_char;
     cfg.platform.write_bytes = host_write_bytes;
     cfg.platform.spawn_thread = NULL;
+    cfg.platform.alloc = host_alloc;
+    cfg.platform.free = host_free;
+    cfg.platform.channel_make = NULL;
+    cfg.platform.channel_send = NULL;
+    cfg.platform.channel_recv = NULL;
+    cfg.platform.now_ns = host_now_ns;
+    cfg.platform.trace = NULL;
+
+    Scheme shared;
+    SchemeConfig shared_cfg = cfg;
+    shared_cfg.heap = NULL;
+    shared_cfg.sym_buf = NULL;
+    shared_cfg.str_buf = NULL;
+    if (shared_heap && !image) {
+        shared_cfg.heap = (struct Cell *)calloc(heap_cells, sizeof(struct Cell));
+        shared_cfg.sym_buf = (char *)calloc(sym_buf_size, 1);
+        shared_cfg.str_buf = (char *)calloc(str_buf_size, 1);
+        shared_cfg.gc_mode = SCHEME_GC_MARK_SWEEP;
+        shared_cfg.gc_pause_cells = 0;
+        if (!shared_cfg.heap || !shared_cfg.sym_buf || !shared_cfg.str_buf) {
+            perror("calloc");
+            return 1;
+        }
+        scheme_init(&shared, &shared_cfg);
+        if (scheme_freeze(&shared) < 0) {
+            fprintf(stderr, "scheme-host: cannot freeze shared heap\n");
+            return 1;
+        }
+    }
+
+    unsigned long long start = host_now_ns(NULL);
+    if (image) {
+        if (scheme_load_image(&sc, &cfg, (const unsigned char *)image, image_len) < 0) {
+            fprintf(stderr, "scheme-host: cannot load heap image %s\n", image_path);
+            return 1;
+        }
+    } else if (shared_cfg.heap) {
+        scheme_init_shared(&sc, &shared, &cfg);
+    } else {
+        scheme_init(&sc, &cfg);
+    }
+    host_profile_init(&sc);
+    int status = scheme_eval_string(&sc, input ? input : default_program) < 0 ? 1 : 0;
+    unsigned long long end = host_now_ns(NULL);
+
+    if (dump_path) {
+        unsigned char *out;
+        size_t out_len;
+        if (scheme_dump_image(&sc, &out, &out_len) < 0) {
+            fprintf(stderr, "scheme-host: cannot dump heap image\n");
+            return 1;
+        }
+        FILE *f = fopen(dump_path, "wb");
+        if (!f || fwrite(out, 1, out_len, f) != out_len) {
+            perror("fwrite");
+            return 1;
+        }
+        fclose(f);
+        free(out);
+    }
 
-    scheme_init(&sc, &cfg);
-    scheme_eval_string(&sc, input ? input : default_program);
+    if (show_stats) {
+        // One JSON object on stderr so it never mixes with program output.
+        SchemeStats stats;
+        scheme_get_stats(&sc, &stats);
+        fflush(stdout);
+        fprintf(stderr,
+                "{\"wall_ns\": %llu, \"cells_allocated\": %zu, \"cells_freed\": %zu, "
+                "\"gc_count\": %zu, \"heap_cells\": %zu, \"live_cells\": %zu, "
+                "\"str_arena_peak\": %zu, \"sym_arena_peak\": %zu, "
+                "\"mark_ns\": %llu, \"sweep_ns\": %llu, \"max_pause_ns\": %llu}\n",
+                end - start, stats.cells_allocated, stats.cells_freed, stats.gc_count, stats.heap_cells,
+                stats.live_cells, stats.str_arena_peak, stats.sym_arena_peak, stats.mark_ns, stats.sweep_ns,
+                stats.max_pause_ns);
+    }
+    scheme_destroy(&sc);
+    if (shared_cfg.heap) {
+        scheme_destroy(&shared);
+    }
 
     free(input);
+    free(image);
     free(disk.data);
     free(heap);
     free(sym_buf);
     free(str_buf);
-    return 0;
+    free(shared_cfg.heap);
+    free(shared_cfg.sym_buf);
+    free(shared_cfg.str_buf);
+    return status;
 }
@@ -12,6 +12,7 @@ INIT_NAME="$(basename "$INIT_PATH" .scm)"
 BUILD_DIR="$ROOT_DIR/build"
 MKFS="$ROOT_DIR/scripts/mkfs.py"
 QEMU="${QEMU:-qemu-system-i386}"
+SMP="${SLOPOS_SMP:-1}"
 SNAPSHOT_FLAG="-snapshot"
 if [[ "${SLOPOS_NO_SNAPSHOT:-}" == "1" ]]; then
   SNAPSHOT_FLAG=""
@@ -33,7 +34,12 @@ mkdir -p "$TMP_DIR"
 cp "$ROOT_DIR/programs/"*.scm "$TMP_DIR/"
 cp "$INIT_PATH" "$TMP_DIR/init.scm"
 FS_IMG="$BUILD_DIR/test_${INIT_NAME}_fs.img"
-python3 "$MKFS" "$TMP_DIR" "$FS_IMG"
+if [[ "${SLOPOS_NO_HEAP_IMAGE:-}" == "1" ]]; then
+  python3 "$MKFS" "$TMP_DIR" "$FS_IMG"
+else
+  make -C "$ROOT_DIR" -s build/scheme-host
+  python3 "$MKFS" --heap-image "$BUILD_DIR/scheme-host" "$TMP_DIR" "$FS_IMG"
+fi
 
 make -C "$ROOT_DIR" -s build/kernel.bin
 rm -f "$BUILD_DIR/stage2.bin"
@@ -71,11 +77,11 @@ fi
 
 if [[ -z "${INPUT_FILE}" || ! -s "$INPUT_FILE" ]]; then
   set +e
-  "$QEMU" -drive if=floppy,format=raw,file="$IMG" -drive if=ide,format=raw,file="$FS_IMG" $SNAPSHOT_FLAG -display none -serial stdio -monitor none -device isa-debug-exit,iobase=0xf4,iosize=0x04
+  "$QEMU" -smp "$SMP" -drive if=floppy,format=raw,file="$IMG" -drive if=ide,format=raw,file="$FS_IMG" $SNAPSHOT_FLAG -display none -serial stdio -monitor none -device isa-debug-exit,iobase=0xf4,iosize=0x04
   exit 0
 fi
 
-python3 - "$INPUT_FILE" "$QEMU" "$IMG" "$FS_IMG" "$SNAPSHOT_FLAG" <<'PY'
+python3 - "$INPUT_FILE" "$QEMU" "$IMG" "$FS_IMG" "$SNAPSHOT_FLAG" "$SMP" <<'PY'
 import os
 import pty
 import select
@@ -89,9 +95,11 @@ qemu = sys.argv[2]
 img = sys.argv[3]
 fs_img = sys.argv[4]
 snapshot_flag = sys.argv[5]
+smp = sys.argv[6]
 
 args = [
     qemu,
+    "-smp", smp,
     "-drive", f"if=floppy,format=raw,file={img}",
     "-drive", f"if=ide,format=raw,file={fs_img}",
     "-device", "isa-debug-exit,iobase=0xf4,iosize=0x04",
@@ -1,3 +1,4 @@
+import importlib.util
 import os
 import struct
 import subprocess
@@ -8,14 +9,19 @@ ROOT = Path(__file__).resolve().parent.parent
 TEST_SH = ROOT / "test.sh"
 
 
-def run_init(
+def run_init_raw(
     path: Path,
     input_text: str = "",
     snapshot: bool = True,
     timeout: int = 15,
     slow_input: bool = False,
-) -> str:
+    smp: int = 1,
+    heap_image: bool = True,
+) -> bytes:
     env = os.environ.copy()
+    env["SLOPOS_SMP"] = str(smp)
+    if not heap_image:
+        env["SLOPOS_NO_HEAP_IMAGE"] = "1"
     if not snapshot:
         env["SLOPOS_NO_SNAPSHOT"] = "1"
     if slow_input:
@@ -30,7 +36,11 @@ def run_init(
         timeout=timeout,
         env=env,
     )
-    out = proc.stdout.decode(errors="replace")
+    return proc.stdout
+
+
+def run_init(path: Path, input_text: str = "", **kwargs) -> str:
+    out = run_init_raw(path, input_text, **kwargs).decode(errors="replace")
     out = out.replace("\r\n", "\n")
     if "SlopOS booting..." in out:
         out = out[out.index("SlopOS booting...") :]
@@ -60,6 +70,112 @@ def test_gc_stress_script_runs():
     out = run_init(ROOT / "init_scripts" / "gc_stress.scm")
     assert "SlopOS booting..." in out
     assert "gc stress ok" in out
+    assert "collections counted" in out
+    assert "cells freed counted" in out
+    assert "live below heap" in out
+
+
+def test_copying_collector_moves_live_data():
+    out = run_init(ROOT / "init_scripts" / "gc_copying.scm")
+    # eq? table keys are found again after the collector moved them.
+    assert "\nfirst\nsecond\nabsent\n" in out
+    assert "\nkept\n6\n2\n" in out
+    assert "\n31\ncopying gc ok\n" in out
+
+
+def test_incremental_collector_keeps_stored_data():
+    out = run_init(ROOT / "init_scripts" / "gc_incremental.scm")
+    # Lists stored by set!, vector-set! and hash-set! while a cycle ran.
+    assert "\n55\n420\n930\n" in out
+    assert "\n120\n78\nincremental gc ok\n" in out
+
+
+def test_vectors_and_bytevectors():
+    out = run_init(ROOT / "init_scripts" / "vectors.scm")
+    assert "vector ok" in out
+    assert "\n120\n305419896\n" in out
+    assert "bytes round trip" in out
+    assert "bytevector churn ok\n0\n" in out
+    # The rewrite replaced the first entry rather than adding a second one.
+    assert "second\n1\n" in out
+
+
+def test_string_primitives_and_builder():
+    out = run_init(ROOT / "init_scripts" / "strings.scm")
+    assert "\nworld\nconcatenate\n1\nindex missing ok\n5\n" in out
+    assert "\n299\nabcab\n" in out
+
+
+def test_hash_tables():
+    out = run_init(ROOT / "init_scripts" / "hashtables.scm")
+    assert "\n2\nforty-two\nnone\n" in out
+    assert "\n502\n998001\nremoved key gone\n" in out
+    assert "\nlib\n1\n" in out
+
+
+def test_compile_cache_reuses_and_invalidates():
+    out = run_init(ROOT / "init_scripts" / "compile_cache.scm")
+    assert "hello\nhello\nhello\n2\n" in out
+    assert "goodbye\n2\n" in out
+    assert "absent missing" in out
+
+
+def test_reader_edge_cases():
+    out = run_init(ROOT / "init_scripts" / "reader.scm")
+    assert "\n40\n41\n32\n-12\n3\n42\n-2147483647\n" in out
+
+
+def test_integers_promote_to_bignums():
+    out = run_init(ROOT / "init_scripts" / "bignum.scm")
+    assert (
+        "265252859812191058636308480000000\n2147483648\n-2147483649\n0\n"
+        "123456789012345678901234567890\n870\n559267619\n#t\n#t\n"
+        "-9999999999800000000001\n+: expected number\n"
+    ) in out
+    # Bignums survive a trip through a channel.
+    assert "15511210043330985984000000\n" in out
+
+
+def test_native_comparisons_and_fixed_arity_calls():
+    out = run_init(ROOT / "init_scripts" / "arith.scm")
+    assert (
+        "#t #f #t #f #t \n#t #f #t #t #t \n#t #f #t #f #f \n42 2147483648 1 \n"
+        "<: expected number +: expected number zero?: expected number \n"
+        "3 2 modulo: divide by zero \n"
+    ) in out
+
+
+def test_errors_are_caught_and_contained():
+    out = run_init(ROOT / "init_scripts" / "errors.scm")
+    assert (
+        "divide by zero\n7\ncaught symbol\n42\nouter passed\ncar: expected pair\n"
+        "parse error at line 1, column 1: unterminated list\n30\n"
+    ) in out
+    # The failing child thread reports its error and the main script goes on.
+    assert "child\n" in out
+    assert "scheme error: car: expected pair" in out
+    assert "main continues" in out
+    assert "scheme error: unbound symbol: missing-procedure" in out
+    assert "unreachable" not in out
+
+
+def test_heap_image_skips_prelude_evaluation():
+    script = ROOT / "init_scripts" / "heap_image.scm"
+
+    def allocated(out):
+        assert "prelude ready" in out
+        return int(out.split("allocated ", 1)[1].split()[0])
+
+    with_image = allocated(run_init(script))
+    data = (ROOT / "build" / "test_heap_image_fs.img").read_bytes()
+    boot_len, _ = struct.unpack_from("<II", data, 0)
+    image_offset = (8 + boot_len + 15) // 16 * 16
+    assert data[image_offset : image_offset + 8] == b"SLOPIMG1"
+
+    # Without an image the kernel falls back to evaluating boot.scm, which
+    # parses and runs fs.scm before init.scm starts.
+    without_image = allocated(run_init(script, heap_image=False))
+    assert with_image * 2 < without_image
 
 
 def test_spawn_threads_script_runs():
@@ -71,6 +187,77 @@ def test_spawn_threads_script_runs():
     assert "t2done" in out
 
 
+def test_spawned_threads_shadow_the_shared_prelude_privately():
+    out = run_init(ROOT / "init_scripts" / "shared_heap.scm")
+    assert "t1-shadowed" in out
+    assert "t1-set" in out
+    assert "t2-shared" in out
+    assert "broken" not in out
+
+
+def test_spawned_threads_are_stopped_by_quotas():
+    out = run_init(ROOT / "init_scripts" / "quota.scm")
+    assert "scheme error: cpu quota exceeded" in out
+    assert "caught" not in out
+    assert "0123456789012345678901234scheme error: output quota exceeded" in out
+    assert "child-cpu-limit3000\n" in out
+    assert "parent alive\nparent cpu-limit 0\n" in out
+
+
+def test_channels_pass_values_between_threads():
+    out = run_init(ROOT / "init_scripts" / "channel.scm")
+    assert "SlopOS booting..." in out
+    assert "3^2=9" in out
+    assert "4^2=16" in out
+    assert "5^2=25" in out
+    assert "channel done" in out
+
+
+def test_profiler_reports_hot_functions():
+    out = run_init(ROOT / "init_scripts" / "profile.scm")
+    assert "profile: " in out
+    assert "% fib" in out
+    assert "fib -> fib" in out
+    assert "profile has samples" in out
+
+
+def test_tsc_clock_and_sub_tick_sleep():
+    out = run_init(ROOT / "init_scripts" / "timing.scm")
+    assert "sleep long enough" in out
+    assert "sleep was sub-tick" in out
+
+
+def load_trace_decoder():
+    spec = importlib.util.spec_from_file_location("trace_decode", ROOT / "scripts" / "trace_decode.py")
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def test_trace_dump_records_kernel_events():
+    raw = run_init_raw(ROOT / "init_scripts" / "trace.scm")
+    assert b"trace start" in raw
+    decoder = load_trace_decoder()
+    header, records = decoder.parse(raw)
+    kinds = {r[1] for r in records}
+    assert header["count"] == len(records) > 0
+    assert decoder.CTX_SWITCH in kinds
+    assert decoder.THREAD_SPAWN in kinds
+    assert decoder.GC_START in kinds and decoder.GC_END in kinds
+    assert decoder.DISK_WRITE_START in kinds and decoder.DISK_WRITE_END in kinds
+    stamps = [r[0] for r in records]
+    assert stamps == sorted(stamps)
+
+
+def test_threads_and_channels_on_multiple_cpus():
+    out = run_init(ROOT / "init_scripts" / "spawn.scm", smp=4)
+    assert "t1done" in out
+    assert "t2done" in out
+    out = run_init(ROOT / "init_scripts" / "channel.scm", smp=4)
+    assert "5^2=25" in out
+    assert "channel done" in out
+
+
 def _read_file_from_fs(img_path: Path, filename: str) -> str:
     data = img_path.read_bytes()
     boot_len, fs_offset = struct.unpack_from("<II", data, 0)
@@ -110,6 +297,23 @@ def test_list_files():
     assert "factorial.scm" in out
 
 
+def test_shell_exec_error_returns_to_prompt():
+    input_text = "\n".join(
+        [
+            "create bad.scm",
+            "(car 1)",
+            "EOF",
+            "exec bad.scm",
+            "ls",
+            "exit",
+            "",
+        ]
+    )
+    out = run_init(ROOT / "init_scripts" / "shell.scm", input_text, timeout=10, slow_input=True)
+    assert "error: car: expected pair" in out
+    assert "bad.scm\n" in out.split("error: car: expected pair", 1)[1]
+
+
 def test_shell_create_two_files():
     input_text = "\n".join(
         [